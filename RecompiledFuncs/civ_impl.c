@@ -11,43 +11,161 @@
 
 #include "recomp/cpu.h"
 #include "recomp/dos_compat.h"
+#include "recomp/dispatch.h"
+#include "recomp/log.h"
+#include "recomp/pic.h"
+#include "recomp/asset_cache.h"
+#include "hal/gfx.h"
 #include "hal/input.h"
 #include "hal/timer.h"
+#include "civ_globals.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-/* Access the global DOS state for keyboard/file operations */
+/* Access the instance's DOS state for keyboard/file operations */
 extern DosState *get_dos_state(CPU *cpu);
 
 /* Forward declarations for functions we reference */
 extern void res_020FA0(CPU *cpu);
 
+/* ─── Per-instance state ─── */
+/* What these routines keep between calls belongs to one game, so it
+ * hangs off its DosState (dos->game) rather than living in statics;
+ * counters that only pace log output stay static. */
+
+/* The .PIC image being decoded, as far as the asset cache is concerned */
+typedef struct {
+    uint32_t        size;       /* Bytes the rows will add up to; 0 = untracked */
+    uint32_t        pos;        /* Bytes handed out so far */
+    int             handle;     /* DOS handle the data is read from */
+    uint8_t         is_4bit;
+    const PicImage *cached;     /* Rows are served from here */
+    uint8_t        *record;     /* Decoded rows, for the cache */
+    uint8_t         start_first, start_chr;    /* The decode's start bytes */
+} PicTrack;
+
+typedef struct {
+    uint8_t    pending_scan;        /* getch: scan code still to return */
+    int        timer_speed;         /* Timer multiplier for the delay routines */
+    uint32_t   delay_start_ticks;   /* far_0000_0330 */
+    uint16_t   heap_break;          /* Near heap break pointer (res_0222C0) */
+    int        heap_chain_fixed;
+    uint32_t   rng_seed;
+    int        rng_seeded;
+
+    /* Calls between event polls in the drawing and timer routines */
+    uint32_t   fill_calls, blit_calls, tick_reads;
+    int        key_prompts;         /* far_0000_09E5, shown in its prompt */
+
+    PicDecoder pic;
+    PicTrack   pic_img;
+    uint8_t    wrap_buf[0x20000];   /* A PIC row that wraps around ES */
+} CivState;
+
+/* What a snapshot keeps of CivState: the guest-visible state. The poll
+ * counters only pace host work, and the PIC decoder keeps what the next
+ * decode reads from the last one. */
+typedef struct {
+    uint32_t delay_start_ticks;
+    uint32_t rng_seed;
+    int32_t  timer_speed;
+    int32_t  heap_chain_fixed;
+    int32_t  rng_seeded;
+    int32_t  key_prompts;
+    uint16_t heap_break;
+    uint8_t  pending_scan;
+    PicState pic;
+} CivSave;
+
+static void pic_image_end(CivState *s);
+
+static void civ_state_save(const void *game, void *buf)
+{
+    const CivState *s = (const CivState *)game;
+    CivSave v;
+    memset(&v, 0, sizeof(v));
+    v.delay_start_ticks = s->delay_start_ticks;
+    v.rng_seed = s->rng_seed;
+    v.timer_speed = s->timer_speed;
+    v.heap_chain_fixed = s->heap_chain_fixed;
+    v.rng_seeded = s->rng_seeded;
+    v.key_prompts = s->key_prompts;
+    v.heap_break = s->heap_break;
+    v.pending_scan = s->pending_scan;
+    pic_save_state(&s->pic, &v.pic);
+    memcpy(buf, &v, sizeof(v));
+}
+
+static void civ_state_load(void *game, const void *buf)
+{
+    CivState *s = (CivState *)game;
+    CivSave v;
+    memcpy(&v, buf, sizeof(v));
+    s->delay_start_ticks = v.delay_start_ticks;
+    s->rng_seed = v.rng_seed;
+    s->timer_speed = v.timer_speed;
+    s->heap_chain_fixed = v.heap_chain_fixed;
+    s->rng_seeded = v.rng_seeded;
+    s->key_prompts = v.key_prompts;
+    s->heap_break = v.heap_break;
+    s->pending_scan = v.pending_scan;
+    pic_image_end(s);           /* No image is half read at a restore point */
+    pic_load_state(&s->pic, &v.pic);
+}
+
+static void civ_state_free(void *game)
+{
+    CivState *s = (CivState *)game;
+    if (s->pic_img.cached)
+        asset_cache_release(s->pic_img.cached, 0);
+    free(s->pic_img.record);
+    free(s);
+}
+
+static CivState *civ_state(CPU *cpu)
+{
+    DosState *dos = get_dos_state(cpu);
+    if (!dos->game) {
+        CivState *s = (CivState *)calloc(1, sizeof(CivState));
+        if (!s) {
+            fprintf(stderr, "[FATAL] cannot allocate the game state\n");
+            exit(1);
+        }
+        s->timer_speed = 20;        /* Speeds up animation during world gen */
+        s->heap_break = 0xF7F0;     /* Starts at BSS end */
+        dos->game = s;
+        dos->game_free = civ_state_free;
+        dos->game_save_size = sizeof(CivSave);
+        dos->game_save = civ_state_save;
+        dos->game_load = civ_state_load;
+    }
+    return (CivState *)dos->game;
+}
+
 /* ─── MSC CRT: getch() ─── */
 /* far_205A_20AA - Read a character from keyboard without echo.
- * Blocking: pumps SDL event loop while waiting for input.
+ * Blocking: sleeps in dos_wait_input until a key arrives.
  * Extended keys (arrows, F-keys): first call returns 0,
  * second call returns the scan code. */
 void far_205A_20AA(CPU *cpu)
 {
-    static uint8_t pending_scan = 0;
-    if (pending_scan) {
-        cpu->ax = (uint16_t)pending_scan;
-        pending_scan = 0;
+    CivState *s = civ_state(cpu);
+    if (s->pending_scan) {
+        cpu->ax = (uint16_t)s->pending_scan;
+        s->pending_scan = 0;
         return;
     }
     DosState *dos = get_dos_state(cpu);
-    fprintf(stderr, "[BLOCK] Waiting for key in far_205A_20AA (getch)\n");
-    while (!keyboard_available(&dos->keyboard)) {
-        if (dos->poll_events)
-            dos->poll_events(dos->platform_ctx, dos, cpu);
-    }
+    LOG_DEBUG(LOG_KEY, "[BLOCK] Waiting for key in far_205A_20AA (getch)\n");
+    dos_wait_input(cpu, DOS_WAIT_FOREVER);
     uint16_t key = keyboard_read(&dos->keyboard);
-    fprintf(stderr, "[KEY] getch: 0x%04X\n", key);
+    LOG_INFO(LOG_KEY, "[KEY] getch: 0x%04X\n", key);
     uint8_t ascii = (uint8_t)(key & 0xFF);
     if (ascii == 0 && key != 0) {
-        pending_scan = (uint8_t)(key >> 8);
+        s->pending_scan = (uint8_t)(key >> 8);
         cpu->ax = 0;
     } else {
         cpu->ax = (uint16_t)ascii;
@@ -61,17 +179,9 @@ void far_205A_20AA(CPU *cpu)
  * Pumps the SDL event loop before checking. */
 void far_205A_2096(CPU *cpu)
 {
-    static uint64_t call_count = 0;
-    call_count++;
-    DosState *dos = get_dos_state(cpu);
-    if (dos->poll_events)
-        dos->poll_events(dos->platform_ctx, dos, cpu);
-    cpu->ax = keyboard_available(&dos->keyboard) ? 0x00FF : 0x0000;
-    if (call_count <= 5 || (call_count % 500) == 0) {
-        fprintf(stderr, "[KBHIT] #%llu result=%u\n",
-                (unsigned long long)call_count, cpu->ax);
-        fflush(stderr);
-    }
+    cpu->ax = dos_poll_input(cpu) ? 0x00FF : 0x0000;
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_KEY, 5, 500, "[KBHIT] #%llu result=%u\n",
+                (unsigned long long)log_hit, cpu->ax);
     cpu->sp += 4; /* far ret */
 }
 
@@ -97,7 +207,9 @@ L_res_021BAE_refill:;
     res_020FA0(cpu);
     cpu->sp = (uint16_t)(flags_add16(cpu, cpu->sp, 0x2));
 L_res_021BAE_done:;
-    { static int gc=0; gc++; if ((gc >= 30 && gc <= 50) || (gc >= 100 && gc <= 120)) { fprintf(stderr, "[GETC] #%d ch=%02X('%c')\n", gc, cpu->ax, (cpu->ax >= 0x20 && cpu->ax < 0x7F) ? cpu->ax : '.'); fflush(stderr); } }
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_KEY, 20, 100, "[GETC] #%llu ch=%02X('%c')\n",
+                (unsigned long long)log_hit, cpu->ax,
+                (cpu->ax >= 0x20 && cpu->ax < 0x7F) ? cpu->ax : '.');
     cpu->si = (uint16_t)(pop16(cpu));
     cpu->sp += 4; /* far ret - callers use push cs + call near */
     return;
@@ -109,32 +221,49 @@ void res_031BAE(CPU *cpu)
     res_021BAE(cpu);
 }
 
+/* ─── Display: page copy ─── */
+/* Copy a 320x200 back buffer page to the VGA framebuffer. Only rows that
+ * differ are copied and marked dirty, so an unchanged frame costs a
+ * compare and nothing downstream (the renderer skips clean rows). */
+static void gfx_present_page(CPU *cpu, uint32_t src)
+{
+    if (src + 64000 > MEM_SIZE) return;
+    for (int y = 0; y < 200; y++) {
+        uint8_t *d = &cpu->mem[0xA0000 + (uint32_t)y * 320];
+        const uint8_t *s = &cpu->mem[src + (uint32_t)y * 320];
+        if (memcmp(d, s, 320) != 0) {
+            memcpy(d, s, 320);
+            vga_mark_rows(cpu, y, y + 1);
+        }
+    }
+}
+
+/* Non-zero pixels in the VGA framebuffer, counting stops at limit */
+static int vga_nonzero(const CPU *cpu, int limit)
+{
+    int nonzero = 0;
+    for (int i = 0; i < 64000 && nonzero < limit; i++) {
+        if (cpu->mem[0xA0000 + i] != 0) nonzero++;
+    }
+    return nonzero;
+}
+
 /* ─── Display: end frame ─── */
 /* far_01A7_0252 - Copy active back buffer page to VGA framebuffer.
  * Called at end of frame. DS:0xAA points to GFX struct.
  * GFX struct[+00] = page flag (0=direct, 1=page1, 2=page2). */
 void far_01A7_0252(CPU *cpu)
 {
-    static int call_count = 0;
-    call_count++;
     uint16_t gfx_ptr = mem_read16(cpu, cpu->ds, 0xAA);
     uint16_t page = mem_read16(cpu, cpu->ds, gfx_ptr); /* struct[+00] page flag */
     if (page != 0) {
-        uint32_t src = gfx_page_addr(page);
-        if (src + 64000 <= MEM_SIZE) {
-            memcpy(&cpu->mem[0xA0000], &cpu->mem[src], 64000);
-        }
+        gfx_present_page(cpu, gfx_page_addr(page));
     }
 
-    if (call_count <= 5 || (call_count % 100) == 0) {
-        /* Scan VGA framebuffer for non-zero pixels */
-        int nonzero = 0;
-        for (int i = 0; i < 64000 && nonzero < 20; i++) {
-            if (cpu->mem[0xA0000 + i] != 0) nonzero++;
-        }
-        fprintf(stderr, "[FRAME] end_frame #%d page=%d gfx=%04X nonzero=%d\n",
-                call_count, page, gfx_ptr, nonzero);
-    }
+    /* Count (up to 20) non-zero pixels in the VGA framebuffer */
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_GFX, 5, 100,
+                "[FRAME] end_frame #%llu page=%d gfx=%04X nonzero=%d\n",
+                (unsigned long long)log_hit, page, gfx_ptr, vga_nonzero(cpu, 20));
 
     /* Yield after rendering */
     DosState *dos = get_dos_state(cpu);
@@ -148,10 +277,7 @@ void far_01A7_0252(CPU *cpu)
 /* far_01A7_026A - Begin a new display frame. */
 void far_01A7_026A(CPU *cpu)
 {
-    static int frame_count = 0;
-    frame_count++;
-    if (frame_count <= 5 || (frame_count % 100) == 0)
-        fprintf(stderr, "[FRAME] begin_frame #%d\n", frame_count);
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_GFX, 5, 100, "[FRAME] begin_frame #%d\n", (int)log_hit);
     cpu->sp += 4; /* far ret */
 }
 
@@ -221,8 +347,7 @@ void far_0000_077D(CPU *cpu)
  * display primitives (0856, 084F, 0848) are wrong, causing hangs. */
 void far_1FB6_044A(CPU *cpu)
 {
-    fprintf(stderr, "[BYPASS] far_1FB6_044A (story display) skipped\n");
-    fflush(stderr);
+    LOG_INFO(LOG_DIAG, "[BYPASS] far_1FB6_044A (story display) skipped\n");
     cpu->sp += 4; /* far ret */
 }
 
@@ -234,10 +359,7 @@ void far_085F_259C(CPU *cpu)
     uint16_t gfx_ptr = mem_read16(cpu, cpu->ds, 0xAA);
     uint16_t page = mem_read16(cpu, cpu->ds, gfx_ptr); /* struct[+00] page flag */
     if (page != 0) {
-        uint32_t src = gfx_page_addr(page);
-        if (src + 64000 <= MEM_SIZE) {
-            memcpy(&cpu->mem[0xA0000], &cpu->mem[src], 64000);
-        }
+        gfx_present_page(cpu, gfx_page_addr(page));
     }
     cpu->sp += 4; /* far ret */
 }
@@ -248,8 +370,6 @@ void far_085F_259C(CPU *cpu)
  * Reads filename pointer from stack. */
 void far_0000_065C(CPU *cpu)
 {
-    static int call_count = 0;
-    call_count++;
     /* Stack: [ret_addr 4 bytes] [path_off 2 bytes] [mode 2 bytes] */
     uint16_t path_off = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 4));
     DosState *dos = get_dos_state(cpu);
@@ -265,18 +385,14 @@ void far_0000_065C(CPU *cpu)
     dos_path[i] = 0;
 
     char native_path[520];
-    snprintf(native_path, sizeof(native_path), "%s/%s", dos->game_dir, dos_path);
-
-    FILE *f = fopen(native_path, "rb");
-    if (f) {
-        fclose(f);
-        cpu->ax = 0;
-    } else {
-        cpu->ax = 0xFFFF;
-    }
-    if (call_count <= 10)
-        fprintf(stderr, "[ACCESS] #%d off=%04X path='%s' result=%s\n",
-                call_count, path_off, native_path, f ? "EXISTS" : "NOT_FOUND");
+    int n = snprintf(native_path, sizeof(native_path), "%s/%s", dos->game_dir, dos_path);
+
+    /* A path too long to build can't name an existing file */
+    int exists = n >= 0 && n < (int)sizeof(native_path) &&
+                 dos_file_attributes(dos, native_path, sizeof(native_path)) >= 0;
+    cpu->ax = exists ? 0 : 0xFFFF;
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_FILE, 10, 0, "[ACCESS] #%llu off=%04X path='%s' result=%s\n",
+                (unsigned long long)log_hit, path_off, native_path, exists ? "EXISTS" : "NOT_FOUND");
     cpu->sp += 4; /* far ret */
 }
 
@@ -295,19 +411,8 @@ void far_0000_065C(CPU *cpu)
  *   Page 0 = VGA framebuffer (0xA0000)
  *   Page 1 = 0xC0000 (768KB mark, 64KB)
  *   Page 2 = 0xD0000 (832KB mark, 64KB)
+ * (GFX_PAGE_*, GfxContext and the drawing primitives are in hal/gfx.h)
  */
-#define GFX_PAGE_VGA   0xA0000
-#define GFX_PAGE_1     0xC0000
-#define GFX_PAGE_2     0xD0000
-
-static uint32_t gfx_page_addr(uint16_t page)
-{
-    switch (page) {
-    case 1:  return GFX_PAGE_1;
-    case 2:  return GFX_PAGE_2;
-    default: return GFX_PAGE_VGA;
-    }
-}
 
 /* far_0000_0BEC - Fill a rectangle in the active drawing page.
  * Stack params (cdecl, caller cleans 12 bytes):
@@ -319,15 +424,14 @@ static uint32_t gfx_page_addr(uint16_t page)
  *   [bp+10] color    - palette index */
 void far_0000_0BEC(CPU *cpu)
 {
-    static uint64_t call_count = 0;
-    call_count++;
+    CivState *s = civ_state(cpu);
 
     /* Yield periodically so the window stays responsive */
-    if (call_count % 50 == 0) {
+    if (++s->fill_calls % 50 == 0) {
         DosState *dos = get_dos_state(cpu);
         if (dos->poll_events)
             dos->poll_events(dos->platform_ctx, dos, cpu);
-        uint64_t ms = (uint64_t)clock() * 1000ULL / CLOCKS_PER_SEC;
+        uint64_t ms = timer_now_ms(&dos->timer);
         timer_update(&dos->timer, ms);
     }
 
@@ -340,25 +444,20 @@ void far_0000_0BEC(CPU *cpu)
     int16_t height = (int16_t)mem_read16(cpu, cpu->ss, (uint16_t)(sp + 8));
     uint8_t color  = (uint8_t)mem_read16(cpu, cpu->ss, (uint16_t)(sp + 10));
 
-    if (call_count <= 5 || (call_count % 500) == 0) {
-        fprintf(stderr, "[FILL] #%llu gfx=DS:%04X x=%d y=%d w=%d h=%d color=%d\n",
-                (unsigned long long)call_count, gfx_ptr, x, y, width, height, color);
-    }
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_GFX, 5, 500,
+                "[FILL] #%llu gfx=DS:%04X x=%d y=%d w=%d h=%d color=%d\n",
+                (unsigned long long)log_hit, gfx_ptr, x, y, width, height, color);
     /* Dump game state on first few minimap fills to diagnose the loop */
     if (x == 160 && y == 0 && width == 80 && height == 50) {
-        static int minimap_count = 0;
-        minimap_count++;
-        if (minimap_count <= 5 || minimap_count == 100 || minimap_count == 1000) {
-            fprintf(stderr, "[DIAG] minimap_fill #%d: EB78=%04X 6B1A=%04X E71E=%04X 9102=%04X EE90=%04X sp=%04X\n",
-                    minimap_count,
+        LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_DIAG, 5, 1000,
+                    "[DIAG] minimap_fill #%llu: EB78=%04X 6B1A=%04X E71E=%04X 9102=%04X EE90=%04X sp=%04X\n",
+                    (unsigned long long)log_hit,
                     mem_read16(cpu, cpu->ds, 0xEB78),
                     mem_read16(cpu, cpu->ds, 0x6B1A),
                     mem_read16(cpu, cpu->ds, 0xE71E),
                     mem_read16(cpu, cpu->ds, 0x9102),
                     mem_read16(cpu, cpu->ds, 0xEE90),
                     cpu->sp);
-            fflush(stderr);
-        }
     }
 
     /* Early out: nothing to draw */
@@ -367,36 +466,10 @@ void far_0000_0BEC(CPU *cpu)
         return;
     }
 
-    /* Read GFX context struct from DS */
-    uint16_t page     = mem_read16(cpu, cpu->ds, gfx_ptr);       /* [+00] page flag */
-    int16_t  x_origin = (int16_t)mem_read16(cpu, cpu->ds, (uint16_t)(gfx_ptr + 2)); /* [+02] */
-    int16_t  y_origin = (int16_t)mem_read16(cpu, cpu->ds, (uint16_t)(gfx_ptr + 4)); /* [+04] */
-
-    /* Apply origin offsets */
-    x += x_origin;
-    y += y_origin;
-
-    uint32_t buf_base = gfx_page_addr(page);
-
-    /* Clip to screen bounds */
-    int16_t x1 = x, y1 = y;
-    int16_t x2 = x + width, y2 = y + height;
-    if (x1 < 0) x1 = 0;
-    if (y1 < 0) y1 = 0;
-    if (x2 > 320) x2 = 320;
-    if (y2 > 200) y2 = 200;
-    if (x1 >= x2 || y1 >= y2) {
-        cpu->sp += 4; /* far ret */
-        return;
-    }
-
-    /* Fill the rectangle */
-    for (int row = y1; row < y2; row++) {
-        uint32_t row_addr = buf_base + (uint32_t)row * 320 + (uint32_t)x1;
-        if (row_addr + (x2 - x1) <= MEM_SIZE) {
-            memset(&cpu->mem[row_addr], color, (size_t)(x2 - x1));
-        }
-    }
+    GfxContext gfx;
+    gfx_read_context(cpu, gfx_ptr, &gfx);
+    gfx_fill_rect(cpu, gfx.page, (int16_t)(x + gfx.x_origin), (int16_t)(y + gfx.y_origin),
+                  width, height, color);
     cpu->sp += 4; /* far ret */
 }
 
@@ -419,11 +492,10 @@ void far_0000_0BEC(CPU *cpu)
  */
 void far_0000_07ED(CPU *cpu)
 {
-    static uint64_t call_count = 0;
-    call_count++;
+    CivState *st = civ_state(cpu);
 
     /* Yield periodically */
-    if (call_count % 50 == 0) {
+    if (++st->blit_calls % 50 == 0) {
         DosState *dos = get_dos_state(cpu);
         if (dos->poll_events)
             dos->poll_events(dos->platform_ctx, dos, cpu);
@@ -439,70 +511,23 @@ void far_0000_07ED(CPU *cpu)
     int16_t dx       = (int16_t)mem_read16(cpu, cpu->ss, (uint16_t)(sp + 12));
     int16_t dy       = (int16_t)mem_read16(cpu, cpu->ss, (uint16_t)(sp + 14));
 
-    if (call_count <= 10 || (call_count % 1000) == 0) {
-        uint16_t sp2 = mem_read16(cpu, cpu->ds, src_gfx);
-        uint16_t dp2 = mem_read16(cpu, cpu->ds, dst_gfx);
-        fprintf(stderr, "[BLIT] #%llu src=DS:%04X(pg%d,%d,%d) %dx%d -> dst=DS:%04X(pg%d,%d,%d)\n",
-                (unsigned long long)call_count, src_gfx, sp2, sx, sy, width, height, dst_gfx, dp2, dx, dy);
-        fflush(stderr);
-    }
+    GfxContext src, dst;
+    gfx_read_context(cpu, src_gfx, &src);
+    gfx_read_context(cpu, dst_gfx, &dst);
 
-    if (width <= 0 || height <= 0) {
-        cpu->sp += 4; /* far ret */
-        return;
-    }
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_GFX, 10, 1000,
+                "[BLIT] #%llu src=DS:%04X(pg%d,%d,%d) %dx%d -> dst=DS:%04X(pg%d,%d,%d)\n",
+                (unsigned long long)log_hit, src_gfx, src.page,
+                sx, sy, width, height, dst_gfx, dst.page, dx, dy);
 
-    /* Read source GFX context */
-    uint16_t src_page     = mem_read16(cpu, cpu->ds, src_gfx);
-    int16_t  src_x_origin = (int16_t)mem_read16(cpu, cpu->ds, (uint16_t)(src_gfx + 2));
-    int16_t  src_y_origin = (int16_t)mem_read16(cpu, cpu->ds, (uint16_t)(src_gfx + 4));
-
-    /* Read destination GFX context */
-    uint16_t dst_page     = mem_read16(cpu, cpu->ds, dst_gfx);
-    int16_t  dst_x_origin = (int16_t)mem_read16(cpu, cpu->ds, (uint16_t)(dst_gfx + 2));
-    int16_t  dst_y_origin = (int16_t)mem_read16(cpu, cpu->ds, (uint16_t)(dst_gfx + 4));
-
-    /* Apply origin offsets */
-    sx += src_x_origin;
-    sy += src_y_origin;
-    dx += dst_x_origin;
-    dy += dst_y_origin;
-
-    uint32_t src_base = gfx_page_addr(src_page);
-    uint32_t dst_base = gfx_page_addr(dst_page);
-
-    /* Clip to screen bounds (320x200) */
-    int16_t src_x1 = sx, src_y1 = sy;
-    int16_t dst_x1 = dx, dst_y1 = dy;
-    int16_t copy_w = width, copy_h = height;
-
-    /* Clip left edge */
-    if (src_x1 < 0) { copy_w += src_x1; dst_x1 -= src_x1; src_x1 = 0; }
-    if (dst_x1 < 0) { copy_w += dst_x1; src_x1 -= dst_x1; dst_x1 = 0; }
-    /* Clip right edge */
-    if (src_x1 + copy_w > 320) copy_w = 320 - src_x1;
-    if (dst_x1 + copy_w > 320) copy_w = 320 - dst_x1;
-    /* Clip top edge */
-    if (src_y1 < 0) { copy_h += src_y1; dst_y1 -= src_y1; src_y1 = 0; }
-    if (dst_y1 < 0) { copy_h += dst_y1; src_y1 -= dst_y1; dst_y1 = 0; }
-    /* Clip bottom edge */
-    if (src_y1 + copy_h > 200) copy_h = 200 - src_y1;
-    if (dst_y1 + copy_h > 200) copy_h = 200 - dst_y1;
-
-    if (copy_w <= 0 || copy_h <= 0) {
+    if (width <= 0 || height <= 0) {
         cpu->sp += 4; /* far ret */
         return;
     }
 
-    /* Copy scanlines */
-    for (int row = 0; row < copy_h; row++) {
-        uint32_t s = src_base + (uint32_t)(src_y1 + row) * 320 + (uint32_t)src_x1;
-        uint32_t d = dst_base + (uint32_t)(dst_y1 + row) * 320 + (uint32_t)dst_x1;
-        if (s + copy_w <= MEM_SIZE && d + copy_w <= MEM_SIZE) {
-            memmove(&cpu->mem[d], &cpu->mem[s], (size_t)copy_w);
-        }
-    }
-
+    gfx_copy_rect(cpu, src.page, (int16_t)(sx + src.x_origin), (int16_t)(sy + src.y_origin),
+                  width, height,
+                  dst.page, (int16_t)(dx + dst.x_origin), (int16_t)(dy + dst.y_origin));
     cpu->sp += 4; /* far ret */
 }
 
@@ -514,10 +539,8 @@ void far_0000_07ED(CPU *cpu)
  * The terrain data was already generated by earlier pipeline stages. */
 void ovl07_035B6E(CPU *cpu)
 {
-    static int call_count = 0;
-    call_count++;
-    if (call_count <= 5 || (call_count % 1000) == 0)
-        fprintf(stderr, "[ANIM_SKIP] ovl07_035B6E call #%d sp=%04X\n", call_count, cpu->sp);
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_GFX, 5, 1000, "[ANIM_SKIP] ovl07_035B6E call #%d sp=%04X\n",
+                (int)log_hit, cpu->sp);
 
     /* Return AX=0 (no animation work to do) */
     cpu->ax = 0;
@@ -539,15 +562,13 @@ void far_205A_30E4(CPU *cpu)
     uint16_t size      = mem_read16(cpu, cpu->ss, (uint16_t)(sp + 6));
     uint16_t res_ptr   = mem_read16(cpu, cpu->ss, (uint16_t)(sp + 8));
 
-    DosState *dos = get_dos_state(cpu);
     uint16_t got = 0;
 
-    if (handle < DOS_MAX_HANDLES && dos->file_table.files[handle]) {
-        uint32_t dest = seg_off(buf_seg, buf_off);
-        if (dest + size <= MEM_SIZE) {
-            size_t n = fread(cpu->mem + dest, 1, size, dos->file_table.files[handle]);
+    uint32_t dest = seg_off(buf_seg, buf_off);
+    if (dest + size <= MEM_SIZE) {
+        long n = dos_file_read(get_dos_state(cpu), handle, cpu->mem + dest, size);
+        if (n > 0)
             got = (uint16_t)n;
-        }
     }
 
     /* Store result at SS:result_ptr */
@@ -582,13 +603,8 @@ void far_1DDE_007C(CPU *cpu)
     uint16_t arg2 = mem_read16(cpu, cpu->ss, (uint16_t)(sp + 2));
     uint16_t arg3 = mem_read16(cpu, cpu->ss, (uint16_t)(sp + 4));
 
-    static int call_count = 0;
-    call_count++;
-    if (call_count <= 5) {
-        fprintf(stderr, "[DELAY] far_1DDE_007C #%d args=(%u, %u, %u)\n",
-                call_count, arg1, arg2, arg3);
-        fflush(stderr);
-    }
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_INT, 5, 0, "[DELAY] far_1DDE_007C #%d args=(%u, %u, %u)\n",
+                (int)log_hit, arg1, arg2, arg3);
 
     /* Return the target time to indicate we've reached it */
     cpu->ax = arg3;
@@ -614,61 +630,53 @@ void far_0000_0838(CPU *cpu)
     cpu->sp += 4; /* far ret */
 }
 
-/* Timer speed multiplier - speeds up animation during world gen */
-static int timer_speed = 20;
-
 /* ─── Game timer: save/read ─── */
 /* far_0000_0330 - Save current timer tick count (start a delay measurement).
  * Used by delay loops (res_001932): saves the current tick count so that
  * far_0000_032C can later return the elapsed ticks.
  * No stack params, no return value. */
-static uint32_t delay_start_ticks = 0;
 void far_0000_0330(CPU *cpu)
 {
-    static int call_count = 0;
-    call_count++;
-
     DosState *dos = get_dos_state(cpu);
+    CivState *s = civ_state(cpu);
 
     /* Update timer with real wall-clock time (scaled by speed multiplier) */
-    uint64_t ms = (uint64_t)clock() * 1000ULL / CLOCKS_PER_SEC * timer_speed;
+    uint64_t ms = timer_now_ms(&dos->timer) * s->timer_speed;
     timer_update(&dos->timer, ms);
 
-    delay_start_ticks = timer_get_ticks(&dos->timer);
-    if (call_count <= 5) {
-        fprintf(stderr, "[TIMER] save #%d tick=%u (speed=%dx)\n", call_count, delay_start_ticks, timer_speed);
-        fflush(stderr);
-    }
+    s->delay_start_ticks = timer_get_ticks(&dos->timer);
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_INT, 5, 0, "[TIMER] save #%d tick=%u (speed=%dx)\n",
+                (int)log_hit, s->delay_start_ticks, s->timer_speed);
     cpu->sp += 4; /* far ret */
 }
 
 /* far_0000_032C - Read elapsed ticks since last far_0000_0330 call.
  * Returns elapsed ticks in AX (at 18.2 Hz, each tick ~55ms).
- * Also pumps SDL events so the window stays responsive during delays. */
+ * Also pumps SDL events so the window stays responsive during delays.
+ * The delay loop polls this until enough ticks pass, so in turbo mode
+ * timer_poll hurries the ticks along. */
 void far_0000_032C(CPU *cpu)
 {
-    static uint64_t call_count = 0;
-    call_count++;
-
     DosState *dos = get_dos_state(cpu);
+    CivState *s = civ_state(cpu);
 
     /* Pump events so the window stays responsive during delay loops */
     if (dos->poll_events)
         dos->poll_events(dos->platform_ctx, dos, cpu);
 
     /* Update timer with real wall-clock time (scaled by speed multiplier) */
-    uint64_t ms = (uint64_t)clock() * 1000ULL / CLOCKS_PER_SEC * timer_speed;
+    uint64_t ms = timer_now_ms(&dos->timer) * s->timer_speed;
     timer_update(&dos->timer, ms);
 
-    uint32_t now = timer_get_ticks(&dos->timer);
-    uint32_t elapsed = now - delay_start_ticks;
+    uint32_t now = timer_poll(&dos->timer);
+    uint32_t elapsed = now - s->delay_start_ticks;
     cpu->ax = (uint16_t)(elapsed & 0xFFFF);
 
-    if (call_count <= 5 || (call_count % 1000) == 0) {
-        fprintf(stderr, "[TIMER] read #%llu elapsed=%u tick=%u\n",
-                (unsigned long long)call_count, (unsigned)elapsed, now);
-        fflush(stderr);
-    }
+    /* The delay loop spins on this; let it sleep once it has spun a while */
+    dos_idle_poll(cpu);
+
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_INT, 5, 1000, "[TIMER] read #%llu elapsed=%u tick=%u\n",
+                (unsigned long long)log_hit, (unsigned)elapsed, now);
     cpu->sp += 4; /* far ret */
 }
 
@@ -681,12 +689,13 @@ void far_0000_032C(CPU *cpu)
 void far_0000_0A40(CPU *cpu)
 {
     DosState *dos = get_dos_state(cpu);
+    CivState *s = civ_state(cpu);
 
     /* Update timer from wall-clock time (scaled by speed multiplier) */
-    uint64_t ms = (uint64_t)clock() * 1000ULL / CLOCKS_PER_SEC * timer_speed;
+    uint64_t ms = timer_now_ms(&dos->timer) * s->timer_speed;
     timer_update(&dos->timer, ms);
 
-    uint32_t ticks = timer_get_ticks(&dos->timer);
+    uint32_t ticks = timer_poll(&dos->timer);
     cpu->ax = (uint16_t)(ticks & 0xFFFF);
 
     /* Also write to BIOS data area for consistency */
@@ -694,10 +703,10 @@ void far_0000_0A40(CPU *cpu)
     mem_write16(cpu, 0x0040, 0x006E, (uint16_t)(ticks >> 16));
 
     /* Pump events periodically to keep window responsive */
-    static uint32_t call_count = 0;
-    call_count++;
-    if ((call_count % 100) == 0 && dos->poll_events) {
-        dos->poll_events(dos->platform_ctx, dos, cpu);
+    if ((++s->tick_reads % 100) == 0) {
+        if (dos->poll_events)
+            dos->poll_events(dos->platform_ctx, dos, cpu);
+        dos_idle_poll(cpu);
     }
 
     cpu->sp += 4; /* far ret */
@@ -714,9 +723,6 @@ void far_0000_0A40(CPU *cpu)
  * Without this, the SDL window freezes during non-I/O game logic. */
 void far_0402_44E9(CPU *cpu)
 {
-    static uint64_t call_count = 0;
-    call_count++;
-
     DosState *dos = get_dos_state(cpu);
 
     /* Pump SDL events and render the current frame */
@@ -724,7 +730,7 @@ void far_0402_44E9(CPU *cpu)
         dos->poll_events(dos->platform_ctx, dos, cpu);
 
     /* Update timer with real wall-clock time */
-    uint64_t ms = (uint64_t)clock() * 1000ULL / CLOCKS_PER_SEC;
+    uint64_t ms = timer_now_ms(&dos->timer);
     timer_update(&dos->timer, ms);
 
     /* Write BIOS timer tick count to data area at 0040:006C (dword) */
@@ -733,16 +739,13 @@ void far_0402_44E9(CPU *cpu)
     mem_write16(cpu, 0x0040, 0x006E, (uint16_t)(ticks >> 16));
 
     /* Periodic trace for debugging */
-    if (call_count <= 5 || (call_count % 500) == 0) {
-        fprintf(stderr, "[YIELD] far_0402_44E9 #%llu tick=%u 6AC2=%04X E692=%04X\n",
-                (unsigned long long)call_count, ticks,
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_INT, 5, 500,
+                "[YIELD] far_0402_44E9 #%llu tick=%u 6AC2=%04X E692=%04X\n",
+                (unsigned long long)log_hit, ticks,
                 mem_read16(cpu, cpu->ds, 0x6AC2),
                 mem_read16(cpu, cpu->ds, 0xE692));
-        fflush(stderr);
-    }
 
     cpu->sp += 4; /* far ret */
-    fprintf(stderr, "[YIELD] RETURNING sp=%04X\n", cpu->sp); fflush(stderr);
 }
 
 /* ─── Traced alias wrappers ─── */
@@ -750,8 +753,8 @@ void far_0402_44E9(CPU *cpu)
 void ovl02_02C200(CPU *cpu);  /* forward decl - defined below */
 void far_0000_0768(CPU *cpu)
 {
-    fprintf(stderr, "[TRACE] far_0000_0768 -> ovl02_02C200 (bypassed) sp=%04X\n",
-            cpu->sp);
+    LOG_DEBUG(LOG_DIAG, "[TRACE] far_0000_0768 -> ovl02_02C200 (bypassed) sp=%04X\n",
+              cpu->sp);
     ovl02_02C200(cpu);
 }
 
@@ -761,8 +764,7 @@ void far_0000_0768(CPU *cpu)
  * returns AX=1 if user pressed 'c', 0 otherwise. We return 0 (skip). */
 void far_0000_0792(CPU *cpu)
 {
-    fprintf(stderr, "[BYPASS] far_0000_0792 (civ info screen) skipped\n");
-    fflush(stderr);
+    LOG_INFO(LOG_DIAG, "[BYPASS] far_0000_0792 (civ info screen) skipped\n");
     cpu->ax = 0;  /* no 'c' pressed */
     cpu->sp += 4; /* far ret */
 }
@@ -771,13 +773,11 @@ void far_0000_0792(CPU *cpu)
 extern void ovl05_0307DA(CPU *cpu);
 void far_0000_07DF(CPU *cpu)
 {
-    fprintf(stderr, "[TRACE] far_0000_07DF -> ovl05_0307DA ENTER sp=%04X\n",
-            cpu->sp);
-    fflush(stderr);
+    LOG_DEBUG(LOG_DIAG, "[TRACE] far_0000_07DF -> ovl05_0307DA ENTER sp=%04X\n",
+              cpu->sp);
     ovl05_0307DA(cpu);
-    fprintf(stderr, "[TRACE] far_0000_07DF -> ovl05_0307DA EXIT sp=%04X\n",
-            cpu->sp);
-    fflush(stderr);
+    LOG_DEBUG(LOG_DIAG, "[TRACE] far_0000_07DF -> ovl05_0307DA EXIT sp=%04X\n",
+              cpu->sp);
 }
 
 /* far_0000_0761 - Alias for ovl01_02BA00 (intro function) */
@@ -816,10 +816,10 @@ void res_001CAE(CPU *cpu)
     mem_write16(cpu, cpu->ds, 0xEE1A, ref_count);
 
     uint16_t vga_flag = mem_read16(cpu, cpu->ds, 0x1A3C);
-    fprintf(stderr, "[VGA] res_001CAE: vga_flag=%u ref_count=%u\n",
-            vga_flag, ref_count);
+    LOG_DEBUG(LOG_GFX, "[VGA] res_001CAE: vga_flag=%u ref_count=%u\n",
+              vga_flag, ref_count);
     if (vga_flag != 0 && ref_count == 1) {
-        fprintf(stderr, "[VGA] Setting mode 13h (320x200x256)\n");
+        LOG_INFO(LOG_GFX, "[VGA] Setting mode 13h (320x200x256)\n");
         cpu->ax = 0x0013;
         extern void bios_int10(CPU *cpu);
         bios_int10(cpu);
@@ -862,11 +862,10 @@ void res_021C08(CPU *cpu)
  * Calls through to memory management to allocate a segment.
  * On success: DX != 0xFFFF, ZF clear.
  * On failure: DX = 0xFFFF, ZF set. */
-/* Near heap break pointer - starts at BSS end */
-static uint16_t heap_break = 0xF7F0;
-
 void res_0222C0(CPU *cpu)
 {
+    CivState *s = civ_state(cpu);
+
     /* The original _nheapgrow: extends the near heap by AX paragraphs.
      * Returns AX = DS offset of new memory, ZF clear on success.
      * Checks against stack pointer to prevent collision. */
@@ -874,22 +873,22 @@ void res_0222C0(CPU *cpu)
     if (paras == 0) paras = 1;
     uint16_t bytes = paras * 16;
 
-    uint16_t new_break = heap_break + bytes;
+    uint16_t new_break = s->heap_break + bytes;
     /* Check for stack collision: leave 64 bytes minimum for stack */
-    if (new_break >= cpu->sp - 64 || new_break < heap_break) {
-        fprintf(stderr, "[SBRK] FAIL: need %u bytes, break=0x%04X sp=0x%04X\n",
-                bytes, heap_break, cpu->sp);
+    if (new_break >= cpu->sp - 64 || new_break < s->heap_break) {
+        LOG_WARN(LOG_DOS, "[SBRK] FAIL: need %u bytes, break=0x%04X sp=0x%04X\n",
+                 bytes, s->heap_break, cpu->sp);
         cpu->dx = 0xFFFF; /* failure */
         cpu->flags |= FLAG_ZF;
         cpu->sp += 2; /* near ret */
         return;
     }
 
-    uint16_t result = heap_break;
-    heap_break = new_break;
+    uint16_t result = s->heap_break;
+    s->heap_break = new_break;
 
-    fprintf(stderr, "[SBRK] res_0222C0: %u paras (%u bytes) -> DS:0x%04X (break->0x%04X)\n",
-            paras, bytes, result, heap_break);
+    LOG_INFO(LOG_DOS, "[SBRK] res_0222C0: %u paras (%u bytes) -> DS:0x%04X (break->0x%04X)\n",
+             paras, bytes, result, s->heap_break);
 
     cpu->ax = result;
     cpu->dx = result; /* caller expects DX != 0xFFFF on success */
@@ -965,7 +964,6 @@ void far_0237_171C(CPU *cpu)
  *
  * _nfree ORs 0x01 into header byte to mark available.
  * Allocator writes even header value to mark in-use. */
-static int heap_chain_fixed = 0;
 
 /* Advance to next block: skip 2-byte header + user data */
 #define HEAP_NEXT(pos, hdr) ((uint16_t)((pos) + 2 + ((hdr) & 0xFFFE)))
@@ -973,6 +971,8 @@ static int heap_chain_fixed = 0;
 
 void res_022181(CPU *cpu)
 {
+    CivState *s = civ_state(cpu);
+
     uint16_t requested = cpu->cx;
     if (requested == 0) requested = 2;
     /* Match MSC convention: inc cx; and cl, 0xFE */
@@ -983,26 +983,26 @@ void res_022181(CPU *cpu)
     /* One-time: connect initial MSC chain to bump-allocated area.
      * MSC init creates: [0x0001][0xFFFE]...(gap)...heap_break
      * We replace the sentinel with a free block spanning to heap_break. */
-    if (!heap_chain_fixed && head != 0 && heap_break > head + 4) {
+    if (!s->heap_chain_fixed && head != 0 && s->heap_break > head + 4) {
         uint16_t scan = head;
         for (int i = 0; i < 64; i++) {
             uint16_t hdr = mem_read16(cpu, cpu->ds, scan);
             if (hdr == 0xFFFE) {
                 /* Replace sentinel with free block spanning to heap_break.
                  * Free block user data size = heap_break - (scan + 2). */
-                uint16_t free_udata = heap_break - scan - 2;
+                uint16_t free_udata = s->heap_break - scan - 2;
                 if (free_udata >= 2) {
                     mem_write16(cpu, cpu->ds, scan, (uint16_t)(free_udata | 1));
-                    mem_write16(cpu, cpu->ds, heap_break, 0xFFFE);
-                    fprintf(stderr, "[HEAP] Chain fix: free @0x%04X udata=%u, sentinel @0x%04X\n",
-                            scan, free_udata, heap_break);
+                    mem_write16(cpu, cpu->ds, s->heap_break, 0xFFFE);
+                    LOG_DEBUG(LOG_DOS, "[HEAP] Chain fix: free @0x%04X udata=%u, sentinel @0x%04X\n",
+                              scan, free_udata, s->heap_break);
                 }
-                heap_chain_fixed = 1;
+                s->heap_chain_fixed = 1;
                 break;
             }
             uint16_t ud = HEAP_UDATA(hdr);
             scan = HEAP_NEXT(scan, hdr);
-            if (ud == 0 && !(hdr & 1)) { heap_chain_fixed = 1; break; }
+            if (ud == 0 && !(hdr & 1)) { s->heap_chain_fixed = 1; break; }
         }
     }
 
@@ -1048,7 +1048,7 @@ void res_022181(CPU *cpu)
                     uint16_t ptr = pos + 2;
                     mem_write16(cpu, cpu->ds, (uint16_t)(cpu->bx + 2),
                                 HEAP_NEXT(pos, udata_sz));
-                    fprintf(stderr, "[HEAP] Reused %u bytes at DS:0x%04X\n", udata_sz, ptr);
+                    LOG_DEBUG(LOG_DOS, "[HEAP] Reused %u bytes at DS:0x%04X\n", udata_sz, ptr);
                     cpu->ax = ptr;
                     cpu->dx = cpu->ds;
                     cpu->flags &= ~FLAG_ZF;
@@ -1062,24 +1062,24 @@ void res_022181(CPU *cpu)
 
     /* No available block - bump allocate from heap_break */
     uint16_t block_total = 2 + udata_sz; /* header + user data */
-    uint16_t alloc_end = heap_break + block_total;
-    if (alloc_end >= cpu->sp - 64 || alloc_end < heap_break) {
+    uint16_t alloc_end = s->heap_break + block_total;
+    if (alloc_end >= cpu->sp - 64 || alloc_end < s->heap_break) {
         uint16_t need_paras = (uint16_t)((block_total + 15) / 16);
         uint16_t save_ax = cpu->ax;
         cpu->ax = need_paras;
         res_0222C0(cpu);
         cpu->sp -= 2;
         if (cpu->flags & FLAG_ZF) {
-            fprintf(stderr, "[HEAP] FAIL: need %u bytes, no room\n", block_total);
+            LOG_WARN(LOG_DOS, "[HEAP] FAIL: need %u bytes, no room\n", block_total);
             cpu->ax = 0; cpu->dx = 0; cpu->flags |= FLAG_ZF;
             uint16_t h = mem_read16(cpu, cpu->ds, cpu->bx);
             mem_write16(cpu, cpu->ds, (uint16_t)(cpu->bx + 2), h);
             cpu->sp += 2; return;
         }
         cpu->ax = save_ax;
-        alloc_end = heap_break + block_total;
-        if (alloc_end >= cpu->sp - 64 || alloc_end < heap_break) {
-            fprintf(stderr, "[HEAP] FAIL: still no room after sbrk\n");
+        alloc_end = s->heap_break + block_total;
+        if (alloc_end >= cpu->sp - 64 || alloc_end < s->heap_break) {
+            LOG_WARN(LOG_DOS, "[HEAP] FAIL: still no room after sbrk\n");
             cpu->ax = 0; cpu->dx = 0; cpu->flags |= FLAG_ZF;
             uint16_t h = mem_read16(cpu, cpu->ds, cpu->bx);
             mem_write16(cpu, cpu->ds, (uint16_t)(cpu->bx + 2), h);
@@ -1088,15 +1088,15 @@ void res_022181(CPU *cpu)
     }
 
     /* Bump: [header=udata_sz in-use][user data][sentinel] */
-    uint16_t hdr_off = heap_break;
+    uint16_t hdr_off = s->heap_break;
     uint16_t ptr = hdr_off + 2;
     mem_write16(cpu, cpu->ds, hdr_off, udata_sz); /* in-use (even) */
-    heap_break = (uint16_t)(hdr_off + 2 + udata_sz);
-    mem_write16(cpu, cpu->ds, (uint16_t)(cpu->bx + 2), heap_break);
-    mem_write16(cpu, cpu->ds, heap_break, 0xFFFE);
+    s->heap_break = (uint16_t)(hdr_off + 2 + udata_sz);
+    mem_write16(cpu, cpu->ds, (uint16_t)(cpu->bx + 2), s->heap_break);
+    mem_write16(cpu, cpu->ds, s->heap_break, 0xFFFE);
 
-    fprintf(stderr, "[HEAP] Allocated %u+2 bytes at DS:0x%04X (break->0x%04X)\n",
-            udata_sz, ptr, heap_break);
+    LOG_DEBUG(LOG_DOS, "[HEAP] Allocated %u+2 bytes at DS:0x%04X (break->0x%04X)\n",
+              udata_sz, ptr, s->heap_break);
     cpu->ax = ptr;
     cpu->dx = cpu->ds;
     cpu->flags &= ~FLAG_ZF;
@@ -1142,8 +1142,8 @@ void res_000A54(CPU *cpu)
     for (int i = 0; i < 0x40 && base + i < MEM_SIZE; i++)
         cpu->mem[base + i] = 0;
 
-    fprintf(stderr, "[RUNTIME] res_000A54: allocated %u paras at seg 0x%04X\n",
-            alloc_size, seg);
+    LOG_INFO(LOG_DOS, "[RUNTIME] res_000A54: allocated %u paras at seg 0x%04X\n",
+             alloc_size, seg);
 
     cpu->ax = seg;
     cpu->sp += 4; /* far ret */
@@ -1159,7 +1159,7 @@ void res_000A54(CPU *cpu)
 void res_000B4E(CPU *cpu)
 {
     (void)cpu;
-    fprintf(stderr, "[RUNTIME] res_000B4E (thunk table init) - skipped\n");
+    LOG_INFO(LOG_DOS, "[RUNTIME] res_000B4E (thunk table init) - skipped\n");
     cpu->sp += 4; /* far ret */
 }
 
@@ -1170,8 +1170,7 @@ void res_000B4E(CPU *cpu)
 void res_000AFC(CPU *cpu)
 {
     (void)cpu;
-    static int _warned = 0;
-    if (!_warned) { fprintf(stderr, "[RUNTIME] res_000AFC (overlay file loader) called\n"); _warned = 1; }
+    LOG_SAMPLED(LOG_LEVEL_INFO, LOG_DOS, 1, 0, "[RUNTIME] res_000AFC (overlay file loader) called\n");
     cpu->sp += 2; /* near ret */
 }
 
@@ -1182,8 +1181,7 @@ void res_000AFC(CPU *cpu)
 void res_000B98(CPU *cpu)
 {
     (void)cpu;
-    static int _warned = 0;
-    if (!_warned) { fprintf(stderr, "[RUNTIME] res_000B98 (DOS EXEC) called - skipping\n"); _warned = 1; }
+    LOG_SAMPLED(LOG_LEVEL_INFO, LOG_DOS, 1, 0, "[RUNTIME] res_000B98 (DOS EXEC) called - skipping\n");
     cpu->sp += 2; /* near ret */
 }
 
@@ -1215,13 +1213,13 @@ void far_205A_1E60(CPU *cpu)
  * Blocks until input available, pumps SDL event loop. */
 void far_0000_09E5(CPU *cpu)
 {
-    static int call_count = 0;
-    call_count++;
+    CivState *s = civ_state(cpu);
+    int prompt_no = ++s->key_prompts;
     DosState *dos = get_dos_state(cpu);
 
     /* Show a visible prompt on screen so the user knows the game is waiting */
     char prompt[81];
-    snprintf(prompt, sizeof(prompt), " Press Space to continue... (%d) ", call_count);
+    snprintf(prompt, sizeof(prompt), " Press Space to continue... (%d) ", prompt_no);
     uint32_t row_base = 0xB8000 + 12 * 80 * 2; /* Center of screen */
     /* Center the prompt */
     int len = (int)strlen(prompt);
@@ -1234,11 +1232,8 @@ void far_0000_09E5(CPU *cpu)
         cpu->mem[row_base + i * 2 + 1] = attr;
     }
 
-    fprintf(stderr, "[BLOCK] Waiting for key in far_0000_09E5 (#%d)\n", call_count);
-    while (!keyboard_available(&dos->keyboard)) {
-        if (dos->poll_events)
-            dos->poll_events(dos->platform_ctx, dos, cpu);
-    }
+    LOG_DEBUG(LOG_KEY, "[BLOCK] Waiting for key in far_0000_09E5 (#%d)\n", prompt_no);
+    dos_wait_input(cpu, DOS_WAIT_FOREVER);
     uint16_t key = keyboard_read(&dos->keyboard);
     cpu->al = (uint8_t)(key & 0xFF);
 
@@ -1248,8 +1243,8 @@ void far_0000_09E5(CPU *cpu)
         cpu->mem[row_base + i * 2 + 1] = 0;
     }
 
-    fprintf(stderr, "[KEY] far_0000_09E5 #%d: 0x%04X (ascii='%c')\n",
-            call_count, key, (cpu->al >= 32 && cpu->al < 127) ? cpu->al : '.');
+    LOG_INFO(LOG_KEY, "[KEY] far_0000_09E5 #%d: 0x%04X (ascii='%c')\n",
+             prompt_no, key, (cpu->al >= 32 && cpu->al < 127) ? cpu->al : '.');
     cpu->sp += 4; /* far ret */
 }
 
@@ -1288,8 +1283,8 @@ void far_205A_20C2(CPU *cpu)
     uint8_t opt_count = cpu->mem[seg_off(cpu->ds, ctrl_off)];
     uint8_t flags     = cpu->mem[seg_off(cpu->ds, (uint16_t)(ctrl_off + 1))];
 
-    fprintf(stderr, "[DIALOG] type=%u opts=%u flags=0x%02X ctrl=0x%04X text=0x%04X\n",
-            type, opt_count, flags, ctrl_off, text_off);
+    LOG_INFO(LOG_KEY, "[DIALOG] type=%u opts=%u flags=0x%02X ctrl=0x%04X text=0x%04X\n",
+             type, opt_count, flags, ctrl_off, text_off);
 
     if (type == 0x10 && opt_count > 0) {
         /* Selection dialog - check if we're in VGA graphics mode yet.
@@ -1308,8 +1303,8 @@ void far_205A_20C2(CPU *cpu)
             if (selection > opt_count)
                 selection = opt_count;
             mem_write16(cpu, cpu->ds, (uint16_t)(ctrl_off - 2), selection);
-            fprintf(stderr, "[DIALOG] result=%u (key=0x%04X ascii='%c')\n",
-                    selection, key, (ascii >= 32 && ascii < 127) ? ascii : '.');
+            LOG_INFO(LOG_KEY, "[DIALOG] result=%u (key=0x%04X ascii='%c')\n",
+                     selection, key, (ascii >= 32 && ascii < 127) ? ascii : '.');
         } else {
             /* No key available - auto-select option 0 (New Game on main menu).
              * The game's main menu maps: 0=New Game, 1=Load, 2=Scenario, etc.
@@ -1317,7 +1312,7 @@ void far_205A_20C2(CPU *cpu)
              * the new-game path; now that dialog code is real, we must
              * explicitly select 0. */
             mem_write16(cpu, cpu->ds, (uint16_t)(ctrl_off - 2), 0);
-            fprintf(stderr, "[DIALOG] auto-selected 0 (no key available)\n");
+            LOG_INFO(LOG_KEY, "[DIALOG] auto-selected 0 (no key available)\n");
         }
     } else if (type == 0x10) {
         /* Display-only dialog (opts=0) - set result=0, don't block.
@@ -1380,7 +1375,7 @@ void far_205A_2A06(CPU *cpu)
  * If this returns 0, the game skips VGA mode 13h setup entirely. */
 void far_0000_1630(CPU *cpu)
 {
-    fprintf(stderr, "[VGA] far_0000_1630: VGA detection -> returning 1 (present)\n");
+    LOG_INFO(LOG_GFX, "[VGA] far_0000_1630: VGA detection -> returning 1 (present)\n");
     cpu->ax = 1;  /* VGA is present */
     cpu->sp += 4; /* far ret */
 }
@@ -1401,8 +1396,8 @@ void far_0000_1630(CPU *cpu)
  */
 void ovl01_02BA00(CPU *cpu)
 {
-    fprintf(stderr, "[INTRO] Bypassing intro screen (VGA=1, sound=none) DS=%04X\n",
-            cpu->ds);
+    LOG_INFO(LOG_DIAG, "[INTRO] Bypassing intro screen (VGA=1, sound=none) DS=%04X\n",
+             cpu->ds);
 
     /* No sound driver */
     mem_write8(cpu, cpu->ds, 0x1A30, 0);
@@ -1412,7 +1407,7 @@ void ovl01_02BA00(CPU *cpu)
 
     /* Verify it was written */
     uint16_t check = mem_read16(cpu, cpu->ds, 0x1A3C);
-    fprintf(stderr, "[INTRO] DS:0x1A3C = %u (expected 1)\n", check);
+    LOG_INFO(LOG_DIAG, "[INTRO] DS:0x1A3C = %u (expected 1)\n", check);
 
     cpu->sp += 4; /* far ret */
 }
@@ -1495,7 +1490,7 @@ void res_0224EE(CPU *cpu)
  */
 void ovl02_02C200(CPU *cpu)
 {
-    fprintf(stderr, "[TITLE] Bypassing title screen -> New Game\n");
+    LOG_INFO(LOG_DIAG, "[TITLE] Bypassing title screen -> New Game\n");
 
     /* Set game mode to "New Game" */
     mem_write16(cpu, cpu->ds, 0x6AC2, 0x0000);
@@ -1524,17 +1519,15 @@ void ovl02_02C200(CPU *cpu)
  * MSC 5.x uses: seed = seed * 214013 + 2531011; return (seed>>16) & 0x7FFF
  * We use the same LCG for reproducibility.
  */
-static uint32_t rng_seed = 0;
-static int rng_seeded = 0;
-
-static uint16_t civ_rand(void)
+static uint16_t civ_rand(CPU *cpu)
 {
-    if (!rng_seeded) {
-        rng_seed = (uint32_t)time(NULL);
-        rng_seeded = 1;
+    CivState *s = civ_state(cpu);
+    if (!s->rng_seeded) {
+        s->rng_seed = (uint32_t)timer_wall_time(&get_dos_state(cpu)->timer);
+        s->rng_seeded = 1;
     }
-    rng_seed = rng_seed * 214013u + 2531011u;
-    return (uint16_t)((rng_seed >> 16) & 0x7FFF);
+    s->rng_seed = s->rng_seed * 214013u + 2531011u;
+    return (uint16_t)((s->rng_seed >> 16) & 0x7FFF);
 }
 
 /* far_1DDE_0042 - srand(seed): Seed the random number generator.
@@ -1542,9 +1535,10 @@ static uint16_t civ_rand(void)
 void far_1DDE_0042(CPU *cpu)
 {
     uint16_t seed = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 4));
-    rng_seed = (uint32_t)seed;
-    rng_seeded = 1;
-    fprintf(stderr, "[RNG] srand(%u)\n", seed);
+    CivState *s = civ_state(cpu);
+    s->rng_seed = (uint32_t)seed;
+    s->rng_seeded = 1;
+    LOG_INFO(LOG_DIAG, "[RNG] srand(%u)\n", seed);
     cpu->sp += 4; /* far ret */
 }
 
@@ -1557,7 +1551,7 @@ void far_1DDE_005D(CPU *cpu)
     if (max_val == 0) {
         cpu->ax = 0;
     } else {
-        cpu->ax = civ_rand() % max_val;
+        cpu->ax = civ_rand(cpu) % max_val;
     }
     cpu->sp += 4; /* far ret */
 }
@@ -1573,42 +1567,25 @@ void far_1DDE_005D(CPU *cpu)
  * organized by layer. Return the byte from the map data array. */
 void far_0000_07C3(CPU *cpu)
 {
-    static int call_count = 0;
-    call_count++;
-
     uint16_t arg1 = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 4));
     uint16_t arg2 = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 6));
     uint16_t arg3 = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 8));
 
-    if (call_count <= 10) {
-        fprintf(stderr, "[MAP_Q] far_0000_07C3 #%d args=(%u, %u, %u)\n",
-                call_count, arg1, arg2, arg3);
-        fflush(stderr);
-    }
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_DIAG, 10, 0, "[MAP_Q] far_0000_07C3 #%llu args=(%u, %u, %u)\n",
+                (unsigned long long)log_hit, arg1, arg2, arg3);
 
     uint16_t layer = arg1;
     uint16_t col = arg2 % 80;  /* E-W wrap */
     uint16_t row = arg3;
 
-    /* Map data: 80 columns x 50 rows, 6 layers.
-     * Base offsets per layer (from code analysis):
-     *   Layer 0: DS:0x5864 (terrain type)
-     *   Layer 1: DS:0x6824 (terrain modifiers)
-     *   Layer 2: DS:0x77E4 (visibility/ownership)
-     * Each layer = 80*50 = 4000 bytes */
-    if (row < 50 && layer < 6) {
-        uint16_t base;
-        switch (layer) {
-        case 0: base = 0x5864; break;
-        case 1: base = 0x6824; break;
-        case 2: base = 0x77E4; break;
-        case 3: base = 0x87A4; break;
-        case 4: base = 0x9764; break;
-        case 5: base = 0xA724; break;
-        default: base = 0x5864; break;
-        }
-        uint16_t offset = base + row * 80 + col;
-        cpu->ax = (uint16_t)mem_read8(cpu, cpu->ds, offset);
+    /* Map data: 80 columns x 50 rows, 6 layers (map_layers in
+     * civ.syms.toml), one G_MAP_LAYERS_STRIDE record each from DS:0x5864
+     * (from code analysis):
+     *   Layer 0: terrain type
+     *   Layer 1: terrain modifiers
+     *   Layer 2: visibility/ownership */
+    if (row < 50 && layer < G_MAP_LAYERS_COUNT) {
+        cpu->ax = g_map_layers(cpu->dgroup, layer)[row * 80 + col];
     } else {
         cpu->ax = 0;
     }
@@ -1621,19 +1598,13 @@ void far_0000_07C3(CPU *cpu)
  * Writes a value to the map at given coordinates and layer. */
 void far_1B05_17C3(CPU *cpu)
 {
-    static int call_count = 0;
-    call_count++;
-
     uint16_t arg1 = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 4));
     uint16_t arg2 = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 6));
     uint16_t arg3 = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 8));
     uint16_t arg4 = mem_read16(cpu, cpu->ss, (uint16_t)(cpu->sp + 10));
 
-    if (call_count <= 10) {
-        fprintf(stderr, "[MAP_W] far_1B05_17C3 #%d args=(%u, %u, %u, %u)\n",
-                call_count, arg1, arg2, arg3, arg4);
-        fflush(stderr);
-    }
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_DIAG, 10, 0, "[MAP_W] far_1B05_17C3 #%llu args=(%u, %u, %u, %u)\n",
+                (unsigned long long)log_hit, arg1, arg2, arg3, arg4);
 
     /* Write value to map: arg1=col, arg2=row, arg3=value, arg4=layer */
     uint16_t col = arg1 % 80;  /* E-W wrap */
@@ -1641,20 +1612,8 @@ void far_1B05_17C3(CPU *cpu)
     uint16_t value = arg3;
     uint16_t layer = arg4;
 
-    if (row < 50 && layer < 6) {
-        uint16_t base;
-        switch (layer) {
-        case 0: base = 0x5864; break;
-        case 1: base = 0x6824; break;
-        case 2: base = 0x77E4; break;
-        case 3: base = 0x87A4; break;
-        case 4: base = 0x9764; break;
-        case 5: base = 0xA724; break;
-        default: base = 0x5864; break;
-        }
-        uint16_t offset = base + row * 80 + col;
-        mem_write8(cpu, cpu->ds, offset, (uint8_t)(value & 0xFF));
-    }
+    if (row < 50 && layer < G_MAP_LAYERS_COUNT)
+        g_map_layers(cpu->dgroup, layer)[row * 80 + col] = (uint8_t)(value & 0xFF);
 
     cpu->sp += 4; /* far ret */
 }
@@ -1663,9 +1622,17 @@ void far_1B05_17C3(CPU *cpu)
 /* These are internal near-call subroutines within the res_0011E6 code range
  * (0x0011E6-0x0013A6). They implement LZW decompression for .PIC files.
  *
- * The decoder uses the emulated stack as a LIFO buffer for LZW-decompressed
- * characters, switching between normal stack and decode stack via
- * xchg sp, [0x687A].
+ * The original decoder keeps its dictionary in DS and uses the x86 stack
+ * as a LIFO buffer for expanded strings (xchg sp, [0x687A]). Here the
+ * decoding is done by the host-side PicDecoder (recomp/pic.h), which
+ * reads words from the guest buffer and writes a whole row straight to
+ * ES:DI. Only the scalar state is written back to DS, once per call, so
+ * the guest still sees where the decoder stands; the guest dictionary
+ * area is no longer touched.
+ *
+ * Each image is also matched against the asset cache: a cached image is
+ * copied out row by row instead of being decoded, and a decoded one is
+ * recorded into the cache when its last row is done.
  *
  * Data structures (all in DS segment):
  *   0x6874: image width (pixels per row)
@@ -1686,94 +1653,177 @@ void far_1B05_17C3(CPU *cpu)
  *   0xC19E: read position in compressed data buffer
  *   0x54D8: end of compressed data buffer
  *   0xE84A: callback to refill compressed data buffer
- *   0xC936-: LZW dictionary area
- *   DS-0x36CA: dictionary parent pointers (word, indexed by code*3)
- *   DS-0x36C8: dictionary character values (byte, indexed by code*3)
+ *   0xC936-: LZW dictionary area (original decoder only)
  */
 
-/* Forward declare callback function */
-extern void res_020191(CPU *cpu);
+#define PIC_DECODE_SP   0x6A8D  /* Empty guest decode stack */
+
+/* The decoder and the image being decoded are CivState.pic / .pic_img */
 
-/* Helper: refill the compressed data buffer via the E84A callback */
+/* Helper: refill the compressed data buffer via the E84A callback
+ * (normally 1FB6:0642 -> res_020191, see [dispatch] in civ.syms.toml) */
 static void pic_refill_buffer(CPU *cpu)
 {
     push16(cpu, cpu->bx);
     push16(cpu, cpu->cx);
     push16(cpu, cpu->dx);
-    uint16_t cb_off = mem_read16(cpu, cpu->ds, 0xE84A);
-    uint16_t cb_seg = mem_read16(cpu, cpu->ds, 0xE84C);
-    if (cb_seg == 0x1FB6 && cb_off == 0x0642) {
-        push16(cpu, cpu->cs); push16(cpu, 0);
-        res_020191(cpu);
-    } else {
-        fprintf(stderr, "[WARN] PIC: Unknown callback %04X:%04X\n", cb_seg, cb_off);
-    }
+    uint16_t cb_off = g_pic_refill(cpu->dgroup, 0);
+    uint16_t cb_seg = g_pic_refill(cpu->dgroup, 1);
+    push16(cpu, cpu->cs); push16(cpu, 0);
+    recomp_dispatch(cpu, cb_seg, cb_off);
     cpu->dx = pop16(cpu);
     cpu->cx = pop16(cpu);
     cpu->bx = pop16(cpu);
-    cpu->si = mem_read16(cpu, cpu->ds, 0xC19E);
+    cpu->si = g_pic_buf_pos(cpu->dgroup);
 }
 
-/* Helper: Read next variable-width LZW code from bitstream.
- * Returns the code value. Manages bit buffer at DS:0x6886/0x6888. */
-static uint16_t pic_read_code(CPU *cpu)
+/* Helper: PicDecoder word source, the compressed data at DS:SI */
+static uint16_t pic_guest_word(void *ctx)
 {
-    uint16_t bit_buf = mem_read16(cpu, cpu->ds, 0x6886);
-    uint8_t bits_avail = mem_read8(cpu, cpu->ds, 0x6888);
-    uint8_t code_bits = mem_read8(cpu, cpu->ds, 0x6880);
+    CPU *cpu = (CPU *)ctx;
+    if (cpu->si >= g_pic_buf_end(cpu->dgroup))
+        pic_refill_buffer(cpu);
+    uint16_t word = mem_read16(cpu, cpu->ds, cpu->si);
+    cpu->si += 2;
+    return word;
+}
 
-    /* Shift out already-consumed bits */
-    uint8_t shift = 16 - bits_avail;
-    uint16_t bx = (shift < 16) ? (bit_buf >> shift) : 0;
-    uint8_t cl = bits_avail;
+/* Helper: write the scalar decoder state back to DS */
+static void pic_sync(CPU *cpu, const PicDecoder *d)
+{
+    g_set_pic_saved_sp(cpu->dgroup, (uint16_t)(PIC_DECODE_SP - 2 * d->depth));
+    g_set_pic_rle_count(cpu->dgroup, d->rle_count);
+    g_set_pic_rle_byte(cpu->dgroup, d->rle_byte);
+    g_set_pic_code_bits(cpu->dgroup, d->code_bits);
+    g_set_pic_max_bits(cpu->dgroup, d->max_bits);
+    g_set_pic_max_code(cpu->dgroup, d->max_code);
+    g_set_pic_next_code(cpu->dgroup, d->next_code);
+    g_set_pic_bit_buf(cpu->dgroup, d->bit_buf);
+    g_set_pic_bits_avail(cpu->dgroup, d->bits_avail);
+    g_set_pic_prev_code(cpu->dgroup, d->prev_code);
+    g_set_pic_first_char(cpu->dgroup, d->first_char);
+}
 
-    /* Read more words until we have enough bits */
-    while ((int8_t)cl < (int8_t)code_bits) {
-        /* Refill from compressed data buffer if needed */
-        if (cpu->si >= mem_read16(cpu, cpu->ds, 0x54D8)) {
-            pic_refill_buffer(cpu);
+/* Helper: registers and DS as the original leaves them after a reset */
+static void pic_reset_done(CPU *cpu)
+{
+    CivState *s = civ_state(cpu);
+    g_set_pic_buf_pos(cpu->dgroup, cpu->si);
+    cpu->dx = s->pic.next_code;
+    cpu->ax = s->pic.bit_buf;
+    if (cpu->al > 0x0B) cpu->al = 0x0B;
+    pic_sync(cpu, &s->pic);
+}
+
+/* ─── PIC asset cache hookup ─── */
+
+static void pic_image_end(CivState *s)
+{
+    if (s->pic_img.cached)
+        asset_cache_release(s->pic_img.cached, 0);
+    free(s->pic_img.record);
+    memset(&s->pic_img, 0, sizeof(s->pic_img));
+}
+
+/* A decode is starting: look the file up in the cache */
+static void pic_image_begin(CPU *cpu, uint16_t w, uint16_t h)
+{
+    CivState *s = civ_state(cpu);
+    DosState *dos = get_dos_state(cpu);
+    int handle = dos->file_table.last_read;
+    const char *path = dos_handle_path(dos, handle);
+    size_t len = path ? strlen(path) : 0;
+    if (len < 4 || (strcmp(path + len - 4, ".PIC") && strcmp(path + len - 4, ".pic")))
+        return;
+
+    s->pic_img.handle = handle;
+    s->pic_img.is_4bit = g_pic_4bit(cpu->dgroup) ? 1 : 0;
+    s->pic_img.size = pic_row_bytes(w, s->pic_img.is_4bit) * h;
+    s->pic_img.start_first = s->pic.first_char;
+    s->pic_img.start_chr = s->pic.chr[s->pic.prev_code];
+
+    const PicImage *img = asset_cache_acquire(path, s->pic_img.is_4bit);
+    if (img && (img->width != w || img->height != h || img->size != s->pic_img.size)) {
+        asset_cache_release(img, 1);
+        img = NULL;
+    }
+    if (img && !pic_image_fits(img, &s->pic)) {
+        asset_cache_release(img, 0);    /* Decoded from other start bytes */
+        img = NULL;
+    }
+    s->pic_img.cached = img;
+    if (!img)
+        s->pic_img.record = (uint8_t *)malloc(s->pic_img.size);
+    LOG_DEBUG(LOG_FILE, "[PIC] %s %ux%u%s: %s\n", path, w, h,
+              s->pic_img.is_4bit ? " 4-bit" : "", img ? "cached" : "decode");
+}
+
+/* The last row is out: leave the file where a full decode would have,
+ * or keep what was decoded */
+static void pic_image_finish(CPU *cpu)
+{
+    CivState *s = civ_state(cpu);
+    DosState *dos = get_dos_state(cpu);
+    const char *path = dos_handle_path(dos, s->pic_img.handle);
+    long pos = dos_file_tell(dos, s->pic_img.handle);
+
+    if (s->pic_img.cached) {
+        /* Served from the cache: skip the compressed data, buffer empty,
+         * and the decoder where decoding the rows would have left it */
+        if (pos >= 0 && s->pic_img.cached->data_end) {
+            dos_file_seek(dos, s->pic_img.handle, s->pic_img.cached->data_end, SEEK_SET);
+            cpu->si = g_pic_buf_end(cpu->dgroup);
+            g_set_pic_buf_pos(cpu->dgroup, cpu->si);
         }
-        /* Read next 16 bits */
-        uint16_t word = mem_read16(cpu, cpu->ds, cpu->si);
-        cpu->si += 2;
-        mem_write16(cpu, cpu->ds, 0x6886, word);
-        bx |= (uint16_t)(word << cl);
-        cl += 16;
+        pic_load_state(&s->pic, &s->pic_img.cached->end);
+    } else if (s->pic_img.record && pos >= 0 && path) {
+        PicImage img;
+        if (pic_load(path, &img, 0) != 0)
+            memset(&img, 0, sizeof(img));
+        img.width = g_pic_width(cpu->dgroup);
+        img.height = g_pic_height(cpu->dgroup);
+        img.is_4bit = s->pic_img.is_4bit;
+        img.pixels = s->pic_img.record;
+        img.size = s->pic_img.size;
+        /* Next unread byte: the file position less what is still buffered */
+        img.data_end = pos - (long)(uint16_t)(g_pic_buf_end(cpu->dgroup) - cpu->si);
+        img.start_used = s->pic.start_used;
+        img.start_first = s->pic_img.start_first;
+        img.start_chr = s->pic_img.start_chr;
+        pic_save_state(&s->pic, &img.end);
+        asset_cache_insert(path, s->pic_img.is_4bit, &img, 1);
+        s->pic_img.record = NULL;
     }
+    pic_image_end(s);
+}
 
-    /* Extract the code */
-    cl -= code_bits;
-    mem_write8(cpu, cpu->ds, 0x6888, cl);
-    uint16_t mask = mem_read16(cpu, cpu->ds, 0x6882);
-    return bx & mask;
+/* A row of n bytes was produced at out */
+static void pic_image_row(CPU *cpu, const uint8_t *out, uint32_t n)
+{
+    CivState *s = civ_state(cpu);
+    if (!s->pic_img.size)
+        return;
+    if (s->pic_img.pos + n > s->pic_img.size) {
+        pic_image_end(s);       /* More rows than the header said */
+        return;
+    }
+    if (s->pic_img.record)
+        memcpy(s->pic_img.record + s->pic_img.pos, out, n);
+    s->pic_img.pos += n;
+    if (s->pic_img.pos == s->pic_img.size)
+        pic_image_finish(cpu);
 }
 
+/* ─── PIC decoder entry points ─── */
+
 /* res_00124E - Reset LZW dictionary when it overflows.
  * Near call (sp += 2 on return). */
 void res_00124E(CPU *cpu)
 {
-    /* Read new LZW parameters */
-    if (cpu->si >= mem_read16(cpu, cpu->ds, 0x54D8))
-        pic_refill_buffer(cpu);
-    cpu->ax = mem_read16(cpu, cpu->ds, cpu->si);
-    cpu->si += 2;
-    mem_write16(cpu, cpu->ds, 0xC19E, cpu->si);
-    if (cpu->al > 0x0B) cpu->al = 0x0B;
-    mem_write8(cpu, cpu->ds, 0x6881, cpu->al);
-    mem_write16(cpu, cpu->ds, 0x6886, cpu->ax);
-    mem_write8(cpu, cpu->ds, 0x6888, 0x8);
-    mem_write8(cpu, cpu->ds, 0x6880, 0x9);
-    mem_write16(cpu, cpu->ds, 0x6882, 0x1FF);
-    cpu->dx = 0x100;
-    mem_write16(cpu, cpu->ds, 0x6884, cpu->dx);
-    /* Clear dictionary parent pointers to 0xFFFF (unused) */
-    for (int i = 0; i < 0x800; i++) {
-        mem_write16(cpu, cpu->ds, (uint16_t)((i * 3) + (uint16_t)(-0x36CA & 0xFFFF)), 0xFFFF);
-    }
-    /* Init single-byte codes 0-255 */
-    for (int i = 0; i < 0x100; i++) {
-        mem_write8(cpu, cpu->ds, (uint16_t)((i * 3) + (uint16_t)(-0x36C8 & 0xFFFF)), (uint8_t)i);
-    }
+    CivState *s = civ_state(cpu);
+    s->pic.ctx = cpu;
+    pic_reset_dict(&s->pic);
+    pic_reset_done(cpu);
     cpu->sp += 2; /* near ret */
 }
 
@@ -1781,195 +1831,79 @@ void res_00124E(CPU *cpu)
  * Near call (sp += 2 on return). */
 void res_001205(CPU *cpu)
 {
-    uint16_t w = mem_read16(cpu, cpu->ds, 0x6874);
-    uint16_t h = mem_read16(cpu, cpu->ds, 0x6876);
+    CivState *s = civ_state(cpu);
+    pic_image_end(s);
+    uint16_t w = g_pic_width(cpu->dgroup);
+    uint16_t h = g_pic_height(cpu->dgroup);
     if ((w | h) == 0) {
         cpu->sp += 2; return;
     }
-    /* Initialize RLE state */
-    mem_write8(cpu, cpu->ds, 0x687E, 0x0);
-    mem_write8(cpu, cpu->ds, 0x687F, 0x0);
-    /* Set decode stack base */
-    mem_write16(cpu, cpu->ds, 0x687A, 0x6A8D);
-    /* Read initial parameters and init dictionary */
-    cpu->si = mem_read16(cpu, cpu->ds, 0xC19E);
-    push16(cpu, 0);
-    res_00124E(cpu);
+    /* Read initial parameters and init dictionary. The first entry
+     * added links to whatever code the guest held last. */
+    cpu->si = g_pic_buf_pos(cpu->dgroup);
+    pic_begin(&s->pic, pic_guest_word, cpu, g_pic_prev_code(cpu->dgroup));
+    s->pic.first_char = g_pic_first_char(cpu->dgroup);
+    pic_reset_done(cpu);
+
+    /* The first buffer has been read by now, so last_read is the file */
+    pic_image_begin(cpu, w, h);
     cpu->sp += 2; /* near ret */
 }
 
-/* res_0012F6 - LZW decode: return next decompressed byte.
- * This is the core LZW decoder. It maintains a decode stack (at DS:0x6A8D)
- * where multi-byte LZW sequences are expanded. Each call returns one byte.
- *
- * The original code uses the x86 stack as the decode buffer (xchg sp, [687A]),
- * pushing decoded chars onto it and popping them one at a time.
- * We simulate this using the emulated memory stack.
- *
- * Returns decoded byte in AL.
+/* res_0012F6 - LZW decode: return next decompressed byte in AL.
+ * res_001284 no longer goes through here; kept for any lifted caller.
  * Near call (sp += 2 on return). */
 void res_0012F6(CPU *cpu)
 {
-    /* Dictionary layout: 3 bytes per entry at DS:[entry*3 - 0x36CA]
-     *   word: parent code (0xFFFF = root/single-byte)
-     *   byte: character value
-     * Entries 0-255 are single-byte codes. */
-    uint16_t dict_base_parent = (uint16_t)(-0x36CA & 0xFFFF);
-    uint16_t dict_base_char   = (uint16_t)(-0x36C8 & 0xFFFF);
-
-    /* Check if decode stack has buffered characters */
-    uint16_t decode_sp = mem_read16(cpu, cpu->ds, 0x687A);
-    if (decode_sp != 0x6A8D) {
-        /* Pop one byte from decode stack */
-        cpu->al = mem_read8(cpu, cpu->ds, decode_sp);
-        decode_sp += 2;  /* stack grows down, pop = sp += 2 (word-sized) */
-        mem_write16(cpu, cpu->ds, 0x687A, decode_sp);
-        cpu->sp += 2; /* near ret */
-        return;
-    }
-
-    /* Decode stack empty - need to decode next LZW code */
-    uint16_t dx = mem_read16(cpu, cpu->ds, 0x6884); /* next free dict entry */
-    uint16_t code = pic_read_code(cpu);
-    uint16_t cx = code;
-
-    /* Handle code >= next free entry (KwKwK case) */
-    if ((int16_t)code >= (int16_t)dx) {
-        cx = dx;
-        /* Push the first char of previous string */
-        uint16_t prev_first = mem_read16(cpu, cpu->ds, 0x688A);
-        uint8_t prev_first_char = mem_read8(cpu, cpu->ds, 0x688C);
-        /* Use the first char of the previous code's output */
-        decode_sp -= 2;
-        mem_write8(cpu, cpu->ds, decode_sp, prev_first_char);
-    }
-
-    /* Walk the dictionary chain, pushing characters onto decode stack */
-    uint16_t walk_code = cx;
-    while (1) {
-        uint16_t parent = mem_read16(cpu, cpu->ds, (uint16_t)(walk_code * 3 + dict_base_parent));
-        uint8_t ch = mem_read8(cpu, cpu->ds, (uint16_t)(walk_code * 3 + dict_base_char));
-        if ((int16_t)(parent + 1) == 0) {
-            /* Root code (parent == 0xFFFF): this is the first character */
-            /* Save as first char for dictionary update */
-            mem_write8(cpu, cpu->ds, 0x688C, ch);
-            /* Push it (will be popped last = output first) */
-            decode_sp -= 2;
-            mem_write8(cpu, cpu->ds, decode_sp, ch);
-            break;
-        }
-        /* Push character and continue walking */
-        decode_sp -= 2;
-        mem_write8(cpu, cpu->ds, decode_sp, ch);
-        walk_code = parent;
-    }
-
-    /* Add new dictionary entry: prev_code + first_char_of_current */
-    uint8_t first_char = mem_read8(cpu, cpu->ds, 0x688C);
-    mem_write8(cpu, cpu->ds, (uint16_t)(dx * 3 + dict_base_char), first_char);
-    uint16_t prev_code = mem_read16(cpu, cpu->ds, 0x688A);
-    mem_write16(cpu, cpu->ds, (uint16_t)(dx * 3 + dict_base_parent), prev_code);
-    dx++;
-
-    /* Check if dictionary needs to grow bit width */
-    uint16_t max_code = mem_read16(cpu, cpu->ds, 0x6882);
-    if ((int16_t)dx > (int16_t)max_code) {
-        uint8_t cur_bits = mem_read8(cpu, cpu->ds, 0x6880);
-        cur_bits++;
-        uint8_t max_bits = mem_read8(cpu, cpu->ds, 0x6881);
-        if ((int8_t)cur_bits > (int8_t)max_bits) {
-            /* Dictionary full - reset */
-            mem_write16(cpu, cpu->ds, 0x6884, dx);
-            mem_write16(cpu, cpu->ds, 0x688A, code);
-            push16(cpu, 0);
-            res_00124E(cpu);
-            dx = mem_read16(cpu, cpu->ds, 0x6884);
-        } else {
-            mem_write8(cpu, cpu->ds, 0x6880, cur_bits);
-            /* rcl word [0x6882], 1 → max_code = max_code * 2 + CF */
-            /* CF was set by stc before this in original code */
-            max_code = (max_code << 1) | 1;
-            mem_write16(cpu, cpu->ds, 0x6882, max_code);
-        }
-    }
-
-    mem_write16(cpu, cpu->ds, 0x6884, dx);
-    mem_write16(cpu, cpu->ds, 0x688A, code);
-
-    /* Pop first byte from decode stack */
-    cpu->al = mem_read8(cpu, cpu->ds, decode_sp);
-    decode_sp += 2;
-    mem_write16(cpu, cpu->ds, 0x687A, decode_sp);
-
+    CivState *s = civ_state(cpu);
+    s->pic.ctx = cpu;
+    cpu->al = pic_next_byte(&s->pic);
+    pic_sync(cpu, &s->pic);
     cpu->sp += 2; /* near ret */
 }
 
 /* res_001284 - Decode one row of PIC data (RLE + LZW).
- * Reads CX decompressed bytes via res_0012F6 (LZW) and applies
- * PackBits RLE decoding (0x90 escape). Output goes to ES:DI.
+ * Decodes CX pixels into ES:DI (in 4-bit mode CX/2 bytes, each split
+ * into two pixels), or copies them from the cached image.
  *
  * CX = pixel count (set by caller), DI = output buffer, SI = read ptr.
  * Near call (sp += 2 on return). */
 void res_001284(CPU *cpu)
 {
-    uint8_t is_4bit = mem_read8(cpu, cpu->ds, 0x6889);
+    CivState *s = civ_state(cpu);
+    uint8_t is_4bit = g_pic_4bit(cpu->dgroup);
 
     /* Adjust pixel count for 4-bit mode */
     if (is_4bit) {
         cpu->cx++;
         cpu->cx >>= 1;
     }
-    mem_write16(cpu, cpu->ds, 0x687C, cpu->cx);
-
-    /* Main decode loop: decode pixels one at a time */
-    while (mem_read16(cpu, cpu->ds, 0x687C) != 0) {
-        if (mem_read8(cpu, cpu->ds, 0x687E) != 0) {
-            /* RLE repeat: output previous byte again */
-            cpu->al = mem_read8(cpu, cpu->ds, 0x687F);
-            mem_write8(cpu, cpu->ds, 0x687E,
-                       (uint8_t)(mem_read8(cpu, cpu->ds, 0x687E) - 1));
-        } else {
-            /* Get next decompressed byte from LZW */
-            push16(cpu, 0);
-            res_0012F6(cpu);
-
-            if (cpu->al == 0x90) {
-                /* PackBits RLE escape */
-                push16(cpu, 0);
-                res_0012F6(cpu);
-                if (cpu->al == 0) {
-                    /* Literal 0x90 byte */
-                    cpu->al = 0x90;
-                    mem_write8(cpu, cpu->ds, 0x687F, cpu->al);
-                } else {
-                    /* Repeat previous byte (count-1) more times */
-                    cpu->al--;
-                    mem_write8(cpu, cpu->ds, 0x687E, cpu->al);
-                    cpu->al = mem_read8(cpu, cpu->ds, 0x687F);
-                    mem_write8(cpu, cpu->ds, 0x687E,
-                               (uint8_t)(mem_read8(cpu, cpu->ds, 0x687E) - 1));
-                }
-            } else {
-                mem_write8(cpu, cpu->ds, 0x687F, cpu->al);
-            }
-        }
 
-        /* Output pixel(s) */
-        if (is_4bit) {
-            cpu->ah = cpu->al;
-            cpu->al &= 0x0F;
-            cpu->ah >>= 4;
-            mem_write8(cpu, cpu->es, cpu->di, cpu->al);
-            mem_write8(cpu, cpu->es, (uint16_t)(cpu->di + 1), cpu->ah);
-            cpu->di += 2;
-        } else {
-            mem_write8(cpu, cpu->es, cpu->di, cpu->al);
-            cpu->di++;
-        }
+    uint32_t n = is_4bit ? 2u * cpu->cx : cpu->cx;
+    uint8_t *seg = cpu->mem + seg_off(cpu->es, 0);
+    uint16_t di = cpu->di;
+    int direct = (uint32_t)di + n <= 0x10000;
+    uint8_t *out = direct ? seg + di : s->wrap_buf;
 
-        mem_write16(cpu, cpu->ds, 0x687C,
-                    (uint16_t)(mem_read16(cpu, cpu->ds, 0x687C) - 1));
+    if (s->pic_img.cached && s->pic_img.pos + n <= s->pic_img.size) {
+        memcpy(out, s->pic_img.cached->pixels + s->pic_img.pos, n);
+    } else {
+        s->pic.ctx = cpu;
+        pic_decode_row(&s->pic, out, cpu->cx, is_4bit);
     }
 
+    /* Bytes went around mem_write8, so mark the rows they changed */
+    if (direct) {
+        vga_mark_range(cpu, seg_off(cpu->es, di), n);
+    } else {
+        for (uint32_t i = 0; i < n; i++)
+            mem_write8(cpu, cpu->es, (uint16_t)(di + i), s->wrap_buf[i]);
+    }
+
+    pic_image_row(cpu, out, n);
+
+    cpu->di = (uint16_t)(di + n);
+    mem_write16(cpu, cpu->ds, 0x687C, 0);
+    pic_sync(cpu, &s->pic);
     cpu->sp += 2; /* near ret */
 }
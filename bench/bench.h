@@ -0,0 +1,46 @@
+/*
+ * bench.h - civ_bench microbenchmark cases
+ *
+ * Each case times one of the runtime's hot primitives in isolation, on
+ * its own CPU and arena: the flag helpers and memory accessors lifted
+ * code inlines everywhere, the REP string helpers, the GFX page fill
+ * and copy behind far_0000_0BEC / far_0000_07ED and the sprite, line
+ * and glyph primitives next to them, the .PIC decoder on
+ * the game's own files, the DAC palette conversion and 8bpp expansion,
+ * and the text mode rasterizer. The table is shared by the built-in
+ * driver (bench_main.c) and the Google Benchmark one (bench_gbench.cpp);
+ * both emit Google Benchmark's JSON, so two runs can be compared with
+ * its tools/compare.py.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_BENCH_H
+#define CIV_BENCH_H
+
+#include <stdint.h>
+
+typedef struct {
+    char      name[64];
+    void    (*run)(void *ctx, uint64_t iters);  /* iters is a multiple of batch */
+    void     *ctx;
+    uint64_t  batch;            /* Iterations too short to time one at a time */
+    uint64_t  bytes;            /* Bytes written per iteration, 0 = not meaningful */
+} BenchCase;
+
+/* Build the case table; .PIC cases come from game_dir (none if it has
+ * no .PIC files). Returns the number of cases, or -1 if out of memory. */
+int bench_cases_init(const char *game_dir);
+const BenchCase *bench_case(int index);
+void bench_cases_free(void);
+
+/* Pixel kernel set the palette and glyph cases run with */
+const char *bench_pixel_kernels(void);
+
+/* GFX row kernel set the sprite cases run with */
+const char *bench_gfx_kernels(void);
+
+/* Remove "--gamedir DIR" from argv; returns DIR, or "." */
+const char *bench_take_gamedir(int *argc, char **argv);
+
+#endif /* CIV_BENCH_H */
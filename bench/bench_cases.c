@@ -0,0 +1,502 @@
+/*
+ * bench_cases.c - civ_bench microbenchmark cases
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L     /* dirent */
+#endif
+
+#include "bench.h"
+#include "recomp/cpu.h"
+#include "recomp/string_ops.h"
+#include "recomp/pic.h"
+#include "hal/gfx.h"
+#include "hal/video.h"
+#include "platform/pixel_kernels.h"
+#include "platform/text_mode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <strings.h>
+#endif
+
+/* Segments the memory and string cases work in */
+#define SRC_SEG     0x2000
+#define DST_SEG     0x3000
+
+/* g.pixels holds a converted frame or the 640x200 text image */
+#define PIXELS_MAX  (TEXT_PITCH * TEXT_ROWS * CHAR_H)
+
+/* Batch for the cases that are a handful of instructions each */
+#define TINY_BATCH  1024
+
+/* Results feed this so the compiler can't drop the work */
+static volatile uint32_t g_sink;
+
+/* ─── Shared state ─── */
+
+static struct {
+    CPU         cpu;
+    VideoState  video;
+    uint32_t    rgba[256];
+    uint8_t    *fb;                 /* Indexed frame for px_pal8 */
+    uint32_t   *pixels;             /* PIXELS_MAX 32-bit pixels */
+    uint8_t     text[TEXT_BYTES];
+    uint8_t     text_seen[TEXT_BYTES];
+    const char *kernels;
+    const char *gfx_kernels;
+
+    BenchCase  *cases;
+    int         count, cap;
+    char      (*pic_paths)[512];
+    int         pic_count;
+} g;
+
+/* Parameters of one sized case (rectangle or string length) */
+typedef struct {
+    int      w, h;              /* Rectangle; h = 0 for a string length of w */
+    int      op;
+} Sized;
+
+static Sized g_sized[64];
+static int   g_sized_count;
+
+static BenchCase *add(const char *name, void (*run)(void *, uint64_t), void *ctx,
+                      uint64_t batch, uint64_t bytes)
+{
+    if (g.count == g.cap) {
+        int cap = g.cap ? g.cap * 2 : 64;
+        BenchCase *c = (BenchCase *)realloc(g.cases, (size_t)cap * sizeof(*c));
+        if (!c)
+            return NULL;
+        g.cases = c;
+        g.cap = cap;
+    }
+    BenchCase *c = &g.cases[g.count++];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->run = run;
+    c->ctx = ctx;
+    c->batch = batch;
+    c->bytes = bytes;
+    return c;
+}
+
+static Sized *sized(int w, int h, int op)
+{
+    if (g_sized_count == (int)(sizeof(g_sized) / sizeof(g_sized[0])))
+        return NULL;
+    Sized *s = &g_sized[g_sized_count++];
+    s->w = w;
+    s->h = h;
+    s->op = op;
+    return s;
+}
+
+/* ─── Flags ─── */
+
+static void run_add16(void *ctx, uint64_t n)
+{
+    CPU *cpu = (CPU *)ctx;
+    uint16_t a = 0x1234;
+    for (uint64_t i = 0; i < n; i++)
+        a = flags_add16(cpu, a, (uint16_t)(i * 0x9E37u));
+    g_sink = a ^ cpu->flags;
+}
+
+static void run_sub16(void *ctx, uint64_t n)
+{
+    CPU *cpu = (CPU *)ctx;
+    uint16_t a = 0x1234;
+    for (uint64_t i = 0; i < n; i++)
+        a = flags_sub16(cpu, a, (uint16_t)(i * 0x9E37u));
+    g_sink = a ^ cpu->flags;
+}
+
+/* Each result depends on the flags of the last, so none can be skipped */
+static void run_szp8(void *ctx, uint64_t n)
+{
+    CPU *cpu = (CPU *)ctx;
+    for (uint64_t i = 0; i < n; i++)
+        set_szp8(cpu, (uint8_t)(i + cpu->flags));
+    g_sink = cpu->flags;
+}
+
+static void run_szp16(void *ctx, uint64_t n)
+{
+    CPU *cpu = (CPU *)ctx;
+    for (uint64_t i = 0; i < n; i++)
+        set_szp16(cpu, (uint16_t)(i * 0x0101u + cpu->flags));
+    g_sink = cpu->flags;
+}
+
+/* ─── Memory accessors ─── */
+
+static void run_read16(void *ctx, uint64_t n)
+{
+    CPU *cpu = (CPU *)ctx;
+    uint32_t sum = 0;
+    uint16_t off = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        sum += mem_read16(cpu, SRC_SEG, off);
+        off = (uint16_t)(off + 0x0123);
+    }
+    g_sink = sum;
+}
+
+static void write16_loop(CPU *cpu, uint16_t seg, uint64_t n)
+{
+    uint16_t off = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        mem_write16(cpu, seg, off, (uint16_t)i);
+        off = (uint16_t)(off + 0x0123);
+    }
+}
+
+static void run_write16(void *ctx, uint64_t n)
+{
+    write16_loop((CPU *)ctx, DST_SEG, n);
+}
+
+/* Through the VGA window, with dirty-row tracking */
+static void run_write16_vga(void *ctx, uint64_t n)
+{
+    write16_loop((CPU *)ctx, 0xA000, n);
+}
+
+/* ─── REP string helpers ─── */
+
+enum { REP_MOVSB, REP_MOVSW, REP_STOSB, REP_STOSW, REP_CMPSB, REP_SCASB };
+
+static const char *const rep_names[] = {
+    "movsb", "movsw", "stosb", "stosw", "cmpsb", "scasb"
+};
+
+static void run_rep(void *ctx, uint64_t n)
+{
+    const Sized *s = (const Sized *)ctx;
+    CPU *cpu = &g.cpu;
+    int words = s->op == REP_MOVSW || s->op == REP_STOSW;
+    for (uint64_t i = 0; i < n; i++) {
+        cpu->cx = (uint16_t)(words ? s->w / 2 : s->w);
+        cpu->si = 0;
+        cpu->di = 0;
+        /* Both segments stay zero: compares match and the scan for
+         * FFh runs to the end */
+        cpu->ax = s->op == REP_SCASB ? 0xFFFF : 0;
+        switch (s->op) {
+        case REP_MOVSB: rep_movsb(cpu, SRC_SEG);    break;
+        case REP_MOVSW: rep_movsw(cpu, SRC_SEG);    break;
+        case REP_STOSB: rep_stosb(cpu);             break;
+        case REP_STOSW: rep_stosw(cpu);             break;
+        case REP_CMPSB: rep_cmpsb(cpu, SRC_SEG, 1); break;
+        case REP_SCASB: rep_scasb(cpu, 0);          break;
+        }
+    }
+    g_sink = cpu->di;
+}
+
+/* ─── GFX pages ─── */
+
+static void run_fill(void *ctx, uint64_t n)
+{
+    const Sized *s = (const Sized *)ctx;
+    for (uint64_t i = 0; i < n; i++)
+        gfx_fill_rect(&g.cpu, 1, 0, 0, (int16_t)s->w, (int16_t)s->h, (uint8_t)i);
+}
+
+/* Off-screen page to the VGA page, the game's present path */
+static void run_copy(void *ctx, uint64_t n)
+{
+    const Sized *s = (const Sized *)ctx;
+    for (uint64_t i = 0; i < n; i++)
+        gfx_copy_rect(&g.cpu, 1, 0, 0, (int16_t)s->w, (int16_t)s->h, 0,
+                      (int16_t)(i & 7), 0);
+}
+
+/* Colour-keyed sprite from an off-screen page, the map tile path */
+static void run_masked(void *ctx, uint64_t n)
+{
+    const Sized *s = (const Sized *)ctx;
+    for (uint64_t i = 0; i < n; i++)
+        gfx_blit_masked(&g.cpu, 1, 0, 0, (int16_t)s->w, (int16_t)s->h, 0,
+                        (int16_t)(i & 7), 0, 0);
+}
+
+static void run_expand4(void *ctx, uint64_t n)
+{
+    static const uint8_t map[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+    const Sized *s = (const Sized *)ctx;
+    uint16_t pitch = (uint16_t)((s->w + 1) / 2);
+    for (uint64_t i = 0; i < n; i++)
+        gfx_blit_expand4(&g.cpu, GFX_PAGE_2, pitch, (int16_t)s->w, (int16_t)s->h, 0,
+                         (int16_t)(i & 7), 0, map, 0);
+}
+
+/* Lines at every angle across the page */
+static void run_line(void *ctx, uint64_t n)
+{
+    (void)ctx;
+    for (uint64_t i = 0; i < n; i++) {
+        int16_t t = (int16_t)(i % 520);
+        if (t < 320)
+            gfx_line(&g.cpu, 0, t, 0, (int16_t)(GFX_WIDTH - 1 - t), GFX_HEIGHT - 1, (uint8_t)i);
+        else
+            gfx_line(&g.cpu, 0, 0, (int16_t)(t - 320), GFX_WIDTH - 1,
+                     (int16_t)(GFX_HEIGHT - 1 - (t - 320)), (uint8_t)i);
+    }
+}
+
+/* A 40x25 screen of 8x8 glyphs (rows from the noise frame), transparent
+ * background */
+static void run_glyphs(void *ctx, uint64_t n)
+{
+    (void)ctx;
+    for (uint64_t i = 0; i < n; i++)
+        for (int c = 0; c < 40 * 25; c++)
+            gfx_glyph(&g.cpu, 0, (int16_t)(c % 40 * 8), (int16_t)(c / 40 * 8),
+                      g.fb + c * 8, 8, 8, (uint8_t)i, GFX_NO_COLOR);
+}
+
+/* ─── .PIC decoding ─── */
+
+/* The whole of pic_load: the read (from the page cache after the first
+ * iteration), the chunk walk and the LZW/RLE decode */
+static void run_pic(void *ctx, uint64_t n)
+{
+    const char *path = (const char *)ctx;
+    for (uint64_t i = 0; i < n; i++) {
+        PicImage img;
+        if (pic_load(path, &img, 1) == 0) {
+            g_sink = img.pixels[img.size - 1];
+            pic_free(&img);
+        }
+    }
+}
+
+static int pic_name_cmp(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+#ifndef _WIN32
+static int is_pic_name(const char *name)
+{
+    size_t n = strlen(name);
+    return n > 4 && strcasecmp(name + n - 4, ".pic") == 0;
+}
+#endif
+
+static void add_pic(const char *dir, const char *name)
+{
+    char (*paths)[512] = (char (*)[512])realloc(g.pic_paths,
+                                              (size_t)(g.pic_count + 1) * sizeof(*paths));
+    if (!paths)
+        return;
+    g.pic_paths = paths;
+    snprintf(paths[g.pic_count++], sizeof(*paths), "%s/%s", dir, name);
+}
+
+/* The .PIC files in dir, sorted by name so runs line up */
+static void find_pics(const char *dir)
+{
+#ifdef _WIN32
+    char pattern[280];
+    WIN32_FIND_DATAA fd;
+    snprintf(pattern, sizeof(pattern), "%s\\*.PIC", dir);
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            add_pic(dir, fd.cFileName);
+        } while (FindNextFileA(h, &fd));
+        FindClose(h);
+    }
+#else
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            if (is_pic_name(de->d_name))
+                add_pic(dir, de->d_name);
+        }
+        closedir(d);
+    }
+#endif
+    qsort(g.pic_paths, (size_t)g.pic_count, sizeof(*g.pic_paths), pic_name_cmp);
+}
+
+/* ─── Palette and text ─── */
+
+static void run_palette(void *ctx, uint64_t n)
+{
+    (void)ctx;
+    for (uint64_t i = 0; i < n; i++) {
+        g.video.palette[i & 0xFF][0] = (uint8_t)(i & 0x3F);     /* a DAC write */
+        video_get_rgba_palette(&g.video, g.rgba);
+    }
+    g_sink = g.rgba[255];
+}
+
+static void run_pal8(void *ctx, uint64_t n)
+{
+    (void)ctx;
+    for (uint64_t i = 0; i < n; i++)
+        px_pal8(g.pixels, g.fb, g.rgba, VGA_FB_LEN);
+    g_sink = g.pixels[VGA_FB_LEN - 1];
+}
+
+/* Every cell, as after a mode switch */
+static void run_text_full(void *ctx, uint64_t n)
+{
+    (void)ctx;
+    int first, last;
+    for (uint64_t i = 0; i < n; i++)
+        text_mode_render(g.pixels, g.text_seen, g.text, 1, &first, &last);
+}
+
+/* One changed cell per frame, as while the game is typing */
+static void run_text_cell(void *ctx, uint64_t n)
+{
+    (void)ctx;
+    int first, last;
+    for (uint64_t i = 0; i < n; i++) {
+        g.text[(i % (TEXT_COLS * TEXT_ROWS)) * 2] ^= 0x01;
+        text_mode_render(g.pixels, g.text_seen, g.text, 0, &first, &last);
+    }
+}
+
+/* ─── Table ─── */
+
+int bench_cases_init(const char *game_dir)
+{
+    cpu_init(&g.cpu);
+    if (cpu_alloc_mem(&g.cpu) < 0)
+        return -1;
+    set_sreg(&g.cpu, SREG_DS, SRC_SEG);
+    set_sreg(&g.cpu, SREG_ES, DST_SEG);
+    g.kernels = pixel_kernels_init();
+    g.gfx_kernels = gfx_kernels_init();
+
+    video_init(&g.video);
+    video_get_rgba_palette(&g.video, g.rgba);
+    g.fb = (uint8_t *)malloc(VGA_FB_LEN);
+    g.pixels = (uint32_t *)malloc(PIXELS_MAX * sizeof(uint32_t));
+    if (!g.fb || !g.pixels)
+        return -1;
+
+    /* Deterministic content: a noisy frame, and text of every glyph */
+    uint32_t x = 0x2545F491u;
+    for (int i = 0; i < VGA_FB_LEN; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        g.fb[i] = (uint8_t)x;
+    }
+    for (int i = 0; i < TEXT_COLS * TEXT_ROWS; i++) {
+        g.text[i * 2] = (uint8_t)i;
+        g.text[i * 2 + 1] = (uint8_t)(0x07 + (i & 0x70));
+    }
+    memcpy(g.cpu.mem + GFX_PAGE_1, g.fb, VGA_FB_LEN);
+    memcpy(g.cpu.mem + GFX_PAGE_2, g.fb, VGA_FB_LEN);
+
+    int ok = add("flags/add16", run_add16, &g.cpu, TINY_BATCH, 0) &&
+             add("flags/sub16", run_sub16, &g.cpu, TINY_BATCH, 0) &&
+             add("flags/set_szp8", run_szp8, &g.cpu, TINY_BATCH, 0) &&
+             add("flags/set_szp16", run_szp16, &g.cpu, TINY_BATCH, 0) &&
+             add("mem/read16", run_read16, &g.cpu, TINY_BATCH, 0) &&
+             add("mem/write16", run_write16, &g.cpu, TINY_BATCH, 2) &&
+             add("mem/write16_vga", run_write16_vga, &g.cpu, TINY_BATCH, 2);
+
+    static const int rep_lengths[] = { 16, 256, 4096, 64000 };
+    for (int op = REP_MOVSB; ok && op <= REP_SCASB; op++) {
+        for (int i = 0; ok && i < 4; i++) {
+            char name[64];
+            int len = rep_lengths[i];
+            Sized *s = sized(len, 0, op);
+            snprintf(name, sizeof(name), "string/rep_%s/%d", rep_names[op], len);
+            int writes = op <= REP_STOSW;
+            ok = s && add(name, run_rep, s, len < 1024 ? 64 : 1, writes ? (uint64_t)len : 0);
+        }
+    }
+
+    static const int rects[][2] = { { 8, 8 }, { 16, 16 }, { 80, 50 }, { 320, 200 } };
+    for (int i = 0; ok && i < 4; i++) {
+        char name[64];
+        int w = rects[i][0], h = rects[i][1];
+        Sized *s = sized(w, h, 0);
+        snprintf(name, sizeof(name), "gfx/fill_rect/%dx%d", w, h);
+        ok = s && add(name, run_fill, s, w * h < 1024 ? 64 : 1, (uint64_t)(w * h));
+        snprintf(name, sizeof(name), "gfx/copy_rect/%dx%d", w, h);
+        ok = ok && add(name, run_copy, s, w * h < 1024 ? 64 : 1, (uint64_t)(w * h));
+        snprintf(name, sizeof(name), "gfx/blit_masked/%dx%d", w, h);
+        ok = ok && add(name, run_masked, s, w * h < 1024 ? 64 : 1, (uint64_t)(w * h));
+        snprintf(name, sizeof(name), "gfx/blit_expand4/%dx%d", w, h);
+        ok = ok && add(name, run_expand4, s, w * h < 1024 ? 64 : 1, (uint64_t)(w * h));
+    }
+    ok = ok && add("gfx/line", run_line, NULL, 16, 0) &&
+         add("gfx/glyph_screen", run_glyphs, NULL, 1, 40 * 25 * 64);
+
+    ok = ok && add("video/rgba_palette", run_palette, NULL, 16, sizeof(g.rgba)) &&
+         add("video/pal8_frame", run_pal8, NULL, 1, VGA_FB_LEN * sizeof(uint32_t)) &&
+         add("text/render_full", run_text_full, NULL, 1, 0) &&
+         add("text/render_cell", run_text_cell, NULL, 16, 0);
+
+    find_pics(game_dir);
+    for (int i = 0; ok && i < g.pic_count; i++) {
+        PicImage img;
+        if (pic_load(g.pic_paths[i], &img, 1) != 0)
+            continue;
+        char name[64];
+        const char *base = strrchr(g.pic_paths[i], '/');
+        snprintf(name, sizeof(name), "pic/load/%s", base ? base + 1 : g.pic_paths[i]);
+        ok = add(name, run_pic, g.pic_paths[i], 1, img.size) != NULL;
+        pic_free(&img);
+    }
+
+    return ok ? g.count : -1;
+}
+
+const BenchCase *bench_case(int index)
+{
+    return index >= 0 && index < g.count ? &g.cases[index] : NULL;
+}
+
+void bench_cases_free(void)
+{
+    free(g.cases);
+    free(g.pic_paths);
+    free(g.fb);
+    free(g.pixels);
+    cpu_free(&g.cpu);
+    memset(&g, 0, sizeof(g));
+}
+
+const char *bench_pixel_kernels(void)
+{
+    return g.kernels ? g.kernels : "scalar";
+}
+
+const char *bench_gfx_kernels(void)
+{
+    return g.gfx_kernels ? g.gfx_kernels : "scalar";
+}
+
+const char *bench_take_gamedir(int *argc, char **argv)
+{
+    const char *dir = ".";
+    int out = 1;
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--gamedir") == 0 && i + 1 < *argc)
+            dir = argv[++i];
+        else
+            argv[out++] = argv[i];
+    }
+    *argc = out;
+    argv[out] = NULL;
+    return dir;
+}
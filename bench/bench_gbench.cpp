@@ -0,0 +1,50 @@
+/*
+ * bench_gbench.cpp - civ_bench driver on Google Benchmark
+ *
+ * Registers the cases of bench_cases.c with Google Benchmark, which then
+ * takes its usual flags (--benchmark_filter, --benchmark_min_time,
+ * --benchmark_format=json, --benchmark_out=FILE, ...). --gamedir DIR is
+ * taken out of the command line first.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+extern "C" {
+#include "bench.h"
+}
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    const char *game_dir = bench_take_gamedir(&argc, argv);
+    int count = bench_cases_init(game_dir);
+    if (count < 0) {
+        std::fprintf(stderr, "Error: out of memory setting up the benchmarks\n");
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const BenchCase *c = bench_case(i);
+        benchmark::RegisterBenchmark(c->name, [c](benchmark::State &state) {
+            while (state.KeepRunningBatch(static_cast<benchmark::IterationCount>(c->batch)))
+                c->run(c->ctx, c->batch);
+            if (c->bytes)
+                state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                                        static_cast<int64_t>(c->bytes));
+        });
+    }
+    benchmark::AddCustomContext("pixel_kernels", bench_pixel_kernels());
+    benchmark::AddCustomContext("gfx_kernels", bench_gfx_kernels());
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    bench_cases_free();
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * bench_main.c - civ_bench driver without Google Benchmark
+ *
+ * Runs every case (or those whose name contains --filter) for at least
+ * --min-time seconds and writes the results as Google Benchmark JSON to
+ * stdout or --out FILE, with a readable table on stderr:
+ *
+ *   civ_bench --gamedir path/to/civ [--filter gfx/] [--min-time 0.5] [--out base.json]
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Iteration counts grow by at most this factor between timing runs */
+#define MAX_GROWTH  10.0
+
+static double wall_s(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    uint64_t iters;
+    double   real_s;
+    double   cpu_s;
+} Timing;
+
+/* Grow the iteration count until one run lasts min_time */
+static Timing measure(const BenchCase *c, double min_time)
+{
+    Timing t = { c->batch, 0, 0 };
+    for (;;) {
+        clock_t c0 = clock();
+        double w0 = wall_s();
+        c->run(c->ctx, t.iters);
+        t.real_s = wall_s() - w0;
+        t.cpu_s = (double)(clock() - c0) / CLOCKS_PER_SEC;
+        if (t.real_s >= min_time)
+            return t;
+
+        double grow = t.real_s > 0 ? min_time * 1.4 / t.real_s : MAX_GROWTH;
+        if (grow > MAX_GROWTH)
+            grow = MAX_GROWTH;
+        uint64_t next = (uint64_t)((double)t.iters * grow);
+        next = (next + c->batch - 1) / c->batch * c->batch;
+        t.iters = next > t.iters ? next : t.iters + c->batch;
+    }
+}
+
+static void put_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *game_dir = bench_take_gamedir(&argc, argv);
+    const char *filter = NULL;
+    const char *out_path = NULL;
+    double min_time = 0.2;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--gamedir DIR] [--filter TEXT] [--min-time S] [--out FILE]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    int count = bench_cases_init(game_dir);
+    if (count < 0) {
+        fprintf(stderr, "Error: out of memory setting up the benchmarks\n");
+        return 1;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: cannot write '%s'\n", out_path);
+        bench_cases_free();
+        return 1;
+    }
+
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    fprintf(out, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": ", date);
+    put_string(out, argv[0]);
+#ifdef NDEBUG
+    fprintf(out, ",\n    \"library_build_type\": \"release\"");
+#else
+    fprintf(out, ",\n    \"library_build_type\": \"debug\"");
+#endif
+    fprintf(out, ",\n    \"pixel_kernels\": \"%s\",\n    \"gfx_kernels\": \"%s\"\n  },\n"
+            "  \"benchmarks\": [", bench_pixel_kernels(), bench_gfx_kernels());
+
+    fprintf(stderr, "%-32s %14s %14s %12s\n", "case", "ns/iter", "iterations", "MB/s");
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        const BenchCase *c = bench_case(i);
+        if (filter && !strstr(c->name, filter))
+            continue;
+
+        Timing t = measure(c, min_time);
+        double ns = t.real_s * 1e9 / (double)t.iters;
+        double bps = c->bytes ? (double)c->bytes * (double)t.iters / t.real_s : 0;
+        fprintf(stderr, "%-32s %14.2f %14llu %12.1f\n", c->name, ns,
+                (unsigned long long)t.iters, bps / 1e6);
+
+        fprintf(out, "%s\n    {\n      \"name\": ", written++ ? "," : "");
+        put_string(out, c->name);
+        fprintf(out, ",\n      \"run_name\": ");
+        put_string(out, c->name);
+        fprintf(out, ",\n      \"run_type\": \"iteration\",\n"
+                "      \"repetitions\": 1,\n      \"repetition_index\": 0,\n"
+                "      \"threads\": 1,\n      \"iterations\": %llu,\n"
+                "      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n"
+                "      \"time_unit\": \"ns\"",
+                (unsigned long long)t.iters, ns, t.cpu_s * 1e9 / (double)t.iters);
+        if (c->bytes)
+            fprintf(out, ",\n      \"bytes_per_second\": %.1f", bps);
+        fprintf(out, "\n    }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    bench_cases_free();
+    return 0;
+}
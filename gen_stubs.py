@@ -9,9 +9,8 @@ for sym in syms:
         ret = 'cpu->sp += 2; /* near ret */'
     lines.append(
         'void %s(CPU *cpu) {\n'
-        '    (void)cpu;\n'
-        '    static int _count = 0; _count++;\n'
-        '    if (_count == 1 || (_count %% 10000) == 0) fprintf(stderr, "[STUB] %s called (n=%%d)\\n", _count);\n'
+        '    LOG_SAMPLED(LOG_LEVEL_WARN, LOG_DIAG, 1, 10000, "[STUB] %s called (n=%%llu)\\n",\n'
+        '                (unsigned long long)log_hit);\n'
         '    %s\n'
         '}\n' % (sym, sym, ret))
 with open('D:/recomp/pc/civ/repo/new_stubs.txt', 'w') as f:
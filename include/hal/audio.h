@@ -0,0 +1,84 @@
+/*
+ * audio.h - AdLib OPL2 and PC speaker HAL
+ *
+ * The game thread never synthesizes anything: its writes to the AdLib
+ * ports (0x388/0x389), the speaker gate (0x61) and PIT channel 2
+ * (0x42/0x43) become timestamped events in a single-producer/single-
+ * consumer ring. The audio thread (the SDL audio callback) drains the
+ * ring in audio_render, replays each event AUDIO_LATENCY_MS after its
+ * timestamp and renders the OPL2 and the speaker in blocks of
+ * AUDIO_BLOCK samples. Neither side takes a lock; a full ring drops the
+ * write (counted in dropped).
+ *
+ * The OPL2 status register is answered on the game thread, so the
+ * driver's timer-based detection works whether or not a device is open.
+ * Timers report expiry as soon as they are started. Rhythm mode voices
+ * are approximations of the chip's noise mixing.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_HAL_AUDIO_H
+#define CIV_HAL_AUDIO_H
+
+#include <stdint.h>
+
+#define AUDIO_RING_SIZE   4096    /* Events, power of two */
+#define AUDIO_BLOCK       32      /* Samples per envelope/LFO step */
+#define AUDIO_LATENCY_MS  40      /* Event time to playback time */
+
+/* AudioEvent.kind */
+#define AUDIO_EV_OPL      0       /* OPL2 register reg = value */
+#define AUDIO_EV_SPEAKER  1       /* Port 0x61 bits 0-1 (gate, data) */
+#define AUDIO_EV_PIT2     2       /* PIT channel 2 reload value */
+
+typedef struct {
+    uint64_t at_ms;               /* Instance clock at the write */
+    uint16_t value;
+    uint8_t  kind;
+    uint8_t  reg;
+} AudioEvent;
+
+typedef struct {
+    /* Game thread */
+    uint8_t  active;              /* A device is consuming the ring */
+    uint8_t  opl_index;           /* Register selected through 0x388 */
+    uint8_t  opl_status;          /* Timer flags read back from 0x388 */
+    uint8_t  port61;              /* Last value written to port 0x61 */
+    uint8_t  refresh;             /* Port 0x61 bit 4, toggles per read */
+    uint8_t  pit2_access;         /* Channel 2 access mode (PIT command bits 5-4) */
+    uint8_t  pit2_byte;           /* Next byte of a lo/hi reload */
+    uint16_t pit2_reload;
+    uint32_t dropped;             /* Events lost to a full ring */
+
+    /* Ring: head is written by the game thread, tail by the audio thread */
+    AudioEvent        ring[AUDIO_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+
+    /* Audio thread */
+    void    *synth;               /* Synthesizer state, while open */
+} AudioState;
+
+void audio_init(AudioState *as);
+
+/* Port I/O from the game. now_ms stamps the event; it is only looked at
+ * while a device is open (audio_is_active). */
+void audio_port_write(AudioState *as, uint16_t port, uint8_t value, uint64_t now_ms);
+uint8_t audio_port_read(AudioState *as, uint16_t port);
+int audio_is_active(const AudioState *as);
+
+/* Attach a consumer rendering at rate Hz, before its device starts.
+ * Returns 0, or -1 if the synthesizer can't be allocated. */
+int audio_open(AudioState *as, int rate);
+
+/* Audio thread: fill out with frames mono samples */
+void audio_render(AudioState *as, int16_t *out, int frames);
+
+/* Detach the consumer, after its device has stopped calling audio_render */
+void audio_close(AudioState *as);
+
+/* SIMD variant the synthesizer was built with ("sse2", "neon" or "scalar") */
+const char *audio_kernels(void);
+
+#endif /* CIV_HAL_AUDIO_H */
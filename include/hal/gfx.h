@@ -0,0 +1,108 @@
+/*
+ * gfx.h - GFX page drawing primitives
+ *
+ * The game draws into three 320x200 byte-per-pixel pages: the VGA
+ * framebuffer and two off-screen pages above it in the 1 MB arena. Its
+ * drawing routines take a GFX context (a DS offset) whose first words
+ * are the page number and an x/y origin; the hand-written replacements
+ * in civ_impl.c read those and call the primitives here with page
+ * coordinates. Everything is clipped to the page, and drawing into the
+ * VGA page marks the rows it touched.
+ *
+ * Besides the opaque fill and copy there are the sprite primitives the
+ * map redraw spends its time in: colour-keyed blits, 4bpp expand-blits,
+ * lines and 1bpp glyphs. Their row kernels come in scalar, SSE2 / SSSE3
+ * / AVX2 (x86) and NEON (ARM) versions; gfx_kernels_init() picks the set.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_HAL_GFX_H
+#define CIV_HAL_GFX_H
+
+#include "recomp/cpu.h"
+
+#define GFX_PAGE_VGA   0xA0000
+#define GFX_PAGE_1     0xC0000
+#define GFX_PAGE_2     0xD0000
+
+#define GFX_WIDTH      320
+#define GFX_HEIGHT     200
+
+/* "No colour" for the int colour params below */
+#define GFX_NO_COLOR   (-1)
+
+/* Flat address of a GFX page (0 = VGA, 1 and 2 off-screen) */
+static inline uint32_t gfx_page_addr(uint16_t page)
+{
+    switch (page) {
+    case 1:  return GFX_PAGE_1;
+    case 2:  return GFX_PAGE_2;
+    default: return GFX_PAGE_VGA;
+    }
+}
+
+/* The words of a GFX context the page primitives need */
+typedef struct {
+    uint16_t page;      /* [+00] drawing page (0=VGA, 1, 2) */
+    int16_t  x_origin;  /* [+02] added to x params */
+    int16_t  y_origin;  /* [+04] added to y params */
+} GfxContext;
+
+/* Read the context at ds:ptr through the cached DS base. The game
+ * rewrites it between calls, so it is read once per call, not cached. */
+static inline void gfx_read_context(CPU *cpu, uint16_t ptr, GfxContext *ctx)
+{
+    ctx->page     = ds_read16(cpu, ptr);
+    ctx->x_origin = (int16_t)ds_read16(cpu, (uint16_t)(ptr + 0x02));
+    ctx->y_origin = (int16_t)ds_read16(cpu, (uint16_t)(ptr + 0x04));
+}
+
+/* Fill width x height pixels at (x, y) of page with color */
+void gfx_fill_rect(CPU *cpu, uint16_t page, int16_t x, int16_t y,
+                   int16_t width, int16_t height, uint8_t color);
+
+/* Copy width x height pixels from (sx, sy) of src_page to (dx, dy) of
+ * dst_page; the rectangles may overlap */
+void gfx_copy_rect(CPU *cpu, uint16_t src_page, int16_t sx, int16_t sy,
+                   int16_t width, int16_t height,
+                   uint16_t dst_page, int16_t dx, int16_t dy);
+
+/* As gfx_copy_rect, but source pixels equal to key are left out */
+void gfx_blit_masked(CPU *cpu, uint16_t src_page, int16_t sx, int16_t sy,
+                     int16_t width, int16_t height,
+                     uint16_t dst_page, int16_t dx, int16_t dy, uint8_t key);
+
+/* Draw a width x height 4bpp image (two pixels per byte, high nibble
+ * first, pitch bytes per row) from flat address src to (dx, dy) of
+ * dst_page, mapping each nibble through map. Nibbles equal to key are
+ * left out unless key is GFX_NO_COLOR. */
+void gfx_blit_expand4(CPU *cpu, uint32_t src, uint16_t pitch,
+                      int16_t width, int16_t height,
+                      uint16_t dst_page, int16_t dx, int16_t dy,
+                      const uint8_t map[16], int key);
+
+/* Horizontal / vertical line of length pixels starting at (x, y) */
+void gfx_hline(CPU *cpu, uint16_t page, int16_t x, int16_t y, int16_t length, uint8_t color);
+void gfx_vline(CPU *cpu, uint16_t page, int16_t x, int16_t y, int16_t length, uint8_t color);
+
+/* Bresenham line from (x0, y0) to (x1, y1), both ends included. Clipping
+ * leaves the pixels inside the page exactly where the unclipped line
+ * would have put them. */
+void gfx_line(CPU *cpu, uint16_t page, int16_t x0, int16_t y0,
+              int16_t x1, int16_t y1, uint8_t color);
+
+/* Draw height 1bpp font rows (MSB = leftmost pixel, width <= 8) at
+ * (x, y): set bits in fg, clear bits in bg (left out if bg is
+ * GFX_NO_COLOR) */
+void gfx_glyph(CPU *cpu, uint16_t page, int16_t x, int16_t y, const uint8_t *rows,
+               int width, int height, uint8_t fg, int bg);
+
+/* Select row kernels for this CPU; returns the name of the set chosen
+ * ("avx2", "ssse3", "sse2", "neon" or "scalar"). A set is only chosen
+ * if it matches the scalar kernels on a fixed pattern of lengths and
+ * keys. Usable before init: the kernels start out at the baseline set
+ * for the target. */
+const char *gfx_kernels_init(void);
+
+#endif /* CIV_HAL_GFX_H */
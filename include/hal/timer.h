@@ -4,6 +4,14 @@
  * Emulates the 8253/8254 PIT (Programmable Interval Timer) that
  * drives the DOS 18.2 Hz system tick (INT 08h/1Ch).
  *
+ * Two counts run off it. tick_count is the BIOS tick the game reads
+ * (INT 1Ah, 0040:006C), brought up to date by timer_update with
+ * whatever time the caller passes (the delay routines in civ_impl.c
+ * pass a sped-up one). The IRQ0 count follows the instance clock alone
+ * at the rate channel 0 is programmed for; timer_irq_sync advances it
+ * and the DOS layer hands each IRQ0 to the game's INT 08h/1Ch handlers
+ * at the next safe point (see cpu_safe_point).
+ *
  * Part of the Civ Recomp project (sp00nznet/civ)
  */
 
@@ -11,17 +19,49 @@
 #define CIV_HAL_TIMER_H
 
 #include <stdint.h>
+#include <time.h>
 
 #define PIT_FREQUENCY   1193182  /* PIT oscillator frequency in Hz */
 #define DOS_TICK_HZ     18.2065  /* Standard DOS timer tick rate */
 
+/* Millisecond clock behind timer_now_ms(), see timer_set_clock */
+typedef uint64_t (*timer_clock_fn)(void *ctx);
+
 typedef struct {
     uint32_t tick_count;         /* BIOS tick counter (at 0040:006C) */
     uint64_t start_ms;           /* SDL tick at init */
     uint16_t pit_reload;         /* PIT channel 0 reload value */
     double   tick_rate_hz;       /* Current effective tick rate */
+
+    /* Turbo: skip ahead whenever the game busy-waits on the tick */
+    uint8_t  turbo;              /* Enabled (--turbo, Alt+T) */
+    uint8_t  poll_repeats;       /* Polls in a row that saw poll_tick */
+    uint32_t poll_tick;          /* Tick count seen by the last poll */
+    uint64_t last_ms;            /* current_ms of the last timer_update */
+    uint64_t skipped_ms;         /* Time skipped so far, added to current_ms */
+
+    /* Clock of this instance; NULL = the host's */
+    timer_clock_fn clock_fn;
+    void          *clock_ctx;
+
+    /* PIT command port: last command, and which byte of the reload
+     * value channel 0 expects next */
+    uint8_t  pit_command;
+    uint8_t  pit_byte;
+
+    /* IRQ0 on the instance clock in microseconds (timer_irq_sync) */
+    uint64_t irq_start_us;       /* Clock at the first sync, 0 = not started */
+    uint64_t irq_last_us;        /* Elapsed time at the last sync */
+    uint64_t irq_base_us;        /* Elapsed time irq_rate_hz took effect at */
+    uint32_t irq_base;           /* IRQ0 count at that point */
+    double   irq_rate_hz;        /* Rate since then (tick_rate_hz when synced) */
+    uint32_t irq_due;            /* IRQ0s so far */
+    uint32_t irq_done;           /* IRQ0s handed to the game (or dropped) */
 } TimerState;
 
+/* Polls of an unchanged tick before turbo treats them as a wait loop */
+#define TURBO_POLL_SPINS 3
+
 void timer_init(TimerState *ts);
 
 /* Update tick count based on elapsed time */
@@ -30,6 +70,47 @@ void timer_update(TimerState *ts, uint64_t current_ms);
 /* Get current tick count (for BIOS data area) */
 uint32_t timer_get_ticks(const TimerState *ts);
 
+/* Read the tick count on behalf of the game. Use this, not
+ * timer_get_ticks, where the game polls it: with turbo on, once
+ * TURBO_POLL_SPINS polls in a row see the same tick the clock jumps
+ * forward to the next one, so wait loops run at host speed. */
+uint32_t timer_poll(TimerState *ts);
+
+/* Turn turbo on or off. Skipped time is kept, so ticks never go back. */
+void timer_set_turbo(TimerState *ts, int on);
+
+/* Move the clock so the tick count reads ticks as of current_ms, e.g.
+ * when a snapshot is restored; it carries on counting from there.
+ * IRQ0s still pending are dropped. */
+void timer_set_ticks(TimerState *ts, uint32_t ticks, uint64_t current_ms);
+
+/* Milliseconds from current_ms until tick_count next increments (>= 1) */
+uint32_t timer_ms_to_next_tick(const TimerState *ts, uint64_t current_ms);
+
+/* Bring the IRQ0 count up to the instance clock (timer_now_us). A new
+ * channel 0 rate takes effect from the previous sync. Returns the number
+ * of IRQ0s due but not yet marked done. */
+uint32_t timer_irq_sync(TimerState *ts);
+
+/* Milliseconds from the last sync until the next IRQ0 (>= 1) */
+uint32_t timer_ms_to_next_irq(const TimerState *ts);
+
+/* Millisecond clock of the instance ts belongs to. The default is the
+ * host's monotonic clock; headless bench mode installs a deterministic
+ * one derived from the lifted-function call count. NULL restores the
+ * default. Install it after timer_init, which clears it. */
+void timer_set_clock(TimerState *ts, timer_clock_fn fn, void *ctx);
+uint64_t timer_now_ms(const TimerState *ts);
+
+/* The same clock in microseconds: the host's high-resolution counter,
+ * or the virtual clock's milliseconds * 1000 */
+uint64_t timer_now_us(const TimerState *ts);
+int timer_is_virtual(const TimerState *ts);
+
+/* Wall-clock time for DOS date/time and RNG seeding: time(NULL), or a
+ * fixed epoch plus the virtual clock when one is installed */
+time_t timer_wall_time(const TimerState *ts);
+
 /* PIT port I/O */
 void timer_port_write(TimerState *ts, uint16_t port, uint8_t value);
 uint8_t timer_port_read(TimerState *ts, uint16_t port);
@@ -34,7 +34,8 @@ typedef struct {
     uint8_t dac_component;      /* 0=R, 1=G, 2=B */
     int     dac_is_write;       /* 1=writing, 0=reading */
 
-    /* Frame dirty flag (set when framebuffer is written) */
+    /* Palette changed since the last render; pixel rows are tracked
+     * per scanline in CPU.vga_dirty */
     int dirty;
 
     /* VGA status register state */
@@ -0,0 +1,48 @@
+/*
+ * gl_renderer.h - OpenGL 3.3 render path (--renderer gl)
+ *
+ * Keeps the mode 13h framebuffer on the GPU as what it is: a 320x200
+ * single-channel texture of palette indices plus a 256x1 palette
+ * texture, resolved to colour in the fragment shader. Dirty scanlines
+ * are uploaded straight from emulated memory with no conversion, and a
+ * DAC palette change (palette cycling, fades) costs a 1 KB upload
+ * instead of reconverting the frame. Text mode is still rasterized on
+ * the CPU and shown through a third texture.
+ *
+ * GL entry points are loaded through SDL_GL_GetProcAddress, so nothing
+ * links against an OpenGL library directly.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_GL_RENDERER_H
+#define CIV_GL_RENDERER_H
+
+#include <stdint.h>
+
+typedef struct GlRenderer GlRenderer;
+
+/* Request a 3.3 core profile; call before creating the window */
+void gl_renderer_prepare(void);
+
+/* Create a 3.3 core context on an SDL_WINDOW_OPENGL window (SDL_Window*).
+ * Returns NULL, after logging why, if the context, an entry point or
+ * the shaders are unavailable; the caller then falls back to the SDL
+ * renderer. */
+GlRenderer *gl_renderer_create(void *window, int text_w, int text_h);
+void gl_renderer_destroy(GlRenderer *gl);
+
+/* Upload scanlines [y0, y1) of the 320x200 index buffer */
+void gl_upload_indices(GlRenderer *gl, const uint8_t *fb, int y0, int y1);
+
+/* Upload the palette (256 entries, R in the low byte) */
+void gl_upload_palette(GlRenderer *gl, const uint32_t *rgba);
+
+/* Upload rows [y0, y1) of the RGBA text mode image */
+void gl_upload_text(GlRenderer *gl, const uint32_t *pixels, int y0, int y1);
+
+/* Draw the graphics (text_mode = 0) or text image letterboxed into the
+ * window and swap buffers */
+void gl_present(GlRenderer *gl, int text_mode);
+
+#endif /* CIV_GL_RENDERER_H */
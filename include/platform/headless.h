@@ -0,0 +1,95 @@
+/*
+ * headless.h - Null platform backend and scripted benchmark runner
+ *
+ * `civ --headless` runs the game with no window: event polls render
+ * nothing and return immediately. `civ --bench <script>` (implies
+ * --headless) also replaces the wall clock with a deterministic one
+ * driven by the lifted-function call count, feeds scripted keys into
+ * the keyboard buffer at fixed virtual times, and stops after a set
+ * number of game turns or a virtual time limit, printing wall time,
+ * lifted-function calls and frames produced.
+ *
+ * Script format, one directive per line ('#' starts a comment):
+ *
+ *   rate  <calls>          lifted calls per virtual millisecond (1000)
+ *   poll  <ms>             virtual ms charged per event poll (1)
+ *   key   <ms> <key>       queue a key at virtual time ms; key is a
+ *                          name (ENTER ESC SPACE TAB BKSP UP DOWN LEFT
+ *                          RIGHT F1..F10), a letter/digit, or 0xSSAA
+ *                          (scancode SS, ascii AA)
+ *   turns <n> <seg:off>    stop after the word at seg:off changed n times
+ *   end   <ms>             stop at virtual time ms (600000)
+ *
+ * `civ --instances N` runs N independent games headless at once, each
+ * on its own CPU, 1 MB arena, DosState and clock, spread over a pool of
+ * up to one thread per host core (headless_run_pool), and reports each
+ * as it stops plus the combined throughput. With a bench script every
+ * instance follows the same script, so all of them should finish with
+ * the same screen hash.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_HEADLESS_H
+#define CIV_HEADLESS_H
+
+#include "recomp/cpu.h"
+#include "recomp/dos_compat.h"
+
+#include <setjmp.h>
+
+#define HEADLESS_MAX_EVENTS 4096
+#define HEADLESS_TEXT_BASE  0xB8000
+#define HEADLESS_TEXT_SIZE  (80 * 25 * 2)
+
+typedef struct {
+    uint64_t at_ms;
+    uint8_t  scancode;
+    uint8_t  ascii;
+} BenchKey;
+
+typedef struct {
+    /* Script */
+    int       bench;            /* Deterministic clock + stop conditions */
+    BenchKey  keys[HEADLESS_MAX_EVENTS];
+    int       key_count;
+    int       next_key;
+    uint32_t  calls_per_ms;
+    uint32_t  poll_ms;
+    uint64_t  end_ms;
+    uint32_t  turn_limit;       /* 0 = no turn watch */
+    uint16_t  turn_seg, turn_off;
+
+    /* Run state */
+    const CPU *cpu;
+    DosState  *dos;
+    int       instance;         /* 1-based with --instances, else 0 */
+    jmp_buf   *stop;            /* Set: a stop condition longjmps here, else exits */
+    uint64_t  polls;
+    uint64_t  clock_reads;
+    uint64_t  frames;           /* Polls where the screen had changed */
+    uint32_t  turns;
+    uint16_t  last_turn;
+    uint64_t  wall_start_ns;
+    uint8_t   last_vga[VGA_FB_SIZE];
+    uint8_t   last_text[HEADLESS_TEXT_SIZE];
+} Headless;
+
+/* Defaults; bench = 0 runs on the normal clock with no script */
+void headless_init(Headless *h);
+
+/* Parse a bench script (sets h->bench). Returns 0, or -1 on error. */
+int headless_load_script(Headless *h, const char *path);
+
+/* Hook into the DOS layer: poll callback, virtual clock if benchmarking */
+void headless_start(Headless *h, CPU *cpu, DosState *dos);
+
+/* Print the benchmark report (reason = why the run stopped) */
+void headless_report(const Headless *h, const char *reason);
+
+/* Run run(i, arg) for i = 0 .. count-1 on a pool of at most threads
+ * threads (0 = one per host core), returning when all are done. The
+ * calling thread is one of them; returns how many were used. */
+int headless_run_pool(int count, int threads, void (*run)(int index, void *arg), void *arg);
+
+#endif /* CIV_HEADLESS_H */
@@ -0,0 +1,34 @@
+/*
+ * pixel_kernels.h - Palette and glyph expansion kernels
+ *
+ * The two inner loops of the renderer: 8bpp indexed pixels to 32-bit
+ * colour through a 256-entry palette (mode 13h), and 1bpp font rows to
+ * foreground/background pixels (text mode). Each has a scalar version
+ * and SSE4.1 / AVX2 (x86) or NEON (ARM) versions; pixel_kernels_init()
+ * points px_pal8 / px_glyph8 at the best one the CPU supports.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_PIXEL_KERNELS_H
+#define CIV_PIXEL_KERNELS_H
+
+#include <stdint.h>
+
+/* dst[i] = pal[src[i]] for i in [0, n) */
+typedef void (*px_pal8_fn)(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int n);
+
+/* Expand h font rows (MSB = leftmost pixel) into an 8-pixel-wide cell;
+ * pitch is the distance between dst rows in pixels */
+typedef void (*px_glyph8_fn)(uint32_t *dst, int pitch, const uint8_t *rows, int h,
+                             uint32_t fg, uint32_t bg);
+
+extern px_pal8_fn   px_pal8;
+extern px_glyph8_fn px_glyph8;
+
+/* Select kernels for this CPU; returns the name of the set chosen
+ * ("avx2", "sse4.1", "neon" or "scalar"). Usable before init: the
+ * pointers start out at the scalar versions. */
+const char *pixel_kernels_init(void);
+
+#endif /* CIV_PIXEL_KERNELS_H */
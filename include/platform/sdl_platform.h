@@ -15,28 +15,58 @@
 
 #define WINDOW_SCALE 3  /* 320x200 * 3 = 960x600 */
 
+/* Render backends (--renderer) */
+#define RENDERER_SDL 0  /* SDL_Renderer, palette expanded on the CPU */
+#define RENDERER_GL  1  /* OpenGL 3.3, palette resolved in a shader */
+
 typedef struct {
     void *window;       /* SDL_Window* */
+    void *present;      /* Frame handoff to the render thread */
+
+    /* Owned by the render thread after platform_init */
     void *renderer;     /* SDL_Renderer* */
     void *tex_vga;      /* SDL_Texture* for VGA mode 13h (320x200) */
     void *tex_text;     /* SDL_Texture* for text mode (640x200) */
+    void *gl;           /* GlRenderer* when the GL path is active */
+    int   last_mode;    /* Track mode changes for texture switching */
+    uint32_t *stage;    /* Converted RGBA rows for partial texture uploads */
+    uint32_t *text_pixels;              /* 640x200 text mode cell cache */
+    uint8_t  last_text[80 * 25 * 2];    /* Text buffer as last rendered */
+
     int   scale;
     int   running;
     int   fullscreen;
-    int   last_mode;    /* Track mode changes for texture switching */
+
+    /* Audio device and the instance it plays (platform_open_audio) */
+    uint32_t    audio_dev;      /* SDL_AudioDeviceID, 0 = none */
+    AudioState *audio;
 } Platform;
 
-/* Initialize SDL2 window and renderer */
-int platform_init(Platform *plat, int scale);
+/* Initialize SDL2 window and start the render thread, which creates the
+ * renderer. RENDERER_GL falls back to RENDERER_SDL if no 3.3 context
+ * can be created. */
+int platform_init(Platform *plat, int scale, int renderer);
 
-/* Shut down SDL2 */
+/* Open the audio device and play audio from it: the SDL audio callback
+ * renders the OPL2 and speaker events the game queues there. Returns 0,
+ * or -1 (the game runs silent) if no device can be opened. */
+int platform_open_audio(Platform *plat, AudioState *audio);
+
+/* Stop the render thread, close the audio device and shut down SDL2 */
 void platform_shutdown(Platform *plat);
 
 /* Process SDL events (keyboard, mouse, window) */
 void platform_poll_events(Platform *plat, DosState *dos);
 
-/* Render VGA framebuffer to screen */
-void platform_render(Platform *plat, const CPU *cpu, const DosState *dos);
+/* Sleep until an SDL event arrives or timeout_ms passes, then process
+ * everything queued. Returns 0 on timeout. */
+int platform_wait_events(Platform *plat, DosState *dos, uint32_t timeout_ms);
+
+/* Hand the screen to the render thread: copies the scanlines marked in
+ * cpu->vga_dirty, the text buffer and the palette into a snapshot and
+ * returns without waiting for the display. With nothing changed it does
+ * nothing. Clears the dirty state it consumes. */
+void platform_render(Platform *plat, CPU *cpu, DosState *dos);
 
 /* Get current time in milliseconds */
 uint64_t platform_get_ticks(void);
@@ -0,0 +1,29 @@
+/*
+ * text_mode.h - 80x25 text mode rasterizer
+ *
+ * Turns the char/attribute pairs of the text buffer into a 640x200
+ * 32-bit image with the 8x8 CP437 font, redrawing only the cells that
+ * changed. Used by the render thread for both renderers; it has no SDL
+ * dependency.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_TEXT_MODE_H
+#define CIV_TEXT_MODE_H
+
+#include <stdint.h>
+
+#define TEXT_COLS       80
+#define TEXT_ROWS       25
+#define TEXT_BYTES      (TEXT_COLS * TEXT_ROWS * 2)
+#define CHAR_H          8   /* pixels per character height (25*8 = 200) */
+#define TEXT_PITCH      (TEXT_COLS * 8)     /* Pixels per row of the image */
+
+/* Rasterize the cells of textbuf that differ from seen (all of them if
+ * full) into pixels and copy them to seen. Returns 0 if nothing changed,
+ * else 1 with the first and last text rows touched in *first, *last. */
+int text_mode_render(uint32_t *pixels, uint8_t *seen, const uint8_t *textbuf, int full,
+                     int *first, int *last);
+
+#endif /* CIV_TEXT_MODE_H */
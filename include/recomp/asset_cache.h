@@ -0,0 +1,43 @@
+/*
+ * asset_cache.h - Decoded .PIC image cache
+ *
+ * LRU cache of decoded images, keyed by (host path, mtime, 4-bit mode),
+ * with the file's palette alongside. The game's PIC reader records every
+ * image it decodes; when it later starts decoding a file the cache
+ * holds, the rows are copied out of the cache instead. An entry is only
+ * used when the decoder's start bytes match (pic_image_fits), and the
+ * decoder is left in the end state stored with it.
+ *
+ * asset_cache_preload() fills the cache from the game directory on a
+ * background thread using pic_load, the same decoder the game runs.
+ * An image recorded from the game replaces a preloaded one.
+ *
+ * All calls are thread-safe. Entries stay valid while acquired.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_ASSET_CACHE_H
+#define CIV_RECOMP_ASSET_CACHE_H
+
+#include "recomp/pic.h"
+
+#define ASSET_CACHE_SLOTS   160
+#define ASSET_CACHE_BUDGET  (24u << 20)  /* Bytes of decoded pixels */
+
+/* Look up a decoded image; NULL on a miss */
+const PicImage *asset_cache_acquire(const char *path, int is_4bit);
+
+/* Done with an acquired image. With discard set the entry is dropped,
+ * e.g. because it did not match what the game decoded. */
+void asset_cache_release(const PicImage *img, int discard);
+
+/* Add an image; the cache takes over img->pixels (freeing them if it
+ * cannot keep the image). With verified set (recorded from the game)
+ * it replaces a preloaded entry. */
+void asset_cache_insert(const char *path, int is_4bit, PicImage *img, int verified);
+
+/* Decode every .PIC file in game_dir on a background thread */
+void asset_cache_preload(const char *game_dir);
+
+#endif /* CIV_RECOMP_ASSET_CACHE_H */
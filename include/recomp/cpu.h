@@ -9,7 +9,10 @@
  * Memory model: The original game runs in 16-bit real mode with a
  * 1 MB address space (20-bit physical = segment << 4 + offset).
  * We allocate a flat 1 MB + 64K buffer and translate segment:offset
- * addresses to flat offsets at runtime.
+ * addresses to flat offsets at runtime. Each segment register also has
+ * its flat base pointer cached in CPU.seg_base, so an access through a
+ * segment register is one add and one (unaligned) load; segment
+ * registers must therefore be written through set_sreg.
  *
  * Part of the Civ Recomp project (sp00nznet/civ)
  */
@@ -36,9 +39,21 @@
 #define VGA_SEGMENT       0xA000
 #define VGA_FRAMEBUFFER   (VGA_SEGMENT << 4)     /* 0xA0000 */
 #define VGA_FB_SIZE       65536
+#define VGA_ROW_BYTES     320                    /* Mode 13h scanline */
+#define VGA_ROWS          200
+#define VGA_DIRTY_WORDS   ((VGA_ROWS + 31) / 32)
 #define BIOS_DATA_SEG     0x0040
 #define DOS_PSP_SIZE      256
 
+/* Segment register numbers, in ModRM sreg order (CPU.seg_base index) */
+enum { SREG_ES = 0, SREG_CS, SREG_SS, SREG_DS };
+
+/* Hosts where a guest word can be loaded with a plain unaligned memcpy */
+#if defined(_WIN32) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CPU_HOST_LE 1
+#endif
+
 /* ---------- CPU State ---------- */
 typedef struct CPU {
     /* General-purpose registers (low byte, high byte, word access) */
@@ -68,21 +83,185 @@ typedef struct CPU {
     /* Flat memory (1 MB address space) */
     uint8_t *mem;
 
+    /* mem + (sreg << 4) for ES, CS, SS, DS, indexed by SREG_*. Kept
+     * current by set_sreg; cpu_sync_sregs recomputes all four. */
+    uint8_t *seg_base[4];
+
+    /* DGROUP, the data segment DS holds outside the CRT startup, and
+     * mem + (dgroup_seg << 4) for DGROUP-specialized lifted code (dg_*).
+     * cpu_sync_sregs recomputes the pointer. */
+    uint16_t dgroup_seg;
+    uint8_t *dgroup;
+
     /* Direction flag cache (1 = decrement, 0 = increment) for string ops */
     int dir;
 
     /* Halt flag (set by HLT or INT 20h / program exit) */
     int halted;
 
+    /* Lazy flags: last flag-setting ALU op, see "Lazy flags" below.
+     * lf_op == LF_NONE means 'flags' is authoritative. */
+    uint8_t  lf_op;
+    uint8_t  lf_cf;     /* CF preserved across INC/DEC */
+    uint16_t lf_sign;   /* sign bit of the op width (0x80 or 0x8000) */
+    uint32_t lf_a;
+    uint32_t lf_b;
+    uint32_t lf_res;    /* unmasked result (carry/borrow in bit 8/16) */
+
+    /* Lifted-function entries so far (RECOMP_ENTER). Doubles as the
+     * deterministic clock in headless bench mode. */
+    uint64_t calls;
+
+    /* Safe points left until the next cpu_safe_point, and set while it
+     * runs an interrupt handler (see RECOMP_SAFE_POINT) */
+    uint32_t safe_countdown;
+    uint8_t  in_irq;
+
+    /* Mode 13h scanlines written since the platform last uploaded them,
+     * one bit per row (see vga_mark_rows) */
+    uint32_t vga_dirty[VGA_DIRTY_WORDS];
+
+    /* DOS layer of the game instance this CPU runs (set by dos_init) */
+    struct DosState *dos;
+
 } CPU;
 
+/* Safe points: function entries and loop back-edges in lifted code,
+ * where the registers are all in CPU (or preserved by the interrupt
+ * handler) and a hardware interrupt may run. Only every
+ * SAFE_POINT_INTERVAL-th one calls cpu_safe_point, which reads the
+ * clock and runs the game's INT 08h/1Ch handlers for IRQ0s due
+ * (dos_compat.c). */
+#define SAFE_POINT_INTERVAL 1024
+
+void cpu_safe_point(CPU *cpu);
+
+#define RECOMP_SAFE_POINT(cpu) \
+    do { if (--(cpu)->safe_countdown == 0) cpu_safe_point(cpu); } while (0)
+
+/* First statement of every lifted function */
+#define RECOMP_ENTER(cpu) do { (cpu)->calls++; RECOMP_SAFE_POINT(cpu); } while (0)
+
+/* Register-promoted local (lift.py --promote-regs): a word register
+ * with byte halves, same layout as the CPU struct unions. Lifted code
+ * keeps these in C locals so the compiler can hold them in host
+ * registers; they are spilled to CPU around calls and at exits. */
+typedef union { uint16_t x; struct { uint8_t l, h; }; } Reg16;
+
 /* ---------- Segment:offset → flat address ---------- */
 static inline uint32_t seg_off(uint16_t seg, uint16_t off)
 {
     return ((uint32_t)seg << 4) + off;
 }
 
+/* ---------- VGA dirty rows ---------- */
+
+/* Mark scanlines [y0, y1) of the mode 13h framebuffer as changed */
+static inline void vga_mark_rows(CPU *cpu, int y0, int y1)
+{
+    if (y0 < 0) y0 = 0;
+    if (y1 > VGA_ROWS) y1 = VGA_ROWS;
+    for (int y = y0; y < y1; y++)
+        cpu->vga_dirty[y >> 5] |= 1u << (y & 31);
+}
+
+/* Mark the scanlines covered by flat range [addr, addr + len) */
+static inline void vga_mark_range(CPU *cpu, uint32_t addr, uint32_t len)
+{
+    uint32_t end = VGA_FRAMEBUFFER + VGA_ROWS * VGA_ROW_BYTES;
+    if (len == 0 || addr >= end || addr + len <= VGA_FRAMEBUFFER) return;
+    uint32_t lo = addr < VGA_FRAMEBUFFER ? 0 : addr - VGA_FRAMEBUFFER;
+    uint32_t hi = (addr + len > end ? end : addr + len) - VGA_FRAMEBUFFER;
+    vga_mark_rows(cpu, (int)(lo / VGA_ROW_BYTES), (int)((hi - 1) / VGA_ROW_BYTES) + 1);
+}
+
+/* Single-byte store check, kept cheap for the mem_write path */
+static inline void vga_mark_byte(CPU *cpu, uint32_t addr)
+{
+    uint32_t rel = addr - VGA_FRAMEBUFFER;
+    if (rel < VGA_ROWS * VGA_ROW_BYTES) {
+        uint32_t y = rel / VGA_ROW_BYTES;
+        cpu->vga_dirty[y >> 5] |= 1u << (y & 31);
+    }
+}
+
+/* ---------- Segment registers ---------- */
+
+static inline void set_sreg(CPU *cpu, int sreg, uint16_t val)
+{
+    switch (sreg) {
+    case SREG_ES: cpu->es = val; break;
+    case SREG_CS: cpu->cs = val; break;
+    case SREG_SS: cpu->ss = val; break;
+    default:      cpu->ds = val; break;
+    }
+    cpu->seg_base[sreg & 3] = cpu->mem + ((uint32_t)val << 4);
+}
+
+/* Recompute seg_base after cpu->mem or the registers changed wholesale */
+static inline void cpu_sync_sregs(CPU *cpu)
+{
+    set_sreg(cpu, SREG_ES, cpu->es);
+    set_sreg(cpu, SREG_CS, cpu->cs);
+    set_sreg(cpu, SREG_SS, cpu->ss);
+    set_sreg(cpu, SREG_DS, cpu->ds);
+    cpu->dgroup = cpu->mem + ((uint32_t)cpu->dgroup_seg << 4);
+}
+
+static inline void cpu_set_dgroup(CPU *cpu, uint16_t seg)
+{
+    cpu->dgroup_seg = seg;
+    cpu->dgroup = cpu->mem + ((uint32_t)seg << 4);
+}
+
 /* ---------- Memory access ---------- */
+
+static inline uint16_t load_le16(const uint8_t *p)
+{
+#ifdef CPU_HOST_LE
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+#else
+    return (uint16_t)(p[0] | (p[1] << 8));
+#endif
+}
+
+static inline void store_le16(uint8_t *p, uint16_t v)
+{
+#ifdef CPU_HOST_LE
+    memcpy(p, &v, 2);
+#else
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+#endif
+}
+
+/* Word at base:off. At offset FFFFh the high byte wraps to offset 0 of
+ * the same segment, as on the 8086. */
+static inline uint16_t base_read16(const uint8_t *base, uint16_t off)
+{
+    if (off == 0xFFFF)
+        return (uint16_t)(base[0xFFFF] | (base[0] << 8));
+    return load_le16(base + off);
+}
+
+static inline void base_write16(CPU *cpu, uint8_t *base, uint16_t off, uint16_t val)
+{
+    uint32_t addr = (uint32_t)(base - cpu->mem) + off;
+    if (off == 0xFFFF) {
+        base[0xFFFF] = (uint8_t)val;
+        base[0] = (uint8_t)(val >> 8);
+        vga_mark_byte(cpu, addr);
+        vga_mark_byte(cpu, (uint32_t)(base - cpu->mem));
+        return;
+    }
+    store_le16(base + off, val);
+    vga_mark_byte(cpu, addr);
+    vga_mark_byte(cpu, addr + 1);
+}
+
+/* By segment value */
 static inline uint8_t mem_read8(CPU *cpu, uint16_t seg, uint16_t off)
 {
     return cpu->mem[seg_off(seg, off)];
@@ -90,53 +269,117 @@ static inline uint8_t mem_read8(CPU *cpu, uint16_t seg, uint16_t off)
 
 static inline uint16_t mem_read16(CPU *cpu, uint16_t seg, uint16_t off)
 {
-    uint32_t addr = seg_off(seg, off);
-    return (uint16_t)cpu->mem[addr] | ((uint16_t)cpu->mem[addr + 1] << 8);
+    return base_read16(cpu->mem + ((uint32_t)seg << 4), off);
 }
 
 static inline void mem_write8(CPU *cpu, uint16_t seg, uint16_t off, uint8_t val)
 {
-    cpu->mem[seg_off(seg, off)] = val;
+    uint32_t addr = seg_off(seg, off);
+    cpu->mem[addr] = val;
+    vga_mark_byte(cpu, addr);
 }
 
 static inline void mem_write16(CPU *cpu, uint16_t seg, uint16_t off, uint16_t val)
 {
-    uint32_t addr = seg_off(seg, off);
-    cpu->mem[addr] = (uint8_t)(val & 0xFF);
-    cpu->mem[addr + 1] = (uint8_t)(val >> 8);
+    base_write16(cpu, cpu->mem + ((uint32_t)seg << 4), off, val);
+}
+
+/* Through a segment register (SREG_*), using its cached base. Lifted
+ * code uses these for every memory operand. */
+static inline uint8_t sreg_read8(CPU *cpu, int sreg, uint16_t off)
+{
+    return cpu->seg_base[sreg][off];
+}
+
+static inline uint16_t sreg_read16(CPU *cpu, int sreg, uint16_t off)
+{
+    return base_read16(cpu->seg_base[sreg], off);
+}
+
+static inline void sreg_write8(CPU *cpu, int sreg, uint16_t off, uint8_t val)
+{
+    uint8_t *p = cpu->seg_base[sreg] + off;
+    *p = val;
+    vga_mark_byte(cpu, (uint32_t)(p - cpu->mem));
+}
+
+static inline void sreg_write16(CPU *cpu, int sreg, uint16_t off, uint16_t val)
+{
+    base_write16(cpu, cpu->seg_base[sreg], off, val);
 }
 
 /* Data segment shortcuts (most common) */
 static inline uint8_t ds_read8(CPU *cpu, uint16_t off)
 {
-    return mem_read8(cpu, cpu->ds, off);
+    return sreg_read8(cpu, SREG_DS, off);
 }
 
 static inline uint16_t ds_read16(CPU *cpu, uint16_t off)
 {
-    return mem_read16(cpu, cpu->ds, off);
+    return sreg_read16(cpu, SREG_DS, off);
 }
 
 static inline void ds_write8(CPU *cpu, uint16_t off, uint8_t val)
 {
-    mem_write8(cpu, cpu->ds, off, val);
+    sreg_write8(cpu, SREG_DS, off, val);
 }
 
 static inline void ds_write16(CPU *cpu, uint16_t off, uint16_t val)
 {
-    mem_write16(cpu, cpu->ds, off, val);
+    sreg_write16(cpu, SREG_DS, off, val);
+}
+
+/* ---------- DGROUP ---------- */
+
+/* Lifted functions that provably run with DS = DGROUP (see
+ * tools/recomp/dgroup.py) fetch the DGROUP pointer once at entry and
+ * access DS-relative memory through it, so a global at a constant
+ * offset is a plain load from one pointer the compiler can keep in a
+ * register. DGROUP lies well below the VGA window, so writes skip the
+ * dirty-row marking. Built with CIV_CHECK_DGROUP, the entry compares DS
+ * against DGROUP and falls back to DS (with a warning) on a mismatch. */
+#ifdef CIV_CHECK_DGROUP
+uint8_t *dgroup_checked(CPU *cpu, const char *func);
+#define DGROUP_ENTER(cpu) dgroup_checked(cpu, __func__)
+#else
+#define DGROUP_ENTER(cpu) ((cpu)->dgroup)
+#endif
+
+static inline uint8_t dg_read8(const uint8_t *dg, uint16_t off)
+{
+    return dg[off];
+}
+
+static inline uint16_t dg_read16(const uint8_t *dg, uint16_t off)
+{
+    return base_read16(dg, off);
+}
+
+static inline void dg_write8(uint8_t *dg, uint16_t off, uint8_t val)
+{
+    dg[off] = val;
+}
+
+static inline void dg_write16(uint8_t *dg, uint16_t off, uint16_t val)
+{
+    if (off == 0xFFFF) {
+        dg[0xFFFF] = (uint8_t)val;
+        dg[0] = (uint8_t)(val >> 8);
+        return;
+    }
+    store_le16(dg + off, val);
 }
 
 /* Stack operations */
 static inline void push16(CPU *cpu, uint16_t val)
 {
     cpu->sp -= 2;
-    mem_write16(cpu, cpu->ss, cpu->sp, val);
+    sreg_write16(cpu, SREG_SS, cpu->sp, val);
 }
 
 static inline uint16_t pop16(CPU *cpu)
 {
-    uint16_t val = mem_read16(cpu, cpu->ss, cpu->sp);
+    uint16_t val = sreg_read16(cpu, SREG_SS, cpu->sp);
     cpu->sp += 2;
     return val;
 }
@@ -152,9 +395,22 @@ static inline int parity8(uint8_t v)
     return (~v) & 1;
 }
 
+/* Lazy flag op kinds (CPU.lf_op) */
+enum {
+    LF_NONE = 0,
+    LF_ADD,         /* add/adc:          lf_res = a + b (+ CF)  */
+    LF_SUB,         /* sub/sbb/cmp/neg:  lf_res = a - b (- CF)  */
+    LF_LOGIC,       /* and/or/xor/test:  CF = OF = AF = 0       */
+    LF_INC,         /* inc: like LF_ADD, CF taken from lf_cf    */
+    LF_DEC          /* dec: like LF_SUB, CF taken from lf_cf    */
+};
+
+#define FLAGS_ARITH (FLAG_CF | FLAG_OF | FLAG_AF | FLAG_SF | FLAG_ZF | FLAG_PF)
+
 /* Set SF, ZF, PF based on result (8-bit) */
 static inline void set_szp8(CPU *cpu, uint8_t result)
 {
+    cpu->lf_op = LF_NONE;   /* eager helpers leave 'flags' authoritative */
     cpu->flags &= ~(FLAG_SF | FLAG_ZF | FLAG_PF);
     if (result == 0)           cpu->flags |= FLAG_ZF;
     if (result & 0x80)         cpu->flags |= FLAG_SF;
@@ -164,6 +420,7 @@ static inline void set_szp8(CPU *cpu, uint8_t result)
 /* Set SF, ZF, PF based on result (16-bit) */
 static inline void set_szp16(CPU *cpu, uint16_t result)
 {
+    cpu->lf_op = LF_NONE;
     cpu->flags &= ~(FLAG_SF | FLAG_ZF | FLAG_PF);
     if (result == 0)             cpu->flags |= FLAG_ZF;
     if (result & 0x8000)         cpu->flags |= FLAG_SF;
@@ -260,15 +517,193 @@ static inline void flags_shift16(CPU *cpu, uint16_t result)
     set_szp16(cpu, result);
 }
 
+/* ---------- Lazy flags ----------
+ * The eager helpers above compute all six arithmetic flags after every
+ * ALU op, although nearly every result is overwritten by the next op
+ * before anything reads it. The lazy_* helpers below only record the op
+ * kind, operands and unmasked result; individual flags are derived when
+ * a cc_*() test asks for them, and flags_sync() materializes them into
+ * cpu->flags before code that touches cpu->flags directly (pushf, lahf,
+ * clc/stc, shifts, calls into hand-written code and DOS/BIOS handlers).
+ */
+
+static inline uint32_t lf_record(CPU *cpu, uint8_t op, uint16_t sign,
+                                 uint32_t a, uint32_t b, uint32_t res)
+{
+    cpu->lf_op = op;
+    cpu->lf_sign = sign;
+    cpu->lf_a = a;
+    cpu->lf_b = b;
+    cpu->lf_res = res;
+    return res;
+}
+
+static inline int lazy_cf(const CPU *cpu)
+{
+    switch (cpu->lf_op) {
+    case LF_ADD:
+    case LF_SUB:   return (cpu->lf_res & ((uint32_t)cpu->lf_sign << 1)) != 0;
+    case LF_INC:
+    case LF_DEC:   return cpu->lf_cf;
+    default:       return 0;
+    }
+}
+
+static inline int lazy_of(const CPU *cpu)
+{
+    uint32_t a = cpu->lf_a, b = cpu->lf_b, r = cpu->lf_res;
+    switch (cpu->lf_op) {
+    case LF_ADD:
+    case LF_INC:   return ((~(a ^ b) & (a ^ r)) & cpu->lf_sign) != 0;
+    case LF_SUB:
+    case LF_DEC:   return (((a ^ b) & (a ^ r)) & cpu->lf_sign) != 0;
+    default:       return 0;
+    }
+}
+
+static inline int lazy_af(const CPU *cpu)
+{
+    if (cpu->lf_op == LF_LOGIC) return 0;
+    return ((cpu->lf_a ^ cpu->lf_b ^ cpu->lf_res) & 0x10) != 0;
+}
+
+static inline int lazy_zf(const CPU *cpu)
+{
+    return (cpu->lf_res & (((uint32_t)cpu->lf_sign << 1) - 1)) == 0;
+}
+
+static inline int lazy_sf(const CPU *cpu)
+{
+    return (cpu->lf_res & cpu->lf_sign) != 0;
+}
+
+static inline int lazy_pf(const CPU *cpu)
+{
+    return parity8((uint8_t)cpu->lf_res);
+}
+
+/* Materialize pending lazy flags into cpu->flags */
+static inline void flags_sync(CPU *cpu)
+{
+    uint16_t f;
+    if (cpu->lf_op == LF_NONE) return;
+    f = cpu->flags & ~FLAGS_ARITH;
+    if (lazy_cf(cpu)) f |= FLAG_CF;
+    if (lazy_pf(cpu)) f |= FLAG_PF;
+    if (lazy_af(cpu)) f |= FLAG_AF;
+    if (lazy_zf(cpu)) f |= FLAG_ZF;
+    if (lazy_sf(cpu)) f |= FLAG_SF;
+    if (lazy_of(cpu)) f |= FLAG_OF;
+    cpu->flags = f;
+    cpu->lf_op = LF_NONE;
+}
+
+/* Full FLAGS word (pushf, lahf) */
+static inline uint16_t flags_get(CPU *cpu)
+{
+    flags_sync(cpu);
+    return cpu->flags;
+}
+
+/* Record forms of the ALU ops (return the masked result) */
+static inline uint8_t lazy_add8(CPU *cpu, uint8_t a, uint8_t b)
+{
+    return (uint8_t)lf_record(cpu, LF_ADD, 0x80, a, b, (uint32_t)a + b);
+}
+
+static inline uint16_t lazy_add16(CPU *cpu, uint16_t a, uint16_t b)
+{
+    return (uint16_t)lf_record(cpu, LF_ADD, 0x8000, a, b, (uint32_t)a + b);
+}
+
+static inline uint8_t lazy_sub8(CPU *cpu, uint8_t a, uint8_t b)
+{
+    return (uint8_t)lf_record(cpu, LF_SUB, 0x80, a, b, (uint32_t)a - b);
+}
+
+static inline uint16_t lazy_sub16(CPU *cpu, uint16_t a, uint16_t b)
+{
+    return (uint16_t)lf_record(cpu, LF_SUB, 0x8000, a, b, (uint32_t)a - b);
+}
+
+static inline void lazy_cmp8(CPU *cpu, uint8_t a, uint8_t b)
+{
+    lf_record(cpu, LF_SUB, 0x80, a, b, (uint32_t)a - b);
+}
+
+static inline void lazy_cmp16(CPU *cpu, uint16_t a, uint16_t b)
+{
+    lf_record(cpu, LF_SUB, 0x8000, a, b, (uint32_t)a - b);
+}
+
+static inline void lazy_logic8(CPU *cpu, uint8_t result)
+{
+    lf_record(cpu, LF_LOGIC, 0x80, 0, 0, result);
+}
+
+static inline void lazy_logic16(CPU *cpu, uint16_t result)
+{
+    lf_record(cpu, LF_LOGIC, 0x8000, 0, 0, result);
+}
+
 /* ---------- Flag test helpers ---------- */
-static inline int cf(CPU *cpu) { return (cpu->flags & FLAG_CF) != 0; }
-static inline int zf(CPU *cpu) { return (cpu->flags & FLAG_ZF) != 0; }
-static inline int sf(CPU *cpu) { return (cpu->flags & FLAG_SF) != 0; }
-static inline int of(CPU *cpu) { return (cpu->flags & FLAG_OF) != 0; }
-static inline int pf(CPU *cpu) { return (cpu->flags & FLAG_PF) != 0; }
-static inline int af(CPU *cpu) { return (cpu->flags & FLAG_AF) != 0; }
+static inline int cf(CPU *cpu) { return cpu->lf_op ? lazy_cf(cpu) : (cpu->flags & FLAG_CF) != 0; }
+static inline int zf(CPU *cpu) { return cpu->lf_op ? lazy_zf(cpu) : (cpu->flags & FLAG_ZF) != 0; }
+static inline int sf(CPU *cpu) { return cpu->lf_op ? lazy_sf(cpu) : (cpu->flags & FLAG_SF) != 0; }
+static inline int of(CPU *cpu) { return cpu->lf_op ? lazy_of(cpu) : (cpu->flags & FLAG_OF) != 0; }
+static inline int pf(CPU *cpu) { return cpu->lf_op ? lazy_pf(cpu) : (cpu->flags & FLAG_PF) != 0; }
+static inline int af(CPU *cpu) { return cpu->lf_op ? lazy_af(cpu) : (cpu->flags & FLAG_AF) != 0; }
 static inline int df(CPU *cpu) { return (cpu->flags & FLAG_DF) != 0; }
 
+/* Carry-in and CF-preserving record forms (need cf() above) */
+static inline uint8_t lazy_adc8(CPU *cpu, uint8_t a, uint8_t b)
+{
+    uint32_t c = (uint32_t)cf(cpu);
+    return (uint8_t)lf_record(cpu, LF_ADD, 0x80, a, b, (uint32_t)a + b + c);
+}
+
+static inline uint16_t lazy_adc16(CPU *cpu, uint16_t a, uint16_t b)
+{
+    uint32_t c = (uint32_t)cf(cpu);
+    return (uint16_t)lf_record(cpu, LF_ADD, 0x8000, a, b, (uint32_t)a + b + c);
+}
+
+static inline uint8_t lazy_sbb8(CPU *cpu, uint8_t a, uint8_t b)
+{
+    uint32_t c = (uint32_t)cf(cpu);
+    return (uint8_t)lf_record(cpu, LF_SUB, 0x80, a, b, (uint32_t)a - b - c);
+}
+
+static inline uint16_t lazy_sbb16(CPU *cpu, uint16_t a, uint16_t b)
+{
+    uint32_t c = (uint32_t)cf(cpu);
+    return (uint16_t)lf_record(cpu, LF_SUB, 0x8000, a, b, (uint32_t)a - b - c);
+}
+
+static inline uint8_t lazy_inc8(CPU *cpu, uint8_t a)
+{
+    cpu->lf_cf = (uint8_t)cf(cpu);
+    return (uint8_t)lf_record(cpu, LF_INC, 0x80, a, 1, (uint32_t)a + 1);
+}
+
+static inline uint16_t lazy_inc16(CPU *cpu, uint16_t a)
+{
+    cpu->lf_cf = (uint8_t)cf(cpu);
+    return (uint16_t)lf_record(cpu, LF_INC, 0x8000, a, 1, (uint32_t)a + 1);
+}
+
+static inline uint8_t lazy_dec8(CPU *cpu, uint8_t a)
+{
+    cpu->lf_cf = (uint8_t)cf(cpu);
+    return (uint8_t)lf_record(cpu, LF_DEC, 0x80, a, 1, (uint32_t)a - 1);
+}
+
+static inline uint16_t lazy_dec16(CPU *cpu, uint16_t a)
+{
+    cpu->lf_cf = (uint8_t)cf(cpu);
+    return (uint16_t)lf_record(cpu, LF_DEC, 0x8000, a, 1, (uint32_t)a - 1);
+}
+
 /* Condition code tests (matching x86 Jcc encodings) */
 static inline int cc_o(CPU *cpu)  { return of(cpu); }
 static inline int cc_no(CPU *cpu) { return !of(cpu); }
@@ -294,7 +729,8 @@ static inline void cpu_init(CPU *cpu)
 {
     memset(cpu, 0, sizeof(*cpu));
     cpu->mem = NULL;
-    cpu->flags = 0x0002; /* bit 1 always set on 8086 */
+    cpu->flags = 0x0002 | FLAG_IF; /* bit 1 always set; DOS starts programs with IF on */
+    cpu->safe_countdown = SAFE_POINT_INTERVAL;
 }
 
 /* Allocate flat memory */
@@ -0,0 +1,71 @@
+/*
+ * dispatch.h - seg:off -> recompiled function lookup
+ *
+ * Far function pointers the game keeps in memory (menu handlers, AI
+ * strategy tables, the PIC decoder refill callback) can only be resolved
+ * at runtime. recomp.py emits a table of every function it knows the
+ * address of into RecompiledFuncs/civ_dispatch.c, keyed by the linear
+ * address seg*16 + off, and builds a two-level perfect hash over it:
+ *
+ *   bucket = dispatch_hash(addr, 0)            & bucket_mask
+ *   slot   = dispatch_hash(addr, disp[bucket]) & slot_mask
+ *
+ * slots[slot] is an index into the address-sorted entries array, so a
+ * lookup is two hashes and one compare. tools/recomp/dispatch.py holds
+ * the Python side of the hash and must stay in sync with this file.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_DISPATCH_H
+#define CIV_RECOMP_DISPATCH_H
+
+#include "recomp/cpu.h"
+
+typedef void (*RecompFunc)(CPU *cpu);
+
+#define DISPATCH_EMPTY 0xFFFF   /* Unused slot in DispatchTable.slots */
+
+typedef struct {
+    uint32_t    addr;           /* Linear address seg*16 + off */
+    RecompFunc  fn;
+    const char *name;
+} DispatchEntry;
+
+typedef struct {
+    const DispatchEntry *entries;   /* Sorted by addr */
+    uint32_t             count;
+    const uint16_t      *disp;      /* Per-bucket hash seed */
+    uint32_t             bucket_mask;
+    const uint16_t      *slots;     /* Index into entries, or DISPATCH_EMPTY */
+    uint32_t             slot_mask;
+    uint16_t             load_seg;  /* Also tried when seg was relocated */
+} DispatchTable;
+
+static inline uint32_t dispatch_hash(uint32_t key, uint32_t seed)
+{
+    key ^= seed;
+    key *= 0x9E3779B1u;
+    key ^= key >> 15;
+    key *= 0x85EBCA77u;
+    key ^= key >> 13;
+    return key;
+}
+
+/* Install the generated table (civ_dispatch_table from civ_recomp.h) */
+void recomp_dispatch_init(const DispatchTable *table);
+
+/* Function at seg:off, or NULL if none is known */
+RecompFunc recomp_lookup(uint16_t seg, uint16_t off);
+
+/* Name of the function at seg:off (for logging), or NULL */
+const char *recomp_lookup_name(uint16_t seg, uint16_t off);
+
+/*
+ * Call the function at seg:off. The caller has already pushed the far
+ * return frame, exactly as for a direct far call. Returns 0 and unwinds
+ * that frame if the target is unknown.
+ */
+int recomp_dispatch(CPU *cpu, uint16_t seg, uint16_t off);
+
+#endif /* CIV_RECOMP_DISPATCH_H */
@@ -16,44 +16,171 @@
 #include "hal/video.h"
 #include "hal/input.h"
 #include "hal/timer.h"
+#include "hal/audio.h"
 
-/* Maximum open file handles */
-#define DOS_MAX_HANDLES 32
+/* Handles 0-4 are the standard devices; the table starts with room for
+ * DOS_INITIAL_HANDLES and doubles whenever it fills up */
+#define DOS_INITIAL_HANDLES 32
+#define DOS_FIRST_FILE      5
+
+/* How an open handle is backed */
+enum {
+    DOS_FILE_FREE = 0,
+    DOS_FILE_DEVICE,            /* stdin/stdout/stderr */
+    DOS_FILE_MAPPED,            /* Read-only game data, mapped whole */
+    DOS_FILE_STREAM,            /* Host FILE* */
+    DOS_FILE_BUFFERED           /* Whole file in memory, written back on close */
+};
+
+typedef struct {
+    uint8_t  kind;
+    uint8_t  access;            /* 0 read, 1 write, 2 read/write (INT 21h/3Dh AL) */
+    uint8_t  dirty;             /* BUFFERED: changed since loaded */
+    FILE    *fp;                /* DEVICE, STREAM */
+    uint8_t *data;              /* MAPPED: the mapping; BUFFERED: heap copy */
+    uint32_t size;
+    uint32_t cap;               /* BUFFERED: bytes allocated */
+    uint32_t pos;               /* MAPPED, BUFFERED */
+    char     path[512];         /* Host path the handle was opened with */
+} DosFile;
 
 /* DOS file handle table */
 typedef struct {
-    FILE *files[DOS_MAX_HANDLES];
-    int   next_handle;
+    DosFile *files;             /* Indexed by handle */
+    int      count;             /* Entries allocated */
+    int      last_read;         /* Handle of the most recent file read */
 } DosFileTable;
 
 /* Callback type for pumping the platform event loop.
  * Called when the game blocks waiting for input or timer events.
  * The platform layer fills the keyboard/mouse buffers via this callback. */
-typedef void (*dos_poll_fn)(void *platform_ctx, void *dos_state, const void *cpu);
+typedef void (*dos_poll_fn)(void *platform_ctx, void *dos_state, void *cpu);
+
+/* Callback type for sleeping in the platform until an input event
+ * arrives or timeout_ms passes, processing whatever arrived. */
+typedef void (*dos_wait_fn)(void *platform_ctx, void *dos_state, void *cpu, uint32_t timeout_ms);
 
-/* Global DOS state */
+#define DOS_WAIT_FOREVER 0xFFFFFFFFu
+
+/* Non-blocking checks (kbhit, delay loops) never sleep by themselves.
+ * After DOS_IDLE_POLLS empty ones in a row, each less than DOS_IDLE_CALLS
+ * lifted calls after the last, the game is spinning and the next ones
+ * wait up to DOS_IDLE_WAIT_MS in dos_wait_input. */
+#define DOS_IDLE_POLLS   16
+#define DOS_IDLE_CALLS   4096
+#define DOS_IDLE_WAIT_MS 1
+
+/* Cached listing of one host directory (dos_file_attributes) */
 typedef struct {
+    char    name[256];
+    uint8_t attr;               /* DOS attributes: 10h directory, 20h archive */
+} DosDirEntry;
+
+typedef struct {
+    char         path[512];     /* Host directory, as it appears in paths */
+    DosDirEntry *entries;
+    int          count;
+    uint8_t      valid;
+} DosDirCache;
+
+#define DOS_DIR_CACHE 8
+
+/* DOS state of one game instance, reachable from its CPU (cpu->dos) */
+typedef struct DosState {
     DosFileTable    file_table;
     VideoState      video;
     KeyboardState   keyboard;
     MouseState      mouse;
     TimerState      timer;
+    AudioState      audio;
     char            game_dir[260];  /* Path to game data files */
 
+    /* Directory listings, replaced round-robin */
+    DosDirCache     dirs[DOS_DIR_CACHE];
+    int             dir_next;
+
     /* DOS memory manager (simplified) */
     uint16_t        mem_top;        /* Top of available memory (segment) */
 
     /* Interrupt vector table (for get/set vector) */
     uint32_t        ivt[256];       /* seg:off packed as uint32 */
 
+    /* Fake DMA word count the game's timing loop reads (port_in8) */
+    uint8_t         dma_counter;
+
     /* Platform event loop callback (set by main.c) */
     dos_poll_fn     poll_events;
+    dos_wait_fn     wait_events;    /* Optional; without it waits spin on poll_events */
     void           *platform_ctx;   /* Opaque pointer to Platform struct */
+
+    /* Empty non-blocking checks in a row, and cpu->calls at the last */
+    uint32_t        idle_polls;
+    uint64_t        idle_calls;
+
+    /* Quick save/restore asked for by a hotkey (SNAPSHOT_SAVE/RESTORE),
+     * carried out at the next input wait */
+    uint8_t         snapshot_request;
+
+    /* State the hand-written game routines keep between calls
+     * (civ_impl.c), created on first use; game_free releases it */
+    void           *game;
+    void          (*game_free)(void *game);
+
+    /* What a snapshot keeps of it: game_save writes game_save_size
+     * bytes to buf, game_load puts them back */
+    uint32_t        game_save_size;
+    void          (*game_save)(const void *game, void *buf);
+    void          (*game_load)(void *game, const void *buf);
 } DosState;
 
-/* Initialize DOS compatibility layer */
+/* Initialize DOS compatibility layer and attach it to cpu (cpu->dos) */
 void dos_init(DosState *ds, CPU *cpu, const char *game_dir);
 
+/* Close every file and free what the instance allocated (handle table,
+ * directory listings, game state); ds can be dos_init'ed again */
+void dos_shutdown(DosState *ds);
+
+/* Block until a key is buffered or timeout_ms (DOS_WAIT_FOREVER = no
+ * limit) passes, sleeping in the platform rather than spinning. Wakes at
+ * every timer tick to keep the tick count current. Returns 1 if a key is
+ * available. */
+int dos_wait_input(CPU *cpu, uint32_t timeout_ms);
+
+/* kbhit: pump platform events and return 1 if a key is buffered. An
+ * empty check counts towards dos_idle_poll. */
+int dos_poll_input(CPU *cpu);
+
+/* A non-blocking check found nothing to do. Once the game has spun on
+ * such checks for a while, waits briefly for input instead (windowed
+ * runs only: not in turbo, and not without a wait_events callback). */
+void dos_idle_poll(CPU *cpu);
+
+/* File access by DOS handle. Reads and writes return the bytes moved
+ * and seeks the new position, or -1 if the handle is not open (or the
+ * seek lands before the start). */
+long dos_file_read(DosState *ds, int handle, void *dst, uint32_t count);
+long dos_file_write(DosState *ds, int handle, const void *src, uint32_t count);
+long dos_file_seek(DosState *ds, int handle, long offset, int whence);
+long dos_file_tell(DosState *ds, int handle);
+
+/* Host path behind a file handle (not the devices); NULL if not open */
+const char *dos_handle_path(DosState *ds, int handle);
+
+/* DOS attributes of a host path from the directory cache, or -1 if
+ * there is no such file. The name part of path is corrected to the
+ * case it has on disk. */
+int dos_file_attributes(DosState *ds, char *path, size_t size);
+
+/* Open path as the given handle (closing what it was) at position pos,
+ * for restoring a snapshot. Returns 0, or -1 if it cannot be reopened. */
+int dos_file_reopen(DosState *ds, int handle, const char *path, int access, long pos);
+
+/* Write out buffered saves and host streams, keeping them open */
+void dos_flush_files(DosState *ds);
+
+/* Close every file handle, writing back buffered saves (program exit) */
+void dos_close_all(DosState *ds);
+
 /* Interrupt handlers */
 void dos_int21(CPU *cpu);       /* DOS API */
 void bios_int10(CPU *cpu);      /* Video BIOS */
@@ -65,7 +192,7 @@ void int_handler(CPU *cpu, uint8_t num);  /* Generic interrupt */
 void port_out8(CPU *cpu, uint16_t port, uint8_t value);
 uint8_t port_in8(CPU *cpu, uint16_t port);
 
-/* Get global DOS state (stored in CPU context) */
+/* DOS state of the instance cpu belongs to (cpu->dos) */
 DosState *get_dos_state(CPU *cpu);
 
 #endif /* CIV_DOS_COMPAT_H */
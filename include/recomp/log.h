@@ -0,0 +1,118 @@
+/*
+ * log.h - Channelled, compile-time gated logging
+ *
+ * Runtime diagnostics from the DOS layer and the hand-written function
+ * implementations go through LOG_* instead of fprintf(stderr, ...).
+ * Messages are formatted into a fixed-size slot of a lock-free ring
+ * buffer and written to stderr by a background thread, so a hot path
+ * never blocks on console I/O. If the ring is full the message is
+ * dropped and counted; the drain thread reports how many were lost.
+ *
+ * Two gates decide whether a call does anything:
+ *
+ *   CIV_LOG_LEVEL      compile-time ceiling. Calls above it are dead
+ *                      code and vanish entirely. Defaults to debug, or
+ *                      off (no logging at all) when NDEBUG is defined.
+ *   log_levels[chan]   runtime level per channel, info by default, set
+ *                      with log_configure("FILE=debug,GFX=off").
+ *
+ * Messages keep their own "[TAG] " prefix; the channel only filters.
+ *
+ *   LOG_INFO(LOG_FILE, "[FILE] Open '%s' -> handle %d\n", path, h);
+ *   LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_GFX, 5, 500, "[FILL] #%llu\n", log_hit);
+ *
+ * LOG_SAMPLED logs the first `first` hits of a call site and then every
+ * `every`th (never, if 0); the hit count is available to the arguments
+ * as log_hit. A site that writes several lines keeps its own count and
+ * tests it with log_sample():
+ *
+ *   static volatile uint64_t hits;
+ *   if (LOG_ENABLED(LOG_LEVEL_INFO, LOG_DIAG) && log_sample(&hits, 1, 0)) { ... }
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_LOG_H
+#define CIV_RECOMP_LOG_H
+
+#include <stdint.h>
+
+/* Levels */
+#define LOG_LEVEL_OFF     0
+#define LOG_LEVEL_WARN    1
+#define LOG_LEVEL_INFO    2
+#define LOG_LEVEL_DEBUG   3
+
+#ifndef CIV_LOG_LEVEL
+#ifdef NDEBUG
+#define CIV_LOG_LEVEL LOG_LEVEL_OFF
+#else
+#define CIV_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+/* Channels */
+typedef enum {
+    LOG_FILE,       /* File I/O (INT 21h handles, access checks) */
+    LOG_GFX,        /* Video mode, fills, blits, frames */
+    LOG_INT,        /* Interrupt dispatch, timer and delay services */
+    LOG_KEY,        /* Keyboard reads and blocking waits */
+    LOG_DOS,        /* Memory allocation, heap, C runtime */
+    LOG_DIAG,       /* Bypasses, traces, one-off state dumps */
+    LOG_CHANNEL_COUNT
+} LogChannel;
+
+extern uint8_t log_levels[LOG_CHANNEL_COUNT];
+
+#define LOG_ENABLED(level, chan) \
+    ((level) <= CIV_LOG_LEVEL && (level) <= log_levels[chan])
+
+#define LOG_AT(level, chan, ...) do { \
+    if (LOG_ENABLED(level, chan)) log_write(chan, __VA_ARGS__); \
+} while (0)
+
+#define LOG_WARN(chan, ...)  LOG_AT(LOG_LEVEL_WARN, chan, __VA_ARGS__)
+#define LOG_INFO(chan, ...)  LOG_AT(LOG_LEVEL_INFO, chan, __VA_ARGS__)
+#define LOG_DEBUG(chan, ...) LOG_AT(LOG_LEVEL_DEBUG, chan, __VA_ARGS__)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define log_count(p) ((uint64_t)_InterlockedIncrement64((volatile long long *)(p)))
+#else
+#define log_count(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#endif
+
+/* Count a hit; returns its number if it is one to log, else 0. Atomic,
+ * since --instances runs the same call sites on several threads. */
+static inline uint64_t log_sample(volatile uint64_t *hits, uint64_t first, uint64_t every)
+{
+    uint64_t n = log_count(hits);
+    return (n <= first || (every && n % every == 0)) ? n : 0;
+}
+
+#define LOG_SAMPLED(level, chan, first, every, ...) do { \
+    static volatile uint64_t log_site; \
+    uint64_t log_hit; \
+    if (LOG_ENABLED(level, chan) && \
+        (log_hit = log_sample(&log_site, (first), (every))) != 0) \
+        log_write(chan, __VA_ARGS__); \
+} while (0)
+
+/* Start the drain thread; flushes and stops it at exit. Until this is
+ * called, messages are written to stderr synchronously. */
+void log_init(void);
+
+/* Set runtime levels: comma-separated CHAN=level pairs, where CHAN is a
+ * channel name or ALL and level is off/warn/info/debug or 0..3.
+ * Returns 0, or -1 if the spec has an unknown name. */
+int log_configure(const char *spec);
+
+/* Write out everything queued so far (also called at exit) */
+void log_flush(void);
+
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+void log_write(LogChannel chan, const char *fmt, ...);
+
+#endif /* CIV_RECOMP_LOG_H */
@@ -0,0 +1,78 @@
+/*
+ * override.h - Registry of hand-written overrides of lifted functions
+ *
+ * A hand-written function in civ_impl.c replaces the lifted function of
+ * the same name at link time. The ones that claim to behave exactly like
+ * the original are listed in the [overrides] section of civ.syms.toml;
+ * for those recomp.py keeps the lifted code as NAME_lifted and writes an
+ * Override record for the pair into RecompiledFuncs/civ_overrides.c.
+ * Lifted call sites reach them through OVERRIDE_CALL.
+ *
+ * With --verify-overrides every such call runs the override, then the
+ * lifted original from the same CPU state and memory, and compares the
+ * two results: registers outside the entry's clobber mask, flags
+ * (CF PF AF ZF SF OF DF) and all of emulated memory except the
+ * OVERRIDE_STACK_SLACK bytes below the final SP, where the lifted code
+ * kept its frames. The lifted result is the one the game continues
+ * with, so a wrong override can't derail a verification run. Calls
+ * made while a check is running go straight to the override.
+ *
+ * Only routines whose effects are confined to CPU and memory belong in
+ * the registry: file I/O, timers or input would happen twice.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_OVERRIDE_H
+#define CIV_RECOMP_OVERRIDE_H
+
+#include "recomp/cpu.h"
+
+/* Override.clobbers: registers the override may leave different */
+#define OVR_AX      0x0001
+#define OVR_BX      0x0002
+#define OVR_CX      0x0004
+#define OVR_DX      0x0008
+#define OVR_SI      0x0010
+#define OVR_DI      0x0020
+#define OVR_BP      0x0040
+#define OVR_SP      0x0080
+#define OVR_CS      0x0100
+#define OVR_DS      0x0200
+#define OVR_ES      0x0400
+#define OVR_SS      0x0800
+#define OVR_FLAGS   0x1000
+
+/* Stack bytes below the final SP left out of the memory comparison */
+#define OVERRIDE_STACK_SLACK  0x1000
+
+typedef struct {
+    const char *name;
+    void      (*native)(CPU *cpu);      /* Hand-written replacement */
+    void      (*lifted)(CPU *cpu);      /* Lifted original (NAME_lifted), or NULL */
+    uint16_t    clobbers;               /* OVR_* */
+
+    /* --verify-overrides statistics */
+    uint64_t    checked;
+    uint64_t    mismatches;
+} Override;
+
+/* Set by --verify-overrides */
+extern int override_verify;
+
+#define OVERRIDE_CALL(cpu, name) \
+    (override_verify ? override_verify_call((cpu), &override_##name) : name(cpu))
+
+/* Run both versions of ov on cpu and report any difference */
+void override_verify_call(CPU *cpu, Override *ov);
+
+/* Install the generated registry (civ_overrides from civ_recomp.h) and,
+ * with verification on, allocate its memory copies and check the harness
+ * itself (an identical pair must match, a wrong one must be flagged).
+ * Returns 0, or -1 with verification turned off if either fails. */
+int override_init(Override *const *list, unsigned count);
+
+/* Per-override check and mismatch counts, after a verification run */
+void override_report(void);
+
+#endif /* CIV_RECOMP_OVERRIDE_H */
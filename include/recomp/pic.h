@@ -0,0 +1,136 @@
+/*
+ * pic.h - MicroProse .PIC image decoding
+ *
+ * A .PIC file is a run of chunks, each a 2-byte tag and a 2-byte length
+ * followed by that many bytes:
+ *
+ *   "E0"  16-colour mapping table
+ *   "M0"  palette: first index, last index, then 6-bit RGB triples
+ *   "X0"  256-colour image: width, height, then compressed data
+ *   "X1"  16-colour image, the same but two pixels per decoded byte
+ *
+ * Image data is LZW with 9- to 11-bit codes, read as 16-bit words
+ * LSB first. It starts with a word whose low byte is the maximum code
+ * width and whose high byte is the first 8 bits of code data, and again
+ * so every time the dictionary fills up. Under the LZW sits an RLE
+ * layer: "90 00" is a literal 0x90, "90 n" repeats the previous byte
+ * to make a run of n.
+ *
+ * PicDecoder is shared by the game's own PIC reader (res_0011E6 and its
+ * subroutines in civ_impl.c, fed from the guest's file buffer) and by
+ * pic_load, which decodes a file on the host for the asset cache.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_PIC_H
+#define CIV_RECOMP_PIC_H
+
+#include <stdint.h>
+
+#define PIC_DICT_SIZE   0x800   /* Codes are at most 11 bits */
+
+/* Source of compressed data, one 16-bit word per call */
+typedef uint16_t (*pic_word_fn)(void *ctx);
+
+typedef struct {
+    uint16_t parent[PIC_DICT_SIZE];     /* Prefix code, 0xFFFF = single byte */
+    uint8_t  chr[PIC_DICT_SIZE];        /* Last byte of the entry's string */
+    uint8_t  stack[PIC_DICT_SIZE + 1];  /* Expanded string, next byte on top */
+    int      depth;                     /* Bytes pending in stack */
+    uint16_t bit_buf;                   /* Last word read; top bits_avail unused */
+    uint8_t  bits_avail;
+    uint8_t  code_bits;
+    uint8_t  max_bits;
+    uint16_t max_code;
+    uint16_t next_code;
+    uint16_t prev_code;
+    uint8_t  first_char;                /* First byte of the last string */
+    uint8_t  rle_count;                 /* Repeats of rle_byte still owed */
+    uint8_t  rle_byte;
+    uint8_t  start_live;                /* No reset since pic_begin */
+    uint8_t  start_used;                /* Output so far depends on the start bytes */
+
+    pic_word_fn read_word;
+    void       *ctx;
+} PicDecoder;
+
+/* Start decoding: clears the RLE state and reads the first parameter
+ * word. prev_code is the code the first dictionary entry links to
+ * (the game leaves whatever its last decode ended with).
+ *
+ * A decode depends on what came before it through two bytes only, its
+ * "start bytes": first_char (a KwKwK first code) and chr[prev_code]
+ * (the first entry's prefix). start_used tells whether it read them. */
+void pic_begin(PicDecoder *d, pic_word_fn read_word, void *ctx, uint16_t prev_code);
+
+/* Start a new dictionary; reads the parameter word */
+void pic_reset_dict(PicDecoder *d);
+
+/* Next byte of the LZW layer */
+uint8_t pic_next_byte(PicDecoder *d);
+
+/* Decode count units of the RLE layer into out: count bytes, or in
+ * 4-bit mode 2 * count pixels, low nibble first. Returns bytes written. */
+uint32_t pic_decode_row(PicDecoder *d, uint8_t *out, uint16_t count, int is_4bit);
+
+/* Bytes the row decoder writes for a row of width pixels */
+static inline uint32_t pic_row_bytes(uint16_t width, int is_4bit)
+{
+    return is_4bit ? 2u * ((width + 1u) / 2u) : width;
+}
+
+/* Scalar decoder state, plus the dictionary byte the next decode's
+ * start bytes read (chr[prev_code]) */
+typedef struct {
+    uint16_t bit_buf;
+    uint16_t max_code;
+    uint16_t next_code;
+    uint16_t prev_code;
+    uint16_t depth;
+    uint8_t  bits_avail;
+    uint8_t  code_bits;
+    uint8_t  max_bits;
+    uint8_t  first_char;
+    uint8_t  rle_count;
+    uint8_t  rle_byte;
+    uint8_t  prev_chr;
+} PicState;
+
+void pic_save_state(const PicDecoder *d, PicState *st);
+
+/* Put d where a decode that ended in st would have left it, as far as
+ * the next pic_begin can tell (pending stack bytes are not kept) */
+void pic_load_state(PicDecoder *d, const PicState *st);
+
+/* ─── Whole files ─── */
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t  is_4bit;           /* Image came from an X1 chunk */
+    uint8_t  has_palette;       /* An M0 chunk was present */
+    uint8_t  palette[768];      /* 6-bit DAC values, entries M0 left out are 0 */
+    uint8_t *pixels;            /* height rows of pic_row_bytes(width) */
+    uint32_t size;
+    long     data_end;          /* File offset just past the words the LZW read */
+    uint8_t  start_used;        /* The pixels depend on these start bytes: */
+    uint8_t  start_first;       /*   first_char and chr[prev_code] at pic_begin */
+    uint8_t  start_chr;
+    PicState end;               /* Decoder state after the last row */
+} PicImage;
+
+/* Whether a decode starting from d (just after pic_begin) produces img */
+static inline int pic_image_fits(const PicImage *img, const PicDecoder *d)
+{
+    return !img->start_used ||
+           (img->start_first == d->first_char && img->start_chr == d->chr[d->prev_code]);
+}
+
+/* Read a .PIC file: palette, dimensions and, if decode is set, the
+ * pixels of its first image chunk. Returns 0, or -1 if the file cannot
+ * be read or has no image. */
+int pic_load(const char *path, PicImage *img, int decode);
+void pic_free(PicImage *img);
+
+#endif /* CIV_RECOMP_PIC_H */
@@ -0,0 +1,45 @@
+/*
+ * profile.h - Per-function profiler for recompiled code
+ *
+ * `recomp.py --profile` wraps every lifted function in a prof_enter /
+ * prof_exit pair around a static ProfSite naming it. The runtime keeps a
+ * shadow call stack and charges elapsed TSC ticks to the function on top,
+ * both per function and per call path. On exit it writes:
+ *
+ *   civ_profile.folded   collapsed stacks ("a;b;c ticks"), the input
+ *                        format of flamegraph.pl
+ *   civ_profile.txt      functions sorted by self time, with calls,
+ *                        self/inclusive ms and overlay number
+ *
+ * and prints the top of the table to stderr. Builds lifted without
+ * --profile never call into this file.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_PROFILE_H
+#define CIV_RECOMP_PROFILE_H
+
+#include <stdint.h>
+
+#define PROF_MAX_DEPTH  4096    /* Deeper frames are folded into their parent */
+
+typedef struct {
+    const char *name;
+    int         overlay;        /* Overlay number, -1 = resident */
+    uint32_t    id;             /* 0 until first entry */
+    uint32_t    active;         /* Frames of this function on the stack */
+    uint64_t    calls;
+    uint64_t    self;           /* Ticks with this function on top */
+    uint64_t    total;          /* Ticks inside the outermost activation */
+} ProfSite;
+
+/* Function entry/exit, emitted by the lifter around each function body */
+void prof_enter(ProfSite *site);
+void prof_exit(ProfSite *site);
+
+/* Write civ_profile.folded / civ_profile.txt. Registered with atexit()
+ * on the first prof_enter, so it also runs when the game calls exit(). */
+void prof_dump(void);
+
+#endif /* CIV_RECOMP_PROFILE_H */
@@ -0,0 +1,55 @@
+/*
+ * snapshot.h - Whole-machine quick save and restore
+ *
+ * A snapshot holds the CPU registers, all of emulated memory (which
+ * includes the VGA framebuffer and the game's back-buffer pages), the
+ * DAC palette, keyboard, mouse and timer state, the interrupt vectors,
+ * what the hand-written routines keep outside guest memory (dos->game,
+ * through game_save/game_load) and every open file by path and position. Memory is stored as the
+ * 4 KB pages that differ from the image loaded from CIV.EXE, XORed
+ * against it and run-length packed, so a snapshot of a running game is
+ * mostly the pages it has actually touched.
+ *
+ * The game's control flow lives on the host stack, so a snapshot is
+ * taken and restored only where the game waits for a key (dos_wait_input),
+ * and only restored where the guest stack has the same shape (SS, SP and
+ * the BP frame chain) as when it was taken, e.g. back on the map waiting
+ * for orders. Anywhere else the restore is refused.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_SNAPSHOT_H
+#define CIV_RECOMP_SNAPSHOT_H
+
+#include "recomp/cpu.h"
+#include "recomp/dos_compat.h"
+
+#define SNAPSHOT_PAGE_SIZE  4096
+
+/* DosState.snapshot_request, set by the platform's hotkeys */
+enum {
+    SNAPSHOT_NONE = 0,
+    SNAPSHOT_SAVE,
+    SNAPSHOT_RESTORE
+};
+
+/* Keep the freshly loaded program image as the baseline memory is
+ * compared against, and set the file the hotkeys use. Call after the
+ * EXE is loaded and before it runs. */
+void snapshot_init(const CPU *cpu, const char *path);
+
+/* Write / read a snapshot file. Return 0, or -1 with the reason logged. */
+int snapshot_save(const CPU *cpu, DosState *dos, const char *path);
+int snapshot_restore(CPU *cpu, DosState *dos, const char *path);
+
+/* Carry out a pending DosState.snapshot_request; called at safe points */
+void snapshot_service(CPU *cpu, DosState *dos);
+
+/* The page codec, also used for the pre-baked startup image: FNV-1a over
+ * n bytes, and PackBits-style unpacking of n bytes into exactly size
+ * bytes of out (0, or -1 if the data is malformed or the wrong size) */
+uint64_t snapshot_hash(const uint8_t *p, size_t n);
+int snapshot_unpack(const uint8_t *src, uint32_t n, uint8_t *out, uint32_t size);
+
+#endif /* CIV_RECOMP_SNAPSHOT_H */
@@ -0,0 +1,42 @@
+/*
+ * startup.h - Pre-baked startup image
+ *
+ * CIV.EXE's resident image is EXEPACK-compressed; the entry point
+ * replacement (res_02A310 in startup.c) has to unpack it and apply the
+ * segment relocations before anything else runs. recomp.py does the same
+ * work at build time (tools/recomp/exepack.py) and writes the result
+ * into RecompiledFuncs/civ_image.c as a StartupImage: the unpacked,
+ * relocated image from LOAD_SEG:0000, PackBits-packed like snapshot
+ * pages, with FNV-1a hashes of both the loaded image it was made from
+ * and the result.
+ *
+ * At startup the blob is used when the loaded image hashes to its
+ * source_hash, so a different CIV.EXE never gets a stale image; otherwise,
+ * and when the blob is damaged, the live decompressor runs as before.
+ * With --verify-image both run and the results are compared byte for byte.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_STARTUP_H
+#define CIV_RECOMP_STARTUP_H
+
+#include "recomp/cpu.h"
+
+typedef struct {
+    uint32_t       source_size;     /* Loaded bytes from LOAD_SEG:0000 it was made from */
+    uint64_t       source_hash;
+    uint32_t       size;            /* Unpacked bytes from LOAD_SEG:0000; 0 = no image */
+    uint64_t       hash;
+    const uint8_t *packed;
+    uint32_t       packed_size;
+} StartupImage;
+
+/* Set by --verify-image */
+extern int startup_verify_image;
+
+/* Install the generated image (civ_startup_image from civ_recomp.h).
+ * Without one, or with an empty one, startup always decompresses live. */
+void startup_set_image(const StartupImage *img);
+
+#endif /* CIV_RECOMP_STARTUP_H */
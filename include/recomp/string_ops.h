@@ -0,0 +1,39 @@
+/*
+ * string_ops.h - Bulk REP string instruction helpers
+ *
+ * Lifted `rep movs`/`rep stos`/`repz|repnz cmps`/`repz|repnz scas` call
+ * these instead of looping one element at a time through mem_read8 /
+ * mem_write8. Each helper checks DF, 16-bit offset wrap and overlapping
+ * ranges once up front, then does the bulk work with memmove / memset /
+ * memchr. Ranges that wrap a segment (or overlap in a way that memmove
+ * would not reproduce) fall back to the element-by-element loop.
+ *
+ * Register results match the real instructions: CX counts down by the
+ * number of elements processed, SI/DI advance by the same amount, and
+ * cmps/scas leave the flags of the last comparison.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef CIV_RECOMP_STRING_OPS_H
+#define CIV_RECOMP_STRING_OPS_H
+
+#include "recomp/cpu.h"
+
+/* rep movsb/movsw: copy CX elements src_seg:SI -> ES:DI */
+void rep_movsb(CPU *cpu, uint16_t src_seg);
+void rep_movsw(CPU *cpu, uint16_t src_seg);
+
+/* rep stosb/stosw: fill CX elements at ES:DI with AL/AX */
+void rep_stosb(CPU *cpu);
+void rep_stosw(CPU *cpu);
+
+/* repz (repz = 1) / repnz (repz = 0) cmpsb/cmpsw: src_seg:SI vs ES:DI */
+void rep_cmpsb(CPU *cpu, uint16_t src_seg, int repz);
+void rep_cmpsw(CPU *cpu, uint16_t src_seg, int repz);
+
+/* repz / repnz scasb/scasw: AL/AX vs ES:DI */
+void rep_scasb(CPU *cpu, int repz);
+void rep_scasw(CPU *cpu, int repz);
+
+#endif /* CIV_RECOMP_STRING_OPS_H */
@@ -0,0 +1,746 @@
+/*
+ * audio.c - AdLib OPL2 and PC speaker HAL Implementation
+ *
+ * The synthesizer works in floating point with envelopes and LFOs
+ * stepped once per AUDIO_BLOCK samples and gains ramped linearly across
+ * the block, so an operator without feedback renders as one straight
+ * SIMD loop: SSE2 on x86 and NEON on ARM, both baseline for the targets
+ * that have them, so there is nothing to select at run time. Operators
+ * with feedback, the rhythm voices and the speaker are scalar.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "hal/audio.h"
+#include "hal/timer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AU_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define AU_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define OPL_RATE        49716.0     /* Chip sample rate, 14.31818 MHz / 288 */
+#define OPL_OUT_SCALE   (4084.0f / 32768.0f)   /* Full-scale operator, of 16 bits */
+#define OPL_MOD_CYCLES  4.0f        /* Phase shift of a full-scale modulator */
+#define EG_SILENT       96.0f       /* Attenuation (dB) that is silence */
+#define SPEAKER_LEVEL   0.25f
+#define RESYNC_MS       100.0       /* Drift before playback re-anchors on the events */
+
+#define TWO_PI          6.2831853f
+
+/* ─── Atomics ─── */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static uint32_t load_acquire(volatile uint32_t *p) { return (uint32_t)_InterlockedOr((volatile long *)p, 0); }
+static void store_release(volatile uint32_t *p, uint32_t v) { _InterlockedExchange((volatile long *)p, (long)v); }
+#else
+static uint32_t load_acquire(volatile uint32_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void store_release(volatile uint32_t *p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+#endif
+
+/* ─── Game thread ─── */
+
+void audio_init(AudioState *as)
+{
+    memset(as, 0, sizeof(*as));
+    as->pit2_access = 3;
+}
+
+int audio_is_active(const AudioState *as)
+{
+    return as->active;
+}
+
+static void push(AudioState *as, uint64_t at_ms, uint8_t kind, uint8_t reg, uint16_t value)
+{
+    if (!as->active)
+        return;
+    uint32_t head = as->head;
+    if (head - load_acquire(&as->tail) >= AUDIO_RING_SIZE) {
+        as->dropped++;
+        return;
+    }
+    AudioEvent *ev = &as->ring[head & (AUDIO_RING_SIZE - 1)];
+    ev->at_ms = at_ms;
+    ev->value = value;
+    ev->kind = kind;
+    ev->reg = reg;
+    store_release(&as->head, head + 1);
+}
+
+/* OPL register 04: start/mask the timers or reset their flags. A timer
+ * that is started has expired by the time the driver looks. */
+static void opl_timer_control(AudioState *as, uint8_t value)
+{
+    if (value & 0x80) {
+        as->opl_status = 0;
+        return;
+    }
+    if ((value & 0x01) && !(value & 0x40))
+        as->opl_status |= 0xC0;
+    if ((value & 0x02) && !(value & 0x20))
+        as->opl_status |= 0xA0;
+}
+
+void audio_port_write(AudioState *as, uint16_t port, uint8_t value, uint64_t now_ms)
+{
+    switch (port) {
+    case 0x388: /* OPL address */
+        as->opl_index = value;
+        break;
+
+    case 0x389: /* OPL data */
+        if (as->opl_index == 0x04)
+            opl_timer_control(as, value);
+        push(as, now_ms, AUDIO_EV_OPL, as->opl_index, value);
+        break;
+
+    case 0x61: /* Speaker gate (bit 0) and data (bit 1) */
+        as->port61 = value;
+        push(as, now_ms, AUDIO_EV_SPEAKER, 0, value & 3);
+        break;
+
+    case 0x43: /* PIT command for channel 2; access 0 only latches */
+        if (value & 0x30) {
+            as->pit2_access = (value >> 4) & 3;
+            as->pit2_byte = 0;
+        }
+        break;
+
+    case 0x42: /* PIT channel 2 data */
+        if (as->pit2_access == 1 || (as->pit2_access == 3 && as->pit2_byte == 0)) {
+            as->pit2_reload = (uint16_t)((as->pit2_reload & 0xFF00) | value);
+            as->pit2_byte = as->pit2_access == 3;
+            if (as->pit2_access == 3)
+                break;
+        } else {
+            as->pit2_reload = (uint16_t)((as->pit2_reload & 0x00FF) | (value << 8));
+            as->pit2_byte = 0;
+        }
+        push(as, now_ms, AUDIO_EV_PIT2, 0, as->pit2_reload);
+        break;
+    }
+}
+
+uint8_t audio_port_read(AudioState *as, uint16_t port)
+{
+    switch (port) {
+    case 0x388: /* Status; bits 1-2 always read set on an OPL2 */
+        return (uint8_t)(as->opl_status | 0x06);
+    case 0x61:  /* Refresh (bit 4) and channel 2 output (bit 5) keep changing */
+        as->refresh ^= 0x30;
+        return (uint8_t)((as->port61 & 0x0F) | as->refresh);
+    default:
+        return 0xFF;
+    }
+}
+
+/* ─── OPL2 ─── */
+
+enum { EG_OFF, EG_ATTACK, EG_DECAY, EG_SUSTAIN, EG_RELEASE };
+
+#define KEY_CHANNEL 1               /* Keyed by register B0-B8 */
+#define KEY_RHYTHM  2               /* Keyed by register BD */
+
+/* Rhythm-mode operators (channel 7 and 8 slots) */
+#define OP_HH   13
+#define OP_TOM  14
+#define OP_SD   16
+#define OP_TC   17
+
+typedef struct {
+    /* Registers */
+    uint8_t am, vib, egt, ksr, mult;
+    uint8_t ksl, tl;
+    uint8_t ar, dr, sl, rr;
+    uint8_t wave;
+
+    /* Generator */
+    uint8_t key;                    /* KEY_* bits holding the note */
+    uint8_t stage;                  /* EG_* */
+    float   env;                    /* Envelope attenuation, dB */
+    float   gain;                   /* Linear gain at the end of the last block */
+    float   phase;                  /* Cycles, [0, 1) */
+    float   fb1, fb2;               /* Last two outputs, for feedback */
+} OplOp;
+
+typedef struct {
+    uint16_t fnum;
+    uint8_t  block;
+    uint8_t  fb;
+    uint8_t  cnt;                   /* 0 = FM, 1 = additive */
+} OplChan;
+
+typedef struct {
+    OplOp    op[18];
+    OplChan  ch[9];
+    uint8_t  wse;                   /* Waveform select enabled (register 01) */
+    uint8_t  nts;                   /* Note select (register 08) */
+    uint8_t  bd;                    /* LFO depths and rhythm (register BD) */
+    float    lfo_am, lfo_vib;       /* LFO phases, cycles */
+    uint32_t noise;                 /* 23-bit LFSR of the rhythm voices */
+} Opl;
+
+typedef struct {
+    uint8_t  gate;                  /* Port 0x61 bits 0-1 */
+    uint16_t reload;                /* PIT channel 2 */
+    float    phase;
+    float    x1, y1;                /* DC blocker state */
+} Speaker;
+
+typedef struct {
+    Opl      opl;
+    Speaker  spk;
+    int      rate;
+    double   ms_per_sample;
+    float    hz_scale;              /* Phase increment of F-number 1, block 0 */
+    double   now_ms;                /* Event time of the next block */
+    int      synced;
+    int      pos;                   /* Next sample of mix to hand out */
+    float    mix[AUDIO_BLOCK];
+    float    mod[AUDIO_BLOCK];
+    float    car[AUDIO_BLOCK];
+} AudioSynth;
+
+static const float mult_tab[16] = {
+    0.5f, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 12, 12, 15, 15
+};
+
+static const uint8_t ksl_rom[16] = {
+    0, 32, 40, 45, 48, 51, 53, 55, 56, 58, 59, 60, 61, 62, 63, 64
+};
+
+/* Right shift of the key scale level for KSL 0-3 (0 = off) */
+static const uint8_t ksl_shift[4] = { 0, 1, 2, 0 };
+
+/* Register offset (low 5 bits of 20-95, E0-F5) to operator; -1 = none */
+static const int8_t slot_op[0x20] = {
+     0,  1,  2,  3,  4,  5, -1, -1,  6,  7,  8,  9, 10, 11, -1, -1,
+    12, 13, 14, 15, 16, 17, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static int chan_op(int c)
+{
+    return (c / 3) * 6 + c % 3;     /* Modulator; the carrier is 3 later */
+}
+
+static void op_key(OplOp *op, int on, uint8_t src)
+{
+    uint8_t was = op->key;
+    op->key = on ? (uint8_t)(op->key | src) : (uint8_t)(op->key & ~src);
+    if (!was && op->key) {
+        op->stage = EG_ATTACK;
+        op->phase = 0;
+    } else if (was && !op->key && op->stage != EG_OFF) {
+        op->stage = EG_RELEASE;
+    }
+}
+
+static void opl_write(Opl *o, uint8_t reg, uint8_t v)
+{
+    if ((reg >= 0x20 && reg < 0xA0) || reg >= 0xE0) {
+        int n = slot_op[reg & 0x1F];
+        if (n < 0)
+            return;
+        OplOp *op = &o->op[n];
+        switch (reg & 0xE0) {
+        case 0x20:
+            op->am = v >> 7;
+            op->vib = (v >> 6) & 1;
+            op->egt = (v >> 5) & 1;
+            op->ksr = (v >> 4) & 1;
+            op->mult = v & 0x0F;
+            break;
+        case 0x40:
+            op->ksl = v >> 6;
+            op->tl = v & 0x3F;
+            break;
+        case 0x60:
+            op->ar = v >> 4;
+            op->dr = v & 0x0F;
+            break;
+        case 0x80:
+            op->sl = v >> 4;
+            op->rr = v & 0x0F;
+            break;
+        case 0xE0:
+            op->wave = v & 3;
+            break;
+        }
+        return;
+    }
+
+    int c = reg & 0x0F;
+    switch (reg & 0xF0) {
+    case 0xA0:
+        if (c < 9)
+            o->ch[c].fnum = (uint16_t)((o->ch[c].fnum & 0x300) | v);
+        return;
+    case 0xB0:
+        if (c < 9) {
+            OplChan *ch = &o->ch[c];
+            ch->fnum = (uint16_t)((ch->fnum & 0xFF) | ((v & 3) << 8));
+            ch->block = (v >> 2) & 7;
+            op_key(&o->op[chan_op(c)], v & 0x20, KEY_CHANNEL);
+            op_key(&o->op[chan_op(c) + 3], v & 0x20, KEY_CHANNEL);
+        } else if (reg == 0xBD) {
+            int rhythm = v & 0x20;
+            o->bd = v;
+            op_key(&o->op[12], rhythm && (v & 0x10), KEY_RHYTHM);
+            op_key(&o->op[15], rhythm && (v & 0x10), KEY_RHYTHM);
+            op_key(&o->op[OP_SD], rhythm && (v & 0x08), KEY_RHYTHM);
+            op_key(&o->op[OP_TOM], rhythm && (v & 0x04), KEY_RHYTHM);
+            op_key(&o->op[OP_TC], rhythm && (v & 0x02), KEY_RHYTHM);
+            op_key(&o->op[OP_HH], rhythm && (v & 0x01), KEY_RHYTHM);
+        }
+        return;
+    case 0xC0:
+        if (c < 9) {
+            o->ch[c].fb = (v >> 1) & 7;
+            o->ch[c].cnt = v & 1;
+        }
+        return;
+    }
+
+    if (reg == 0x01)
+        o->wse = (v >> 5) & 1;
+    else if (reg == 0x08)
+        o->nts = (v >> 6) & 1;
+}
+
+/* ─── Envelopes ─── */
+
+/* Effective rate 0-63 of a 4-bit rate register, after key scaling */
+static int eg_rate(const Opl *o, const OplOp *op, const OplChan *ch, int r)
+{
+    if (r == 0)
+        return 0;
+    int ks = (ch->block << 1) | ((ch->fnum >> (o->nts ? 8 : 9)) & 1);
+    int rate = r * 4 + (op->ksr ? ks : ks >> 2);
+    return rate < 63 ? rate : 63;
+}
+
+/* Milliseconds a rate takes across the full 96 dB, given the time at
+ * rates 4-7: it halves every 4 steps, in quarter steps between */
+static double eg_span_ms(int rate, double base_ms)
+{
+    if (rate > 60)
+        rate = 60;
+    return base_ms / (double)(1 << ((rate >> 2) - 1)) / (1.0 + 0.25 * (rate & 3));
+}
+
+static void eg_step(const Opl *o, OplOp *op, const OplChan *ch, float dt_ms)
+{
+    int rate;
+    switch (op->stage) {
+    case EG_ATTACK:
+        /* Exponential in dB; rates 60-63 are instant */
+        rate = eg_rate(o, op, ch, op->ar);
+        if (rate >= 60)
+            op->env = 0;
+        else if (rate >= 4)
+            op->env *= expf(-6.2f * dt_ms / (float)eg_span_ms(rate, 2826.0));
+        if (op->env < 0.1f) {
+            op->env = 0;
+            op->stage = EG_DECAY;
+        }
+        break;
+
+    case EG_DECAY: {
+        float sl = op->sl == 15 ? 93.0f : 3.0f * op->sl;
+        rate = eg_rate(o, op, ch, op->dr);
+        if (rate >= 4)
+            op->env += EG_SILENT * dt_ms / (float)eg_span_ms(rate, 39280.0);
+        if (op->env >= sl) {
+            op->env = sl;
+            op->stage = EG_SUSTAIN;
+        }
+        break;
+    }
+
+    case EG_SUSTAIN:
+        if (op->egt)
+            break;
+        /* fall through - without EGT the note keeps fading at the release rate */
+    case EG_RELEASE:
+        rate = eg_rate(o, op, ch, op->rr);
+        if (rate >= 4)
+            op->env += EG_SILENT * dt_ms / (float)eg_span_ms(rate, 39280.0);
+        if (op->env >= EG_SILENT) {
+            op->env = EG_SILENT;
+            op->stage = EG_OFF;
+        }
+        break;
+    }
+}
+
+static float op_gain(const OplOp *op, const OplChan *ch, float trem_db)
+{
+    if (op->stage == EG_OFF)
+        return 0;
+    float db = op->env + 0.75f * op->tl + (op->am ? trem_db : 0);
+    if (op->ksl) {
+        int k = ksl_rom[ch->fnum >> 6] * 4 - (8 - ch->block) * 32;
+        if (k > 0)
+            db += 0.1875f * (float)(k >> ksl_shift[op->ksl]);
+    }
+    return db >= EG_SILENT ? 0 : powf(10.0f, -db / 20.0f);
+}
+
+/* ─── Operator kernels ─── */
+
+/* OPL waveforms at phase p (cycles): sine, half sine, absolute sine and
+ * quarter (pulse) sine. sin(pi t) on [0, 1) is q (0.775 + 0.225 q) with
+ * q = 4t(1 - t), within 0.1%. */
+static float wave_at(float p, int wave)
+{
+    float x = p - (float)(int)p;    /* Not floorf: a libm call without SSE4.1 */
+    if (x < 0)
+        x += 1.0f;
+    int h = x >= 0.5f;
+    float t = 2.0f * x - (float)h;
+    float q = 4.0f * t * (1.0f - t);
+    float s = q * (0.775f + 0.225f * q);
+    switch (wave) {
+    case 0:  return h ? -s : s;
+    case 1:  return h ? 0 : s;
+    case 2:  return s;
+    default: return t < 0.5f ? s : 0;
+    }
+}
+
+/* out[i] = wave(phase + i inc + depth mod[i]) (g + i dg), n a multiple of 4 */
+static void op_render(float *out, const float *mod, float depth, float phase, float inc,
+                      float g, float dg, int wave, int n)
+{
+#if defined(AU_SSE2)
+    const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), four = _mm_set1_ps(4.0f);
+    const __m128 c0 = _mm_set1_ps(0.775f), c1 = _mm_set1_ps(0.225f);
+    const __m128 sign = _mm_set1_ps(-0.0f), vdepth = _mm_set1_ps(depth);
+    const __m128 pstep = _mm_set1_ps(4.0f * inc), gstep = _mm_set1_ps(4.0f * dg);
+    __m128 vp = _mm_add_ps(_mm_set1_ps(phase), _mm_mul_ps(lane, _mm_set1_ps(inc)));
+    __m128 vg = _mm_add_ps(_mm_set1_ps(g), _mm_mul_ps(lane, _mm_set1_ps(dg)));
+    for (int i = 0; i < n; i += 4) {
+        __m128 p = mod ? _mm_add_ps(vp, _mm_mul_ps(vdepth, _mm_loadu_ps(mod + i))) : vp;
+        __m128 fl = _mm_cvtepi32_ps(_mm_cvttps_epi32(p));
+        fl = _mm_sub_ps(fl, _mm_and_ps(_mm_cmpgt_ps(fl, p), one));
+        __m128 x = _mm_sub_ps(p, fl);
+        __m128 h = _mm_cmpge_ps(x, half);
+        __m128 t = _mm_sub_ps(_mm_add_ps(x, x), _mm_and_ps(h, one));
+        __m128 q = _mm_mul_ps(_mm_mul_ps(four, t), _mm_sub_ps(one, t));
+        __m128 s = _mm_mul_ps(q, _mm_add_ps(c0, _mm_mul_ps(c1, q)));
+        if (wave == 0)
+            s = _mm_xor_ps(s, _mm_and_ps(h, sign));
+        else if (wave == 1)
+            s = _mm_andnot_ps(h, s);
+        else if (wave == 3)
+            s = _mm_and_ps(s, _mm_cmplt_ps(t, half));
+        _mm_storeu_ps(out + i, _mm_mul_ps(s, vg));
+        vp = _mm_add_ps(vp, pstep);
+        vg = _mm_add_ps(vg, gstep);
+    }
+#elif defined(AU_NEON)
+    static const float lanes[4] = { 0, 1, 2, 3 };
+    const float32x4_t lane = vld1q_f32(lanes);
+    const float32x4_t one = vdupq_n_f32(1.0f), half = vdupq_n_f32(0.5f), zero = vdupq_n_f32(0);
+    const float32x4_t c0 = vdupq_n_f32(0.775f), c1 = vdupq_n_f32(0.225f);
+    const float32x4_t pstep = vdupq_n_f32(4.0f * inc), gstep = vdupq_n_f32(4.0f * dg);
+    float32x4_t vp = vmlaq_n_f32(vdupq_n_f32(phase), lane, inc);
+    float32x4_t vg = vmlaq_n_f32(vdupq_n_f32(g), lane, dg);
+    for (int i = 0; i < n; i += 4) {
+        float32x4_t p = mod ? vmlaq_n_f32(vp, vld1q_f32(mod + i), depth) : vp;
+        float32x4_t fl = vcvtq_f32_s32(vcvtq_s32_f32(p));
+        fl = vsubq_f32(fl, vbslq_f32(vcgtq_f32(fl, p), one, zero));
+        float32x4_t x = vsubq_f32(p, fl);
+        uint32x4_t h = vcgeq_f32(x, half);
+        float32x4_t t = vsubq_f32(vaddq_f32(x, x), vbslq_f32(h, one, zero));
+        float32x4_t q = vmulq_n_f32(vmulq_f32(t, vsubq_f32(one, t)), 4.0f);
+        float32x4_t s = vmulq_f32(q, vmlaq_f32(c0, c1, q));
+        if (wave == 0)
+            s = vbslq_f32(h, vnegq_f32(s), s);
+        else if (wave == 1)
+            s = vbslq_f32(h, zero, s);
+        else if (wave == 3)
+            s = vbslq_f32(vcltq_f32(t, half), s, zero);
+        vst1q_f32(out + i, vmulq_f32(s, vg));
+        vp = vaddq_f32(vp, pstep);
+        vg = vaddq_f32(vg, gstep);
+    }
+#else
+    for (int i = 0; i < n; i++) {
+        float p = phase + inc * (float)i + (mod ? depth * mod[i] : 0);
+        out[i] = wave_at(p, wave) * (g + dg * (float)i);
+    }
+#endif
+}
+
+/* A modulator fed back on itself by the average of its last two outputs */
+static void op_render_feedback(OplOp *op, float *out, float fb, float inc,
+                               float g, float dg, int wave, int n)
+{
+    float o1 = op->fb1, o2 = op->fb2;
+    for (int i = 0; i < n; i++) {
+        float v = wave_at(op->phase + inc * (float)i + fb * (o1 + o2), wave) * (g + dg * (float)i);
+        o2 = o1;
+        o1 = v;
+        out[i] = v;
+    }
+    op->fb1 = o1;
+    op->fb2 = o2;
+}
+
+const char *audio_kernels(void)
+{
+#if defined(AU_SSE2)
+    return "sse2";
+#elif defined(AU_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/* ─── Synthesis ─── */
+
+static float op_inc(const AudioSynth *s, const OplOp *op, const OplChan *ch, float vib)
+{
+    float inc = s->hz_scale * (float)(ch->fnum << ch->block) * mult_tab[op->mult];
+    return op->vib ? inc * vib : inc;
+}
+
+static void op_advance(OplOp *op, float inc)
+{
+    op->phase += inc * AUDIO_BLOCK;
+    op->phase -= floorf(op->phase);
+}
+
+/* Step an operator's envelope over the block; returns the gain it starts at */
+static float op_update(AudioSynth *s, OplOp *op, const OplChan *ch, float trem_db)
+{
+    float g0 = op->gain;
+    eg_step(&s->opl, op, ch, (float)(AUDIO_BLOCK * s->ms_per_sample));
+    op->gain = op_gain(op, ch, trem_db);
+    return g0;
+}
+
+static void render_channel(AudioSynth *s, int c, float level, float trem_db, float vib)
+{
+    Opl *o = &s->opl;
+    const OplChan *ch = &o->ch[c];
+    OplOp *m = &o->op[chan_op(c)];
+    OplOp *k = m + 3;
+    float gm = op_update(s, m, ch, trem_db);
+    float gk = op_update(s, k, ch, trem_db);
+
+    /* Nothing audible: the carrier is silent, and so is the modulator if
+     * it is heard directly */
+    if (gk == 0 && k->gain == 0 && (!ch->cnt || (gm == 0 && m->gain == 0)))
+        return;
+
+    float im = op_inc(s, m, ch, vib), ik = op_inc(s, k, ch, vib);
+    float dm = (m->gain - gm) / AUDIO_BLOCK, dk = (k->gain - gk) / AUDIO_BLOCK;
+    int wm = o->wse ? m->wave : 0, wk = o->wse ? k->wave : 0;
+
+    if (ch->fb)
+        op_render_feedback(m, s->mod, ldexpf(1.0f, ch->fb - 7), im, gm, dm, wm, AUDIO_BLOCK);
+    else
+        op_render(s->mod, NULL, 0, m->phase, im, gm, dm, wm, AUDIO_BLOCK);
+
+    level *= OPL_OUT_SCALE;
+    if (ch->cnt) {
+        op_render(s->car, NULL, 0, k->phase, ik, gk, dk, wk, AUDIO_BLOCK);
+        for (int i = 0; i < AUDIO_BLOCK; i++)
+            s->mix[i] += level * (s->mod[i] + s->car[i]);
+    } else {
+        op_render(s->car, s->mod, OPL_MOD_CYCLES, k->phase, ik, gk, dk, wk, AUDIO_BLOCK);
+        for (int i = 0; i < AUDIO_BLOCK; i++)
+            s->mix[i] += level * s->car[i];
+    }
+    op_advance(m, im);
+    op_advance(k, ik);
+}
+
+/* Hi-hat, snare, tom and cymbal off the channel 7/8 operators. The tom is
+ * a plain operator; the others stand in for the chip's phase-bit and
+ * noise mixing with noise and square waves. */
+static void render_rhythm(AudioSynth *s, float trem_db, float vib)
+{
+    Opl *o = &s->opl;
+    static const int ops[4] = { OP_HH, OP_SD, OP_TOM, OP_TC };
+    float g[4], dg[4], inc[4];
+    int any = 0;
+    for (int j = 0; j < 4; j++) {
+        OplOp *op = &o->op[ops[j]];
+        const OplChan *ch = &o->ch[ops[j] == OP_HH || ops[j] == OP_SD ? 7 : 8];
+        g[j] = op_update(s, op, ch, trem_db);
+        dg[j] = (op->gain - g[j]) / AUDIO_BLOCK;
+        inc[j] = op_inc(s, op, ch, vib);
+        any |= g[j] != 0 || op->gain != 0;
+    }
+    if (!any)
+        return;
+
+    OplOp *sd = &o->op[OP_SD], *tom = &o->op[OP_TOM], *tc = &o->op[OP_TC];
+    int wsd = o->wse ? sd->wave : 0, wtom = o->wse ? tom->wave : 0;
+    const float level = 2.0f * OPL_OUT_SCALE;
+    for (int i = 0; i < AUDIO_BLOCK; i++) {
+        uint32_t bit = ((o->noise >> 14) ^ o->noise) & 1;
+        o->noise = (o->noise >> 1) | (bit << 22);
+        float noise = bit ? 1.0f : -1.0f;
+        float fi = (float)i;
+        float tcp = tc->phase + inc[3] * fi;
+        float v = 0.5f * noise * (g[0] + dg[0] * fi)
+                + (0.5f * wave_at(sd->phase + inc[1] * fi, wsd) + 0.5f * noise) * (g[1] + dg[1] * fi)
+                + wave_at(tom->phase + inc[2] * fi, wtom) * (g[2] + dg[2] * fi)
+                + 0.5f * ((tcp - floorf(tcp)) < 0.5f ? 1.0f : -1.0f) * (g[3] + dg[3] * fi);
+        s->mix[i] += level * v;
+    }
+    for (int j = 0; j < 4; j++)
+        op_advance(&o->op[ops[j]], inc[j]);
+}
+
+static void render_speaker(AudioSynth *s)
+{
+    Speaker *sp = &s->spk;
+    if (!sp->gate && sp->x1 == 0 && fabsf(sp->y1) < 1e-4f)
+        return;
+    float inc = (float)(PIT_FREQUENCY / (sp->reload ? sp->reload : 65536.0) / s->rate);
+    for (int i = 0; i < AUDIO_BLOCK; i++) {
+        float x;
+        if (!(sp->gate & 2))
+            x = 0;                          /* Speaker data off */
+        else if (!(sp->gate & 1))
+            x = 1;                          /* Driven directly through bit 1 */
+        else if (inc >= 0.5f)
+            x = 0.5f;                       /* Tone above Nyquist */
+        else {
+            x = sp->phase < 0.5f ? 1.0f : 0;
+            sp->phase += inc;
+            if (sp->phase >= 1.0f)
+                sp->phase -= 1.0f;
+        }
+        /* DC blocker, so a speaker left on at one level fades out */
+        float y = x - sp->x1 + 0.995f * sp->y1;
+        sp->x1 = x;
+        sp->y1 = y;
+        s->mix[i] += SPEAKER_LEVEL * y;
+    }
+}
+
+static void synth_block(AudioSynth *s)
+{
+    Opl *o = &s->opl;
+    float dt = (float)(AUDIO_BLOCK * s->ms_per_sample / 1000.0);
+    o->lfo_am += 3.7f * dt;
+    o->lfo_am -= floorf(o->lfo_am);
+    o->lfo_vib += 6.07f * dt;
+    o->lfo_vib -= floorf(o->lfo_vib);
+    float trem_db = (o->bd & 0x80 ? 4.8f : 1.0f) * (0.5f - 0.5f * cosf(TWO_PI * o->lfo_am));
+    float vib = exp2f((o->bd & 0x40 ? 14.0f : 7.0f) * sinf(TWO_PI * o->lfo_vib) / 1200.0f);
+
+    memset(s->mix, 0, sizeof(s->mix));
+    int rhythm = o->bd & 0x20;
+    for (int c = 0; c < (rhythm ? 7 : 9); c++)
+        render_channel(s, c, rhythm && c == 6 ? 2.0f : 1.0f, trem_db, vib);
+    if (rhythm)
+        render_rhythm(s, trem_db, vib);
+    render_speaker(s);
+}
+
+/* ─── Audio thread ─── */
+
+static void apply_event(AudioSynth *s, const AudioEvent *ev)
+{
+    switch (ev->kind) {
+    case AUDIO_EV_OPL:
+        opl_write(&s->opl, ev->reg, (uint8_t)ev->value);
+        break;
+    case AUDIO_EV_SPEAKER:
+        s->spk.gate = (uint8_t)(ev->value & 3);
+        break;
+    case AUDIO_EV_PIT2:
+        s->spk.reload = ev->value;
+        break;
+    }
+}
+
+/* Apply the events due before the end of the next block */
+static void drain_events(AudioState *as, AudioSynth *s)
+{
+    double end = s->now_ms + AUDIO_BLOCK * s->ms_per_sample;
+    uint32_t tail = as->tail, head = load_acquire(&as->head);
+    while (tail != head) {
+        const AudioEvent *ev = &as->ring[tail & (AUDIO_RING_SIZE - 1)];
+        double at = (double)ev->at_ms + AUDIO_LATENCY_MS;
+        /* First event, or the game's clock and playback have drifted
+         * apart (a stall, turbo, a restored snapshot): restart from it */
+        if (!s->synced || at < s->now_ms - RESYNC_MS || at > end + RESYNC_MS) {
+            s->now_ms = (double)ev->at_ms;
+            end = s->now_ms + AUDIO_BLOCK * s->ms_per_sample;
+            s->synced = 1;
+            continue;
+        }
+        if (at >= end)
+            break;
+        apply_event(s, ev);
+        tail++;
+    }
+    store_release(&as->tail, tail);
+}
+
+void audio_render(AudioState *as, int16_t *out, int frames)
+{
+    AudioSynth *s = (AudioSynth *)as->synth;
+    if (!s) {
+        memset(out, 0, (size_t)frames * sizeof(*out));
+        return;
+    }
+    for (int i = 0; i < frames; i++) {
+        if (s->pos == AUDIO_BLOCK) {
+            drain_events(as, s);
+            synth_block(s);
+            s->now_ms += AUDIO_BLOCK * s->ms_per_sample;
+            s->pos = 0;
+        }
+        float v = s->mix[s->pos++] * 32767.0f;
+        out[i] = (int16_t)(v > 32767.0f ? 32767 : v < -32768.0f ? -32768 : (int)v);
+    }
+}
+
+int audio_open(AudioState *as, int rate)
+{
+    AudioSynth *s = (AudioSynth *)calloc(1, sizeof(*s));
+    if (!s || rate <= 0) {
+        free(s);
+        return -1;
+    }
+    s->rate = rate;
+    s->ms_per_sample = 1000.0 / rate;
+    s->hz_scale = (float)(OPL_RATE / 1048576.0 / rate);
+    s->pos = AUDIO_BLOCK;
+    for (int i = 0; i < 18; i++)
+        s->opl.op[i].env = EG_SILENT;
+    s->opl.noise = 1;
+    s->spk.gate = as->port61 & 3;
+    s->spk.reload = as->pit2_reload;
+
+    as->tail = as->head;
+    as->synth = s;
+    as->active = 1;
+    return 0;
+}
+
+void audio_close(AudioState *as)
+{
+    as->active = 0;
+    free(as->synth);
+    as->synth = NULL;
+}
@@ -0,0 +1,574 @@
+/*
+ * gfx.c - GFX page drawing primitives
+ *
+ * The colour-keyed row kernels compare a vector of source pixels with
+ * the key and blend source and destination on the result; the 4bpp one
+ * splits bytes into nibbles and looks all of them up in the 16-byte map
+ * with one shuffle. SSE2 and NEON are baseline for their targets; the
+ * SSSE3 and AVX2 versions use per-function target attributes (GCC/Clang)
+ * and are only selected once the CPU (and for AVX2 the OS) is known to
+ * support them, and after they agree with the scalar kernels.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "hal/gfx.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GFX_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define GFX_TARGET(isa)
+#else
+#define GFX_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define GFX_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* dst[i] = src[i] unless src[i] == key, for i in [0, n) */
+typedef void (*gfx_mask8_fn)(uint8_t *dst, const uint8_t *src, int n, uint8_t key);
+
+/* Pixel i is nibble i of src (high nibble first); dst[i] = map[pixel]
+ * unless pixel == key (key < 0: never) */
+typedef void (*gfx_expand4_fn)(uint8_t *dst, const uint8_t *src, int n,
+                               const uint8_t *map, int key);
+
+/* ─── Scalar ─── */
+
+static void mask8_scalar(uint8_t *dst, const uint8_t *src, int n, uint8_t key)
+{
+    for (int i = 0; i < n; i++)
+        if (src[i] != key)
+            dst[i] = src[i];
+}
+
+static void expand4_scalar(uint8_t *dst, const uint8_t *src, int n,
+                           const uint8_t *map, int key)
+{
+    for (int i = 0; i < n; i++) {
+        int c = (i & 1) ? (src[i >> 1] & 0x0F) : (src[i >> 1] >> 4);
+        if (c != key)
+            dst[i] = map[c];
+    }
+}
+
+/* ─── x86: SSE2 / AVX2 ─── */
+
+#ifdef GFX_SSE2
+
+static void mask8_sse2(uint8_t *dst, const uint8_t *src, int n, uint8_t key)
+{
+    const __m128i vk = _mm_set1_epi8((char)key);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i m = _mm_cmpeq_epi8(s, vk);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, s)));
+    }
+    mask8_scalar(dst + i, src + i, n - i, key);
+}
+
+GFX_TARGET("avx2")
+static void mask8_avx2(uint8_t *dst, const uint8_t *src, int n, uint8_t key)
+{
+    const __m256i vk = _mm256_set1_epi8((char)key);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i m = _mm256_cmpeq_epi8(s, vk);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_blendv_epi8(s, d, m));
+    }
+    /* The tails are non-VEX code and GCC turns the call into a jump
+     * without its vzeroupper: clear the upper halves here, or every SSE
+     * instruction after it pays the transition penalty */
+    _mm256_zeroupper();
+    mask8_sse2(dst + i, src + i, n - i, key);
+}
+
+/* 32 pixels (16 source bytes) per step; a key of -1 compares as 0xFF,
+ * which no nibble equals */
+GFX_TARGET("avx2")
+static void expand4_avx2(uint8_t *dst, const uint8_t *src, int n,
+                         const uint8_t *map, int key)
+{
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)map));
+    const __m256i vk = _mm256_set1_epi8((char)key);
+    const __m128i low = _mm_set1_epi8(0x0F);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i / 2));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), low);
+        __m128i lo = _mm_and_si128(b, low);
+        __m256i idx = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_unpacklo_epi8(hi, lo)), _mm_unpackhi_epi8(hi, lo), 1);
+        __m256i px = _mm256_shuffle_epi8(lut, idx);
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i m = _mm256_cmpeq_epi8(idx, vk);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_blendv_epi8(px, d, m));
+    }
+    _mm256_zeroupper();
+    expand4_scalar(dst + i, src + i / 2, n - i, map, key);
+}
+
+/* 16 pixels (8 source bytes) per step */
+GFX_TARGET("ssse3")
+static void expand4_ssse3(uint8_t *dst, const uint8_t *src, int n,
+                          const uint8_t *map, int key)
+{
+    const __m128i lut = _mm_loadu_si128((const __m128i *)map);
+    const __m128i vk = _mm_set1_epi8((char)key);
+    const __m128i low = _mm_set1_epi8(0x0F);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i b = _mm_loadl_epi64((const __m128i *)(src + i / 2));
+        __m128i idx = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(b, 4), low),
+                                        _mm_and_si128(b, low));
+        __m128i px = _mm_shuffle_epi8(lut, idx);
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i m = _mm_cmpeq_epi8(idx, vk);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, px)));
+    }
+    expand4_scalar(dst + i, src + i / 2, n - i, map, key);
+}
+
+static int cpu_has_ssse3(void)
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 1);
+    return (r[2] >> 9) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static int cpu_has_avx2(void)
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    if (r[0] < 7)
+        return 0;
+    __cpuid(r, 1);
+    /* AVX and OSXSAVE, and the OS saves the SSE and AVX state (XCR0 bits 1-2) */
+    if ((r[2] & (1 << 28)) == 0 || (r[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+        return 0;
+    __cpuidex(r, 7, 0);
+    return (r[1] >> 5) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#define MASK8_BASELINE   mask8_sse2
+#define EXPAND4_BASELINE expand4_scalar
+#define KERNELS_BASELINE "sse2"
+
+#endif /* GFX_SSE2 */
+
+/* ─── ARM: NEON ─── */
+
+#ifdef GFX_NEON
+
+static void mask8_neon(uint8_t *dst, const uint8_t *src, int n, uint8_t key)
+{
+    const uint8x16_t vk = vdupq_n_u8(key);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t d = vld1q_u8(dst + i);
+        vst1q_u8(dst + i, vbslq_u8(vceqq_u8(s, vk), d, s));
+    }
+    mask8_scalar(dst + i, src + i, n - i, key);
+}
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+/* 16 pixels (8 source bytes) per step through a 16-byte table lookup */
+static void expand4_neon(uint8_t *dst, const uint8_t *src, int n,
+                         const uint8_t *map, int key)
+{
+    const uint8x16_t lut = vld1q_u8(map);
+    const uint8x16_t vk = vdupq_n_u8((uint8_t)key);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x8_t b = vld1_u8(src + i / 2);
+        uint8x8x2_t z = vzip_u8(vshr_n_u8(b, 4), vand_u8(b, vdup_n_u8(0x0F)));
+        uint8x16_t idx = vcombine_u8(z.val[0], z.val[1]);
+        uint8x16_t d = vld1q_u8(dst + i);
+        vst1q_u8(dst + i, vbslq_u8(vceqq_u8(idx, vk), d, vqtbl1q_u8(lut, idx)));
+    }
+    expand4_scalar(dst + i, src + i / 2, n - i, map, key);
+}
+#define EXPAND4_BASELINE expand4_neon
+#else
+#define EXPAND4_BASELINE expand4_scalar
+#endif
+
+#define MASK8_BASELINE   mask8_neon
+#define KERNELS_BASELINE "neon"
+
+#endif /* GFX_NEON */
+
+#ifndef MASK8_BASELINE
+#define MASK8_BASELINE   mask8_scalar
+#define EXPAND4_BASELINE expand4_scalar
+#define KERNELS_BASELINE "scalar"
+#endif
+
+static gfx_mask8_fn   gfx_mask8   = MASK8_BASELINE;
+static gfx_expand4_fn gfx_expand4 = EXPAND4_BASELINE;
+
+/* Whether a kernel pair matches the scalar one on every length up to
+ * a few vectors, for keys that hit and keys that don't */
+static int kernels_match(gfx_mask8_fn mask8, gfx_expand4_fn expand4)
+{
+    enum { N = 100 };
+    static const int keys[] = { -1, 0, 7, 15 };
+    uint8_t src[N], map[16], want[N], got[N];
+    for (int i = 0; i < 16; i++)
+        map[i] = (uint8_t)(0xC0 + 5 * i);
+    for (int i = 0; i < N; i++)
+        src[i] = (uint8_t)((i * 0x9D) ^ (i >> 2));
+
+    for (int n = 0; n <= N; n++) {
+        for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+            int key = keys[k];
+            memset(want, 0x5A, sizeof(want));
+            memset(got, 0x5A, sizeof(got));
+            expand4_scalar(want, src, n, map, key);
+            expand4(got, src, n, map, key);
+            if (memcmp(want, got, sizeof(want)) != 0)
+                return 0;
+            if (key < 0)
+                continue;
+            uint8_t key8 = src[(n + 3 * key) % N];
+            memset(want, 0x5A, sizeof(want));
+            memset(got, 0x5A, sizeof(got));
+            mask8_scalar(want, src, n, key8);
+            mask8(got, src, n, key8);
+            if (memcmp(want, got, sizeof(want)) != 0)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+const char *gfx_kernels_init(void)
+{
+#ifdef GFX_SSE2
+    if (cpu_has_avx2() && kernels_match(mask8_avx2, expand4_avx2)) {
+        gfx_mask8 = mask8_avx2;
+        gfx_expand4 = expand4_avx2;
+        return "avx2";
+    }
+    if (cpu_has_ssse3() && kernels_match(mask8_sse2, expand4_ssse3)) {
+        gfx_mask8 = mask8_sse2;
+        gfx_expand4 = expand4_ssse3;
+        return "ssse3";
+    }
+#endif
+    if (kernels_match(MASK8_BASELINE, EXPAND4_BASELINE)) {
+        gfx_mask8 = MASK8_BASELINE;
+        gfx_expand4 = EXPAND4_BASELINE;
+        return KERNELS_BASELINE;
+    }
+    gfx_mask8 = mask8_scalar;
+    gfx_expand4 = expand4_scalar;
+    return "scalar";
+}
+
+/* ─── Clipping ─── */
+
+/* Clip a page-to-page copy against both pages; 0 if nothing is left */
+static int clip_copy(int *sx, int *sy, int *dx, int *dy, int *w, int *h)
+{
+    /* Left and top edges */
+    if (*sx < 0) { *w += *sx; *dx -= *sx; *sx = 0; }
+    if (*dx < 0) { *w += *dx; *sx -= *dx; *dx = 0; }
+    if (*sy < 0) { *h += *sy; *dy -= *sy; *sy = 0; }
+    if (*dy < 0) { *h += *dy; *sy -= *dy; *dy = 0; }
+    /* Right and bottom edges */
+    if (*sx + *w > GFX_WIDTH) *w = GFX_WIDTH - *sx;
+    if (*dx + *w > GFX_WIDTH) *w = GFX_WIDTH - *dx;
+    if (*sy + *h > GFX_HEIGHT) *h = GFX_HEIGHT - *sy;
+    if (*dy + *h > GFX_HEIGHT) *h = GFX_HEIGHT - *dy;
+    return *w > 0 && *h > 0;
+}
+
+/* ─── Rectangles ─── */
+
+void gfx_fill_rect(CPU *cpu, uint16_t page, int16_t x, int16_t y,
+                   int16_t width, int16_t height, uint8_t color)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    uint32_t buf_base = gfx_page_addr(page);
+
+    /* Clip to screen bounds */
+    int16_t x1 = x, y1 = y;
+    int16_t x2 = x + width, y2 = y + height;
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 > GFX_WIDTH) x2 = GFX_WIDTH;
+    if (y2 > GFX_HEIGHT) y2 = GFX_HEIGHT;
+    if (x1 >= x2 || y1 >= y2)
+        return;
+
+    for (int row = y1; row < y2; row++) {
+        uint32_t row_addr = buf_base + (uint32_t)row * GFX_WIDTH + (uint32_t)x1;
+        if (row_addr + (x2 - x1) <= MEM_SIZE)
+            memset(&cpu->mem[row_addr], color, (size_t)(x2 - x1));
+    }
+    if (buf_base == GFX_PAGE_VGA)
+        vga_mark_rows(cpu, y1, y2);
+}
+
+void gfx_copy_rect(CPU *cpu, uint16_t src_page, int16_t sx, int16_t sy,
+                   int16_t width, int16_t height,
+                   uint16_t dst_page, int16_t dx, int16_t dy)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    uint32_t src_base = gfx_page_addr(src_page);
+    uint32_t dst_base = gfx_page_addr(dst_page);
+
+    int src_x1 = sx, src_y1 = sy, dst_x1 = dx, dst_y1 = dy;
+    int copy_w = width, copy_h = height;
+    if (!clip_copy(&src_x1, &src_y1, &dst_x1, &dst_y1, &copy_w, &copy_h))
+        return;
+
+    for (int row = 0; row < copy_h; row++) {
+        uint32_t s = src_base + (uint32_t)(src_y1 + row) * GFX_WIDTH + (uint32_t)src_x1;
+        uint32_t d = dst_base + (uint32_t)(dst_y1 + row) * GFX_WIDTH + (uint32_t)dst_x1;
+        if (s + copy_w <= MEM_SIZE && d + copy_w <= MEM_SIZE)
+            memmove(&cpu->mem[d], &cpu->mem[s], (size_t)copy_w);
+    }
+    if (dst_base == GFX_PAGE_VGA)
+        vga_mark_rows(cpu, dst_y1, dst_y1 + copy_h);
+}
+
+void gfx_blit_masked(CPU *cpu, uint16_t src_page, int16_t sx, int16_t sy,
+                     int16_t width, int16_t height,
+                     uint16_t dst_page, int16_t dx, int16_t dy, uint8_t key)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    uint32_t src_base = gfx_page_addr(src_page);
+    uint32_t dst_base = gfx_page_addr(dst_page);
+
+    int src_x1 = sx, src_y1 = sy, dst_x1 = dx, dst_y1 = dy;
+    int w = width, h = height;
+    if (!clip_copy(&src_x1, &src_y1, &dst_x1, &dst_y1, &w, &h))
+        return;
+
+    /* Within one page, walk the rows so none is overwritten before it is
+     * read, and take each row out first in case it overlaps itself */
+    int same = src_base == dst_base;
+    int step = same && dst_y1 > src_y1 ? -1 : 1;
+    int row = step > 0 ? 0 : h - 1;
+    uint8_t tmp[GFX_WIDTH];
+    for (int i = 0; i < h; i++, row += step) {
+        const uint8_t *s = &cpu->mem[src_base + (uint32_t)(src_y1 + row) * GFX_WIDTH + (uint32_t)src_x1];
+        uint8_t *d = &cpu->mem[dst_base + (uint32_t)(dst_y1 + row) * GFX_WIDTH + (uint32_t)dst_x1];
+        if (same) {
+            memcpy(tmp, s, (size_t)w);
+            s = tmp;
+        }
+        gfx_mask8(d, s, w, key);
+    }
+    if (dst_base == GFX_PAGE_VGA)
+        vga_mark_rows(cpu, dst_y1, dst_y1 + h);
+}
+
+void gfx_blit_expand4(CPU *cpu, uint32_t src, uint16_t pitch,
+                      int16_t width, int16_t height,
+                      uint16_t dst_page, int16_t dx, int16_t dy,
+                      const uint8_t map[16], int key)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    uint32_t dst_base = gfx_page_addr(dst_page);
+
+    /* Clip the destination; (ox, oy) is the first source pixel drawn */
+    int x1 = dx, y1 = dy, x2 = dx + width, y2 = dy + height;
+    int ox = 0, oy = 0;
+    if (x1 < 0) { ox = -x1; x1 = 0; }
+    if (y1 < 0) { oy = -y1; y1 = 0; }
+    if (x2 > GFX_WIDTH) x2 = GFX_WIDTH;
+    if (y2 > GFX_HEIGHT) y2 = GFX_HEIGHT;
+    if (x1 >= x2 || y1 >= y2)
+        return;
+
+    int w = x2 - x1;
+    for (int row = y1; row < y2; row++) {
+        uint32_t s = src + (uint32_t)(oy + row - y1) * pitch + (uint32_t)ox / 2;
+        if (s + (uint32_t)(w + 2) / 2 > MEM_SIZE)
+            break;
+        uint8_t *d = &cpu->mem[dst_base + (uint32_t)row * GFX_WIDTH + (uint32_t)x1];
+        const uint8_t *p = &cpu->mem[s];
+        int n = w;
+        /* The kernels start on a high nibble */
+        if (ox & 1) {
+            int c = *p++ & 0x0F;
+            if (c != key)
+                *d = map[c];
+            d++;
+            n--;
+        }
+        gfx_expand4(d, p, n, map, key);
+    }
+    if (dst_base == GFX_PAGE_VGA)
+        vga_mark_rows(cpu, y1, y2);
+}
+
+/* ─── Lines ─── */
+
+void gfx_hline(CPU *cpu, uint16_t page, int16_t x, int16_t y, int16_t length, uint8_t color)
+{
+    gfx_fill_rect(cpu, page, x, y, length, 1, color);
+}
+
+void gfx_vline(CPU *cpu, uint16_t page, int16_t x, int16_t y, int16_t length, uint8_t color)
+{
+    if (length <= 0 || x < 0 || x >= GFX_WIDTH)
+        return;
+
+    uint32_t base = gfx_page_addr(page);
+    int y1 = y < 0 ? 0 : y;
+    int y2 = y + length > GFX_HEIGHT ? GFX_HEIGHT : y + length;
+    if (y1 >= y2)
+        return;
+
+    uint8_t *p = &cpu->mem[base + (uint32_t)y1 * GFX_WIDTH + (uint32_t)x];
+    for (int row = y1; row < y2; row++, p += GFX_WIDTH)
+        *p = color;
+    if (base == GFX_PAGE_VGA)
+        vga_mark_rows(cpu, y1, y2);
+}
+
+void gfx_line(CPU *cpu, uint16_t page, int16_t x0, int16_t y0,
+              int16_t x1, int16_t y1, uint8_t color)
+{
+    if (y0 == y1) {
+        gfx_hline(cpu, page, x0 < x1 ? x0 : x1, y0, (int16_t)(abs(x1 - x0) + 1), color);
+        return;
+    }
+    if (x0 == x1) {
+        gfx_vline(cpu, page, x0, y0 < y1 ? y0 : y1, (int16_t)(abs(y1 - y0) + 1), color);
+        return;
+    }
+
+    uint32_t base = gfx_page_addr(page);
+
+    /* Step i moves the major axis by one and the minor one by
+     * round(i * minor / major), kept as quotient q and remainder r of
+     * (2 * i * minor + major) / (2 * major) */
+    int x_major = abs(x1 - x0) >= abs(y1 - y0);
+    int ma0 = x_major ? x0 : y0, ma1 = x_major ? x1 : y1;
+    int mi0 = x_major ? y0 : x0, mi1 = x_major ? y1 : x1;
+    int ma_step = ma1 > ma0 ? 1 : -1, mi_step = mi1 > mi0 ? 1 : -1;
+    int major = abs(ma1 - ma0), minor = abs(mi1 - mi0);
+    int ma_lim = x_major ? GFX_WIDTH : GFX_HEIGHT;
+    int mi_lim = x_major ? GFX_HEIGHT : GFX_WIDTH;
+
+    /* Only the steps whose major coordinate is on the page */
+    int first = ma_step > 0 ? -ma0 : ma0 - (ma_lim - 1);
+    int last = ma_step > 0 ? ma_lim - 1 - ma0 : ma0;
+    if (first < 0) first = 0;
+    if (last > major) last = major;
+    if (first > last)
+        return;
+
+    int64_t num = 2 * (int64_t)first * minor + major;
+    int64_t q = num / (2 * major);
+    int r = (int)(num % (2 * major));
+    int ymin = GFX_HEIGHT, ymax = -1;
+    int inside = 0;
+
+    for (int i = first; i <= last; i++) {
+        int ma = ma0 + ma_step * i;
+        int mi = mi0 + mi_step * (int)q;
+        if (mi >= 0 && mi < mi_lim) {
+            int x = x_major ? ma : mi, y = x_major ? mi : ma;
+            cpu->mem[base + (uint32_t)y * GFX_WIDTH + (uint32_t)x] = color;
+            if (y < ymin) ymin = y;
+            if (y > ymax) ymax = y;
+            inside = 1;
+        } else if (inside) {
+            break;      /* both coordinates are monotonic: it won't come back */
+        }
+        r += 2 * minor;
+        if (r >= 2 * major) {
+            r -= 2 * major;
+            q++;
+        }
+    }
+    if (base == GFX_PAGE_VGA && ymax >= 0)
+        vga_mark_rows(cpu, ymin, ymax + 1);
+}
+
+/* ─── Glyphs ─── */
+
+/* One byte per bit of b, 0xFF where set; byte 0 is the MSB */
+static inline uint64_t spread_bits(uint8_t b)
+{
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t t = ((uint64_t)b * 0x0101010101010101ULL) & 0x0102040810204080ULL;
+    uint64_t nz = (((t & low7) + low7) | t) & ~low7;
+    return (nz >> 7) * 0xFF;
+}
+
+/* Each row is one 8-byte read-modify-write with byte masks (the bytes
+ * are stored little-endian, which every target is). Columns a clip
+ * removes drop out of the masks, so the window may reach past the
+ * row ends: the pages never sit at either end of guest memory. */
+void gfx_glyph(CPU *cpu, uint16_t page, int16_t x, int16_t y, const uint8_t *rows,
+               int width, int height, uint8_t fg, int bg)
+{
+    if (width <= 0 || height <= 0 || x <= -8 || x >= GFX_WIDTH)
+        return;
+    if (width > 8)
+        width = 8;
+
+    uint8_t cols = (uint8_t)(0xFF << (8 - width));
+    if (x < 0)
+        cols &= (uint8_t)(0xFF >> -x);
+    if (x > GFX_WIDTH - 8)
+        cols &= (uint8_t)(0xFF << (x - (GFX_WIDTH - 8)));
+
+    int r0 = y < 0 ? -y : 0;
+    int r1 = y + height > GFX_HEIGHT ? GFX_HEIGHT - y : height;
+    if (r0 >= r1)
+        return;
+
+    uint32_t base = gfx_page_addr(page);
+    uint64_t fg64 = (uint64_t)fg * 0x0101010101010101ULL;
+    uint64_t bg64 = bg >= 0 ? (uint64_t)(uint8_t)bg * 0x0101010101010101ULL : 0;
+    for (int r = r0; r < r1; r++) {
+        uint8_t bits = rows[r] & cols;
+        uint64_t set = spread_bits(bits);
+        uint64_t clr = bg >= 0 ? spread_bits((uint8_t)(~rows[r] & cols)) : 0;
+        uint8_t *p = &cpu->mem[base + (uint32_t)(y + r) * GFX_WIDTH + (uint32_t)x];
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v = (v & ~(set | clr)) | (fg64 & set) | (bg64 & clr);
+        memcpy(p, &v, 8);
+    }
+    if (base == GFX_PAGE_VGA)
+        vga_mark_rows(cpu, y + r0, y + r1);
+}
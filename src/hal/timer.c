@@ -4,14 +4,81 @@
  * Part of the Civ Recomp project (sp00nznet/civ)
  */
 
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L     /* clock_gettime */
+#endif
+
 #include "hal/timer.h"
 #include <string.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+/* Virtual-clock runs report this as the wall-clock start (1991-09-01) */
+#define VIRTUAL_EPOCH   ((time_t)683683200)
+
+void timer_set_clock(TimerState *ts, timer_clock_fn fn, void *ctx)
+{
+    ts->clock_fn = fn;
+    ts->clock_ctx = ctx;
+}
+
+/* Monotonic wall time in microseconds. Not clock(): that is CPU time on
+ * POSIX and stands still while the game sleeps in dos_wait_input. Nor
+ * GetTickCount64, which only moves every 10-16 ms. */
+static uint64_t host_us(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    /* Split so the multiply can't overflow however long the host is up */
+    uint64_t q = (uint64_t)now.QuadPart / (uint64_t)freq.QuadPart;
+    uint64_t r = (uint64_t)now.QuadPart % (uint64_t)freq.QuadPart;
+    return q * 1000000ULL + r * 1000000ULL / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+#endif
+}
+
+uint64_t timer_now_us(const TimerState *ts)
+{
+    if (ts->clock_fn)
+        return ts->clock_fn(ts->clock_ctx) * 1000ULL;
+    return host_us();
+}
+
+uint64_t timer_now_ms(const TimerState *ts)
+{
+    if (ts->clock_fn)
+        return ts->clock_fn(ts->clock_ctx);
+    return host_us() / 1000ULL;
+}
+
+int timer_is_virtual(const TimerState *ts)
+{
+    return ts->clock_fn != NULL;
+}
+
+time_t timer_wall_time(const TimerState *ts)
+{
+    if (ts->clock_fn)
+        return VIRTUAL_EPOCH + (time_t)(timer_now_ms(ts) / 1000);
+    return time(NULL);
+}
+
 void timer_init(TimerState *ts)
 {
     memset(ts, 0, sizeof(*ts));
     ts->pit_reload = 0;  /* 0 = 65536 = standard 18.2 Hz */
     ts->tick_rate_hz = DOS_TICK_HZ;
+    ts->irq_rate_hz = DOS_TICK_HZ;
 }
 
 void timer_update(TimerState *ts, uint64_t current_ms)
@@ -21,7 +88,8 @@ void timer_update(TimerState *ts, uint64_t current_ms)
         return;
     }
 
-    uint64_t elapsed = current_ms - ts->start_ms;
+    ts->last_ms = current_ms;
+    uint64_t elapsed = current_ms + ts->skipped_ms - ts->start_ms;
     /* Standard DOS: 18.2065 ticks per second */
     ts->tick_count = (uint32_t)(elapsed * ts->tick_rate_hz / 1000.0);
 }
@@ -31,25 +99,123 @@ uint32_t timer_get_ticks(const TimerState *ts)
     return ts->tick_count;
 }
 
-void timer_port_write(TimerState *ts, uint16_t port, uint8_t value)
+uint32_t timer_poll(TimerState *ts)
+{
+    if (!ts->turbo || ts->start_ms == 0)
+        return ts->tick_count;
+
+    if (ts->tick_count != ts->poll_tick) {
+        ts->poll_tick = ts->tick_count;
+        ts->poll_repeats = 0;
+    } else if (++ts->poll_repeats >= TURBO_POLL_SPINS) {
+        /* Nothing else is happening until the tick changes: make it change */
+        ts->skipped_ms += timer_ms_to_next_tick(ts, ts->last_ms);
+        timer_update(ts, ts->last_ms);
+        ts->poll_tick = ts->tick_count;
+        ts->poll_repeats = 0;
+    }
+    return ts->tick_count;
+}
+
+void timer_set_turbo(TimerState *ts, int on)
+{
+    ts->turbo = on ? 1 : 0;
+    ts->poll_tick = ts->tick_count;
+    ts->poll_repeats = 0;
+}
+
+void timer_set_ticks(TimerState *ts, uint32_t ticks, uint64_t current_ms)
+{
+    /* First millisecond at which timer_update reports ticks */
+    uint64_t want = (uint64_t)((double)ticks * 1000.0 / ts->tick_rate_hz);
+    while ((uint64_t)((double)want * ts->tick_rate_hz / 1000.0) < ticks)
+        want++;
+
+    if (ts->start_ms == 0)
+        ts->start_ms = current_ms;
+    uint64_t elapsed = current_ms + ts->skipped_ms - ts->start_ms;
+    if (want >= elapsed)
+        ts->skipped_ms += want - elapsed;
+    else
+        ts->start_ms += elapsed - want;
+    timer_update(ts, current_ms);
+    ts->poll_tick = ts->tick_count;
+    ts->poll_repeats = 0;
+    ts->irq_done = ts->irq_due;
+}
+
+uint32_t timer_ms_to_next_tick(const TimerState *ts, uint64_t current_ms)
 {
-    static uint8_t pit_latch = 0;
-    static int pit_byte = 0;
+    if (ts->start_ms == 0 || current_ms + ts->skipped_ms < ts->start_ms)
+        return 1;
+    uint64_t elapsed = current_ms + ts->skipped_ms - ts->start_ms;
+    uint64_t next = (uint64_t)((double)elapsed * ts->tick_rate_hz / 1000.0) + 1;
+    uint64_t at = (uint64_t)((double)next * 1000.0 / ts->tick_rate_hz);
+    /* Same rounding as timer_update, so the tick has happened by 'at' */
+    while ((uint64_t)((double)at * ts->tick_rate_hz / 1000.0) < next)
+        at++;
+    return at > elapsed ? (uint32_t)(at - elapsed) : 1;
+}
+
+/* ─── IRQ0 ─── */
+
+/* IRQ0 count at elapsed time t (>= irq_base_us) */
+static uint32_t irq_count_at(const TimerState *ts, uint64_t t)
+{
+    return ts->irq_base + (uint32_t)((double)(t - ts->irq_base_us) * ts->irq_rate_hz / 1e6);
+}
 
+uint32_t timer_irq_sync(TimerState *ts)
+{
+    uint64_t now = timer_now_us(ts);
+    if (ts->irq_start_us == 0 || now < ts->irq_start_us) {
+        ts->irq_start_us = now ? now : 1;
+        return 0;
+    }
+
+    /* Turbo's skipped time hurries the IRQs along with the tick */
+    uint64_t elapsed = now - ts->irq_start_us + ts->skipped_ms * 1000ULL;
+    if (elapsed < ts->irq_last_us)
+        elapsed = ts->irq_last_us;
+    ts->irq_due = irq_count_at(ts, elapsed);
+    ts->irq_last_us = elapsed;
+
+    if (ts->irq_rate_hz != ts->tick_rate_hz) {
+        /* Reprogrammed since the last sync: the new rate counts from here */
+        ts->irq_base = ts->irq_due;
+        ts->irq_base_us = elapsed;
+        ts->irq_rate_hz = ts->tick_rate_hz;
+    }
+    return ts->irq_due - ts->irq_done;
+}
+
+uint32_t timer_ms_to_next_irq(const TimerState *ts)
+{
+    uint32_t next = irq_count_at(ts, ts->irq_last_us) + 1;
+    uint64_t at = ts->irq_base_us +
+                  (uint64_t)((double)(next - ts->irq_base) * 1e6 / ts->irq_rate_hz);
+    while (irq_count_at(ts, at) < next)
+        at++;
+    uint64_t ms = (at - ts->irq_last_us + 999) / 1000;
+    return ms ? (uint32_t)ms : 1;
+}
+
+void timer_port_write(TimerState *ts, uint16_t port, uint8_t value)
+{
     switch (port) {
     case 0x43: /* PIT command register */
         /* Parse command: bits 7-6 = channel, 5-4 = access mode, 3-1 = mode */
-        pit_latch = value;
-        pit_byte = 0;
+        ts->pit_command = value;
+        ts->pit_byte = 0;
         break;
 
     case 0x40: /* PIT channel 0 data */
-        if (pit_byte == 0) {
+        if (ts->pit_byte == 0) {
             ts->pit_reload = (ts->pit_reload & 0xFF00) | value;
-            pit_byte = 1;
+            ts->pit_byte = 1;
         } else {
             ts->pit_reload = (ts->pit_reload & 0x00FF) | ((uint16_t)value << 8);
-            pit_byte = 0;
+            ts->pit_byte = 0;
             /* Recalculate tick rate */
             uint32_t reload = ts->pit_reload ? ts->pit_reload : 65536;
             ts->tick_rate_hz = (double)PIT_FREQUENCY / reload;
@@ -11,7 +11,15 @@
 #include "recomp/cpu.h"
 #include "recomp/dos_compat.h"
 #include "platform/sdl_platform.h"
-
+#include "platform/headless.h"
+#include "recomp/log.h"
+#include "recomp/asset_cache.h"
+#include "recomp/snapshot.h"
+#include "recomp/override.h"
+#include "recomp/startup.h"
+#include "hal/gfx.h"
+
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,21 +31,33 @@
 /* Entry point provided by startup.c (replaces MSC crt0) */
 extern void res_02A310(CPU *cpu);
 
-/* Poll callback: pumps SDL events and renders the framebuffer.
- * Called from within game code when it blocks waiting for input. */
-static void game_poll_callback(void *platform_ctx, void *dos_state, const void *cpu)
+/* Poll callback: pumps SDL events and hands the framebuffer over.
+ * Called from kbhit, delay loops and periodic polls in drawing code,
+ * so it never sleeps; idle spinning is caught by dos_idle_poll. */
+static void game_poll_callback(void *platform_ctx, void *dos_state, void *cpu)
 {
     Platform *plat = (Platform *)platform_ctx;
     DosState *dos = (DosState *)dos_state;
-    const CPU *c = (const CPU *)cpu;
+    CPU *c = (CPU *)cpu;
 
     platform_poll_events(plat, dos);
     platform_render(plat, c, dos);
 
     /* Keep timer advancing during blocking I/O waits */
-    timer_update(&dos->timer, (uint64_t)clock() * 1000ULL / CLOCKS_PER_SEC);
+    timer_update(&dos->timer, timer_now_ms(&dos->timer));
+}
+
+/* Wait callback: used by dos_wait_input when the game blocks on a key.
+ * Hands over anything drawn so far, then sleeps in SDL until an event
+ * or the timeout (at most the next timer tick) instead of spinning. */
+static void game_wait_callback(void *platform_ctx, void *dos_state, void *cpu,
+                               uint32_t timeout_ms)
+{
+    Platform *plat = (Platform *)platform_ctx;
+    DosState *dos = (DosState *)dos_state;
 
-    platform_delay(1); /* Yield CPU to avoid 100% spin */
+    platform_render(plat, (CPU *)cpu, dos);
+    platform_wait_events(plat, dos, timeout_ms);
 }
 
 /*
@@ -126,14 +146,14 @@ static int load_exe_data(CPU *cpu, const char *exe_path)
     }
 
     /* Set up CPU registers as DOS would after loading */
-    cpu->cs = LOAD_SEG + init_cs;
+    set_sreg(cpu, SREG_CS, (uint16_t)(LOAD_SEG + init_cs));
     cpu->ip = init_ip;
-    cpu->ss = LOAD_SEG + init_ss;
+    set_sreg(cpu, SREG_SS, (uint16_t)(LOAD_SEG + init_ss));
     cpu->sp = init_sp;
 
     /* DS and ES point to PSP (LOAD_SEG - 0x10) as DOS convention */
-    cpu->ds = LOAD_SEG;
-    cpu->es = LOAD_SEG;
+    set_sreg(cpu, SREG_DS, LOAD_SEG);
+    set_sreg(cpu, SREG_ES, LOAD_SEG);
 
     /* Set up a minimal PSP at LOAD_SEG - 0x10 */
     uint16_t psp_seg = LOAD_SEG - 0x10;
@@ -154,6 +174,85 @@ static int load_exe_data(CPU *cpu, const char *exe_path)
     return 0;
 }
 
+/* ─── --instances ─── */
+
+typedef struct {
+    const char     *exe_path;
+    const char     *game_dir;
+    const Headless *script;     /* Template every instance copies */
+    int             turbo;
+    volatile long long calls;   /* Lifted calls, all instances */
+} Instances;
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static void add_calls(volatile long long *p, uint64_t n) { _InterlockedExchangeAdd64(p, (long long)n); }
+#else
+static void add_calls(volatile long long *p, uint64_t n) { __atomic_fetch_add(p, (long long)n, __ATOMIC_RELAXED); }
+#endif
+
+/* One complete game: its own CPU, arena, DOS layer and clock */
+static void run_instance(int index, void *arg)
+{
+    Instances *in = (Instances *)arg;
+    CPU cpu;
+    cpu_init(&cpu);
+    Headless *hl = (Headless *)malloc(sizeof(*hl));
+    if (!hl || cpu_alloc_mem(&cpu) < 0 || load_exe_data(&cpu, in->exe_path) < 0) {
+        fprintf(stderr, "[MAIN] Instance %d could not start\n", index + 1);
+        free(hl);
+        cpu_free(&cpu);
+        return;
+    }
+
+    DosState dos;
+    dos_init(&dos, &cpu, in->game_dir);
+    timer_set_turbo(&dos.timer, in->turbo);
+
+    jmp_buf stop;
+    memcpy(hl, in->script, sizeof(*hl));
+    hl->instance = index + 1;
+    hl->stop = &stop;
+    headless_start(hl, &cpu, &dos);
+
+    if (!setjmp(stop)) {
+        CIV_ENTRY_POINT(&cpu);
+        headless_report(hl, "game exited");
+    }
+
+    add_calls(&in->calls, cpu.calls);
+    dos_shutdown(&dos);
+    free(hl);
+    cpu_free(&cpu);
+}
+
+static int run_instances(int count, const char *exe_path, const char *game_dir,
+                         const char *bench_script, int turbo)
+{
+    static Headless script;
+    headless_init(&script);
+    if (bench_script && headless_load_script(&script, bench_script) < 0)
+        return 1;
+
+    recomp_dispatch_init(&civ_dispatch_table);
+    override_init(civ_overrides, civ_override_count);
+    startup_set_image(&civ_startup_image);
+    gfx_kernels_init();
+
+    Instances in = { exe_path, game_dir, &script, turbo, 0 };
+    printf("[MAIN] Starting %d instances...\n\n", count);
+    struct timespec t0, t1;
+    timespec_get(&t0, TIME_UTC);
+    int threads = headless_run_pool(count, 0, run_instance, &in);
+    timespec_get(&t1, TIME_UTC);
+
+    double wall = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("\n[BENCH] %d instances on %d thread(s): %.3f s wall, %llu lifted calls (%.1f M/s)\n",
+           count, threads, wall, (unsigned long long)in.calls,
+           wall > 0 ? (double)in.calls / wall / 1e6 : 0.0);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     printf("============================================================\n");
@@ -165,13 +264,51 @@ int main(int argc, char *argv[])
     /* Parse arguments */
     const char *game_dir = NULL;
     const char *exe_path = NULL;
+    const char *bench_script = NULL;
+    const char *snapshot_path = NULL;
     int scale = WINDOW_SCALE;
+    int renderer = RENDERER_SDL;
+    int headless = 0;
+    int turbo = 0;
+    int preload = 0;
+    int instances = 0;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
             scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "sdl") == 0) {
+                renderer = RENDERER_SDL;
+            } else if (strcmp(name, "gl") == 0) {
+                renderer = RENDERER_GL;
+            } else {
+                fprintf(stderr, "Error: unknown renderer '%s' (sdl, gl)\n", name);
+                return 1;
+            }
         } else if (strcmp(argv[i], "--gamedir") == 0 && i + 1 < argc) {
             game_dir = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_script = argv[++i];
+            headless = 1;
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instances = atoi(argv[++i]);
+            headless = 1;
+        } else if (strcmp(argv[i], "--turbo") == 0) {
+            turbo = 1;
+        } else if (strcmp(argv[i], "--preload-assets") == 0) {
+            preload = 1;
+        } else if (strcmp(argv[i], "--verify-overrides") == 0) {
+            override_verify = 1;
+        } else if (strcmp(argv[i], "--verify-image") == 0) {
+            startup_verify_image = 1;
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshot_path = argv[++i];
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            if (log_configure(argv[++i]) < 0)
+                return 1;
         } else if (!exe_path) {
             exe_path = argv[i];
         }
@@ -187,6 +324,26 @@ int main(int argc, char *argv[])
     printf("[MAIN] Game dir:  %s\n", game_dir);
     printf("[MAIN] Scale:     %dx\n\n", scale);
 
+    /* Game-side diagnostics go through the log ring from here on */
+    log_init();
+
+    /* Decode the .PIC files into the asset cache while the game starts */
+    if (preload)
+        asset_cache_preload(game_dir);
+
+    /* Several headless games side by side; no snapshots, no window */
+    if (instances > 0) {
+        if (override_verify) {
+            fprintf(stderr, "Error: --verify-overrides can't be combined with --instances\n");
+            return 1;
+        }
+#ifdef CIV_PROFILED
+        fprintf(stderr, "Error: a --profile build can't run --instances\n");
+        return 1;
+#endif
+        return run_instances(instances, exe_path, game_dir, bench_script, turbo);
+    }
+
     /* Initialize CPU */
     CPU cpu;
     cpu_init(&cpu);
@@ -202,18 +359,52 @@ int main(int argc, char *argv[])
     /* Initialize DOS compatibility layer */
     DosState dos;
     dos_init(&dos, &cpu, game_dir);
+    timer_set_turbo(&dos.timer, turbo);
+
+    /* Quick save file for Alt+F5 / Alt+F9, diffed against memory as loaded */
+    char snap_default[300];
+    snprintf(snap_default, sizeof(snap_default), "%s/QUICK.SNP", game_dir);
+    snapshot_init(&cpu, snapshot_path ? snapshot_path : snap_default);
 
-    /* Initialize SDL2 platform */
+    /* Initialize SDL2 platform, or the null backend when headless */
     Platform plat;
-    if (platform_init(&plat, scale) < 0) {
-        cpu_free(&cpu);
-        return 1;
+    static Headless hl;
+    jmp_buf stop;
+    if (headless) {
+        headless_init(&hl);
+        if (bench_script && headless_load_script(&hl, bench_script) < 0) {
+            cpu_free(&cpu);
+            return 1;
+        }
+        hl.stop = &stop;    /* A stop condition lands below, saves still open get written */
+        headless_start(&hl, &cpu, &dos);
+    } else {
+        if (platform_init(&plat, scale, renderer) < 0) {
+            cpu_free(&cpu);
+            return 1;
+        }
+
+        /* Hook the platform event loop into the DOS layer so blocking
+         * I/O calls (getch, kbhit, etc.) can pump SDL events. */
+        dos.poll_events = game_poll_callback;
+        dos.wait_events = game_wait_callback;
+        dos.platform_ctx = &plat;
+
+        /* AdLib / PC speaker output; without a device the game runs silent */
+        platform_open_audio(&plat, &dos.audio);
     }
 
-    /* Hook the platform event loop into the DOS layer so blocking
-     * I/O calls (getch, kbhit, etc.) can pump SDL events. */
-    dos.poll_events = game_poll_callback;
-    dos.platform_ctx = &plat;
+    /* Far function pointers (callbacks, handler tables) resolve here */
+    recomp_dispatch_init(&civ_dispatch_table);
+
+    /* Hand-written overrides, checked against the lifted code if asked */
+    override_init(civ_overrides, civ_override_count);
+
+    /* EXEPACK image unpacked at build time, for the entry point to use */
+    startup_set_image(&civ_startup_image);
+
+    /* Sprite / line row kernels for this CPU */
+    printf("[MAIN] GFX kernels: %s\n", gfx_kernels_init());
 
     printf("[MAIN] Starting game...\n\n");
 
@@ -256,7 +447,22 @@ int main(int argc, char *argv[])
      * TODO: Phase 4 - Add cooperative yielding so the game's internal
      * loops interleave with SDL event processing for proper rendering.
      */
-    CIV_ENTRY_POINT(&cpu);
+    int stopped = 0;
+    if (headless) {
+        if (setjmp(stop))
+            stopped = 1;
+    }
+    if (!stopped)
+        CIV_ENTRY_POINT(&cpu);
+    dos_close_all(&dos);    /* Write back saves the game left open */
+    override_report();
+
+    if (headless) {
+        if (hl.bench && !stopped)
+            headless_report(&hl, "game exited");
+        cpu_free(&cpu);
+        return 0;
+    }
 
     /* If the game returns without halting, run a post-game render loop */
     while (plat.running && !cpu.halted) {
@@ -0,0 +1,283 @@
+/*
+ * gl_renderer.c - OpenGL 3.3 render path (--renderer gl)
+ *
+ * One full-screen triangle, three textures:
+ *   index    320x200 R8     palette indices, uploaded per dirty scanline
+ *   palette  256x1   RGBA8  current DAC palette
+ *   text     WxH     RGBA8  CPU-rasterized text mode image
+ * and a fragment shader that either resolves index -> palette or shows
+ * the text image. All sampling is texelFetch/nearest, so the result is
+ * pixel-identical to the SDL renderer path.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "platform/gl_renderer.h"
+#include "hal/video.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+/* ─── Entry points ─── */
+
+#define GL_FUNCS(X) \
+    X(void,   Viewport,           (GLint, GLint, GLsizei, GLsizei)) \
+    X(void,   ClearColor,         (GLfloat, GLfloat, GLfloat, GLfloat)) \
+    X(void,   Clear,              (GLbitfield)) \
+    X(void,   PixelStorei,        (GLenum, GLint)) \
+    X(void,   GenTextures,        (GLsizei, GLuint *)) \
+    X(void,   DeleteTextures,     (GLsizei, const GLuint *)) \
+    X(void,   BindTexture,        (GLenum, GLuint)) \
+    X(void,   ActiveTexture,      (GLenum)) \
+    X(void,   TexParameteri,      (GLenum, GLenum, GLint)) \
+    X(void,   TexImage2D,         (GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void *)) \
+    X(void,   TexSubImage2D,      (GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void *)) \
+    X(GLuint, CreateShader,       (GLenum)) \
+    X(void,   ShaderSource,       (GLuint, GLsizei, const GLchar *const *, const GLint *)) \
+    X(void,   CompileShader,      (GLuint)) \
+    X(void,   GetShaderiv,        (GLuint, GLenum, GLint *)) \
+    X(void,   GetShaderInfoLog,   (GLuint, GLsizei, GLsizei *, GLchar *)) \
+    X(void,   DeleteShader,       (GLuint)) \
+    X(GLuint, CreateProgram,      (void)) \
+    X(void,   AttachShader,       (GLuint, GLuint)) \
+    X(void,   LinkProgram,        (GLuint)) \
+    X(void,   GetProgramiv,       (GLuint, GLenum, GLint *)) \
+    X(void,   GetProgramInfoLog,  (GLuint, GLsizei, GLsizei *, GLchar *)) \
+    X(void,   DeleteProgram,      (GLuint)) \
+    X(void,   UseProgram,         (GLuint)) \
+    X(GLint,  GetUniformLocation, (GLuint, const GLchar *)) \
+    X(void,   Uniform1i,          (GLint, GLint)) \
+    X(void,   GenVertexArrays,    (GLsizei, GLuint *)) \
+    X(void,   BindVertexArray,    (GLuint)) \
+    X(void,   DeleteVertexArrays, (GLsizei, const GLuint *)) \
+    X(void,   DrawArrays,         (GLenum, GLint, GLsizei))
+
+struct GlRenderer {
+    SDL_Window   *window;
+    SDL_GLContext ctx;
+
+    struct {
+#define X(ret, name, args) ret (APIENTRY *name) args;
+        GL_FUNCS(X)
+#undef X
+    } f;
+
+    GLuint prog, vao;
+    GLuint tex_index, tex_palette, tex_text;
+    GLint  u_text_mode;
+    int    text_w, text_h;
+};
+
+/* ─── Shaders ─── */
+
+static const char *vertex_src =
+    "#version 330 core\n"
+    "out vec2 uv;\n"
+    "void main() {\n"
+    "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "    uv = vec2(p.x, 1.0 - p.y);\n"              /* Row 0 at the top */
+    "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *fragment_src =
+    "#version 330 core\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "uniform sampler2D u_index;\n"
+    "uniform sampler2D u_palette;\n"
+    "uniform sampler2D u_text;\n"
+    "uniform int u_text_mode;\n"
+    "void main() {\n"
+    "    if (u_text_mode != 0) {\n"
+    "        ivec2 size = textureSize(u_text, 0);\n"
+    "        color = texelFetch(u_text, min(ivec2(uv * vec2(size)), size - 1), 0);\n"
+    "        return;\n"
+    "    }\n"
+    "    ivec2 p = min(ivec2(uv * vec2(320.0, 200.0)), ivec2(319, 199));\n"
+    "    int idx = int(texelFetch(u_index, p, 0).r * 255.0 + 0.5);\n"
+    "    color = texelFetch(u_palette, ivec2(idx, 0), 0);\n"
+    "}\n";
+
+static GLuint compile(GlRenderer *gl, GLenum type, const char *src)
+{
+    GLuint sh = gl->f.CreateShader(type);
+    GLint ok = 0;
+    gl->f.ShaderSource(sh, 1, &src, NULL);
+    gl->f.CompileShader(sh);
+    gl->f.GetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char msg[512];
+        gl->f.GetShaderInfoLog(sh, sizeof(msg), NULL, msg);
+        fprintf(stderr, "[GL] Shader compile failed: %s\n", msg);
+        gl->f.DeleteShader(sh);
+        return 0;
+    }
+    return sh;
+}
+
+static int build_program(GlRenderer *gl)
+{
+    GLuint vs = compile(gl, GL_VERTEX_SHADER, vertex_src);
+    GLuint fs = compile(gl, GL_FRAGMENT_SHADER, fragment_src);
+    if (!vs || !fs) {
+        if (vs) gl->f.DeleteShader(vs);
+        if (fs) gl->f.DeleteShader(fs);
+        return -1;
+    }
+
+    GLint ok = 0;
+    gl->prog = gl->f.CreateProgram();
+    gl->f.AttachShader(gl->prog, vs);
+    gl->f.AttachShader(gl->prog, fs);
+    gl->f.LinkProgram(gl->prog);
+    gl->f.DeleteShader(vs);
+    gl->f.DeleteShader(fs);
+    gl->f.GetProgramiv(gl->prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char msg[512];
+        gl->f.GetProgramInfoLog(gl->prog, sizeof(msg), NULL, msg);
+        fprintf(stderr, "[GL] Program link failed: %s\n", msg);
+        return -1;
+    }
+
+    gl->f.UseProgram(gl->prog);
+    gl->f.Uniform1i(gl->f.GetUniformLocation(gl->prog, "u_index"), 0);
+    gl->f.Uniform1i(gl->f.GetUniformLocation(gl->prog, "u_palette"), 1);
+    gl->f.Uniform1i(gl->f.GetUniformLocation(gl->prog, "u_text"), 2);
+    gl->u_text_mode = gl->f.GetUniformLocation(gl->prog, "u_text_mode");
+    return 0;
+}
+
+/* Texture on unit `unit`, nearest sampling, contents undefined */
+static GLuint make_texture(GlRenderer *gl, int unit, GLint internal, GLenum format, int w, int h)
+{
+    GLuint tex;
+    gl->f.GenTextures(1, &tex);
+    gl->f.ActiveTexture(GL_TEXTURE0 + unit);
+    gl->f.BindTexture(GL_TEXTURE_2D, tex);
+    gl->f.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    gl->f.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl->f.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->f.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl->f.TexImage2D(GL_TEXTURE_2D, 0, internal, w, h, 0, format, GL_UNSIGNED_BYTE, NULL);
+    return tex;
+}
+
+/* ─── Setup ─── */
+
+void gl_renderer_prepare(void)
+{
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+}
+
+GlRenderer *gl_renderer_create(void *window, int text_w, int text_h)
+{
+    GlRenderer *gl = calloc(1, sizeof(*gl));
+    if (!gl) return NULL;
+    gl->window = (SDL_Window *)window;
+    gl->text_w = text_w;
+    gl->text_h = text_h;
+
+    gl->ctx = SDL_GL_CreateContext(gl->window);
+    if (!gl->ctx) {
+        fprintf(stderr, "[GL] Context creation failed: %s\n", SDL_GetError());
+        free(gl);
+        return NULL;
+    }
+
+#define X(ret, name, args) \
+    gl->f.name = (ret (APIENTRY *) args)SDL_GL_GetProcAddress("gl" #name); \
+    if (!gl->f.name) { \
+        fprintf(stderr, "[GL] Missing entry point gl" #name "\n"); \
+        gl_renderer_destroy(gl); \
+        return NULL; \
+    }
+    GL_FUNCS(X)
+#undef X
+
+    if (build_program(gl) < 0) {
+        gl_renderer_destroy(gl);
+        return NULL;
+    }
+
+    gl->f.GenVertexArrays(1, &gl->vao);
+    gl->f.BindVertexArray(gl->vao);
+    gl->f.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    gl->tex_index   = make_texture(gl, 0, GL_R8, GL_RED, VGA_WIDTH, VGA_HEIGHT);
+    gl->tex_palette = make_texture(gl, 1, GL_RGBA8, GL_RGBA, 256, 1);
+    gl->tex_text    = make_texture(gl, 2, GL_RGBA8, GL_RGBA, text_w, text_h);
+
+    SDL_GL_SetSwapInterval(1);
+    return gl;
+}
+
+void gl_renderer_destroy(GlRenderer *gl)
+{
+    if (!gl) return;
+    if (gl->prog) gl->f.DeleteProgram(gl->prog);
+    if (gl->vao)  gl->f.DeleteVertexArrays(1, &gl->vao);
+    if (gl->tex_index) {
+        GLuint tex[3] = { gl->tex_index, gl->tex_palette, gl->tex_text };
+        gl->f.DeleteTextures(3, tex);
+    }
+    if (gl->ctx) SDL_GL_DeleteContext(gl->ctx);
+    free(gl);
+}
+
+/* ─── Uploads ─── */
+
+void gl_upload_indices(GlRenderer *gl, const uint8_t *fb, int y0, int y1)
+{
+    gl->f.ActiveTexture(GL_TEXTURE0);
+    gl->f.TexSubImage2D(GL_TEXTURE_2D, 0, 0, y0, VGA_WIDTH, y1 - y0,
+                        GL_RED, GL_UNSIGNED_BYTE, fb + y0 * VGA_WIDTH);
+}
+
+void gl_upload_palette(GlRenderer *gl, const uint32_t *rgba)
+{
+    gl->f.ActiveTexture(GL_TEXTURE1);
+    gl->f.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+}
+
+void gl_upload_text(GlRenderer *gl, const uint32_t *pixels, int y0, int y1)
+{
+    gl->f.ActiveTexture(GL_TEXTURE2);
+    gl->f.TexSubImage2D(GL_TEXTURE_2D, 0, 0, y0, gl->text_w, y1 - y0,
+                        GL_RGBA, GL_UNSIGNED_BYTE, pixels + y0 * gl->text_w);
+}
+
+/* ─── Present ─── */
+
+void gl_present(GlRenderer *gl, int text_mode)
+{
+    int dw, dh;
+    SDL_GL_GetDrawableSize(gl->window, &dw, &dh);
+
+    /* Aspect-preserving letterbox, as SDL_RenderSetLogicalSize does */
+    int lw = text_mode ? gl->text_w : VGA_WIDTH;
+    int lh = text_mode ? gl->text_h : VGA_HEIGHT;
+    float sx = (float)dw / (float)lw;
+    float sy = (float)dh / (float)lh;
+    float s = sx < sy ? sx : sy;
+    int vw = (int)((float)lw * s);
+    int vh = (int)((float)lh * s);
+    int vx = (dw - vw) / 2, vy = (dh - vh) / 2;
+
+    gl->f.Viewport(0, 0, dw, dh);
+    gl->f.ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    gl->f.Clear(GL_COLOR_BUFFER_BIT);
+    gl->f.Viewport(vx, vy, vw, vh);
+    gl->f.Uniform1i(gl->u_text_mode, text_mode);
+    gl->f.DrawArrays(GL_TRIANGLES, 0, 3);
+    SDL_GL_SwapWindow(gl->window);
+}
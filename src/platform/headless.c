@@ -0,0 +1,360 @@
+/*
+ * headless.c - Null platform backend and scripted benchmark runner
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L     /* sysconf */
+#endif
+
+#include "platform/headless.h"
+#include "hal/input.h"
+#include "hal/timer.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* Host stack of a pool thread; the game's call chains run on it */
+#define POOL_THREAD_STACK   (16u << 20)
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void headless_init(Headless *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->calls_per_ms = 1000;
+    h->poll_ms = 1;
+    h->end_ms = 600000;
+}
+
+/* ─── Script parsing ─── */
+
+static const struct { const char *name; uint8_t scan, ascii; } key_names[] = {
+    {"ENTER", 0x1C, 0x0D}, {"ESC", 0x01, 0x1B}, {"SPACE", 0x39, 0x20},
+    {"TAB", 0x0F, 0x09}, {"BKSP", 0x0E, 0x08},
+    {"UP", 0x48, 0}, {"DOWN", 0x50, 0}, {"LEFT", 0x4B, 0}, {"RIGHT", 0x4D, 0},
+    {"F1", 0x3B, 0}, {"F2", 0x3C, 0}, {"F3", 0x3D, 0}, {"F4", 0x3E, 0},
+    {"F5", 0x3F, 0}, {"F6", 0x40, 0}, {"F7", 0x41, 0}, {"F8", 0x42, 0},
+    {"F9", 0x43, 0}, {"F10", 0x44, 0},
+};
+
+/* Scancodes for the letter/digit rows of a US keyboard */
+static const char *scan_rows[] = { "1234567890", "qwertyuiop", "asdfghjkl", "zxcvbnm" };
+static const uint8_t scan_row_base[] = { 0x02, 0x10, 0x1E, 0x2C };
+
+static int parse_key(const char *spec, uint8_t *scan, uint8_t *ascii)
+{
+    for (size_t i = 0; i < sizeof(key_names) / sizeof(key_names[0]); i++) {
+        if (strcmp(spec, key_names[i].name) == 0) {
+            *scan = key_names[i].scan;
+            *ascii = key_names[i].ascii;
+            return 0;
+        }
+    }
+    if (spec[0] == '0' && (spec[1] == 'x' || spec[1] == 'X')) {
+        unsigned long v = strtoul(spec, NULL, 16);
+        *scan = (uint8_t)(v >> 8);
+        *ascii = (uint8_t)v;
+        return 0;
+    }
+    if (spec[0] && !spec[1]) {
+        char c = (char)tolower((unsigned char)spec[0]);
+        for (int r = 0; r < 4; r++) {
+            const char *p = strchr(scan_rows[r], c);
+            if (p) {
+                *scan = (uint8_t)(scan_row_base[r] + (p - scan_rows[r]));
+                *ascii = (uint8_t)spec[0];
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+int headless_load_script(Headless *h, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[BENCH] Cannot open script '%s'\n", path);
+        return -1;
+    }
+
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char cmd[16], a[64], b[64];
+        int n = sscanf(line, "%15s %63s %63s", cmd, a, b);
+        if (n <= 0) continue;
+
+        int ok = 1;
+        if (strcmp(cmd, "rate") == 0 && n == 2) {
+            h->calls_per_ms = (uint32_t)strtoul(a, NULL, 0);
+            ok = h->calls_per_ms > 0;
+        } else if (strcmp(cmd, "poll") == 0 && n == 2) {
+            h->poll_ms = (uint32_t)strtoul(a, NULL, 0);
+        } else if (strcmp(cmd, "end") == 0 && n == 2) {
+            h->end_ms = strtoull(a, NULL, 0);
+        } else if (strcmp(cmd, "turns") == 0 && n == 3) {
+            unsigned seg, off;
+            h->turn_limit = (uint32_t)strtoul(a, NULL, 0);
+            ok = sscanf(b, "%x:%x", &seg, &off) == 2;
+            h->turn_seg = (uint16_t)seg;
+            h->turn_off = (uint16_t)off;
+        } else if (strcmp(cmd, "key") == 0 && n == 3 && h->key_count < HEADLESS_MAX_EVENTS) {
+            BenchKey *k = &h->keys[h->key_count];
+            k->at_ms = strtoull(a, NULL, 0);
+            ok = parse_key(b, &k->scancode, &k->ascii) == 0 &&
+                 (h->key_count == 0 || k->at_ms >= h->keys[h->key_count - 1].at_ms);
+            if (ok) h->key_count++;
+        } else {
+            ok = 0;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "[BENCH] %s:%d: bad directive: %s\n", path, lineno, line);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+
+    h->bench = 1;
+    printf("[BENCH] Script %s: %d keys, %u calls/ms, end at %llu ms\n",
+           path, h->key_count, h->calls_per_ms, (unsigned long long)h->end_ms);
+    return 0;
+}
+
+/* ─── Virtual clock ─── */
+
+/* Each clock read also counts as a call, so a busy-wait loop that only
+ * polls the timer through hand-written code still sees time pass. */
+static uint64_t bench_clock(void *ctx)
+{
+    Headless *h = (Headless *)ctx;
+    uint64_t calls = (h->cpu ? h->cpu->calls : 0) + ++h->clock_reads;
+    return calls / h->calls_per_ms + h->polls * h->poll_ms;
+}
+
+/* ─── Null backend ─── */
+
+/* A stop condition was met: unwind to the run's stop point, or exit if it has none */
+static void headless_stop(Headless *h, const char *reason)
+{
+    headless_report(h, reason);
+    if (h->stop)
+        longjmp(*h->stop, 1);
+    exit(0);
+}
+
+/* Stand-in for platform_render: count frames whose contents changed */
+static void headless_render(Headless *h, const CPU *cpu)
+{
+    const uint8_t *vga = cpu->mem + VGA_FRAMEBUFFER;
+    const uint8_t *text = cpu->mem + HEADLESS_TEXT_BASE;
+    int changed = 0;
+    if (memcmp(h->last_vga, vga, VGA_FB_SIZE) != 0) {
+        memcpy(h->last_vga, vga, VGA_FB_SIZE);
+        changed = 1;
+    }
+    if (memcmp(h->last_text, text, HEADLESS_TEXT_SIZE) != 0) {
+        memcpy(h->last_text, text, HEADLESS_TEXT_SIZE);
+        changed = 1;
+    }
+    h->frames += changed;
+}
+
+static void headless_poll(void *platform_ctx, void *dos_state, void *cpu_ptr)
+{
+    Headless *h = (Headless *)platform_ctx;
+    DosState *dos = (DosState *)dos_state;
+    const CPU *cpu = (const CPU *)cpu_ptr;
+
+    h->polls++;
+    headless_render(h, cpu);
+
+    uint64_t now = timer_now_ms(&dos->timer);
+    timer_update(&dos->timer, now);
+    if (!h->bench)
+        return;
+
+    while (h->next_key < h->key_count && h->keys[h->next_key].at_ms <= now) {
+        keyboard_push(&dos->keyboard, h->keys[h->next_key].scancode,
+                      h->keys[h->next_key].ascii);
+        h->next_key++;
+    }
+
+    if (h->turn_limit) {
+        uint16_t turn = mem_read16((CPU *)cpu, h->turn_seg, h->turn_off);
+        if (turn != h->last_turn) {
+            h->last_turn = turn;
+            h->turns++;
+        }
+        if (h->turns >= h->turn_limit)
+            headless_stop(h, "turns");
+    }
+    if (now >= h->end_ms)
+        headless_stop(h, "end");
+}
+
+void headless_start(Headless *h, CPU *cpu, DosState *dos)
+{
+    h->cpu = cpu;
+    h->dos = dos;
+    h->wall_start_ns = wall_ns();
+    dos->poll_events = headless_poll;
+    dos->platform_ctx = h;
+    if (h->bench) {
+        timer_set_clock(&dos->timer, bench_clock, h);
+        if (h->turn_limit)
+            h->last_turn = mem_read16(cpu, h->turn_seg, h->turn_off);
+    }
+}
+
+void headless_report(const Headless *h, const char *reason)
+{
+    uint64_t wall = wall_ns() - h->wall_start_ns;
+    uint64_t calls = h->cpu ? h->cpu->calls : 0;
+
+    /* FNV-1a of the final screen, to spot nondeterminism between runs */
+    uint32_t fb_hash = 2166136261u;
+    for (int i = 0; i < VGA_FB_SIZE; i++)
+        fb_hash = (fb_hash ^ h->last_vga[i]) * 16777619u;
+
+    /* Built whole and written at once, so instances don't interleave */
+    char tag[16] = "";
+    if (h->instance)
+        snprintf(tag, sizeof(tag), " #%d", h->instance);
+    char out[1024];
+    snprintf(out, sizeof(out),
+             "\n[BENCH%s] stopped: %s\n"
+             "[BENCH%s] wall time:      %.3f s\n"
+             "[BENCH%s] lifted calls:   %llu (%.1f M/s)\n"
+             "[BENCH%s] frames:         %llu\n"
+             "[BENCH%s] polls:          %llu\n"
+             "[BENCH%s] virtual time:   %llu ms\n"
+             "[BENCH%s] turns:          %u\n"
+             "[BENCH%s] keys fed:       %d/%d\n"
+             "[BENCH%s] screen hash:    %08X\n",
+             tag, reason,
+             tag, (double)wall / 1e9,
+             tag, (unsigned long long)calls, wall ? (double)calls * 1e3 / (double)wall : 0.0,
+             tag, (unsigned long long)h->frames,
+             tag, (unsigned long long)h->polls,
+             tag, (unsigned long long)(h->bench && h->dos ? timer_now_ms(&h->dos->timer) : 0),
+             tag, h->turns,
+             tag, h->next_key, h->key_count,
+             tag, fb_hash);
+    fputs(out, stdout);
+    fflush(stdout);
+}
+
+/* ─── Instance pool ─── */
+
+typedef struct {
+    void        (*run)(int index, void *arg);
+    void         *arg;
+    int           count;
+    volatile long next;         /* Next index to hand out */
+} Pool;
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static int pool_take(Pool *p) { return (int)_InterlockedIncrement(&p->next) - 1; }
+#else
+static int pool_take(Pool *p) { return (int)__atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED); }
+#endif
+
+#ifdef _WIN32
+static unsigned __stdcall pool_worker(void *arg)
+#else
+static void *pool_worker(void *arg)
+#endif
+{
+    Pool *p = (Pool *)arg;
+    int i;
+    while ((i = pool_take(p)) < p->count)
+        p->run(i, p->arg);
+    return 0;
+}
+
+static int host_cores(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+int headless_run_pool(int count, int threads, void (*run)(int index, void *arg), void *arg)
+{
+    Pool pool = { run, arg, count, 0 };
+    if (threads <= 0)
+        threads = host_cores();
+    if (threads > count)
+        threads = count;
+
+    /* The calling thread works too; the rest are started here */
+#ifdef _WIN32
+    HANDLE *tids = (HANDLE *)calloc(threads > 1 ? threads : 1, sizeof(*tids));
+#else
+    pthread_t *tids = (pthread_t *)calloc(threads > 1 ? threads : 1, sizeof(*tids));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, POOL_THREAD_STACK);
+#endif
+    int started = 0;
+    for (int t = 1; tids && t < threads; t++) {
+#ifdef _WIN32
+        tids[started] = (HANDLE)_beginthreadex(NULL, POOL_THREAD_STACK, pool_worker, &pool, 0, NULL);
+        if (!tids[started])
+            break;
+#else
+        if (pthread_create(&tids[started], &attr, pool_worker, &pool) != 0)
+            break;
+#endif
+        started++;
+    }
+    if (started + 1 < threads)
+        fprintf(stderr, "[BENCH] Started %d of %d pool threads\n", started + 1, threads);
+
+    pool_worker(&pool);
+    for (int t = 0; t < started; t++) {
+#ifdef _WIN32
+        WaitForSingleObject(tids[t], INFINITE);
+        CloseHandle(tids[t]);
+#else
+        pthread_join(tids[t], NULL);
+#endif
+    }
+#ifndef _WIN32
+    pthread_attr_destroy(&attr);
+#endif
+    free(tids);
+    return started + 1;
+}
@@ -0,0 +1,197 @@
+/*
+ * pixel_kernels.c - Palette and glyph expansion kernels
+ *
+ * The x86 variants are compiled with per-function target attributes
+ * (GCC/Clang) so the rest of the build keeps its baseline ISA; they are
+ * only called after CPUID (and XGETBV for the AVX state) says they run.
+ * Without a gather instruction a palette lookup is one load per pixel
+ * anyway, so below AVX2 the gain comes from the glyph kernels.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "platform/pixel_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PX_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PX_TARGET(isa)
+#else
+#include <cpuid.h>
+#define PX_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define PX_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* ─── Scalar ─── */
+
+static void pal8_scalar(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = pal[src[i]];
+}
+
+static void glyph8_scalar(uint32_t *dst, int pitch, const uint8_t *rows, int h,
+                          uint32_t fg, uint32_t bg)
+{
+    for (int y = 0; y < h; y++, dst += pitch) {
+        uint8_t bits = rows[y];
+        for (int x = 0; x < 8; x++)
+            dst[x] = (bits & (0x80 >> x)) ? fg : bg;
+    }
+}
+
+px_pal8_fn   px_pal8   = pal8_scalar;
+px_glyph8_fn px_glyph8 = glyph8_scalar;
+
+/* ─── x86: SSE4.1 / AVX2 ─── */
+
+#ifdef PX_X86
+
+PX_TARGET("sse4.1")
+static void pal8_sse41(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_setr_epi32((int)pal[src[i]], (int)pal[src[i + 1]],
+                                   (int)pal[src[i + 2]], (int)pal[src[i + 3]]);
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    for (; i < n; i++)
+        dst[i] = pal[src[i]];
+}
+
+PX_TARGET("sse4.1")
+static void glyph8_sse41(uint32_t *dst, int pitch, const uint8_t *rows, int h,
+                         uint32_t fg, uint32_t bg)
+{
+    const __m128i lo = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+    const __m128i hi = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+    const __m128i vf = _mm_set1_epi32((int)fg);
+    const __m128i vb = _mm_set1_epi32((int)bg);
+    for (int y = 0; y < h; y++, dst += pitch) {
+        __m128i bits = _mm_set1_epi32(rows[y]);
+        __m128i m0 = _mm_cmpeq_epi32(_mm_and_si128(bits, lo), lo);
+        __m128i m1 = _mm_cmpeq_epi32(_mm_and_si128(bits, hi), hi);
+        _mm_storeu_si128((__m128i *)dst,       _mm_blendv_epi8(vb, vf, m0));
+        _mm_storeu_si128((__m128i *)(dst + 4), _mm_blendv_epi8(vb, vf, m1));
+    }
+}
+
+PX_TARGET("avx2")
+static void pal8_avx2(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+        __m256i v = _mm256_i32gather_epi32((const int *)pal, idx, 4);
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    for (; i < n; i++)
+        dst[i] = pal[src[i]];
+}
+
+PX_TARGET("avx2")
+static void glyph8_avx2(uint32_t *dst, int pitch, const uint8_t *rows, int h,
+                        uint32_t fg, uint32_t bg)
+{
+    const __m256i mask = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m256i vf = _mm256_set1_epi32((int)fg);
+    const __m256i vb = _mm256_set1_epi32((int)bg);
+    for (int y = 0; y < h; y++, dst += pitch) {
+        __m256i bits = _mm256_set1_epi32(rows[y]);
+        __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(bits, mask), mask);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_blendv_epi8(vb, vf, m));
+    }
+}
+
+static void cpuid(uint32_t leaf, uint32_t sub, uint32_t r[4])
+{
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, (int)leaf, (int)sub);
+    for (int i = 0; i < 4; i++) r[i] = (uint32_t)regs[i];
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+/* OS has enabled saving of the SSE and AVX register state (XCR0 bits 1-2) */
+static int os_saves_avx(void)
+{
+#if defined(_MSC_VER)
+    return (_xgetbv(0) & 6) == 6;
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    (void)hi;
+    return (lo & 6) == 6;
+#endif
+}
+
+#endif /* PX_X86 */
+
+/* ─── ARM: NEON ─── */
+
+#ifdef PX_NEON
+
+static void glyph8_neon(uint32_t *dst, int pitch, const uint8_t *rows, int h,
+                        uint32_t fg, uint32_t bg)
+{
+    static const uint32_t lo_bits[4] = { 0x80, 0x40, 0x20, 0x10 };
+    static const uint32_t hi_bits[4] = { 0x08, 0x04, 0x02, 0x01 };
+    const uint32x4_t lo = vld1q_u32(lo_bits);
+    const uint32x4_t hi = vld1q_u32(hi_bits);
+    const uint32x4_t vf = vdupq_n_u32(fg);
+    const uint32x4_t vb = vdupq_n_u32(bg);
+    for (int y = 0; y < h; y++, dst += pitch) {
+        uint32x4_t bits = vdupq_n_u32(rows[y]);
+        vst1q_u32(dst,     vbslq_u32(vtstq_u32(bits, lo), vf, vb));
+        vst1q_u32(dst + 4, vbslq_u32(vtstq_u32(bits, hi), vf, vb));
+    }
+}
+
+#endif /* PX_NEON */
+
+/* ─── Selection ─── */
+
+const char *pixel_kernels_init(void)
+{
+#ifdef PX_X86
+    uint32_t r[4];
+    cpuid(0, 0, r);
+    uint32_t max_leaf = r[0];
+
+    cpuid(1, 0, r);
+    int sse41   = (r[2] >> 19) & 1;
+    int osxsave = (r[2] >> 27) & 1;
+    int avx     = (r[2] >> 28) & 1;
+    int avx2 = 0;
+    if (max_leaf >= 7 && avx && osxsave && os_saves_avx()) {
+        cpuid(7, 0, r);
+        avx2 = (r[1] >> 5) & 1;
+    }
+
+    if (avx2) {
+        px_pal8 = pal8_avx2;
+        px_glyph8 = glyph8_avx2;
+        return "avx2";
+    }
+    if (sse41) {
+        px_pal8 = pal8_sse41;
+        px_glyph8 = glyph8_sse41;
+        return "sse4.1";
+    }
+#elif defined(PX_NEON)
+    /* Compiled for a NEON target, so it is always present */
+    px_glyph8 = glyph8_neon;
+    return "neon";
+#endif
+    px_pal8 = pal8_scalar;
+    px_glyph8 = glyph8_scalar;
+    return "scalar";
+}
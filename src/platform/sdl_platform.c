@@ -5,48 +5,84 @@
  * SDL events for keyboard/mouse input, and renders the VGA output
  * with proper palette conversion.
  *
+ * Rendering runs on its own thread. The game thread only snapshots the
+ * screen (changed framebuffer rows, text buffer, palette) into one of
+ * three slots and hands it over; the render thread converts, uploads
+ * and presents the newest one. A vsync wait therefore stalls only the
+ * render thread, never the recompiled code. Window and events stay on
+ * the game (main) thread. Audio is synthesized in SDL's audio callback
+ * from the events the game queued (hal/audio.h).
+ *
  * Part of the Civ Recomp project (sp00nznet/civ)
  */
 
 #include "platform/sdl_platform.h"
-#include "font8x8.h"
+#include "platform/gl_renderer.h"
+#include "platform/pixel_kernels.h"
+#include "platform/text_mode.h"
+#include "recomp/snapshot.h"
 
 #include <SDL2/SDL.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* Text mode constants */
 #define TEXT_MODE_BASE  0xB8000
-#define TEXT_COLS       80
-#define TEXT_ROWS       25
 #define CHAR_W          4   /* pixels per character width  (80*4 = 320) */
-#define CHAR_H          8   /* pixels per character height (25*8 = 200) */
 
-int platform_init(Platform *plat, int scale)
+/* ─── Frame handoff ─── */
+
+#define SNAP_SLOTS      3
+#define SNAP_FRESH      0x100   /* Set in 'ready' until the render thread takes it */
+
+typedef struct {
+    uint8_t  vga[VGA_FB_LEN];
+    uint8_t  text[TEXT_BYTES];
+    uint32_t palette[256];
+    uint32_t dirty[VGA_DIRTY_WORDS];    /* Rows changed since the last frame handed over */
+    int      palette_changed;
+    int      is_gfx;
+} FrameSnapshot;
+
+/* Triple buffer: the game thread fills 'back', then swaps it with
+ * 'ready'; the render thread swaps 'ready' with its 'front' whenever a
+ * fresh one is there. Neither side waits for the other. */
+typedef struct {
+    FrameSnapshot slot[SNAP_SLOTS];
+    SDL_atomic_t  ready;
+    SDL_atomic_t  redraw;               /* Window exposed/resized: present even if clean */
+    SDL_atomic_t  quit;
+    SDL_mutex    *lock;
+    SDL_cond     *wake;
+    SDL_Thread   *thread;
+    int           renderer_kind;
+    int           init_result;          /* 1 while the render thread starts up */
+
+    /* Game thread only */
+    int      back;
+    uint32_t stale[SNAP_SLOTS][VGA_DIRTY_WORDS];    /* Rows each slot is behind on */
+    uint32_t carry[VGA_DIRTY_WORDS];    /* Changes of frames the renderer skipped */
+    int      carry_palette;
+    int      is_gfx;                    /* Mode of the last frame handed over, -1 = none */
+    uint8_t  text_seen[TEXT_BYTES];
+
+    /* Render thread only */
+    int      front;
+} PresentQueue;
+
+static void wake_renderer(PresentQueue *q)
 {
-    memset(plat, 0, sizeof(*plat));
-    plat->scale = scale > 0 ? scale : WINDOW_SCALE;
-    plat->running = 1;
-
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0) {
-        fprintf(stderr, "[SDL] Init failed: %s\n", SDL_GetError());
-        return -1;
-    }
-
-    int w = VGA_WIDTH * plat->scale;
-    int h = VGA_HEIGHT * plat->scale;
+    SDL_LockMutex(q->lock);
+    SDL_CondBroadcast(q->wake);
+    SDL_UnlockMutex(q->lock);
+}
 
-    SDL_Window *win = SDL_CreateWindow(
-        "Sid Meier's Civilization - Recomp",
-        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        w, h,
-        SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
-    if (!win) {
-        fprintf(stderr, "[SDL] Window creation failed: %s\n", SDL_GetError());
-        return -1;
-    }
-    plat->window = win;
+/* ─── Render thread: setup ─── */
 
+/* SDL_Renderer path: renderer plus streaming VGA and text textures */
+static int init_sdl_renderer(Platform *plat, SDL_Window *win)
+{
     SDL_Renderer *ren = SDL_CreateRenderer(win, -1,
         SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!ren) {
@@ -74,20 +110,314 @@ int platform_init(Platform *plat, int scale)
         return -1;
     }
     plat->tex_text = tex_text;
+    return 0;
+}
+
+/* Renderer objects belong to the thread that created them */
+static int init_renderer(Platform *plat, int kind)
+{
+    SDL_Window *win = (SDL_Window *)plat->window;
+    if (kind == RENDERER_GL) {
+        plat->gl = gl_renderer_create(win, TEXT_COLS * 8, TEXT_ROWS * CHAR_H);
+        if (plat->gl)
+            return 0;
+        fprintf(stderr, "[SDL] Falling back to the SDL renderer\n");
+    }
+    return init_sdl_renderer(plat, win);
+}
+
+static void destroy_renderer(Platform *plat)
+{
+    if (plat->tex_vga)  SDL_DestroyTexture((SDL_Texture *)plat->tex_vga);
+    if (plat->tex_text) SDL_DestroyTexture((SDL_Texture *)plat->tex_text);
+    if (plat->renderer) SDL_DestroyRenderer((SDL_Renderer *)plat->renderer);
+    gl_renderer_destroy(plat->gl);
+    plat->tex_vga = plat->tex_text = plat->renderer = plat->gl = NULL;
+}
+
+/* ─── Render thread: drawing ─── */
+
+/* Render text mode (80x25 chars) into 640x200 pixels and upload the
+ * text rows that changed since the last call (all of them if full) to
+ * whichever renderer is active. Returns 0 if nothing changed. */
+static int render_text_mode(Platform *plat, const uint8_t *textbuf, int full)
+{
+    int pitch = TEXT_PITCH;
+    int first, last;
+
+    if (!text_mode_render(plat->text_pixels, plat->last_text, textbuf, full, &first, &last))
+        return 0;
+    if (plat->gl) {
+        gl_upload_text(plat->gl, plat->text_pixels, first * CHAR_H, (last + 1) * CHAR_H);
+        return 1;
+    }
+    SDL_Rect rect = { 0, first * CHAR_H, pitch, (last - first + 1) * CHAR_H };
+    SDL_UpdateTexture((SDL_Texture *)plat->tex_text, &rect,
+                      plat->text_pixels + first * CHAR_H * pitch, pitch * (int)sizeof(uint32_t));
+    return 1;
+}
+
+/* Convert scanlines [y0, y1) of the mode 13h framebuffer and upload them.
+ * The GL path takes the indices as they are and resolves them on the GPU. */
+static void upload_rows(Platform *plat, const uint8_t *fb, const uint32_t *rgba, int y0, int y1)
+{
+    if (plat->gl) {
+        gl_upload_indices(plat->gl, fb, y0, y1);
+        return;
+    }
+
+    /* The rows are contiguous in both buffers: one kernel call */
+    px_pal8(plat->stage + y0 * VGA_WIDTH, fb + y0 * VGA_WIDTH, rgba, (y1 - y0) * VGA_WIDTH);
+
+    SDL_Rect rect = { 0, y0, VGA_WIDTH, y1 - y0 };
+    SDL_UpdateTexture((SDL_Texture *)plat->tex_vga, &rect,
+                      plat->stage + y0 * VGA_WIDTH, VGA_WIDTH * (int)sizeof(uint32_t));
+}
+
+/* Upload what changed in a snapshot and present it. With fresh = 0 the
+ * textures are up to date and the frame is only presented again. */
+static void draw_frame(Platform *plat, const FrameSnapshot *snap, int fresh)
+{
+    SDL_Renderer *ren = (SDL_Renderer *)plat->renderer;
+    int is_gfx = snap->is_gfx;
+
+    /* Switch logical size when mode changes; the new texture is
+     * rebuilt from scratch */
+    int mode_id = is_gfx ? 1 : 0;
+    int full = 0;
+    if (mode_id != plat->last_mode) {
+        plat->last_mode = mode_id;
+        full = 1;
+        if (ren && is_gfx) {
+            SDL_RenderSetLogicalSize(ren, VGA_WIDTH, VGA_HEIGHT);
+        } else if (ren) {
+            SDL_RenderSetLogicalSize(ren, TEXT_COLS * 8, TEXT_ROWS * CHAR_H);
+        }
+    }
+
+    SDL_Texture *tex;
+    if (!fresh) {
+        tex = (SDL_Texture *)(is_gfx ? plat->tex_vga : plat->tex_text);
+    } else if (is_gfx) {
+        /* Mode 13h: 320x200x256 VGA. A palette change recolours every
+         * row on the CPU path; on the GPU it is just the palette texture. */
+        tex = (SDL_Texture *)plat->tex_vga;
+        if (snap->palette_changed || full) {
+            if (plat->gl)
+                gl_upload_palette(plat->gl, snap->palette);
+            else
+                full = 1;
+        }
+
+        /* Upload each run of consecutive dirty rows with one call */
+        for (int y = 0; y < VGA_HEIGHT; ) {
+            if (!full && !(snap->dirty[y >> 5] & (1u << (y & 31)))) {
+                y++;
+                continue;
+            }
+            int y0 = y;
+            while (y < VGA_HEIGHT && (full || (snap->dirty[y >> 5] & (1u << (y & 31)))))
+                y++;
+            upload_rows(plat, snap->vga, snap->palette, y0, y);
+        }
+    } else {
+        /* Text mode (mode 3 or default) */
+        tex = (SDL_Texture *)plat->tex_text;
+        render_text_mode(plat, snap->text, full);
+    }
+
+    if (plat->gl) {
+        gl_present(plat->gl, !is_gfx);
+        return;
+    }
+    SDL_RenderClear(ren);
+    SDL_RenderCopy(ren, tex, NULL, NULL);
+    SDL_RenderPresent(ren);
+}
+
+static int render_thread(void *arg)
+{
+    Platform *plat = (Platform *)arg;
+    PresentQueue *q = (PresentQueue *)plat->present;
+
+    int rc = init_renderer(plat, q->renderer_kind);
+    SDL_LockMutex(q->lock);
+    q->init_result = rc;
+    SDL_CondBroadcast(q->wake);
+    SDL_UnlockMutex(q->lock);
+    if (rc < 0) {
+        destroy_renderer(plat);
+        return -1;
+    }
+
+    int have_frame = 0;
+    while (!SDL_AtomicGet(&q->quit)) {
+        SDL_LockMutex(q->lock);
+        while (!(SDL_AtomicGet(&q->ready) & SNAP_FRESH) && !SDL_AtomicGet(&q->redraw) &&
+               !SDL_AtomicGet(&q->quit))
+            SDL_CondWaitTimeout(q->wake, q->lock, 100);
+        SDL_UnlockMutex(q->lock);
+        if (SDL_AtomicGet(&q->quit))
+            break;
+
+        int fresh = 0;
+        int cur = SDL_AtomicGet(&q->ready);
+        if ((cur & SNAP_FRESH) && SDL_AtomicCAS(&q->ready, cur, q->front)) {
+            q->front = cur & ~SNAP_FRESH;
+            fresh = have_frame = 1;
+        }
+        int redraw = SDL_AtomicSet(&q->redraw, 0);
+        if (have_frame && (fresh || redraw))
+            draw_frame(plat, &q->slot[q->front], fresh);
+    }
+
+    destroy_renderer(plat);
+    return 0;
+}
+
+/* ─── Init / shutdown ─── */
+
+int platform_init(Platform *plat, int scale, int renderer)
+{
+    memset(plat, 0, sizeof(*plat));
+    plat->scale = scale > 0 ? scale : WINDOW_SCALE;
+    plat->running = 1;
+
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0) {
+        fprintf(stderr, "[SDL] Init failed: %s\n", SDL_GetError());
+        return -1;
+    }
+
+    int w = VGA_WIDTH * plat->scale;
+    int h = VGA_HEIGHT * plat->scale;
+
+    uint32_t flags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE;
+    if (renderer == RENDERER_GL) {
+        gl_renderer_prepare();
+        flags |= SDL_WINDOW_OPENGL;
+    }
+
+    SDL_Window *win = SDL_CreateWindow(
+        "Sid Meier's Civilization - Recomp",
+        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        w, h, flags);
+    if (!win) {
+        fprintf(stderr, "[SDL] Window creation failed: %s\n", SDL_GetError());
+        return -1;
+    }
+    plat->window = win;
+
+    PresentQueue *q = calloc(1, sizeof(PresentQueue));
+    plat->stage = malloc(VGA_WIDTH * VGA_HEIGHT * sizeof(uint32_t));
+    plat->text_pixels = malloc(TEXT_COLS * 8 * TEXT_ROWS * CHAR_H * sizeof(uint32_t));
+    if (!q || !plat->stage || !plat->text_pixels) {
+        fprintf(stderr, "[SDL] Out of memory\n");
+        free(q);
+        return -1;
+    }
+    plat->present = q;
     plat->last_mode = -1;
 
+    /* Every slot starts out missing every row */
+    memset(q->stale, 0xFF, sizeof(q->stale));
+    memset(q->carry, 0xFF, sizeof(q->carry));
+    q->carry_palette = 1;
+    q->is_gfx = -1;
+    q->back = 0;
+    SDL_AtomicSet(&q->ready, 1);
+    q->front = 2;
+    q->renderer_kind = renderer;
+    q->init_result = 1;
+    q->lock = SDL_CreateMutex();
+    q->wake = SDL_CreateCond();
+    if (!q->lock || !q->wake) {
+        fprintf(stderr, "[SDL] Mutex creation failed: %s\n", SDL_GetError());
+        return -1;
+    }
+
+    q->thread = SDL_CreateThread(render_thread, "civ-render", plat);
+    if (!q->thread) {
+        fprintf(stderr, "[SDL] Render thread creation failed: %s\n", SDL_GetError());
+        return -1;
+    }
+    SDL_LockMutex(q->lock);
+    while (q->init_result == 1)
+        SDL_CondWait(q->wake, q->lock);
+    SDL_UnlockMutex(q->lock);
+    if (q->init_result < 0) {
+        SDL_WaitThread(q->thread, NULL);
+        q->thread = NULL;
+        return -1;
+    }
+
     SDL_ShowCursor(SDL_DISABLE);
 
-    printf("[SDL] Initialized: %dx%d (scale %dx)\n", w, h, plat->scale);
+    printf("[SDL] Initialized: %dx%d (scale %dx), %s renderer, %s pixel kernels\n",
+           w, h, plat->scale, plat->gl ? "gl" : "sdl", pixel_kernels_init());
+    return 0;
+}
+
+/* ─── Audio ─── */
+
+static void SDLCALL audio_callback(void *userdata, Uint8 *stream, int len)
+{
+    audio_render((AudioState *)userdata, (int16_t *)stream, len / (int)sizeof(int16_t));
+}
+
+int platform_open_audio(Platform *plat, AudioState *audio)
+{
+    SDL_AudioSpec want, have;
+    SDL_zero(want);
+    want.freq = 48000;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = audio_callback;
+    want.userdata = audio;
+
+    SDL_AudioDeviceID dev = SDL_OpenAudioDevice(NULL, 0, &want, &have,
+                                                SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (dev == 0) {
+        fprintf(stderr, "[SDL] No audio device: %s\n", SDL_GetError());
+        return -1;
+    }
+    if (audio_open(audio, have.freq) < 0) {
+        fprintf(stderr, "[SDL] Out of memory for the synthesizer\n");
+        SDL_CloseAudioDevice(dev);
+        return -1;
+    }
+    plat->audio_dev = dev;
+    plat->audio = audio;
+    SDL_PauseAudioDevice(dev, 0);
+
+    printf("[SDL] Audio: %d Hz, %d-sample buffer, %s synthesis\n",
+           have.freq, have.samples, audio_kernels());
     return 0;
 }
 
 void platform_shutdown(Platform *plat)
 {
-    if (plat->tex_vga)  SDL_DestroyTexture((SDL_Texture *)plat->tex_vga);
-    if (plat->tex_text) SDL_DestroyTexture((SDL_Texture *)plat->tex_text);
-    if (plat->renderer) SDL_DestroyRenderer((SDL_Renderer *)plat->renderer);
+    if (plat->audio_dev) {
+        SDL_CloseAudioDevice(plat->audio_dev);
+        audio_close(plat->audio);
+        plat->audio_dev = 0;
+    }
+
+    PresentQueue *q = (PresentQueue *)plat->present;
+    if (q) {
+        if (q->thread) {
+            SDL_AtomicSet(&q->quit, 1);
+            wake_renderer(q);
+            SDL_WaitThread(q->thread, NULL);
+        }
+        if (q->wake) SDL_DestroyCond(q->wake);
+        if (q->lock) SDL_DestroyMutex(q->lock);
+        free(q);
+        plat->present = NULL;
+    }
     if (plat->window)   SDL_DestroyWindow((SDL_Window *)plat->window);
+    free(plat->stage);
+    free(plat->text_pixels);
     SDL_Quit();
     printf("[SDL] Shutdown complete\n");
 }
@@ -137,149 +467,200 @@ static uint8_t sdl_to_dos_scancode(SDL_Scancode sc)
     return 0;
 }
 
-void platform_poll_events(Platform *plat, DosState *dos)
+/* Window coordinates to the logical resolution of the mode on screen,
+ * matching the letterbox the renderers draw */
+static void window_to_logical(Platform *plat, int wx, int wy, float *lx, float *ly)
 {
-    SDL_Event e;
-    while (SDL_PollEvent(&e)) {
-        switch (e.type) {
-        case SDL_QUIT:
-            plat->running = 0;
-            break;
-
-        case SDL_KEYDOWN: {
-            if (e.key.repeat) break;
+    PresentQueue *q = (PresentQueue *)plat->present;
+    int text = q->is_gfx == 0;
+    float lw = (float)(text ? TEXT_COLS * 8 : VGA_WIDTH);
+    float lh = (float)(text ? TEXT_ROWS * CHAR_H : VGA_HEIGHT);
+    int ww, wh;
+    SDL_GetWindowSize((SDL_Window *)plat->window, &ww, &wh);
+    float s = (float)ww / lw < (float)wh / lh ? (float)ww / lw : (float)wh / lh;
+    if (s <= 0.0f) {
+        *lx = (float)wx;
+        *ly = (float)wy;
+        return;
+    }
+    *lx = ((float)wx - ((float)ww - lw * s) / 2.0f) / s;
+    *ly = ((float)wy - ((float)wh - lh * s) / 2.0f) / s;
+}
 
-            /* Alt+Enter = toggle fullscreen */
-            if (e.key.keysym.sym == SDLK_RETURN &&
-                (e.key.keysym.mod & KMOD_ALT)) {
-                plat->fullscreen = !plat->fullscreen;
-                SDL_SetWindowFullscreen((SDL_Window *)plat->window,
-                    plat->fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
-                break;
-            }
+static void request_redraw(Platform *plat)
+{
+    PresentQueue *q = (PresentQueue *)plat->present;
+    SDL_AtomicSet(&q->redraw, 1);
+    wake_renderer(q);
+}
 
-            uint8_t sc = sdl_to_dos_scancode(e.key.keysym.scancode);
-            uint8_t ascii = 0;
-            if (e.key.keysym.sym >= 32 && e.key.keysym.sym < 127)
-                ascii = (uint8_t)e.key.keysym.sym;
-            else if (e.key.keysym.sym == SDLK_RETURN)
-                ascii = 13;
-            else if (e.key.keysym.sym == SDLK_ESCAPE)
-                ascii = 27;
-            else if (e.key.keysym.sym == SDLK_BACKSPACE)
-                ascii = 8;
-
-            if (sc || ascii)
-                keyboard_push(&dos->keyboard, sc, ascii);
+static void handle_event(Platform *plat, DosState *dos, const SDL_Event *e)
+{
+    switch (e->type) {
+    case SDL_QUIT:
+        plat->running = 0;
+        break;
+
+    case SDL_WINDOWEVENT:
+        /* The window contents are gone; present the texture again */
+        if (e->window.event == SDL_WINDOWEVENT_EXPOSED ||
+            e->window.event == SDL_WINDOWEVENT_SIZE_CHANGED ||
+            e->window.event == SDL_WINDOWEVENT_RESTORED)
+            request_redraw(plat);
+        break;
+
+    case SDL_KEYDOWN: {
+        if (e->key.repeat) break;
+
+        /* Alt+Enter = toggle fullscreen */
+        if (e->key.keysym.sym == SDLK_RETURN &&
+            (e->key.keysym.mod & KMOD_ALT)) {
+            plat->fullscreen = !plat->fullscreen;
+            SDL_SetWindowFullscreen((SDL_Window *)plat->window,
+                plat->fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
+            request_redraw(plat);
             break;
         }
 
-        case SDL_MOUSEMOTION: {
-            float fx, fy;
-            SDL_RenderWindowToLogical((SDL_Renderer *)plat->renderer,
-                e.motion.x, e.motion.y, &fx, &fy);
-            mouse_update(&dos->mouse, (int)fx, (int)fy, dos->mouse.buttons);
+        /* Alt+T = toggle turbo (skip time the game spends waiting) */
+        if (e->key.keysym.sym == SDLK_t &&
+            (e->key.keysym.mod & KMOD_ALT)) {
+            timer_set_turbo(&dos->timer, !dos->timer.turbo);
+            fprintf(stderr, "[SDL] Turbo %s\n", dos->timer.turbo ? "on" : "off");
             break;
         }
 
-        case SDL_MOUSEBUTTONDOWN:
-        case SDL_MOUSEBUTTONUP: {
-            uint16_t btn = dos->mouse.buttons;
-            uint16_t mask = 0;
-            if (e.button.button == SDL_BUTTON_LEFT)   mask = 0x01;
-            if (e.button.button == SDL_BUTTON_RIGHT)  mask = 0x02;
-            if (e.button.button == SDL_BUTTON_MIDDLE) mask = 0x04;
-            if (e.type == SDL_MOUSEBUTTONDOWN)
-                btn |= mask;
-            else
-                btn &= ~mask;
-            dos->mouse.buttons = btn;
+        /* Alt+F5 / Alt+F9 = quick save / restore the whole machine */
+        if ((e->key.keysym.sym == SDLK_F5 || e->key.keysym.sym == SDLK_F9) &&
+            (e->key.keysym.mod & KMOD_ALT)) {
+            dos->snapshot_request = e->key.keysym.sym == SDLK_F5 ? SNAPSHOT_SAVE
+                                                                 : SNAPSHOT_RESTORE;
             break;
         }
-        }
+
+        uint8_t sc = sdl_to_dos_scancode(e->key.keysym.scancode);
+        uint8_t ascii = 0;
+        if (e->key.keysym.sym >= 32 && e->key.keysym.sym < 127)
+            ascii = (uint8_t)e->key.keysym.sym;
+        else if (e->key.keysym.sym == SDLK_RETURN)
+            ascii = 13;
+        else if (e->key.keysym.sym == SDLK_ESCAPE)
+            ascii = 27;
+        else if (e->key.keysym.sym == SDLK_BACKSPACE)
+            ascii = 8;
+
+        if (sc || ascii)
+            keyboard_push(&dos->keyboard, sc, ascii);
+        break;
+    }
+
+    case SDL_MOUSEMOTION: {
+        float fx, fy;
+        window_to_logical(plat, e->motion.x, e->motion.y, &fx, &fy);
+        mouse_update(&dos->mouse, (int)fx, (int)fy, dos->mouse.buttons);
+        break;
+    }
+
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP: {
+        uint16_t btn = dos->mouse.buttons;
+        uint16_t mask = 0;
+        if (e->button.button == SDL_BUTTON_LEFT)   mask = 0x01;
+        if (e->button.button == SDL_BUTTON_RIGHT)  mask = 0x02;
+        if (e->button.button == SDL_BUTTON_MIDDLE) mask = 0x04;
+        if (e->type == SDL_MOUSEBUTTONDOWN)
+            btn |= mask;
+        else
+            btn &= ~mask;
+        dos->mouse.buttons = btn;
+        break;
+    }
     }
 }
 
-/* Render text mode (80x25 chars from 0xB8000) into 640x200 pixels.
- * Each character cell is 8 pixels wide × 8 pixels tall using the CP437 font. */
-static void render_text_mode(const CPU *cpu, uint32_t *pixels, int pitch)
+void platform_poll_events(Platform *plat, DosState *dos)
 {
-    const uint8_t *textbuf = cpu->mem + TEXT_MODE_BASE;
+    SDL_Event e;
+    while (SDL_PollEvent(&e))
+        handle_event(plat, dos, &e);
+}
 
-    for (int row = 0; row < TEXT_ROWS; row++) {
-        for (int col = 0; col < TEXT_COLS; col++) {
-            int cell = (row * TEXT_COLS + col) * 2;
-            uint8_t ch   = textbuf[cell];
-            uint8_t attr = textbuf[cell + 1];
-
-            uint32_t fg = text_colors[attr & 0x0F];
-            uint32_t bg = text_colors[(attr >> 4) & 0x07]; /* high bit = blink, ignore */
-
-            const uint8_t *glyph = font8x8_cp437[ch];
-
-            for (int gy = 0; gy < CHAR_H; gy++) {
-                int py = row * CHAR_H + gy;
-                uint32_t *prow = (uint32_t *)((uint8_t *)pixels + py * pitch);
-                uint8_t bits = glyph[gy];
-                for (int gx = 0; gx < 8; gx++) {
-                    int px = col * 8 + gx;
-                    prow[px] = (bits & (0x80 >> gx)) ? fg : bg;
-                }
-            }
-        }
-    }
+int platform_wait_events(Platform *plat, DosState *dos, uint32_t timeout_ms)
+{
+    SDL_Event e;
+    if (!SDL_WaitEventTimeout(&e, (int)timeout_ms))
+        return 0;
+    handle_event(plat, dos, &e);
+    while (SDL_PollEvent(&e))
+        handle_event(plat, dos, &e);
+    return 1;
 }
 
-void platform_render(Platform *plat, const CPU *cpu, const DosState *dos)
+/* ─── Game thread: frame handoff ─── */
+
+void platform_render(Platform *plat, CPU *cpu, DosState *dos)
 {
-    SDL_Renderer *ren = (SDL_Renderer *)plat->renderer;
+    PresentQueue *q = (PresentQueue *)plat->present;
 
     /* Check video mode from BIOS data area */
     uint8_t vmode = cpu->mem[0x449]; /* 0040:0049 */
     int is_gfx = (vmode == 0x13);
 
-    /* Switch logical size when mode changes */
-    int mode_id = is_gfx ? 1 : 0;
-    if (mode_id != plat->last_mode) {
-        plat->last_mode = mode_id;
-        if (is_gfx) {
-            SDL_RenderSetLogicalSize(ren, VGA_WIDTH, VGA_HEIGHT);
-        } else {
-            SDL_RenderSetLogicalSize(ren, TEXT_COLS * 8, TEXT_ROWS * CHAR_H);
-        }
+    uint32_t dirty[VGA_DIRTY_WORDS];
+    uint32_t any = 0;
+    for (int w = 0; w < VGA_DIRTY_WORDS; w++) {
+        dirty[w] = cpu->vga_dirty[w];
+        cpu->vga_dirty[w] = 0;
+        any |= dirty[w];
     }
+    int palette_changed = dos->video.dirty;
+    dos->video.dirty = 0;
 
-    SDL_Texture *tex;
-    uint32_t *pixels;
-    int pitch;
-
-    if (is_gfx) {
-        /* Mode 13h: 320x200x256 VGA */
-        tex = (SDL_Texture *)plat->tex_vga;
-        SDL_LockTexture(tex, NULL, (void **)&pixels, &pitch);
-
-        uint32_t rgba[256];
-        video_get_rgba_palette(&dos->video, rgba);
+    const uint8_t *textbuf = cpu->mem + TEXT_MODE_BASE;
+    int text_changed = !is_gfx && memcmp(q->text_seen, textbuf, TEXT_BYTES) != 0;
 
-        const uint8_t *fb = cpu->mem + VGA_FB_ADDR;
-        for (int y = 0; y < VGA_HEIGHT; y++) {
-            uint32_t *row = (uint32_t *)((uint8_t *)pixels + y * pitch);
-            for (int x = 0; x < VGA_WIDTH; x++) {
-                row[x] = rgba[fb[y * VGA_WIDTH + x]];
-            }
-        }
-    } else {
-        /* Text mode (mode 3 or default): render from 0xB8000 */
-        tex = (SDL_Texture *)plat->tex_text;
-        SDL_LockTexture(tex, NULL, (void **)&pixels, &pitch);
-        render_text_mode(cpu, pixels, pitch);
+    /* Nothing new on screen: the render thread keeps its last frame */
+    if (is_gfx == q->is_gfx && !any && !palette_changed && !text_changed) {
+        return;
     }
 
-    SDL_UnlockTexture(tex);
+    /* Bring the back slot up to date: rows it missed while other slots
+     * were filled, plus the rows changed now */
+    FrameSnapshot *s = &q->slot[q->back];
+    const uint8_t *fb = cpu->mem + VGA_FB_ADDR;
+    for (int y = 0; y < VGA_HEIGHT; y++) {
+        uint32_t bit = 1u << (y & 31);
+        if ((q->stale[q->back][y >> 5] | dirty[y >> 5]) & bit)
+            memcpy(s->vga + y * VGA_WIDTH, fb + y * VGA_WIDTH, VGA_WIDTH);
+    }
+    for (int i = 0; i < SNAP_SLOTS; i++) {
+        for (int w = 0; w < VGA_DIRTY_WORDS; w++)
+            q->stale[i][w] = i == q->back ? 0 : q->stale[i][w] | dirty[w];
+    }
+    memcpy(s->text, textbuf, TEXT_BYTES);
+    memcpy(q->text_seen, textbuf, TEXT_BYTES);
+    video_get_rgba_palette(&dos->video, s->palette);
 
-    SDL_RenderClear(ren);
-    SDL_RenderCopy(ren, tex, NULL, NULL);
-    SDL_RenderPresent(ren);
+    for (int w = 0; w < VGA_DIRTY_WORDS; w++) {
+        s->dirty[w] = dirty[w] | q->carry[w];
+        q->carry[w] = 0;
+    }
+    s->palette_changed = palette_changed | q->carry_palette;
+    q->carry_palette = 0;
+    s->is_gfx = is_gfx;
+    q->is_gfx = is_gfx;
+
+    /* Hand it over. If the previous frame was never picked up, it comes
+     * back as the new back slot and its changes ride on the next frame. */
+    int old = SDL_AtomicSet(&q->ready, q->back | SNAP_FRESH);
+    q->back = old & ~SNAP_FRESH;
+    if (old & SNAP_FRESH) {
+        const FrameSnapshot *skipped = &q->slot[q->back];
+        for (int w = 0; w < VGA_DIRTY_WORDS; w++)
+            q->carry[w] |= skipped->dirty[w];
+        q->carry_palette |= skipped->palette_changed;
+    }
+    wake_renderer(q);
 }
 
 uint64_t platform_get_ticks(void)
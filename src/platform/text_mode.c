@@ -0,0 +1,45 @@
+/*
+ * text_mode.c - 80x25 text mode rasterizer
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "platform/text_mode.h"
+#include "platform/pixel_kernels.h"
+#include "font8x8.h"
+
+#include <string.h>
+
+int text_mode_render(uint32_t *pixels, uint8_t *seen, const uint8_t *textbuf, int full,
+                     int *first, int *last)
+{
+    int lo = TEXT_ROWS, hi = -1;
+
+    for (int row = 0; row < TEXT_ROWS; row++) {
+        const uint8_t *line = textbuf + row * TEXT_COLS * 2;
+        uint8_t *was = seen + row * TEXT_COLS * 2;
+        if (!full && memcmp(line, was, TEXT_COLS * 2) == 0)
+            continue;
+
+        for (int col = 0; col < TEXT_COLS; col++) {
+            uint8_t ch   = line[col * 2];
+            uint8_t attr = line[col * 2 + 1];
+            if (!full && was[col * 2] == ch && was[col * 2 + 1] == attr)
+                continue;
+
+            uint32_t fg = text_colors[attr & 0x0F];
+            uint32_t bg = text_colors[(attr >> 4) & 0x07]; /* high bit = blink, ignore */
+            px_glyph8(pixels + row * CHAR_H * TEXT_PITCH + col * 8, TEXT_PITCH,
+                      font8x8_cp437[ch], CHAR_H, fg, bg);
+        }
+        memcpy(was, line, TEXT_COLS * 2);
+        if (lo > row) lo = row;
+        hi = row;
+    }
+
+    if (hi < 0)
+        return 0;
+    *first = lo;
+    *last = hi;
+    return 1;
+}
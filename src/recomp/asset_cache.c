@@ -0,0 +1,310 @@
+/*
+ * asset_cache.c - Decoded .PIC image cache
+ *
+ * A fixed table of slots under one lock; the least recently used
+ * unreferenced entries are evicted to stay within ASSET_CACHE_BUDGET.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L     /* dirent, clock_gettime */
+#endif
+
+#include "recomp/asset_cache.h"
+#include "recomp/log.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#endif
+
+typedef struct {
+    char     path[512];
+    time_t   mtime;
+    uint8_t  is_4bit;
+    uint8_t  used;
+    uint8_t  verified;          /* Recorded from the game, not preloaded */
+    uint8_t  discard;           /* Drop once the last reference goes */
+    uint32_t refs;
+    uint64_t stamp;             /* Last use, for LRU */
+    PicImage img;
+} AssetEntry;
+
+static AssetEntry g_entries[ASSET_CACHE_SLOTS];
+static uint64_t   g_clock;
+static size_t     g_bytes;
+
+/* ─── Lock ─── */
+
+#ifdef _WIN32
+static SRWLOCK g_lock = SRWLOCK_INIT;
+static void lock(void)   { AcquireSRWLockExclusive(&g_lock); }
+static void unlock(void) { ReleaseSRWLockExclusive(&g_lock); }
+#else
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static void lock(void)   { pthread_mutex_lock(&g_lock); }
+static void unlock(void) { pthread_mutex_unlock(&g_lock); }
+#endif
+
+/* ─── Entries (lock held) ─── */
+
+/* DOS names are case-insensitive; the first file found on disk wins */
+static int same_path(const char *a, const char *b)
+{
+    for (; *a && *b; a++, b++)
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+            return 0;
+    return *a == *b;
+}
+
+static int file_mtime(const char *path, time_t *mtime)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+    *mtime = st.st_mtime;
+    return 0;
+}
+
+static AssetEntry *find(const char *path, time_t mtime, int is_4bit)
+{
+    for (int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        AssetEntry *e = &g_entries[i];
+        if (e->used && !e->discard && e->mtime == mtime &&
+            e->is_4bit == is_4bit && same_path(e->path, path))
+            return e;
+    }
+    return NULL;
+}
+
+static AssetEntry *entry_of(const PicImage *img)
+{
+    for (int i = 0; i < ASSET_CACHE_SLOTS; i++)
+        if (g_entries[i].used && &g_entries[i].img == img)
+            return &g_entries[i];
+    return NULL;
+}
+
+static void drop(AssetEntry *e)
+{
+    g_bytes -= e->img.size;
+    pic_free(&e->img);
+    e->used = 0;
+}
+
+/* Free space for size more bytes and return an empty slot, or NULL */
+static AssetEntry *make_room(size_t size)
+{
+    for (;;) {
+        AssetEntry *slot = NULL, *lru = NULL;
+        for (int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+            AssetEntry *e = &g_entries[i];
+            if (!e->used) {
+                if (!slot) slot = e;
+            } else if (e->refs == 0 && (!lru || e->stamp < lru->stamp)) {
+                lru = e;
+            }
+        }
+        if (slot && g_bytes + size <= ASSET_CACHE_BUDGET)
+            return slot;
+        if (!lru)
+            return NULL;
+        drop(lru);
+    }
+}
+
+/* ─── API ─── */
+
+const PicImage *asset_cache_acquire(const char *path, int is_4bit)
+{
+    time_t mtime;
+    if (file_mtime(path, &mtime) != 0)
+        return NULL;
+
+    lock();
+    AssetEntry *e = find(path, mtime, is_4bit ? 1 : 0);
+    if (e) {
+        e->refs++;
+        e->stamp = ++g_clock;
+    }
+    unlock();
+    return e ? &e->img : NULL;
+}
+
+void asset_cache_release(const PicImage *img, int discard)
+{
+    lock();
+    AssetEntry *e = entry_of(img);
+    if (e) {
+        if (discard)
+            e->discard = 1;
+        if (--e->refs == 0 && e->discard)
+            drop(e);
+    }
+    unlock();
+}
+
+void asset_cache_insert(const char *path, int is_4bit, PicImage *img, int verified)
+{
+    time_t mtime;
+    if (!img->pixels || file_mtime(path, &mtime) != 0) {
+        pic_free(img);
+        return;
+    }
+    is_4bit = is_4bit ? 1 : 0;
+
+    lock();
+    AssetEntry *e = find(path, mtime, is_4bit);
+    if (e && (e->verified || !verified || e->refs)) {
+        /* Already have one at least as good, or cannot replace it now */
+        unlock();
+        pic_free(img);
+        return;
+    }
+    if (e)
+        drop(e);
+    e = make_room(img->size);
+    if (!e) {
+        unlock();
+        pic_free(img);
+        return;
+    }
+    memset(e, 0, sizeof(*e));
+    snprintf(e->path, sizeof(e->path), "%s", path);
+    e->mtime = mtime;
+    e->is_4bit = (uint8_t)is_4bit;
+    e->verified = verified ? 1 : 0;
+    e->used = 1;
+    e->stamp = ++g_clock;
+    e->img = *img;
+    g_bytes += img->size;
+    unlock();
+
+    img->pixels = NULL;
+    img->size = 0;
+}
+
+/* ─── Preload ─── */
+
+static char g_preload_dir[260];
+static volatile int g_preload_stop;
+
+#ifdef _WIN32
+static HANDLE g_preload_thread;
+#else
+static pthread_t g_preload_thread;
+#endif
+
+static uint64_t now_ms(void)
+{
+#ifdef _WIN32
+    return (uint64_t)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+#endif
+}
+
+static int is_pic_name(const char *name)
+{
+    size_t n = strlen(name);
+    return n > 4 && same_path(name + n - 4, ".pic");
+}
+
+static int preload_one(const char *name)
+{
+    char path[512];
+    PicImage img;
+    snprintf(path, sizeof(path), "%s/%s", g_preload_dir, name);
+    if (pic_load(path, &img, 1) != 0)
+        return 0;
+    asset_cache_insert(path, img.is_4bit, &img, 0);
+    return 1;
+}
+
+#ifdef _WIN32
+static unsigned __stdcall preload_thread(void *arg)
+#else
+static void *preload_thread(void *arg)
+#endif
+{
+    (void)arg;
+    uint64_t start = now_ms();
+    int files = 0, decoded = 0;
+
+#ifdef _WIN32
+    char pattern[280];
+    WIN32_FIND_DATAA fd;
+    snprintf(pattern, sizeof(pattern), "%s\\*.PIC", g_preload_dir);
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            if (g_preload_stop) break;
+            files++;
+            decoded += preload_one(fd.cFileName);
+        } while (FindNextFileA(h, &fd));
+        FindClose(h);
+    }
+#else
+    DIR *dir = opendir(g_preload_dir);
+    if (dir) {
+        struct dirent *de;
+        while (!g_preload_stop && (de = readdir(dir)) != NULL) {
+            if (!is_pic_name(de->d_name)) continue;
+            files++;
+            decoded += preload_one(de->d_name);
+        }
+        closedir(dir);
+    }
+#endif
+
+    lock();
+    size_t bytes = g_bytes;
+    unlock();
+    LOG_INFO(LOG_FILE, "[ASSET] Preloaded %d of %d .PIC files (%zu KB) in %llu ms\n",
+             decoded, files, bytes / 1024, (unsigned long long)(now_ms() - start));
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+static void preload_join(void)
+{
+    g_preload_stop = 1;
+#ifdef _WIN32
+    WaitForSingleObject(g_preload_thread, INFINITE);
+    CloseHandle(g_preload_thread);
+#else
+    pthread_join(g_preload_thread, NULL);
+#endif
+}
+
+void asset_cache_preload(const char *game_dir)
+{
+    snprintf(g_preload_dir, sizeof(g_preload_dir), "%s", game_dir);
+#ifdef _WIN32
+    g_preload_thread = (HANDLE)_beginthreadex(NULL, 0, preload_thread, NULL, 0, NULL);
+    if (!g_preload_thread) {
+#else
+    if (pthread_create(&g_preload_thread, NULL, preload_thread, NULL) != 0) {
+#endif
+        LOG_WARN(LOG_FILE, "[ASSET] Cannot start preload thread\n");
+        return;
+    }
+    atexit(preload_join);
+}
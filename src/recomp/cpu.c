@@ -5,6 +5,7 @@
  */
 
 #include "recomp/cpu.h"
+#include "recomp/log.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -15,6 +16,7 @@ int cpu_alloc_mem(CPU *cpu)
         fprintf(stderr, "Error: failed to allocate %d bytes for CPU memory\n", MEM_SIZE);
         return -1;
     }
+    cpu_sync_sregs(cpu);
     return 0;
 }
 
@@ -56,3 +58,14 @@ int cpu_load(CPU *cpu, const char *path, uint16_t seg, uint16_t off)
     printf("Loaded %ld bytes at %04X:%04X (flat 0x%06X)\n", size, seg, off, addr);
     return 0;
 }
+
+#ifdef CIV_CHECK_DGROUP
+uint8_t *dgroup_checked(CPU *cpu, const char *func)
+{
+    if (cpu->ds == cpu->dgroup_seg)
+        return cpu->dgroup;
+    LOG_SAMPLED(LOG_LEVEL_WARN, LOG_DIAG, 20, 0, "[DGROUP] %s entered with DS=%04X, not DGROUP %04X\n",
+                func, cpu->ds, cpu->dgroup_seg);
+    return cpu->seg_base[SREG_DS];
+}
+#endif
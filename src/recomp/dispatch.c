@@ -0,0 +1,65 @@
+/*
+ * dispatch.c - seg:off -> recompiled function lookup
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "recomp/dispatch.h"
+#include "recomp/log.h"
+
+static const DispatchTable *g_table;
+
+void recomp_dispatch_init(const DispatchTable *table)
+{
+    g_table = table;
+    LOG_INFO(LOG_INT, "[DISPATCH] %u indirect call targets\n", table ? table->count : 0);
+}
+
+static const DispatchEntry *find_linear(uint32_t addr)
+{
+    const DispatchTable *t = g_table;
+    uint32_t bucket = dispatch_hash(addr, 0) & t->bucket_mask;
+    uint32_t slot = dispatch_hash(addr, t->disp[bucket]) & t->slot_mask;
+    uint16_t idx = t->slots[slot];
+    if (idx == DISPATCH_EMPTY || t->entries[idx].addr != addr) return NULL;
+    return &t->entries[idx];
+}
+
+static const DispatchEntry *find_entry(uint16_t seg, uint16_t off)
+{
+    const DispatchEntry *e;
+    if (!g_table || g_table->count == 0) return NULL;
+
+    /* Pointers are normally stored with linker segments; ones that went
+     * through the EXEPACK relocation pass carry LOAD_SEG on top. */
+    e = find_linear(((uint32_t)seg << 4) + off);
+    if (!e && seg >= g_table->load_seg)
+        e = find_linear(((uint32_t)(seg - g_table->load_seg) << 4) + off);
+    return e;
+}
+
+RecompFunc recomp_lookup(uint16_t seg, uint16_t off)
+{
+    const DispatchEntry *e = find_entry(seg, off);
+    return e ? e->fn : NULL;
+}
+
+const char *recomp_lookup_name(uint16_t seg, uint16_t off)
+{
+    const DispatchEntry *e = find_entry(seg, off);
+    return e ? e->name : NULL;
+}
+
+int recomp_dispatch(CPU *cpu, uint16_t seg, uint16_t off)
+{
+    const DispatchEntry *e = find_entry(seg, off);
+    if (e) {
+        e->fn(cpu);
+        return 1;
+    }
+
+    LOG_SAMPLED(LOG_LEVEL_WARN, LOG_INT, 16, 10000, "[DISPATCH] Unknown far target %04X:%04X (n=%llu)\n",
+                seg, off, (unsigned long long)log_hit);
+    cpu->sp += 4;   /* drop the far return frame the caller pushed */
+    return 0;
+}
@@ -13,29 +13,53 @@
  *             30h DOS version, 35h get vector, 47h get dir
  *   Exit:     00h/4Ch terminate
  *
+ * Files go through a small virtual file layer: .PIC/.PAL/.TXT/.MAP
+ * opened for reading are memory-mapped and read with memcpy, .SVE saves
+ * are buffered in memory and written back on close, and existence and
+ * attribute queries are answered from cached directory listings.
+ *
  * Part of the Civ Recomp project (sp00nznet/civ)
  */
 
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L     /* mmap, dirent */
+#endif
+
 #include "recomp/dos_compat.h"
+#include "recomp/dispatch.h"
 #include "hal/input.h"
+#include "recomp/log.h"
+#include "recomp/snapshot.h"
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <time.h>
 
-/* Global DOS state - accessible from interrupt handlers */
-static DosState *g_dos = NULL;
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 DosState *get_dos_state(CPU *cpu)
 {
-    (void)cpu;
-    return g_dos;
+    return cpu->dos;
 }
 
 /* ─── File path translation ─── */
 
-static void dos_path_to_native(const CPU *cpu, uint16_t seg, uint16_t off,
-                                char *out, int out_size)
+/* DS-relative DOS path -> host path under game_dir. Returns 0, or -1 if
+ * the result does not fit in out (the caller fails with "path not found"
+ * rather than open a truncated name). */
+static int dos_path_to_native(const CPU *cpu, uint16_t seg, uint16_t off,
+                              char *out, int out_size)
 {
     /* Read DOS path string from memory */
     char dos_path[260];
@@ -50,37 +74,489 @@ static void dos_path_to_native(const CPU *cpu, uint16_t seg, uint16_t off,
     dos_path[i] = 0;
 
     /* Prepend game directory */
-    snprintf(out, out_size, "%s/%s", g_dos->game_dir, dos_path);
+    int n = snprintf(out, out_size, "%s/%s", cpu->dos->game_dir, dos_path);
+    if (n < 0 || n >= out_size) {
+        LOG_WARN(LOG_FILE, "[FILE] Path too long: '%s/%s'\n", cpu->dos->game_dir, dos_path);
+        return -1;
+    }
+    return 0;
 }
 
-/* ─── DOS File Handle Management ─── */
+/* ─── Directory cache ─── */
+
+/* Listings of the directories the game touches, so _access and INT 21h/43h
+ * do not go to the host file system, and so DOS names (case-insensitive)
+ * resolve to whatever case the files have on disk. A listing is dropped
+ * whenever the game creates, deletes or writes back a file in it. */
+
+static int dos_same_name(const char *a, const char *b)
+{
+    for (; *a && *b; a++, b++)
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+            return 0;
+    return *a == *b;
+}
+
+static void dir_add(DosDirCache *d, int *cap, const char *name, int is_dir)
+{
+    if (!strcmp(name, ".") || !strcmp(name, ".."))
+        return;
+    if (d->count == *cap) {
+        int n = *cap ? *cap * 2 : 64;
+        DosDirEntry *e = (DosDirEntry *)realloc(d->entries, (size_t)n * sizeof(*e));
+        if (!e) return;
+        d->entries = e;
+        *cap = n;
+    }
+    DosDirEntry *e = &d->entries[d->count++];
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->attr = is_dir ? 0x10 : 0x20;
+}
 
-static int dos_alloc_handle(FILE *f)
+static DosDirCache *dir_listing(DosState *ds, const char *dir)
 {
-    DosFileTable *ft = &g_dos->file_table;
-    for (int i = 5; i < DOS_MAX_HANDLES; i++) {  /* 0-4 reserved for stdin/out/err/aux/prn */
-        if (ft->files[i] == NULL) {
-            ft->files[i] = f;
-            return i;
+    for (int i = 0; i < DOS_DIR_CACHE; i++)
+        if (ds->dirs[i].valid && !strcmp(ds->dirs[i].path, dir))
+            return &ds->dirs[i];
+
+    DosDirCache *d = &ds->dirs[ds->dir_next];
+    ds->dir_next = (ds->dir_next + 1) % DOS_DIR_CACHE;
+    free(d->entries);
+    memset(d, 0, sizeof(*d));
+    snprintf(d->path, sizeof(d->path), "%s", dir);
+    int cap = 0;
+
+#ifdef _WIN32
+    char pattern[530];
+    WIN32_FIND_DATAA fd;
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE)
+        return NULL;
+    do {
+        dir_add(d, &cap, fd.cFileName, (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    DIR *dh = opendir(dir);
+    if (!dh)
+        return NULL;
+    struct dirent *de;
+    while ((de = readdir(dh)) != NULL) {
+        char full[800];
+        struct stat st;
+        snprintf(full, sizeof(full), "%s/%s", dir, de->d_name);
+        dir_add(d, &cap, de->d_name, stat(full, &st) == 0 && S_ISDIR(st.st_mode));
+    }
+    closedir(dh);
+#endif
+
+    d->valid = 1;
+    LOG_DEBUG(LOG_FILE, "[FILE] Listed '%s': %d entries\n", dir, d->count);
+    return d;
+}
+
+/* Split a host path into its directory and final name */
+static const char *split_path(const char *path, char *dir, size_t size)
+{
+    const char *slash = strrchr(path, '/');
+    if (!slash) {
+        snprintf(dir, size, ".");
+        return path;
+    }
+    snprintf(dir, size, "%.*s", (int)(slash - path), path);
+    return slash + 1;
+}
+
+/* Look a host path up in its directory's listing. On a match the name
+ * part of path is rewritten to the case on disk and the DOS attributes
+ * are returned; -1 if there is no such file. */
+static int dir_lookup(DosState *ds, char *path, size_t size)
+{
+    char dir[512];
+    const char *name = split_path(path, dir, sizeof(dir));
+    DosDirCache *d = dir_listing(ds, dir);
+    if (!d)
+        return -1;
+    for (int i = 0; i < d->count; i++) {
+        if (dos_same_name(d->entries[i].name, name)) {
+            size_t at = (size_t)(name - path);
+            snprintf(path + at, size - at, "%s", d->entries[i].name);
+            return d->entries[i].attr;
         }
     }
     return -1;
 }
 
-static FILE *dos_get_file(int handle)
+static void dir_forget(DosState *ds, const char *path)
+{
+    char dir[512];
+    split_path(path, dir, sizeof(dir));
+    for (int i = 0; i < DOS_DIR_CACHE; i++)
+        if (ds->dirs[i].valid && !strcmp(ds->dirs[i].path, dir))
+            ds->dirs[i].valid = 0;
+}
+
+int dos_file_attributes(DosState *ds, char *path, size_t size)
+{
+    return dir_lookup(ds, path, size);
+}
+
+/* ─── Virtual files ─── */
+
+/* Read-only game data is mapped whole and read with memcpy; saves are
+ * held in memory and written out in one go when closed. */
+
+static uint8_t g_empty_file;    /* "Mapping" of a zero-length file */
+
+static int has_ext(const char *path, const char *ext)
+{
+    size_t n = strlen(path), e = strlen(ext);
+    return n > e && dos_same_name(path + n - e, ext);
+}
+
+static int is_game_data(const char *path)
 {
-    if (handle < 0 || handle >= DOS_MAX_HANDLES) return NULL;
-    return g_dos->file_table.files[handle];
+    return has_ext(path, ".PIC") || has_ext(path, ".PAL") ||
+           has_ext(path, ".TXT") || has_ext(path, ".MAP");
 }
 
-static void dos_close_handle(int handle)
+static uint8_t *map_file(const char *path, uint32_t *size)
 {
-    if (handle >= 5 && handle < DOS_MAX_HANDLES) {
-        if (g_dos->file_table.files[handle]) {
-            fclose(g_dos->file_table.files[handle]);
-            g_dos->file_table.files[handle] = NULL;
+    uint8_t *p = NULL;
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(path, GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return NULL;
+    LARGE_INTEGER len;
+    if (GetFileSizeEx(fh, &len) && len.QuadPart < 0xFFFFFFFFLL) {
+        *size = (uint32_t)len.QuadPart;
+        if (*size == 0) {
+            p = &g_empty_file;
+        } else {
+            HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mh) {
+                p = (uint8_t *)MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mh);    /* The view keeps the mapping alive */
+            }
         }
     }
+    CloseHandle(fh);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size < 0xFFFFFFFFLL) {
+        *size = (uint32_t)st.st_size;
+        if (*size == 0) {
+            p = &g_empty_file;
+        } else {
+            void *m = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED)
+                p = (uint8_t *)m;
+        }
+    }
+    close(fd);
+#endif
+    return p;
+}
+
+static void unmap_file(uint8_t *p, uint32_t size)
+{
+    if (p == &g_empty_file)
+        return;
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(p);
+#else
+    munmap(p, size);
+#endif
+}
+
+/* Make room for a buffered file to reach size bytes */
+static int buffer_reserve(DosFile *df, uint32_t size)
+{
+    if (size <= df->cap)
+        return 0;
+    uint32_t cap = df->cap ? df->cap : 4096;
+    while (cap < size)
+        cap = (cap > 0x7FFFFFFFu) ? size : cap * 2;
+    uint8_t *p = (uint8_t *)realloc(df->data, cap);
+    if (!p)
+        return -1;
+    df->data = p;
+    df->cap = cap;
+    return 0;
+}
+
+static int buffer_load(DosFile *df, FILE *f)
+{
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0 || buffer_reserve(df, (uint32_t)size) != 0)
+        return -1;
+    df->size = (uint32_t)fread(df->data, 1, (size_t)size, f);
+    return 0;
+}
+
+static void buffer_write_back(DosState *ds, DosFile *df)
+{
+    FILE *f = fopen(df->path, "wb");
+    size_t n = f ? fwrite(df->data, 1, df->size, f) : 0;
+    if (f) fclose(f);
+    if (n != df->size)
+        LOG_WARN(LOG_FILE, "[FILE] Write-back '%s' FAIL (%zu of %u bytes)\n",
+                 df->path, n, df->size);
+    else
+        LOG_INFO(LOG_FILE, "[FILE] Wrote '%s' (%u bytes)\n", df->path, df->size);
+    df->dirty = 0;
+    dir_forget(ds, df->path);
+}
+
+/* ─── DOS File Handle Management ─── */
+
+static DosFile *dos_get_file(DosState *ds, int handle)
+{
+    DosFileTable *ft = &ds->file_table;
+    if (handle < 0 || handle >= ft->count || ft->files[handle].kind == DOS_FILE_FREE)
+        return NULL;
+    return &ft->files[handle];
+}
+
+/* Make the table hold at least count handles */
+static int dos_grow_table(DosState *ds, int count)
+{
+    DosFileTable *ft = &ds->file_table;
+    if (count <= ft->count)
+        return 0;
+    if (count > 0xFFFF)
+        return -1;
+    int n = ft->count ? ft->count : DOS_INITIAL_HANDLES;
+    while (n < count)
+        n *= 2;
+    if (n > 0xFFFF) n = 0xFFFF;
+    DosFile *files = (DosFile *)realloc(ft->files, (size_t)n * sizeof(DosFile));
+    if (!files)
+        return -1;
+    memset(files + ft->count, 0, (size_t)(n - ft->count) * sizeof(DosFile));
+    ft->files = files;
+    ft->count = n;
+    LOG_DEBUG(LOG_FILE, "[FILE] Handle table grown to %d\n", n);
+    return 0;
+}
+
+/* Find a free handle, growing the table when all are in use. The
+ * returned entry is cleared and stays valid until the next allocation. */
+static int dos_alloc_handle(DosState *ds, const char *path)
+{
+    DosFileTable *ft = &ds->file_table;
+    int i;
+    for (i = DOS_FIRST_FILE; i < ft->count; i++)  /* 0-4 reserved for stdin/out/err/aux/prn */
+        if (ft->files[i].kind == DOS_FILE_FREE)
+            break;
+    if (i == ft->count && dos_grow_table(ds, i + 1) != 0)
+        return -1;
+    memset(&ft->files[i], 0, sizeof(DosFile));
+    snprintf(ft->files[i].path, sizeof(ft->files[i].path), "%s", path);
+    return i;
+}
+
+static void dos_close_handle(DosState *ds, int handle)
+{
+    DosFile *df = dos_get_file(ds, handle);
+    if (!df || handle < DOS_FIRST_FILE)
+        return;
+    switch (df->kind) {
+    case DOS_FILE_MAPPED:
+        unmap_file(df->data, df->size);
+        break;
+    case DOS_FILE_BUFFERED:
+        if (df->dirty)
+            buffer_write_back(ds, df);
+        free(df->data);
+        break;
+    case DOS_FILE_STREAM:
+        fclose(df->fp);
+        break;
+    default:
+        break;
+    }
+    memset(df, 0, sizeof(*df));
+}
+
+/* Open an existing file into a cleared entry; AL access mode 0 = read,
+ * 1 = write, 2 = both. Returns 0 or -2 if there is no such file. */
+static int dos_open_into(DosFile *df, const char *path, int access)
+{
+    df->access = (uint8_t)access;
+    if (access == 0 && is_game_data(path)) {
+        df->data = map_file(path, &df->size);
+        if (df->data) {
+            df->kind = DOS_FILE_MAPPED;
+            return 0;
+        }
+    }
+
+    FILE *f = fopen(path, access == 0 ? "rb" : "r+b");
+    if (!f)
+        return -2;  /* File not found */
+    if (access != 0 && has_ext(path, ".SVE") && buffer_load(df, f) == 0) {
+        fclose(f);
+        df->kind = DOS_FILE_BUFFERED;
+        return 0;
+    }
+    df->fp = f;
+    df->kind = DOS_FILE_STREAM;
+    return 0;
+}
+
+/* Returns the handle or a negated DOS error code */
+static int dos_open_file(DosState *ds, const char *path, int access)
+{
+    int handle = dos_alloc_handle(ds, path);
+    if (handle < 0)
+        return -4;  /* Too many open files */
+    if (dos_open_into(&ds->file_table.files[handle], path, access) != 0)
+        return -2;
+    return handle;
+}
+
+int dos_file_reopen(DosState *ds, int handle, const char *path, int access, long pos)
+{
+    if (handle < DOS_FIRST_FILE || dos_grow_table(ds, handle + 1) != 0)
+        return -1;
+    dos_close_handle(ds, handle);
+    DosFile *df = &ds->file_table.files[handle];
+    memset(df, 0, sizeof(*df));
+    snprintf(df->path, sizeof(df->path), "%s", path);
+    if (dos_open_into(df, path, access) != 0)
+        return -1;
+    return dos_file_seek(ds, handle, pos, SEEK_SET) == pos ? 0 : -1;
+}
+
+/* Create or truncate a file. Returns the handle or a negated DOS error. */
+static int dos_create_file(DosState *ds, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -3;  /* Path not found */
+    dir_forget(ds, path);
+
+    int handle = dos_alloc_handle(ds, path);
+    if (handle < 0) {
+        fclose(f);
+        return -4;
+    }
+    DosFile *df = &ds->file_table.files[handle];
+    df->access = 2;
+    if (has_ext(path, ".SVE")) {
+        /* Exists (empty) on disk now; the contents follow on close */
+        fclose(f);
+        df->kind = DOS_FILE_BUFFERED;
+    } else {
+        df->fp = f;
+        df->kind = DOS_FILE_STREAM;
+    }
+    return handle;
+}
+
+long dos_file_read(DosState *ds, int handle, void *dst, uint32_t count)
+{
+    DosFile *df = dos_get_file(ds, handle);
+    if (!df)
+        return -1;
+    if (handle >= DOS_FIRST_FILE)
+        ds->file_table.last_read = handle;
+
+    if (df->kind == DOS_FILE_MAPPED || df->kind == DOS_FILE_BUFFERED) {
+        uint32_t left = (df->pos < df->size) ? df->size - df->pos : 0;
+        if (count > left)
+            count = left;
+        memcpy(dst, df->data + df->pos, count);
+        df->pos += count;
+        return (long)count;
+    }
+    return (long)fread(dst, 1, count, df->fp);
+}
+
+long dos_file_write(DosState *ds, int handle, const void *src, uint32_t count)
+{
+    DosFile *df = dos_get_file(ds, handle);
+    if (!df)
+        return -1;
+
+    switch (df->kind) {
+    case DOS_FILE_MAPPED:
+        return 0;   /* Opened read-only */
+    case DOS_FILE_BUFFERED:
+        if (count == 0) {
+            df->size = df->pos;     /* A zero-length write truncates */
+        } else {
+            if (buffer_reserve(df, df->pos + count) != 0)
+                return 0;
+            if (df->pos > df->size)
+                memset(df->data + df->size, 0, df->pos - df->size);
+            memcpy(df->data + df->pos, src, count);
+            df->pos += count;
+            if (df->pos > df->size)
+                df->size = df->pos;
+        }
+        df->dirty = 1;
+        return (long)count;
+    default:
+        return (long)fwrite(src, 1, count, df->fp);
+    }
+}
+
+long dos_file_seek(DosState *ds, int handle, long offset, int whence)
+{
+    DosFile *df = dos_get_file(ds, handle);
+    if (!df)
+        return -1;
+    if (df->kind == DOS_FILE_STREAM || df->kind == DOS_FILE_DEVICE) {
+        if (fseek(df->fp, offset, whence) != 0)
+            return -1;
+        return ftell(df->fp);
+    }
+
+    long base = (whence == SEEK_CUR) ? (long)df->pos :
+                (whence == SEEK_END) ? (long)df->size : 0;
+    if (base + offset < 0 || base + offset > 0xFFFFFFFFL)
+        return -1;
+    df->pos = (uint32_t)(base + offset);
+    return (long)df->pos;
+}
+
+long dos_file_tell(DosState *ds, int handle)
+{
+    return dos_file_seek(ds, handle, 0, SEEK_CUR);
+}
+
+const char *dos_handle_path(DosState *ds, int handle)
+{
+    DosFile *df = (handle >= DOS_FIRST_FILE) ? dos_get_file(ds, handle) : NULL;
+    return df ? df->path : NULL;
+}
+
+void dos_flush_files(DosState *ds)
+{
+    for (int i = DOS_FIRST_FILE; i < ds->file_table.count; i++) {
+        DosFile *df = &ds->file_table.files[i];
+        if (df->kind == DOS_FILE_BUFFERED && df->dirty)
+            buffer_write_back(ds, df);
+        else if (df->kind == DOS_FILE_STREAM)
+            fflush(df->fp);
+    }
+}
+
+void dos_close_all(DosState *ds)
+{
+    for (int i = DOS_FIRST_FILE; i < ds->file_table.count; i++)
+        dos_close_handle(ds, i);
 }
 
 /* ─── Initialization ─── */
@@ -89,20 +565,23 @@ void dos_init(DosState *ds, CPU *cpu, const char *game_dir)
 {
     memset(ds, 0, sizeof(*ds));
     strncpy(ds->game_dir, game_dir, sizeof(ds->game_dir) - 1);
-    g_dos = ds;
+    cpu->dos = ds;
 
     /* Initialize subsystems */
     video_init(&ds->video);
     keyboard_init(&ds->keyboard);
     mouse_init(&ds->mouse);
     timer_init(&ds->timer);
-
-    /* Set up standard file handles */
-    ds->file_table.files[0] = stdin;
-    ds->file_table.files[1] = stdout;
-    ds->file_table.files[2] = stderr;
-    ds->file_table.files[3] = NULL;  /* AUX */
-    ds->file_table.files[4] = NULL;  /* PRN */
+    audio_init(&ds->audio);
+
+    /* Set up standard file handles; AUX (3) and PRN (4) stay closed */
+    ds->file_table.files = (DosFile *)calloc(DOS_INITIAL_HANDLES, sizeof(DosFile));
+    ds->file_table.count = ds->file_table.files ? DOS_INITIAL_HANDLES : 0;
+    FILE *std[3] = { stdin, stdout, stderr };
+    for (int i = 0; i < 3 && i < ds->file_table.count; i++) {
+        ds->file_table.files[i].kind = DOS_FILE_DEVICE;
+        ds->file_table.files[i].fp = std[i];
+    }
 
     /* Set up BIOS data area */
     /* Equipment word at 0040:0010 */
@@ -119,29 +598,117 @@ void dos_init(DosState *ds, CPU *cpu, const char *game_dir)
     printf("[DOS] Initialized with game dir: %s\n", game_dir);
 }
 
+void dos_shutdown(DosState *ds)
+{
+    dos_close_all(ds);
+    free(ds->file_table.files);
+    ds->file_table.files = NULL;
+    ds->file_table.count = 0;
+    for (int i = 0; i < DOS_DIR_CACHE; i++) {
+        free(ds->dirs[i].entries);
+        ds->dirs[i].entries = NULL;
+        ds->dirs[i].valid = 0;
+    }
+    if (ds->game_free)
+        ds->game_free(ds->game);
+    ds->game = NULL;
+    ds->game_free = NULL;
+    ds->game_save_size = 0;
+    ds->game_save = NULL;
+    ds->game_load = NULL;
+}
+
+/* ─── Blocking input ─── */
+
+int dos_wait_input(CPU *cpu, uint32_t timeout_ms)
+{
+    DosState *ds = cpu->dos;
+    KeyboardState *ks = &ds->keyboard;
+    uint64_t start = timer_now_ms(&ds->timer);
+
+    while (!keyboard_available(ks)) {
+        /* Waiting for a key is where snapshots can be taken and restored */
+        snapshot_service(cpu, ds);
+
+        uint64_t now = timer_now_ms(&ds->timer);
+        timer_update(&ds->timer, now);
+        uint64_t waited = now - start;
+        if (timeout_ms != DOS_WAIT_FOREVER && waited >= timeout_ms)
+            return 0;
+
+        /* The game's timer handlers keep running while it waits */
+        cpu_safe_point(cpu);
+
+        if (ds->wait_events) {
+            /* Sleep until input, the next tick (or IRQ0 a handler is
+             * installed for), or the timeout */
+            uint32_t slice = timer_ms_to_next_tick(&ds->timer, now);
+            if (ds->ivt[0x08] || ds->ivt[0x1C]) {
+                uint32_t irq = timer_ms_to_next_irq(&ds->timer);
+                if (irq < slice)
+                    slice = irq;
+            }
+            if (timeout_ms != DOS_WAIT_FOREVER && timeout_ms - waited < slice)
+                slice = (uint32_t)(timeout_ms - waited);
+            ds->wait_events(ds->platform_ctx, ds, cpu, slice);
+        } else if (ds->poll_events) {
+            ds->poll_events(ds->platform_ctx, ds, cpu);
+        } else {
+            return 0;   /* Nothing can deliver a key */
+        }
+    }
+    return 1;
+}
+
+int dos_poll_input(CPU *cpu)
+{
+    DosState *ds = cpu->dos;
+    if (ds->poll_events)
+        ds->poll_events(ds->platform_ctx, ds, cpu);
+    if (keyboard_available(&ds->keyboard)) {
+        ds->idle_polls = 0;
+        return 1;
+    }
+    dos_idle_poll(cpu);
+    return 0;
+}
+
+void dos_idle_poll(CPU *cpu)
+{
+    DosState *ds = cpu->dos;
+    if (cpu->calls - ds->idle_calls >= DOS_IDLE_CALLS)
+        ds->idle_polls = 0;     /* The game did real work since the last check */
+    ds->idle_calls = cpu->calls;
+    if (ds->idle_polls < DOS_IDLE_POLLS) {
+        ds->idle_polls++;
+        return;
+    }
+    if (ds->wait_events && !ds->timer.turbo)
+        dos_wait_input(cpu, DOS_IDLE_WAIT_MS);
+}
+
 /* ─── INT 21h - DOS API ─── */
 
 void dos_int21(CPU *cpu)
 {
+    DosState *ds = cpu->dos;
     uint8_t ah = cpu->ah;
 
     switch (ah) {
     case 0x00: /* Terminate program */
         printf("[DOS] Program terminated (INT 21h/00)\n");
+        dos_close_all(ds);
         cpu->halted = 1;
         break;
 
     case 0x01: /* Character input with echo (blocking) */ {
-        KeyboardState *ks = &g_dos->keyboard;
-        fprintf(stderr, "[BLOCK] Waiting for key in INT 21h/01\n");
-        while (!keyboard_available(ks)) {
-            if (g_dos->poll_events)
-                g_dos->poll_events(g_dos->platform_ctx, g_dos, cpu);
-        }
+        KeyboardState *ks = &ds->keyboard;
+        LOG_DEBUG(LOG_KEY, "[BLOCK] Waiting for key in INT 21h/01\n");
+        dos_wait_input(cpu, DOS_WAIT_FOREVER);
         uint16_t key = keyboard_read(ks);
         cpu->al = (uint8_t)(key & 0xFF);
-        fprintf(stderr, "[KEY] INT 21h/01: 0x%04X (ascii='%c')\n",
-                key, (cpu->al >= 32 && cpu->al < 127) ? cpu->al : '.');
+        LOG_INFO(LOG_KEY, "[KEY] INT 21h/01: 0x%04X (ascii='%c')\n",
+                 key, (cpu->al >= 32 && cpu->al < 127) ? cpu->al : '.');
         break;
     }
 
@@ -151,15 +718,12 @@ void dos_int21(CPU *cpu)
 
     case 0x08: /* Character input without echo */
     case 0x07: {
-        KeyboardState *ks = &g_dos->keyboard;
-        fprintf(stderr, "[BLOCK] Waiting for key in INT 21h/%02Xh\n", ah);
-        while (!keyboard_available(ks)) {
-            if (g_dos->poll_events)
-                g_dos->poll_events(g_dos->platform_ctx, g_dos, cpu);
-        }
+        KeyboardState *ks = &ds->keyboard;
+        LOG_DEBUG(LOG_KEY, "[BLOCK] Waiting for key in INT 21h/%02Xh\n", ah);
+        dos_wait_input(cpu, DOS_WAIT_FOREVER);
         uint16_t key = keyboard_read(ks);
         cpu->al = (uint8_t)(key & 0xFF);
-        fprintf(stderr, "[KEY] INT 21h/%02Xh: 0x%04X\n", ah, key);
+        LOG_INFO(LOG_KEY, "[KEY] INT 21h/%02Xh: 0x%04X\n", ah, key);
         break;
     }
 
@@ -202,9 +766,7 @@ void dos_int21(CPU *cpu)
     }
 
     case 0x0B: /* Check keyboard input status */
-        if (g_dos->poll_events)
-            g_dos->poll_events(g_dos->platform_ctx, g_dos, cpu);
-        cpu->al = keyboard_available(&g_dos->keyboard) ? 0xFF : 0x00;
+        cpu->al = dos_poll_input(cpu) ? 0xFF : 0x00;
         break;
 
     case 0x0E: /* Select disk */
@@ -225,13 +787,16 @@ void dos_int21(CPU *cpu)
         break;
 
     case 0x25: /* Set interrupt vector */
-        /* AL = interrupt number, DS:DX = handler */
-        g_dos->ivt[cpu->al] = ((uint32_t)cpu->ds << 16) | cpu->dx;
+        /* AL = interrupt number, DS:DX = handler; 08h and 1Ch are run at
+         * safe points once installed (cpu_safe_point) */
+        ds->ivt[cpu->al] = ((uint32_t)cpu->ds << 16) | cpu->dx;
+        LOG_DEBUG(LOG_INT, "[INT] vector %02X -> %04X:%04X (%s)\n", cpu->al, cpu->ds, cpu->dx,
+                  recomp_lookup_name(cpu->ds, cpu->dx) ? recomp_lookup_name(cpu->ds, cpu->dx) : "?");
         break;
 
     case 0x2A: { /* Get date */
-        time_t t = time(NULL);
-        struct tm *tm = localtime(&t);
+        time_t t = timer_wall_time(&ds->timer);
+        struct tm *tm = timer_is_virtual(&ds->timer) ? gmtime(&t) : localtime(&t);
         cpu->cx = (uint16_t)(tm->tm_year + 1900);
         cpu->dh = (uint8_t)(tm->tm_mon + 1);
         cpu->dl = (uint8_t)tm->tm_mday;
@@ -240,8 +805,8 @@ void dos_int21(CPU *cpu)
     }
 
     case 0x2C: { /* Get time */
-        time_t t = time(NULL);
-        struct tm *tm = localtime(&t);
+        time_t t = timer_wall_time(&ds->timer);
+        struct tm *tm = timer_is_virtual(&ds->timer) ? gmtime(&t) : localtime(&t);
         cpu->ch = (uint8_t)tm->tm_hour;
         cpu->cl = (uint8_t)tm->tm_min;
         cpu->dh = (uint8_t)tm->tm_sec;
@@ -257,71 +822,67 @@ void dos_int21(CPU *cpu)
         break;
 
     case 0x35: { /* Get interrupt vector */
-        uint32_t vec = g_dos->ivt[cpu->al];
-        cpu->es = (uint16_t)(vec >> 16);
+        uint32_t vec = ds->ivt[cpu->al];
+        set_sreg(cpu, SREG_ES, (uint16_t)(vec >> 16));
         cpu->bx = (uint16_t)(vec & 0xFFFF);
         break;
     }
 
     case 0x3C: { /* Create file */
         char path[512];
-        dos_path_to_native(cpu, cpu->ds, cpu->dx, path, sizeof(path));
-        FILE *f = fopen(path, "wb");
-        if (f) {
-            int handle = dos_alloc_handle(f);
-            if (handle >= 0) {
-                cpu->ax = (uint16_t)handle;
-                cpu->flags &= ~FLAG_CF;  /* Success */
-            } else {
-                fclose(f);
-                cpu->ax = 4;  /* Too many open files */
-                cpu->flags |= FLAG_CF;
-            }
-        } else {
+        if (dos_path_to_native(cpu, cpu->ds, cpu->dx, path, sizeof(path)) < 0) {
             cpu->ax = 3;  /* Path not found */
             cpu->flags |= FLAG_CF;
+            break;
+        }
+        dir_lookup(ds, path, sizeof(path));     /* Overwrite under the name on disk */
+        int handle = dos_create_file(ds, path);
+        if (handle >= 0) {
+            cpu->ax = (uint16_t)handle;
+            cpu->flags &= ~FLAG_CF;  /* Success */
+        } else {
+            cpu->ax = (uint16_t)-handle;  /* 3 path not found, 4 too many open files */
+            cpu->flags |= FLAG_CF;
         }
         break;
     }
 
     case 0x3D: { /* Open file */
         char path[512];
-        dos_path_to_native(cpu, cpu->ds, cpu->dx, path, sizeof(path));
-        const char *mode;
-        switch (cpu->al & 3) {
-            case 0: mode = "rb"; break;     /* Read only */
-            case 1: mode = "r+b"; break;    /* Write only */
-            case 2: mode = "r+b"; break;    /* Read/write */
-            default: mode = "rb"; break;
+        if (dos_path_to_native(cpu, cpu->ds, cpu->dx, path, sizeof(path)) < 0) {
+            cpu->ax = 3;  /* Path not found */
+            cpu->flags |= FLAG_CF;
+            break;
         }
-        FILE *f = fopen(path, mode);
-        if (f) {
-            int handle = dos_alloc_handle(f);
-            if (handle >= 0) {
-                cpu->ax = (uint16_t)handle;
-                cpu->flags &= ~FLAG_CF;
-                fprintf(stderr, "[FILE] Open '%s' -> handle %d\n", path, handle);
-            } else {
-                fclose(f);
-                cpu->ax = 4;
-                cpu->flags |= FLAG_CF;
-                fprintf(stderr, "[FILE] Open '%s' FAIL (no handles)\n", path);
-            }
+        dir_lookup(ds, path, sizeof(path));
+        int handle = dos_open_file(ds, path, (cpu->al & 3) == 3 ? 0 : cpu->al & 3);
+        if (handle >= 0) {
+            cpu->ax = (uint16_t)handle;
+            cpu->flags &= ~FLAG_CF;
+            LOG_INFO(LOG_FILE, "[FILE] Open '%s' -> handle %d%s\n", path, handle,
+                     ds->file_table.files[handle].kind == DOS_FILE_MAPPED ? " (mapped)" : "");
+        } else if (handle == -4) {
+            cpu->ax = 4;
+            cpu->flags |= FLAG_CF;
+            LOG_WARN(LOG_FILE, "[FILE] Open '%s' FAIL (no handles)\n", path);
         } else {
             cpu->ax = 2;  /* File not found */
             cpu->flags |= FLAG_CF;
-            fprintf(stderr, "[FILE] Open '%s' FAIL (not found) DS:DX=%04X:%04X raw=",
-                    path, cpu->ds, cpu->dx);
-            for (int j = 0; j < 16; j++)
-                fprintf(stderr, "%02X ", cpu->mem[seg_off(cpu->ds, (uint16_t)(cpu->dx + j))]);
-            fprintf(stderr, "\n");
+            if (LOG_ENABLED(LOG_LEVEL_WARN, LOG_FILE)) {
+                char raw[16 * 3 + 1];
+                for (int j = 0; j < 16; j++)
+                    snprintf(raw + j * 3, 4, "%02X ",
+                             cpu->mem[seg_off(cpu->ds, (uint16_t)(cpu->dx + j))]);
+                LOG_WARN(LOG_FILE, "[FILE] Open '%s' FAIL (not found) DS:DX=%04X:%04X raw=%s\n",
+                         path, cpu->ds, cpu->dx, raw);
+            }
         }
         break;
     }
 
     case 0x3E: { /* Close file */
-        fprintf(stderr, "[FILE] Close handle %d\n", cpu->bx);
-        dos_close_handle(cpu->bx);
+        LOG_INFO(LOG_FILE, "[FILE] Close handle %d\n", cpu->bx);
+        dos_close_handle(ds, cpu->bx);
         cpu->flags &= ~FLAG_CF;
         break;
     }
@@ -336,10 +897,9 @@ void dos_int21(CPU *cpu)
             uint16_t count = cpu->cx;
             uint16_t got = 0;
             /* Pump events so keys can arrive */
-            if (g_dos->poll_events)
-                g_dos->poll_events(g_dos->platform_ctx, g_dos, cpu);
-            while (got < count && keyboard_available(&g_dos->keyboard)) {
-                uint16_t key = keyboard_read(&g_dos->keyboard);
+            dos_poll_input(cpu);
+            while (got < count && keyboard_available(&ds->keyboard)) {
+                uint16_t key = keyboard_read(&ds->keyboard);
                 uint8_t ascii = (uint8_t)(key & 0xFF);
                 if (ascii == 0) continue;  /* skip extended keys */
                 cpu->mem[dest + got] = ascii;
@@ -348,63 +908,63 @@ void dos_int21(CPU *cpu)
             }
             cpu->ax = got;
             cpu->flags &= ~FLAG_CF;
-            { static int _rc0 = 0; _rc0++;
-              if (_rc0 <= 10) fprintf(stderr, "[FILE] Read stdin %u bytes -> %u\n", count, got);
-              if (_rc0 == 1) {
-                  /* Dump VGA text mode buffer and key DS variables on first stdin read */
-                  fprintf(stderr, "[DIAG] VGA text at first stdin read:\n");
-                  for (int row = 0; row < 25; row++) {
-                      char line[81];
-                      int any_nonspace = 0;
-                      for (int col = 0; col < 80; col++) {
-                          uint8_t ch = cpu->mem[0xB8000 + row * 160 + col * 2];
-                          line[col] = (ch >= 32 && ch < 127) ? (char)ch : '.';
-                          if (ch > 32 && ch < 127) any_nonspace = 1;
-                      }
-                      line[80] = 0;
-                      if (any_nonspace) fprintf(stderr, "[VGA] %02d: %s\n", row, line);
-                  }
-                  /* Dump key DS offsets */
-                  fprintf(stderr, "[DIAG] DS:0x0098=[%04X] DS:0xAA=[%04X] DS:0x6AC2=[%04X]\n",
-                      mem_read16(cpu, cpu->ds, 0x0098),
-                      mem_read16(cpu, cpu->ds, 0x00AA),
-                      mem_read16(cpu, cpu->ds, 0x6AC2));
-                  fprintf(stderr, "[DIAG] video mode=0x%02X SP=%04X BP=%04X\n",
-                      cpu->mem[0x449], cpu->sp, cpu->bp);
-              }
+            LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_FILE, 10, 0,
+                        "[FILE] Read stdin %u bytes -> %u\n", count, got);
+            static volatile uint64_t first_read;
+            if (LOG_ENABLED(LOG_LEVEL_INFO, LOG_DIAG) && log_sample(&first_read, 1, 0)) {
+                /* Dump VGA text mode buffer and key DS variables on first stdin read */
+                LOG_INFO(LOG_DIAG, "[DIAG] VGA text at first stdin read:\n");
+                for (int row = 0; row < 25; row++) {
+                    char line[81];
+                    int any_nonspace = 0;
+                    for (int col = 0; col < 80; col++) {
+                        uint8_t ch = cpu->mem[0xB8000 + row * 160 + col * 2];
+                        line[col] = (ch >= 32 && ch < 127) ? (char)ch : '.';
+                        if (ch > 32 && ch < 127) any_nonspace = 1;
+                    }
+                    line[80] = 0;
+                    if (any_nonspace) LOG_INFO(LOG_DIAG, "[VGA] %02d: %s\n", row, line);
+                }
+                /* Dump key DS offsets */
+                LOG_INFO(LOG_DIAG, "[DIAG] DS:0x0098=[%04X] DS:0xAA=[%04X] DS:0x6AC2=[%04X]\n",
+                    mem_read16(cpu, cpu->ds, 0x0098),
+                    mem_read16(cpu, cpu->ds, 0x00AA),
+                    mem_read16(cpu, cpu->ds, 0x6AC2));
+                LOG_INFO(LOG_DIAG, "[DIAG] video mode=0x%02X SP=%04X BP=%04X\n",
+                    cpu->mem[0x449], cpu->sp, cpu->bp);
             }
         } else {
-            FILE *f = dos_get_file(cpu->bx);
-            if (f) {
-                uint32_t dest = seg_off(cpu->ds, cpu->dx);
-                size_t n = fread(cpu->mem + dest, 1, cpu->cx, f);
+            uint32_t dest = seg_off(cpu->ds, cpu->dx);
+            uint32_t count = cpu->cx;
+            if (dest + count > MEM_SIZE)
+                count = MEM_SIZE - dest;
+            long n = dos_file_read(ds, cpu->bx, cpu->mem + dest, count);
+            if (n >= 0) {
                 cpu->ax = (uint16_t)n;
                 cpu->flags &= ~FLAG_CF;
-                { static int _rc = 0; _rc++;
-                  if (_rc <= 20 || n == 0) fprintf(stderr, "[FILE] Read h=%d %u bytes -> %zu (call #%d)\n", cpu->bx, cpu->cx, n, _rc);
-                }
+                if (n == 0)
+                    LOG_DEBUG(LOG_FILE, "[FILE] Read h=%d %u bytes -> EOF\n", cpu->bx, cpu->cx);
+                else
+                    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_FILE, 20, 0, "[FILE] Read h=%d %u bytes -> %ld (call #%llu)\n",
+                                cpu->bx, cpu->cx, n, (unsigned long long)log_hit);
             } else {
                 cpu->ax = 6;  /* Invalid handle */
                 cpu->flags |= FLAG_CF;
-                fprintf(stderr, "[FILE] Read h=%d FAIL (invalid)\n", cpu->bx);
+                LOG_WARN(LOG_FILE, "[FILE] Read h=%d FAIL (invalid)\n", cpu->bx);
             }
         }
         break;
     }
 
     case 0x40: { /* Write file */
-        FILE *f = dos_get_file(cpu->bx);
-        if (f) {
-            uint32_t src = seg_off(cpu->ds, cpu->dx);
-            size_t n = fwrite(cpu->mem + src, 1, cpu->cx, f);
+        uint32_t src = seg_off(cpu->ds, cpu->dx);
+        uint32_t count = cpu->cx;
+        if (src + count > MEM_SIZE)
+            count = MEM_SIZE - src;
+        long n = dos_file_write(ds, cpu->bx, cpu->mem + src, count);
+        if (n >= 0) {
             cpu->ax = (uint16_t)n;
             cpu->flags &= ~FLAG_CF;
-        } else if (cpu->bx == 1 || cpu->bx == 2) {
-            /* stdout/stderr */
-            uint32_t src = seg_off(cpu->ds, cpu->dx);
-            fwrite(cpu->mem + src, 1, cpu->cx, cpu->bx == 1 ? stdout : stderr);
-            cpu->ax = cpu->cx;
-            cpu->flags &= ~FLAG_CF;
         } else {
             cpu->ax = 6;
             cpu->flags |= FLAG_CF;
@@ -414,8 +974,14 @@ void dos_int21(CPU *cpu)
 
     case 0x41: { /* Delete file */
         char path[512];
-        dos_path_to_native(cpu, cpu->ds, cpu->dx, path, sizeof(path));
+        if (dos_path_to_native(cpu, cpu->ds, cpu->dx, path, sizeof(path)) < 0) {
+            cpu->ax = 3;  /* Path not found */
+            cpu->flags |= FLAG_CF;
+            break;
+        }
+        dir_lookup(ds, path, sizeof(path));
         if (remove(path) == 0) {
+            dir_forget(ds, path);
             cpu->flags &= ~FLAG_CF;
         } else {
             cpu->ax = 2;
@@ -425,23 +991,22 @@ void dos_int21(CPU *cpu)
     }
 
     case 0x42: { /* Move file pointer (seek) */
-        FILE *f = dos_get_file(cpu->bx);
-        if (f) {
-            long offset = (long)(((uint32_t)cpu->cx << 16) | cpu->dx);
-            int whence;
-            switch (cpu->al) {
-                case 0: whence = SEEK_SET; break;
-                case 1: whence = SEEK_CUR; break;
-                case 2: whence = SEEK_END; break;
-                default: whence = SEEK_SET; break;
-            }
-            fseek(f, offset, whence);
-            long pos = ftell(f);
+        /* CX:DX is a signed offset from the start, current position or end */
+        long offset = (long)(int32_t)(((uint32_t)cpu->cx << 16) | cpu->dx);
+        int whence;
+        switch (cpu->al) {
+            case 0: whence = SEEK_SET; break;
+            case 1: whence = SEEK_CUR; break;
+            case 2: whence = SEEK_END; break;
+            default: whence = SEEK_SET; break;
+        }
+        long pos = dos_file_seek(ds, cpu->bx, offset, whence);
+        if (pos >= 0) {
             cpu->ax = (uint16_t)(pos & 0xFFFF);
             cpu->dx = (uint16_t)((pos >> 16) & 0xFFFF);
             cpu->flags &= ~FLAG_CF;
         } else {
-            cpu->ax = 6;
+            cpu->ax = dos_get_file(ds, cpu->bx) ? 0x19 : 6;  /* Seek error / invalid handle */
             cpu->flags |= FLAG_CF;
         }
         break;
@@ -458,30 +1023,38 @@ void dos_int21(CPU *cpu)
     case 0x48: { /* Allocate memory */
         /* BX = paragraphs requested */
         uint16_t paras = cpu->bx;
-        if (g_dos->mem_top + paras < 0xA000) {
-            cpu->ax = g_dos->mem_top;
-            fprintf(stderr, "[DOS] Alloc %u paras (%u bytes) -> seg 0x%04X\n",
-                    paras, (unsigned)paras * 16, cpu->ax);
-            g_dos->mem_top += paras;
+        if (ds->mem_top + paras < 0xA000) {
+            cpu->ax = ds->mem_top;
+            LOG_INFO(LOG_DOS, "[DOS] Alloc %u paras (%u bytes) -> seg 0x%04X\n",
+                     paras, (unsigned)paras * 16, cpu->ax);
+            ds->mem_top += paras;
             cpu->flags &= ~FLAG_CF;
         } else {
             cpu->ax = 8;  /* Insufficient memory */
-            cpu->bx = (uint16_t)(0xA000 - g_dos->mem_top);
-            fprintf(stderr, "[DOS] Alloc FAIL: %u paras requested, %u available\n",
-                    paras, cpu->bx);
+            cpu->bx = (uint16_t)(0xA000 - ds->mem_top);
+            LOG_WARN(LOG_DOS, "[DOS] Alloc FAIL: %u paras requested, %u available\n",
+                     paras, cpu->bx);
             cpu->flags |= FLAG_CF;
         }
         break;
     }
 
     case 0x43: { /* Get/Set file attributes */
-        if (cpu->al == 0x00) {
-            /* Get file attributes: DS:DX = filename */
-            /* Return CX = normal file attributes */
-            cpu->cx = 0x0020; /* Archive bit set (normal file) */
-            cpu->flags &= ~FLAG_CF;
+        /* DS:DX = filename; attributes come from the directory cache */
+        char path[512];
+        if (dos_path_to_native(cpu, cpu->ds, cpu->dx, path, sizeof(path)) < 0) {
+            cpu->ax = 3;  /* Path not found */
+            cpu->flags |= FLAG_CF;
+            break;
+        }
+        int attr = dos_file_attributes(ds, path, sizeof(path));
+        if (attr < 0) {
+            cpu->ax = 2;  /* File not found */
+            cpu->flags |= FLAG_CF;
         } else {
-            /* Set file attributes - just succeed */
+            if (cpu->al == 0x00)
+                cpu->cx = (uint16_t)attr;
+            /* Setting attributes just succeeds */
             cpu->flags &= ~FLAG_CF;
         }
         break;
@@ -527,7 +1100,7 @@ void dos_int21(CPU *cpu)
             cpu->flags &= ~FLAG_CF;
             break;
         default:
-            fprintf(stderr, "[DOS] Unhandled IOCTL sub-function AL=%02Xh BX=%04Xh\n", al, cpu->bx);
+            LOG_WARN(LOG_DOS, "[DOS] Unhandled IOCTL sub-function AL=%02Xh BX=%04Xh\n", al, cpu->bx);
             cpu->flags &= ~FLAG_CF;
             break;
         }
@@ -536,6 +1109,7 @@ void dos_int21(CPU *cpu)
 
     case 0x4C: /* Terminate with return code */
         printf("[DOS] Program exit with code %d\n", cpu->al);
+        dos_close_all(ds);
         cpu->halted = 1;
         break;
 
@@ -544,8 +1118,8 @@ void dos_int21(CPU *cpu)
         break;
 
     default:
-        fprintf(stderr, "[DOS] Unhandled INT 21h AH=%02Xh AL=%02Xh BX=%04Xh CX=%04Xh DX=%04Xh\n",
-                ah, cpu->al, cpu->bx, cpu->cx, cpu->dx);
+        LOG_WARN(LOG_DOS, "[DOS] Unhandled INT 21h AH=%02Xh AL=%02Xh BX=%04Xh CX=%04Xh DX=%04Xh\n",
+                 ah, cpu->al, cpu->bx, cpu->cx, cpu->dx);
         break;
     }
 }
@@ -561,12 +1135,13 @@ void bios_int10(CPU *cpu)
 {
     switch (cpu->ah) {
     case 0x00: /* Set video mode */
-        fprintf(stderr, "[VIDEO] Set mode 0x%02X\n", cpu->al);
+        LOG_INFO(LOG_GFX, "[VIDEO] Set mode 0x%02X\n", cpu->al);
         /* Store current mode in BIOS data area */
         mem_write8(cpu, 0x0040, 0x0049, cpu->al);
         if (cpu->al == 0x13) {
             /* Mode 13h: 320x200x256 - clear VGA framebuffer */
             memset(&cpu->mem[0xA0000], 0, 64000);
+            vga_mark_rows(cpu, 0, VGA_ROWS);
             mem_write16(cpu, 0x0040, 0x004A, 40);
         } else if (cpu->al <= 0x03) {
             /* Text mode - clear text mode buffer */
@@ -650,26 +1225,22 @@ void bios_int10(CPU *cpu)
 
 void bios_int16(CPU *cpu)
 {
-    KeyboardState *ks = &g_dos->keyboard;
+    DosState *ds = cpu->dos;
+    KeyboardState *ks = &ds->keyboard;
 
     switch (cpu->ah) {
     case 0x00: /* Read key (blocking) */
     case 0x10: /* Extended read key */
-        fprintf(stderr, "[BLOCK] Waiting for key in INT 16h/%02Xh\n", cpu->ah);
-        while (!keyboard_available(ks)) {
-            if (g_dos->poll_events)
-                g_dos->poll_events(g_dos->platform_ctx, g_dos, cpu);
-        }
+        LOG_DEBUG(LOG_KEY, "[BLOCK] Waiting for key in INT 16h/%02Xh\n", cpu->ah);
+        dos_wait_input(cpu, DOS_WAIT_FOREVER);
         cpu->ax = keyboard_read(ks);
-        fprintf(stderr, "[KEY] INT 16h/%02Xh: 0x%04X\n", cpu->ah, cpu->ax);
+        LOG_INFO(LOG_KEY, "[KEY] INT 16h/%02Xh: 0x%04X\n", cpu->ah, cpu->ax);
         break;
 
     case 0x01: /* Check for key */
     case 0x11:
         /* Pump events before checking */
-        if (g_dos->poll_events)
-            g_dos->poll_events(g_dos->platform_ctx, g_dos, cpu);
-        if (keyboard_available(ks)) {
+        if (dos_poll_input(cpu)) {
             cpu->ax = ks->keybuf[ks->head];
             cpu->flags &= ~FLAG_ZF;  /* Key available */
         } else {
@@ -690,7 +1261,7 @@ void bios_int16(CPU *cpu)
 
 void mouse_int33(CPU *cpu)
 {
-    MouseState *ms = &g_dos->mouse;
+    MouseState *ms = &cpu->dos->mouse;
 
     switch (cpu->ax) {
     case 0x0000: /* Reset / detect mouse */
@@ -739,17 +1310,121 @@ void mouse_int33(CPU *cpu)
     }
 }
 
+/* ─── Installed interrupt handlers ─── */
+
+/* Most IRQ0s run back to back when the game falls behind; the rest are
+ * dropped, as on a PC that held interrupts off that long */
+#define IRQ0_CATCH_UP   8
+
+/*
+ * Run the handler at vector vec as the hardware would: FLAGS and a far
+ * return address pushed, IF cleared. A lifted IRET leaves the frame on
+ * the stack, and the handler may have been interrupted code's only
+ * user of the lazy flags, so the interrupted state is put back whole
+ * afterwards rather than trusting the handler's pops.
+ */
+static void call_vector(CPU *cpu, uint32_t vec)
+{
+    uint32_t eax = cpu->eax, ebx = cpu->ebx, ecx = cpu->ecx, edx = cpu->edx;
+    uint16_t si = cpu->si, di = cpu->di, bp = cpu->bp, sp = cpu->sp;
+    uint16_t cs = cpu->cs, ds = cpu->ds, es = cpu->es, ss = cpu->ss;
+    uint16_t flags = cpu->flags;
+    int dir = cpu->dir;
+    uint8_t lf_op = cpu->lf_op, lf_cf = cpu->lf_cf;
+    uint16_t lf_sign = cpu->lf_sign;
+    uint32_t lf_a = cpu->lf_a, lf_b = cpu->lf_b, lf_res = cpu->lf_res;
+
+    push16(cpu, flags_get(cpu));
+    push16(cpu, cpu->cs);
+    push16(cpu, 0);
+    cpu->flags &= ~FLAG_IF;
+    recomp_dispatch(cpu, (uint16_t)(vec >> 16), (uint16_t)vec);
+
+    cpu->eax = eax; cpu->ebx = ebx; cpu->ecx = ecx; cpu->edx = edx;
+    cpu->si = si; cpu->di = di; cpu->bp = bp; cpu->sp = sp;
+    set_sreg(cpu, SREG_CS, cs);
+    set_sreg(cpu, SREG_DS, ds);
+    set_sreg(cpu, SREG_ES, es);
+    set_sreg(cpu, SREG_SS, ss);
+    cpu->flags = flags;
+    cpu->dir = dir;
+    cpu->lf_op = lf_op; cpu->lf_cf = lf_cf; cpu->lf_sign = lf_sign;
+    cpu->lf_a = lf_a; cpu->lf_b = lf_b; cpu->lf_res = lf_res;
+}
+
+/*
+ * Hand the IRQ0s due to the game: its INT 08h handler if it installed
+ * one, then INT 1Ch, which the BIOS INT 08h handler calls on every
+ * tick. Without either they are just counted off. With IF clear they
+ * wait for a later safe point; handlers don't nest.
+ */
+void cpu_safe_point(CPU *cpu)
+{
+    cpu->safe_countdown = SAFE_POINT_INTERVAL;
+    DosState *ds = cpu->dos;
+    if (!ds || cpu->in_irq)
+        return;
+
+    TimerState *ts = &ds->timer;
+    uint32_t pending = timer_irq_sync(ts);
+    if (pending == 0)
+        return;
+
+    uint32_t v08 = ds->ivt[0x08], v1c = ds->ivt[0x1C];
+    if (!v08 && !v1c) {
+        ts->irq_done = ts->irq_due;
+        return;
+    }
+    if (!(cpu->flags & FLAG_IF))
+        return;
+
+    if (pending > IRQ0_CATCH_UP) {
+        LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_INT, 3, 1000, "[IRQ0] #%llu dropped %u ticks\n",
+                    (unsigned long long)log_hit, pending - IRQ0_CATCH_UP);
+        ts->irq_done = ts->irq_due - IRQ0_CATCH_UP;
+        pending = IRQ0_CATCH_UP;
+    }
+
+    cpu->in_irq = 1;
+    for (; pending > 0; pending--) {
+        ts->irq_done++;
+        if (v08)
+            call_vector(cpu, v08);
+        if (v1c)
+            call_vector(cpu, v1c);
+    }
+    cpu->in_irq = 0;
+}
+
 /* ─── Generic interrupt handler ─── */
 
 void int_handler(CPU *cpu, uint8_t num)
 {
-    static uint64_t call_count = 0;
-    call_count++;
-    if (call_count <= 3 || (call_count % 5000) == 0)
-        fprintf(stderr, "[INT] #%llu int=0x%02X\n", (unsigned long long)call_count, num);
+    DosState *ds = cpu->dos;
+    LOG_SAMPLED(LOG_LEVEL_DEBUG, LOG_INT, 3, 5000, "[INT] #%llu int=0x%02X\n",
+                (unsigned long long)log_hit, num);
     switch (num) {
     case 0x08: /* Timer tick - update timer state */
-        timer_update(&g_dos->timer, 0);  /* Will use SDL tick in main loop */
+    case 0x1C: /* User timer tick */
+        timer_update(&ds->timer, timer_now_ms(&ds->timer));
+        /* A software INT goes to the installed handler, if any */
+        if (ds->ivt[num] && !cpu->in_irq) {
+            cpu->in_irq = 1;
+            call_vector(cpu, ds->ivt[num]);
+            cpu->in_irq = 0;
+        }
+        break;
+
+    case 0x1A: /* BIOS time services */
+        if (cpu->ah == 0x00) {
+            /* Get tick count: CX:DX = ticks since midnight, AL = rollover.
+             * Wait loops spin on this, so it counts as a poll. */
+            timer_update(&ds->timer, timer_now_ms(&ds->timer));
+            uint32_t ticks = timer_poll(&ds->timer);
+            cpu->cx = (uint16_t)(ticks >> 16);
+            cpu->dx = (uint16_t)(ticks & 0xFFFF);
+            cpu->al = 0;
+        }
         break;
 
     case 0x20: /* Terminate */
@@ -766,7 +1441,7 @@ void int_handler(CPU *cpu, uint8_t num)
 
 void port_out8(CPU *cpu, uint16_t port, uint8_t value)
 {
-    DosState *ds = g_dos;
+    DosState *ds = cpu->dos;
 
     /* VGA DAC palette ports */
     if (port >= 0x3C7 && port <= 0x3C9) {
@@ -774,6 +1449,15 @@ void port_out8(CPU *cpu, uint16_t port, uint8_t value)
         return;
     }
 
+    /* AdLib, PC speaker and its PIT channel 2; the clock is only read
+     * for the event timestamp while a device is playing */
+    if (port == 0x388 || port == 0x389 || port == 0x42 || port == 0x61 ||
+        (port == 0x43 && (value >> 6) == 2)) {
+        audio_port_write(&ds->audio, port, value,
+                         audio_is_active(&ds->audio) ? timer_now_ms(&ds->timer) : 0);
+        return;
+    }
+
     /* PIT timer ports */
     if (port == 0x40 || port == 0x43) {
         timer_port_write(&ds->timer, port, value);
@@ -786,12 +1470,11 @@ void port_out8(CPU *cpu, uint16_t port, uint8_t value)
     }
 
     /* All other ports: silently ignore */
-    (void)cpu;
 }
 
 uint8_t port_in8(CPU *cpu, uint16_t port)
 {
-    DosState *ds = g_dos;
+    DosState *ds = cpu->dos;
 
     /* VGA status register */
     if (port == 0x3DA) {
@@ -803,18 +1486,22 @@ uint8_t port_in8(CPU *cpu, uint16_t port)
         return video_port_read(&ds->video, port);
     }
 
-    /* PIT timer read */
+    /* PIT timer read: only ever done to measure time, so this is a
+     * tick poll as far as turbo is concerned */
     if (port == 0x40) {
+        timer_update(&ds->timer, timer_now_ms(&ds->timer));
+        timer_poll(&ds->timer);
         return timer_port_read(&ds->timer, port);
     }
 
     /* DMA channel word count registers (0x01, 0x03, 0x05, 0x07) */
     /* Port 0x0004 is not a standard DMA port but CIV.EXE reads it in a
      * timing loop, expecting the value to change.  Return a fast-moving
-     * counter so the loop exits quickly. */
+     * counter so the loop exits quickly, and let turbo see the wait. */
     if (port <= 0x07 || port == 0x0004) {
-        static uint8_t dma_counter = 0;
-        return dma_counter++;
+        if (port == 0x0004)
+            timer_poll(&ds->timer);
+        return ds->dma_counter++;
     }
 
     /* Keyboard data port */
@@ -822,6 +1509,10 @@ uint8_t port_in8(CPU *cpu, uint16_t port)
         return 0;  /* No key */
     }
 
-    (void)cpu;
+    /* AdLib status, speaker control */
+    if (port == 0x388 || port == 0x389 || port == 0x61) {
+        return audio_port_read(&ds->audio, port);
+    }
+
     return 0;
 }
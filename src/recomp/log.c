@@ -0,0 +1,271 @@
+/*
+ * log.c - Channelled logging with a lock-free ring buffer
+ *
+ * The ring is a bounded multi-producer queue (Vyukov): each slot carries
+ * a sequence number that tells producers when it is free and the drain
+ * thread when it has been filled, so neither side ever takes a lock.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L     /* nanosleep */
+#endif
+
+#include "recomp/log.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define LOG_RING_SIZE   4096    /* Slots, power of two */
+#define LOG_MSG_MAX     240
+
+/* ─── Atomics ─── */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static uint32_t load_acquire(volatile uint32_t *p) { return (uint32_t)_InterlockedOr((volatile long *)p, 0); }
+static void store_release(volatile uint32_t *p, uint32_t v) { _InterlockedExchange((volatile long *)p, (long)v); }
+static int cas(volatile uint32_t *p, uint32_t expect, uint32_t v)
+{
+    return (uint32_t)_InterlockedCompareExchange((volatile long *)p, (long)v, (long)expect) == expect;
+}
+static void fetch_inc(volatile uint32_t *p) { _InterlockedIncrement((volatile long *)p); }
+static uint32_t exchange(volatile uint32_t *p, uint32_t v) { return (uint32_t)_InterlockedExchange((volatile long *)p, (long)v); }
+#else
+static uint32_t load_acquire(volatile uint32_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void store_release(volatile uint32_t *p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static int cas(volatile uint32_t *p, uint32_t expect, uint32_t v)
+{
+    return __atomic_compare_exchange_n(p, &expect, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+static void fetch_inc(volatile uint32_t *p) { __atomic_fetch_add(p, 1, __ATOMIC_RELAXED); }
+static uint32_t exchange(volatile uint32_t *p, uint32_t v) { return __atomic_exchange_n(p, v, __ATOMIC_RELAXED); }
+#endif
+
+/* ─── State ─── */
+
+typedef struct {
+    volatile uint32_t seq;
+    uint16_t          len;
+    char              text[LOG_MSG_MAX];
+} LogSlot;
+
+static LogSlot           g_ring[LOG_RING_SIZE];
+static volatile uint32_t g_head;        /* Next slot to claim (producers) */
+static volatile uint32_t g_tail;        /* Next slot to drain (drain thread) */
+static volatile uint32_t g_dropped;
+static volatile uint32_t g_running;
+
+uint8_t log_levels[LOG_CHANNEL_COUNT] = {
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO,
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO,
+};
+
+static const char *channel_names[LOG_CHANNEL_COUNT] = {
+    "FILE", "GFX", "INT", "KEY", "DOS", "DIAG",
+};
+
+/* ─── Producer ─── */
+
+void log_write(LogChannel chan, const char *fmt, ...)
+{
+    va_list ap;
+    (void)chan;
+
+    if (!g_running) {
+        va_start(ap, fmt);
+        vfprintf(stderr, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    uint32_t pos = load_acquire(&g_head);
+    LogSlot *slot;
+    for (;;) {
+        slot = &g_ring[pos & (LOG_RING_SIZE - 1)];
+        int32_t dif = (int32_t)(load_acquire(&slot->seq) - pos);
+        if (dif == 0) {
+            if (cas(&g_head, pos, pos + 1)) break;
+        } else if (dif < 0) {
+            fetch_inc(&g_dropped);      /* Ring full */
+            return;
+        }
+        pos = load_acquire(&g_head);
+    }
+
+    va_start(ap, fmt);
+    int n = vsnprintf(slot->text, LOG_MSG_MAX, fmt, ap);
+    va_end(ap);
+    slot->len = (uint16_t)(n < 0 ? 0 : n >= LOG_MSG_MAX ? LOG_MSG_MAX - 1 : n);
+    store_release(&slot->seq, pos + 1);
+}
+
+/* ─── Drain ─── */
+
+/* Write out ready slots; returns how many. Only one thread drains. */
+static int drain(void)
+{
+    int n = 0;
+    uint32_t tail = g_tail;
+    for (;;) {
+        LogSlot *slot = &g_ring[tail & (LOG_RING_SIZE - 1)];
+        if (load_acquire(&slot->seq) != tail + 1) break;
+        fwrite(slot->text, 1, slot->len, stderr);
+        store_release(&slot->seq, tail + LOG_RING_SIZE);
+        tail++;
+        n++;
+    }
+    store_release(&g_tail, tail);
+    uint32_t lost = exchange(&g_dropped, 0);
+    if (lost)
+        fprintf(stderr, "[LOG] %u messages dropped (ring full)\n", lost);
+    if (n || lost)
+        fflush(stderr);
+    return n;
+}
+
+#ifdef _WIN32
+static HANDLE g_thread;
+static void sleep_ms(int ms) { Sleep((DWORD)ms); }
+#else
+static pthread_t g_thread;
+static void sleep_ms(int ms)
+{
+    struct timespec ts = { 0, ms * 1000000L };
+    nanosleep(&ts, NULL);
+}
+#endif
+
+/* The drain thread stops once g_running is cleared and the ring is empty */
+#ifdef _WIN32
+static unsigned __stdcall drain_thread(void *arg)
+#else
+static void *drain_thread(void *arg)
+#endif
+{
+    (void)arg;
+    while (load_acquire(&g_running)) {
+        if (!drain())
+            sleep_ms(5);
+    }
+    drain();
+    return 0;
+}
+
+static void log_shutdown(void)
+{
+    if (!g_running) return;
+    store_release(&g_running, 0);
+#ifdef _WIN32
+    WaitForSingleObject(g_thread, INFINITE);
+    CloseHandle(g_thread);
+#else
+    pthread_join(g_thread, NULL);
+#endif
+}
+
+void log_init(void)
+{
+    if (g_running || CIV_LOG_LEVEL == LOG_LEVEL_OFF) return;
+
+    for (uint32_t i = 0; i < LOG_RING_SIZE; i++)
+        g_ring[i].seq = i;
+    g_head = g_tail = 0;
+    store_release(&g_running, 1);
+
+#ifdef _WIN32
+    g_thread = (HANDLE)_beginthreadex(NULL, 0, drain_thread, NULL, 0, NULL);
+    if (!g_thread) {
+#else
+    if (pthread_create(&g_thread, NULL, drain_thread, NULL) != 0) {
+#endif
+        g_running = 0;
+        fprintf(stderr, "[LOG] Cannot start drain thread, logging synchronously\n");
+        return;
+    }
+    atexit(log_shutdown);
+}
+
+void log_flush(void)
+{
+    if (!g_running) {
+        fflush(stderr);
+        return;
+    }
+    /* Wait (up to ~200 ms) for the drain thread to pass what is queued now */
+    uint32_t target = load_acquire(&g_head);
+    for (int tries = 0; tries < 200; tries++) {
+        if ((int32_t)(load_acquire(&g_tail) - target) >= 0)
+            return;
+        sleep_ms(1);
+    }
+}
+
+/* ─── Configuration ─── */
+
+static int name_eq(const char *s, size_t len, const char *name)
+{
+    if (strlen(name) != len) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)s[i]) != tolower((unsigned char)name[i]))
+            return 0;
+    }
+    return 1;
+}
+
+static int parse_level(const char *s, size_t len)
+{
+    static const char *names[] = { "off", "warn", "info", "debug" };
+    if (len == 1 && s[0] >= '0' && s[0] <= '3')
+        return s[0] - '0';
+    for (int i = 0; i < 4; i++) {
+        if (name_eq(s, len, names[i]))
+            return i;
+    }
+    return -1;
+}
+
+int log_configure(const char *spec)
+{
+    while (*spec) {
+        const char *end = strchr(spec, ',');
+        size_t len = end ? (size_t)(end - spec) : strlen(spec);
+        const char *eq = memchr(spec, '=', len);
+        if (!eq) {
+            fprintf(stderr, "[LOG] Bad --log entry '%.*s' (want CHAN=level)\n", (int)len, spec);
+            return -1;
+        }
+
+        size_t name_len = (size_t)(eq - spec);
+        int level = parse_level(eq + 1, len - name_len - 1);
+        int chan = -1;
+        for (int i = 0; i < LOG_CHANNEL_COUNT; i++) {
+            if (name_eq(spec, name_len, channel_names[i]))
+                chan = i;
+        }
+        int all = name_eq(spec, name_len, "ALL");
+        if (level < 0 || (chan < 0 && !all)) {
+            fprintf(stderr, "[LOG] Unknown channel or level in '%.*s'\n", (int)len, spec);
+            return -1;
+        }
+
+        for (int i = 0; i < LOG_CHANNEL_COUNT; i++) {
+            if (all || i == chan)
+                log_levels[i] = (uint8_t)level;
+        }
+        spec = end ? end + 1 : spec + len;
+    }
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * override.c - Override registry and --verify-overrides
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "recomp/override.h"
+#include "recomp/log.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VERIFY_FLAGS  (FLAG_CF | FLAG_PF | FLAG_AF | FLAG_ZF | FLAG_SF | FLAG_OF | FLAG_DF)
+
+/* Mismatches logged in full per override; the rest are only counted */
+#define VERIFY_LOG_MAX  8
+
+int override_verify;
+
+static Override *const *g_list;
+static unsigned g_count;
+
+static uint8_t *g_before;       /* Memory as the call found it */
+static uint8_t *g_native;       /* Memory after the override ran */
+static int g_active;            /* A check is in progress */
+static int g_selftest;          /* Mismatches are expected, don't log them */
+
+static int selftest(void);
+
+int override_init(Override *const *list, unsigned count)
+{
+    g_list = list;
+    g_count = count;
+    fprintf(stderr, "[OVERRIDE] %u registered override(s)%s\n", count,
+            override_verify ? ", verifying every call" : "");
+    if (!override_verify)
+        return 0;
+
+    g_before = (uint8_t *)malloc(MEM_SIZE);
+    g_native = (uint8_t *)malloc(MEM_SIZE);
+    if (!g_before || !g_native) {
+        fprintf(stderr, "Error: failed to allocate %d bytes for --verify-overrides\n",
+                2 * MEM_SIZE);
+        free(g_before);
+        free(g_native);
+        g_before = g_native = NULL;
+        override_verify = 0;
+        return -1;
+    }
+    if (selftest() != 0) {
+        fprintf(stderr, "Error: --verify-overrides failed its self-check, not verifying\n");
+        free(g_before);
+        free(g_native);
+        g_before = g_native = NULL;
+        override_verify = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/* ─── Comparison ─── */
+
+typedef struct {
+    const char *name;
+    uint16_t    mask;
+    size_t      offset;
+} RegField;
+
+static const RegField reg_fields[] = {
+    { "ax", OVR_AX, offsetof(CPU, ax) },
+    { "bx", OVR_BX, offsetof(CPU, bx) },
+    { "cx", OVR_CX, offsetof(CPU, cx) },
+    { "dx", OVR_DX, offsetof(CPU, dx) },
+    { "si", OVR_SI, offsetof(CPU, si) },
+    { "di", OVR_DI, offsetof(CPU, di) },
+    { "bp", OVR_BP, offsetof(CPU, bp) },
+    { "sp", OVR_SP, offsetof(CPU, sp) },
+    { "cs", OVR_CS, offsetof(CPU, cs) },
+    { "ds", OVR_DS, offsetof(CPU, ds) },
+    { "es", OVR_ES, offsetof(CPU, es) },
+    { "ss", OVR_SS, offsetof(CPU, ss) },
+};
+
+static uint16_t reg_value(const CPU *cpu, const RegField *f)
+{
+    uint16_t v;
+    memcpy(&v, (const uint8_t *)cpu + f->offset, sizeof(v));
+    return v;
+}
+
+/* Differing bytes of a and b in [lo, hi); logs the first few */
+static uint32_t diff_range(const uint8_t *a, const uint8_t *b, uint32_t lo, uint32_t hi,
+                           int report, uint32_t *first)
+{
+    uint32_t n = 0;
+    if (lo >= hi || memcmp(a + lo, b + lo, hi - lo) == 0)
+        return 0;
+    for (uint32_t i = lo; i < hi; i++) {
+        if (a[i] == b[i])
+            continue;
+        if (n == 0 && *first == UINT32_MAX)
+            *first = i;
+        if (report && n < 4)
+            LOG_WARN(LOG_DIAG, "[OVERRIDE]   mem %05X: override %02X, lifted %02X\n",
+                     i, a[i], b[i]);
+        n++;
+    }
+    return n;
+}
+
+/* Compare the override's result (native, g_native) with the lifted one
+ * (cpu, cpu->mem). Returns the number of differences. */
+static unsigned compare(const Override *ov, const CPU *native, const CPU *cpu, int report)
+{
+    unsigned diffs = 0;
+
+    for (size_t i = 0; i < sizeof(reg_fields) / sizeof(reg_fields[0]); i++) {
+        const RegField *f = &reg_fields[i];
+        uint16_t a = reg_value(native, f), b = reg_value(cpu, f);
+        if ((ov->clobbers & f->mask) || a == b)
+            continue;
+        if (report)
+            LOG_WARN(LOG_DIAG, "[OVERRIDE]   %s: override %04X, lifted %04X\n", f->name, a, b);
+        diffs++;
+    }
+    if (!(ov->clobbers & OVR_FLAGS) &&
+        ((native->flags ^ cpu->flags) & VERIFY_FLAGS)) {
+        if (report)
+            LOG_WARN(LOG_DIAG, "[OVERRIDE]   flags: override %04X, lifted %04X\n",
+                     native->flags & VERIFY_FLAGS, cpu->flags & VERIFY_FLAGS);
+        diffs++;
+    }
+
+    /* Everything but the dead stack below the lifted code's final SP */
+    uint32_t top = seg_off(cpu->ss, cpu->sp);
+    uint32_t bottom = top > OVERRIDE_STACK_SLACK ? top - OVERRIDE_STACK_SLACK : 0;
+    uint32_t first = UINT32_MAX;
+    uint32_t bytes = diff_range(g_native, cpu->mem, 0, bottom, report, &first) +
+                     diff_range(g_native, cpu->mem, top, MEM_SIZE, report, &first);
+    if (bytes) {
+        if (report)
+            LOG_WARN(LOG_DIAG, "[OVERRIDE]   %u memory byte(s) differ, first at %05X\n",
+                     bytes, first);
+        diffs++;
+    }
+    return diffs;
+}
+
+/* ─── Verification ─── */
+
+void override_verify_call(CPU *cpu, Override *ov)
+{
+    if (g_active || !g_before || !ov->lifted) {
+        ov->native(cpu);
+        return;
+    }
+    g_active = 1;
+
+    /* No timer interrupts in either run: only the lifted one has safe
+     * points, so they would differ by whatever the handler did */
+    uint8_t in_irq = cpu->in_irq;
+    cpu->in_irq = 1;
+
+    flags_sync(cpu);
+    CPU before = *cpu;
+    memcpy(g_before, cpu->mem, MEM_SIZE);
+
+    ov->native(cpu);
+    flags_sync(cpu);
+    CPU native = *cpu;
+    memcpy(g_native, cpu->mem, MEM_SIZE);
+
+    /* The lifted original runs from the same state, and its result stays */
+    memcpy(cpu->mem, g_before, MEM_SIZE);
+    *cpu = before;
+    cpu->calls = native.calls;
+    ov->lifted(cpu);
+    flags_sync(cpu);
+    for (int i = 0; i < VGA_DIRTY_WORDS; i++)
+        cpu->vga_dirty[i] |= native.vga_dirty[i];
+
+    ov->checked++;
+    if (compare(ov, &native, cpu, 0)) {
+        if (!g_selftest && ov->mismatches < VERIFY_LOG_MAX) {
+            LOG_WARN(LOG_DIAG, "[OVERRIDE] %s differs from the lifted original "
+                     "(call %llu, entered with SS:SP %04X:%04X)\n", ov->name,
+                     (unsigned long long)ov->checked, before.ss, before.sp);
+            compare(ov, &native, cpu, 1);
+        }
+        ov->mismatches++;
+    }
+
+    cpu->in_irq = in_irq;
+    g_active = 0;
+}
+
+/* ─── Self-check ─── */
+/* Before any game code runs, a routine verified against itself must
+ * match on every call, and copies that leave one register, one flag or
+ * one byte different must each be caught. */
+
+#define SELFTEST_CALLS  4
+
+/* Stands in for a lifted routine: a frame on the stack, a store
+ * through ES:DI, results in AX and CF */
+static void selftest_ref(CPU *cpu)
+{
+    push16(cpu, cpu->bp);
+    cpu->bp = cpu->sp;
+    push16(cpu, cpu->si);
+    for (uint16_t i = 0; i < 16; i++)
+        mem_write8(cpu, cpu->es, (uint16_t)(cpu->di + i), (uint8_t)(cpu->di + 3 * i));
+    cpu->ax = (uint16_t)(cpu->di * 5 + 1);
+    cpu->lf_op = LF_NONE;
+    cpu->flags = (uint16_t)((cpu->flags & ~FLAG_CF) | ((cpu->di & 1) ? FLAG_CF : 0));
+    cpu->si = pop16(cpu);
+    cpu->bp = pop16(cpu);
+}
+
+static void selftest_bad_reg(CPU *cpu)
+{
+    selftest_ref(cpu);
+    cpu->bx ^= 1;
+}
+
+static void selftest_bad_flag(CPU *cpu)
+{
+    selftest_ref(cpu);
+    cpu->flags ^= FLAG_ZF;
+}
+
+static void selftest_bad_mem(CPU *cpu)
+{
+    selftest_ref(cpu);
+    cpu->mem[seg_off(cpu->ds, 0x10)] ^= 0x80;
+}
+
+static int selftest(void)
+{
+    Override cases[] = {
+        { .name = "self",      .native = selftest_ref,      .lifted = selftest_ref },
+        { .name = "bad reg",   .native = selftest_bad_reg,  .lifted = selftest_ref },
+        { .name = "bad flag",  .native = selftest_bad_flag, .lifted = selftest_ref },
+        { .name = "bad mem",   .native = selftest_bad_mem,  .lifted = selftest_ref },
+        /* A clobbered register is allowed to differ */
+        { .name = "clobber",   .native = selftest_bad_reg,  .lifted = selftest_ref,
+          .clobbers = OVR_BX },
+    };
+    const int want_match[] = { 1, 0, 0, 0, 1 };
+
+    CPU *cpu = (CPU *)calloc(1, sizeof(CPU));
+    uint8_t *mem = (uint8_t *)calloc(1, MEM_SIZE);
+    int failed = !cpu || !mem;
+    for (size_t i = 0; !failed && i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Override *ov = &cases[i];
+        memset(cpu, 0, sizeof(*cpu));
+        memset(mem, 0, MEM_SIZE);
+        cpu->mem = mem;
+        cpu->ss = 0x3000;
+        cpu->sp = 0xFFF0;
+        cpu->ds = 0x2000;
+        cpu->es = 0x1000;
+        cpu_sync_sregs(cpu);
+        g_selftest = 1;
+        for (uint16_t n = 0; n < SELFTEST_CALLS; n++) {
+            cpu->di = (uint16_t)(0x100 + 0x35 * n);
+            override_verify_call(cpu, ov);
+        }
+        g_selftest = 0;
+        int matched = ov->mismatches == 0;
+        if (ov->checked != SELFTEST_CALLS || matched != want_match[i] ||
+            (!matched && ov->mismatches != SELFTEST_CALLS)) {
+            fprintf(stderr, "[OVERRIDE] Self-check '%s': %llu of %llu calls differ\n",
+                    ov->name, (unsigned long long)ov->mismatches,
+                    (unsigned long long)ov->checked);
+            failed = 1;
+        }
+    }
+    free(cpu);
+    free(mem);
+    return failed ? -1 : 0;
+}
+
+void override_report(void)
+{
+    if (!override_verify)
+        return;
+    fprintf(stderr, "[OVERRIDE] %-24s %12s %12s\n", "override", "checked", "mismatches");
+    for (unsigned i = 0; i < g_count; i++) {
+        const Override *ov = g_list[i];
+        fprintf(stderr, "[OVERRIDE] %-24s %12llu %12llu\n", ov->name,
+                (unsigned long long)ov->checked, (unsigned long long)ov->mismatches);
+    }
+}
@@ -0,0 +1,278 @@
+/*
+ * pic.c - MicroProse .PIC image decoding
+ *
+ * The LZW here reproduces the game's decoder exactly, quirks included:
+ * every code adds a dictionary entry (the first one after a reset links
+ * to the last code before it), and a reset keeps the bytes of the old
+ * entries, clearing only their prefix links.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "recomp/pic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PIC_TAG(a, b)   ((uint16_t)((a) | ((b) << 8)))
+
+/* ─── LZW + RLE ─── */
+
+/* Read next variable-width code; the unconsumed bits are the top
+ * bits_avail bits of bit_buf */
+static uint16_t read_code(PicDecoder *d)
+{
+    uint8_t shift = 16 - d->bits_avail;
+    uint16_t bx = (shift < 16) ? (uint16_t)(d->bit_buf >> shift) : 0;
+    uint8_t cl = d->bits_avail;
+
+    while (cl < d->code_bits) {
+        d->bit_buf = d->read_word(d->ctx);
+        bx |= (uint16_t)(d->bit_buf << cl);
+        cl += 16;
+    }
+
+    d->bits_avail = cl - d->code_bits;
+    return bx & d->max_code;
+}
+
+void pic_reset_dict(PicDecoder *d)
+{
+    uint16_t params = d->read_word(d->ctx);
+    uint8_t max_bits = (uint8_t)params;
+    d->max_bits = max_bits > 0x0B ? 0x0B : max_bits;
+    d->bit_buf = params;
+    d->bits_avail = 8;
+    d->code_bits = 9;
+    d->max_code = 0x1FF;
+    d->next_code = 0x100;
+    d->start_live = 0;          /* The first entry no longer links out */
+    memset(d->parent, 0xFF, sizeof(d->parent));
+    for (int i = 0; i < 0x100; i++)
+        d->chr[i] = (uint8_t)i;
+}
+
+void pic_begin(PicDecoder *d, pic_word_fn read_word, void *ctx, uint16_t prev_code)
+{
+    d->read_word = read_word;
+    d->ctx = ctx;
+    d->depth = 0;
+    d->rle_count = 0;
+    d->rle_byte = 0;
+    d->prev_code = prev_code & (PIC_DICT_SIZE - 1);
+    d->first_char = 0;          /* A corrupt first code repeats a 0, not garbage */
+    pic_reset_dict(d);
+    d->start_live = 1;
+    d->start_used = 0;
+}
+
+uint8_t pic_next_byte(PicDecoder *d)
+{
+    if (d->depth)
+        return d->stack[--d->depth];
+
+    uint16_t dx = d->next_code;
+    uint16_t code = read_code(d);
+    uint16_t walk = code;
+
+    /* Code not in the dictionary yet (KwKwK): the string is the previous
+     * one plus its own first byte */
+    if (code >= dx) {
+        d->stack[d->depth++] = d->first_char;
+        walk = d->prev_code;
+        if (d->start_live && dx == 0x100)
+            d->start_used = 1;      /* first_char and prev_code from before */
+    }
+
+    /* Walk the prefix chain, pushing bytes last-to-first */
+    for (;;) {
+        uint16_t parent = d->parent[walk];
+        if (d->start_live && walk == 0x100)
+            d->start_used = 1;      /* The first entry, prefixed by chr[start prev_code] */
+        d->stack[d->depth++] = d->chr[walk];
+        if (parent >= PIC_DICT_SIZE || d->depth >= (int)sizeof(d->stack)) {
+            d->first_char = d->chr[walk];
+            break;
+        }
+        walk = parent;
+    }
+
+    /* Add new dictionary entry: prev_code + first_char_of_current */
+    d->chr[dx] = d->first_char;
+    d->parent[dx] = d->prev_code;
+    dx++;
+
+    /* Grow the code width, or start over once it would pass max_bits */
+    if (dx > d->max_code) {
+        if (d->code_bits + 1 > d->max_bits) {
+            pic_reset_dict(d);
+            dx = d->next_code;
+        } else {
+            d->code_bits++;
+            d->max_code = (uint16_t)((d->max_code << 1) | 1);
+        }
+    }
+
+    d->next_code = dx;
+    d->prev_code = code;
+    return d->stack[--d->depth];
+}
+
+void pic_save_state(const PicDecoder *d, PicState *st)
+{
+    st->bit_buf = d->bit_buf;
+    st->max_code = d->max_code;
+    st->next_code = d->next_code;
+    st->prev_code = d->prev_code;
+    st->depth = (uint16_t)d->depth;
+    st->bits_avail = d->bits_avail;
+    st->code_bits = d->code_bits;
+    st->max_bits = d->max_bits;
+    st->first_char = d->first_char;
+    st->rle_count = d->rle_count;
+    st->rle_byte = d->rle_byte;
+    st->prev_chr = d->chr[d->prev_code];
+}
+
+void pic_load_state(PicDecoder *d, const PicState *st)
+{
+    d->bit_buf = st->bit_buf;
+    d->max_code = st->max_code;
+    d->next_code = st->next_code;
+    d->prev_code = st->prev_code & (PIC_DICT_SIZE - 1);
+    d->depth = st->depth <= sizeof(d->stack) ? st->depth : 0;
+    d->bits_avail = st->bits_avail;
+    d->code_bits = st->code_bits;
+    d->max_bits = st->max_bits;
+    d->first_char = st->first_char;
+    d->rle_count = st->rle_count;
+    d->rle_byte = st->rle_byte;
+    d->chr[d->prev_code] = st->prev_chr;
+}
+
+uint32_t pic_decode_row(PicDecoder *d, uint8_t *out, uint16_t count, int is_4bit)
+{
+    uint8_t *p = out;
+    for (uint16_t n = count; n; n--) {
+        uint8_t al;
+        if (d->rle_count) {
+            /* RLE repeat: output previous byte again */
+            al = d->rle_byte;
+            d->rle_count--;
+        } else {
+            al = pic_next_byte(d);
+            if (al == 0x90) {
+                uint8_t run = pic_next_byte(d);
+                if (run == 0) {
+                    /* Literal 0x90 byte */
+                    d->rle_byte = al;
+                } else {
+                    /* This byte plus run-2 more repeats */
+                    d->rle_count = (uint8_t)(run - 2);
+                    al = d->rle_byte;
+                }
+            } else {
+                d->rle_byte = al;
+            }
+        }
+
+        if (is_4bit) {
+            *p++ = al & 0x0F;
+            *p++ = al >> 4;
+        } else {
+            *p++ = al;
+        }
+    }
+    return (uint32_t)(p - out);
+}
+
+/* ─── Whole files ─── */
+
+typedef struct {
+    const uint8_t *data;
+    long pos, end;
+    long words;                 /* Words handed to the decoder */
+} FileCursor;
+
+static uint16_t file_word(void *ctx)
+{
+    FileCursor *c = (FileCursor *)ctx;
+    long at = c->pos + 2 * c->words++;
+    uint16_t w = 0;
+    if (at < c->end)     w = c->data[at];
+    if (at + 1 < c->end) w |= (uint16_t)(c->data[at + 1] << 8);
+    return w;
+}
+
+int pic_load(const char *path, PicImage *img, int decode)
+{
+    memset(img, 0, sizeof(*img));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = (size > 0) ? (uint8_t *)malloc((size_t)size) : NULL;
+    if (!data || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    int found = 0;
+    long pos = 0;
+    while (!found && pos + 4 <= size) {
+        uint16_t tag = (uint16_t)(data[pos] | (data[pos + 1] << 8));
+        long len = data[pos + 2] | (data[pos + 3] << 8);
+        long body = pos + 4;
+        long end = body + len < size ? body + len : size;
+
+        if (tag == PIC_TAG('M', '0') && end - body >= 2) {
+            int first = data[body], last = data[body + 1];
+            for (int i = first; i <= last && body + 2 + (i - first) * 3 + 2 < end; i++)
+                memcpy(img->palette + i * 3, data + body + 2 + (i - first) * 3, 3);
+            img->has_palette = 1;
+        } else if ((tag == PIC_TAG('X', '0') || tag == PIC_TAG('X', '1')) &&
+                   end - body >= 4) {
+            img->width  = (uint16_t)(data[body]     | (data[body + 1] << 8));
+            img->height = (uint16_t)(data[body + 2] | (data[body + 3] << 8));
+            img->is_4bit = (tag == PIC_TAG('X', '1'));
+            found = 1;
+
+            if (decode && img->width && img->height) {
+                uint32_t row = pic_row_bytes(img->width, img->is_4bit);
+                uint16_t units = img->is_4bit ? (uint16_t)((img->width + 1) / 2) : img->width;
+                img->size = row * img->height;
+                img->pixels = (uint8_t *)malloc(img->size);
+                PicDecoder *d = (PicDecoder *)malloc(sizeof(PicDecoder));
+                if (!img->pixels || !d) {
+                    free(d);
+                    free(data);
+                    pic_free(img);
+                    return -1;
+                }
+                FileCursor cur = { data, body + 4, end, 0 };
+                pic_begin(d, file_word, &cur, 0);
+                for (uint16_t y = 0; y < img->height; y++)
+                    pic_decode_row(d, img->pixels + (size_t)y * row, units, img->is_4bit);
+                img->data_end = cur.pos + 2 * cur.words;
+                img->start_used = d->start_used;    /* Start bytes were 0, 0 */
+                pic_save_state(d, &img->end);
+                free(d);
+            }
+        }
+        pos = body + len;
+    }
+
+    free(data);
+    return found ? 0 : -1;
+}
+
+void pic_free(PicImage *img)
+{
+    free(img->pixels);
+    img->pixels = NULL;
+    img->size = 0;
+}
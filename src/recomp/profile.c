@@ -0,0 +1,255 @@
+/*
+ * profile.c - Per-function profiler for recompiled code
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "recomp/profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define prof_ticks() __rdtsc()
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define prof_ticks() __rdtsc()
+#else
+static uint64_t prof_ticks(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/* ─── State ─── */
+
+/* One node per distinct call path; node 0 is the root */
+typedef struct {
+    uint32_t parent;
+    uint32_t site;              /* Index into g_sites */
+    uint64_t self;
+} ProfNode;
+
+typedef struct {
+    uint32_t node;
+    uint64_t start;
+} ProfFrame;
+
+static ProfSite **g_sites;      /* By id; g_sites[0] unused */
+static uint32_t   g_site_count, g_site_cap;
+
+static ProfNode  *g_nodes;
+static uint32_t   g_node_count, g_node_cap;
+
+/* (parent, site) -> node + 1, open addressing */
+static uint32_t  *g_children;
+static uint32_t   g_child_mask;
+
+static ProfFrame  g_stack[PROF_MAX_DEPTH];
+static uint32_t   g_depth;      /* May exceed PROF_MAX_DEPTH */
+static uint32_t   g_cur;        /* Node on top of the stack */
+static uint64_t   g_last;       /* Tick of the last enter/exit */
+
+static uint64_t   g_start_ticks, g_start_ns;
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void *grow(void *p, uint32_t *cap, size_t elem)
+{
+    *cap = *cap ? *cap * 2 : 256;
+    p = realloc(p, *cap * elem);
+    if (!p) {
+        fprintf(stderr, "[PROF] Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void register_site(ProfSite *site)
+{
+    if (g_site_count == 0) {
+        g_site_count = 1;       /* id 0 = unregistered */
+        g_node_count = 1;       /* node 0 = root */
+        g_nodes = grow(g_nodes, &g_node_cap, sizeof(ProfNode));
+        memset(&g_nodes[0], 0, sizeof(ProfNode));
+        g_start_ticks = prof_ticks();
+        g_start_ns = wall_ns();
+        atexit(prof_dump);
+    }
+    if (g_site_count >= g_site_cap)
+        g_sites = grow(g_sites, &g_site_cap, sizeof(ProfSite *));
+    site->id = g_site_count;
+    g_sites[g_site_count++] = site;
+}
+
+/* ─── Call path tree ─── */
+
+static uint32_t child_hash(uint32_t parent, uint32_t site)
+{
+    uint32_t h = parent * 0x9E3779B1u ^ site * 0x85EBCA77u;
+    return h ^ (h >> 15);
+}
+
+static void rehash(void)
+{
+    uint32_t size = g_child_mask ? (g_child_mask + 1) * 2 : 1024;
+    free(g_children);
+    g_children = calloc(size, sizeof(uint32_t));
+    if (!g_children) {
+        fprintf(stderr, "[PROF] Out of memory\n");
+        exit(1);
+    }
+    g_child_mask = size - 1;
+    for (uint32_t n = 1; n < g_node_count; n++) {
+        uint32_t i = child_hash(g_nodes[n].parent, g_nodes[n].site) & g_child_mask;
+        while (g_children[i]) i = (i + 1) & g_child_mask;
+        g_children[i] = n + 1;
+    }
+}
+
+static uint32_t child_node(uint32_t parent, uint32_t site)
+{
+    if (g_node_count * 2 >= g_child_mask)
+        rehash();
+
+    uint32_t i = child_hash(parent, site) & g_child_mask;
+    for (; g_children[i]; i = (i + 1) & g_child_mask) {
+        const ProfNode *n = &g_nodes[g_children[i] - 1];
+        if (n->parent == parent && n->site == site)
+            return g_children[i] - 1;
+    }
+
+    if (g_node_count == g_node_cap)
+        g_nodes = grow(g_nodes, &g_node_cap, sizeof(ProfNode));
+    uint32_t node = g_node_count++;
+    g_nodes[node].parent = parent;
+    g_nodes[node].site = site;
+    g_nodes[node].self = 0;
+    g_children[i] = node + 1;
+    return node;
+}
+
+/* ─── Enter / exit ─── */
+
+static void charge(uint64_t now)
+{
+    if (g_cur) {
+        g_nodes[g_cur].self += now - g_last;
+        g_sites[g_nodes[g_cur].site]->self += now - g_last;
+    }
+    g_last = now;
+}
+
+void prof_enter(ProfSite *site)
+{
+    uint64_t now = prof_ticks();
+    if (!site->id)
+        register_site(site);
+    charge(now);
+
+    site->calls++;
+    site->active++;
+    if (g_depth++ < PROF_MAX_DEPTH) {
+        g_stack[g_depth - 1].node = g_cur;
+        g_stack[g_depth - 1].start = now;
+        g_cur = child_node(g_cur, site->id);
+    }
+}
+
+void prof_exit(ProfSite *site)
+{
+    uint64_t now = prof_ticks();
+    if (!g_depth) return;
+    charge(now);
+
+    if (g_depth-- <= PROF_MAX_DEPTH) {
+        const ProfFrame *f = &g_stack[g_depth];
+        if (--site->active == 0)
+            site->total += now - f->start;
+        g_cur = f->node;
+    } else {
+        site->active--;
+    }
+}
+
+/* ─── Output ─── */
+
+static int cmp_self(const void *a, const void *b)
+{
+    const ProfSite *x = *(ProfSite *const *)a, *y = *(ProfSite *const *)b;
+    return (x->self < y->self) - (x->self > y->self);
+}
+
+static void write_path(FILE *f, uint32_t node)
+{
+    static uint32_t path[PROF_MAX_DEPTH];
+    int n = 0;
+    for (; node && n < PROF_MAX_DEPTH; node = g_nodes[node].parent)
+        path[n++] = node;
+    while (n--)
+        fprintf(f, "%s%s", g_sites[g_nodes[path[n]].site]->name, n ? ";" : "");
+}
+
+void prof_dump(void)
+{
+    if (g_site_count <= 1) return;
+
+    /* Close frames still open (the game exited from inside a call) */
+    if (g_depth > PROF_MAX_DEPTH) g_depth = PROF_MAX_DEPTH;
+    while (g_depth && g_cur)
+        prof_exit(g_sites[g_nodes[g_cur].site]);
+
+    uint64_t ticks = prof_ticks() - g_start_ticks;
+    uint64_t ns = wall_ns() - g_start_ns;
+    double ms_per_tick = ticks ? (double)ns / 1e6 / (double)ticks : 0.0;
+
+    FILE *f = fopen("civ_profile.folded", "w");
+    if (f) {
+        for (uint32_t n = 1; n < g_node_count; n++) {
+            if (!g_nodes[n].self) continue;
+            write_path(f, n);
+            fprintf(f, " %llu\n", (unsigned long long)g_nodes[n].self);
+        }
+        fclose(f);
+    }
+
+    uint32_t count = g_site_count - 1;
+    ProfSite **sorted = malloc(count * sizeof(ProfSite *));
+    if (!sorted) return;
+    memcpy(sorted, g_sites + 1, count * sizeof(ProfSite *));
+    qsort(sorted, count, sizeof(ProfSite *), cmp_self);
+
+    uint64_t all = 0;
+    for (uint32_t i = 0; i < count; i++) all += sorted[i]->self;
+
+    f = fopen("civ_profile.txt", "w");
+    for (int pass = 0; pass < 2; pass++) {
+        FILE *out = pass ? stderr : f;
+        uint32_t rows = pass ? (count < 20 ? count : 20) : count;
+        if (!out) continue;
+        if (pass) fprintf(out, "\n[PROF] Top %u of %u functions by self time:\n", rows, count);
+        fprintf(out, "%-24s %4s %12s %10s %6s %10s\n",
+                "function", "ovl", "calls", "self ms", "self%", "total ms");
+        for (uint32_t i = 0; i < rows; i++) {
+            const ProfSite *s = sorted[i];
+            char ovl[12] = "-";
+            if (s->overlay >= 0) snprintf(ovl, sizeof(ovl), "%d", s->overlay);
+            fprintf(out, "%-24s %4s %12llu %10.2f %5.1f%% %10.2f\n", s->name, ovl,
+                    (unsigned long long)s->calls, (double)s->self * ms_per_tick,
+                    all ? 100.0 * (double)s->self / (double)all : 0.0,
+                    (double)s->total * ms_per_tick);
+        }
+    }
+    if (f) fclose(f);
+    fprintf(stderr, "[PROF] Wrote civ_profile.folded and civ_profile.txt\n");
+    free(sorted);
+}
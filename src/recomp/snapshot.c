@@ -0,0 +1,388 @@
+/*
+ * snapshot.c - Whole-machine quick save and restore
+ *
+ * File layout: an 8-byte magic, then size-prefixed blocks in a fixed
+ * order (a block whose size does not match this build is rejected),
+ * then the open files, then the changed memory pages.
+ *
+ * Pages are XORed against the baseline image, so unchanged bytes are
+ * zero, and packed with a PackBits-style RLE: a control byte below 80h
+ * is followed by that many plus one literal bytes, one from 80h up
+ * repeats the next byte (control - 7Dh) times.
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "recomp/snapshot.h"
+#include "recomp/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAP_MAGIC      "CIVSNAP2"
+#define SNAP_PAGES      (MEM_SIZE / SNAPSHOT_PAGE_SIZE)
+#define SNAP_FRAMES     16
+#define SNAP_PACK_MAX   (SNAPSHOT_PAGE_SIZE + SNAPSHOT_PAGE_SIZE / 128 + 1)
+
+/* Where the game is waiting: the guest stack and its BP frame chain */
+typedef struct {
+    uint16_t ss, sp, bp;
+    uint16_t depth;
+    uint16_t chain[SNAP_FRAMES];
+} StackShape;
+
+typedef struct {
+    uint64_t baseline;          /* Hash of the image the pages are XORed with */
+    uint32_t ticks;
+    uint16_t mem_top;
+    uint16_t files;
+    uint32_t pages;
+} SnapInfo;
+
+static uint8_t *g_base;
+static uint64_t g_base_hash;
+static char     g_path[512];
+
+/* ─── Helpers ─── */
+
+uint64_t snapshot_hash(const uint8_t *p, size_t n)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;     /* FNV-1a */
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ p[i]) * 0x100000001B3ULL;
+    return h;
+}
+
+static void stack_shape(const CPU *cpu, StackShape *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->ss = cpu->ss;
+    s->sp = cpu->sp;
+    s->bp = cpu->bp;
+    uint16_t bp = cpu->bp, prev = cpu->sp;
+    while (s->depth < SNAP_FRAMES && bp > prev) {
+        s->chain[s->depth++] = bp;
+        prev = bp;
+        uint32_t at = seg_off(cpu->ss, bp);
+        bp = (uint16_t)(cpu->mem[at] | (cpu->mem[at + 1] << 8));
+    }
+}
+
+static uint32_t pack(const uint8_t *src, uint32_t n, uint8_t *out)
+{
+    uint32_t i = 0, o = 0;
+    while (i < n) {
+        uint32_t run = 1;
+        while (i + run < n && run < 130 && src[i + run] == src[i])
+            run++;
+        if (run >= 3) {
+            out[o++] = (uint8_t)(0x80 + run - 3);
+            out[o++] = src[i];
+            i += run;
+            continue;
+        }
+        /* Literals up to the next run of three */
+        uint32_t start = i, len = 0;
+        while (i < n && len < 128) {
+            if (i + 2 < n && src[i] == src[i + 1] && src[i] == src[i + 2])
+                break;
+            i++;
+            len++;
+        }
+        out[o++] = (uint8_t)(len - 1);
+        memcpy(out + o, src + start, len);
+        o += len;
+    }
+    return o;
+}
+
+int snapshot_unpack(const uint8_t *src, uint32_t n, uint8_t *out, uint32_t size)
+{
+    uint32_t i = 0, o = 0;
+    while (i < n) {
+        uint8_t c = src[i++];
+        if (c < 0x80) {
+            uint32_t len = c + 1u;
+            if (i + len > n || o + len > size)
+                return -1;
+            memcpy(out + o, src + i, len);
+            i += len;
+            o += len;
+        } else {
+            uint32_t len = c - 0x7Du;
+            if (i >= n || o + len > size)
+                return -1;
+            memset(out + o, src[i++], len);
+            o += len;
+        }
+    }
+    return o == size ? 0 : -1;
+}
+
+static void put_block(FILE *f, const void *p, uint32_t size)
+{
+    fwrite(&size, sizeof(size), 1, f);
+    fwrite(p, 1, size, f);
+}
+
+static int get_block(FILE *f, void *p, uint32_t size)
+{
+    uint32_t got;
+    if (fread(&got, sizeof(got), 1, f) != 1 || got != size)
+        return -1;
+    return fread(p, 1, size, f) == size ? 0 : -1;
+}
+
+/* ─── API ─── */
+
+void snapshot_init(const CPU *cpu, const char *path)
+{
+    free(g_base);
+    g_base = (uint8_t *)malloc(MEM_SIZE);
+    if (g_base) {
+        memcpy(g_base, cpu->mem, MEM_SIZE);
+        g_base_hash = snapshot_hash(g_base, MEM_SIZE);
+    }
+    snprintf(g_path, sizeof(g_path), "%s", path ? path : "");
+}
+
+int snapshot_save(const CPU *cpu, DosState *dos, const char *path)
+{
+    if (!g_base) {
+        LOG_WARN(LOG_DOS, "[SNAP] No baseline image, cannot save\n");
+        return -1;
+    }
+    uint64_t start = timer_now_ms(&dos->timer);
+
+    /* Saves are reopened from disk on restore, so they must be there */
+    dos_flush_files(dos);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        LOG_WARN(LOG_DOS, "[SNAP] Cannot write '%s'\n", path);
+        return -1;
+    }
+
+    StackShape shape;
+    stack_shape(cpu, &shape);
+    CPU regs = *cpu;
+    regs.mem = NULL;
+    memset(regs.seg_base, 0, sizeof(regs.seg_base));
+    regs.dgroup = NULL;
+    regs.dos = NULL;
+
+    /* The hand-written routines' state, if they have run yet */
+    uint32_t game_size = dos->game && dos->game_save ? dos->game_save_size : 0;
+    uint8_t *game = (uint8_t *)malloc(game_size ? game_size : 1);
+    if (!game) {
+        fclose(f);
+        LOG_WARN(LOG_DOS, "[SNAP] Out of memory\n");
+        return -1;
+    }
+    if (game_size)
+        dos->game_save(dos->game, game);
+
+    SnapInfo info = { 0 };
+    info.baseline = g_base_hash;
+    info.ticks = timer_get_ticks(&dos->timer);
+    info.mem_top = dos->mem_top;
+    for (int i = DOS_FIRST_FILE; i < dos->file_table.count; i++)
+        if (dos_handle_path(dos, i))
+            info.files++;
+    for (uint32_t p = 0; p < SNAP_PAGES; p++)
+        if (memcmp(cpu->mem + p * SNAPSHOT_PAGE_SIZE, g_base + p * SNAPSHOT_PAGE_SIZE,
+                   SNAPSHOT_PAGE_SIZE) != 0)
+            info.pages++;
+
+    fwrite(SNAP_MAGIC, 1, 8, f);
+    put_block(f, &info, sizeof(info));
+    put_block(f, &shape, sizeof(shape));
+    put_block(f, &regs, sizeof(regs));
+    put_block(f, &dos->video, sizeof(dos->video));
+    put_block(f, &dos->keyboard, sizeof(dos->keyboard));
+    put_block(f, &dos->mouse, sizeof(dos->mouse));
+    put_block(f, dos->ivt, sizeof(dos->ivt));
+    put_block(f, game, game_size);
+    free(game);
+
+    for (int i = DOS_FIRST_FILE; i < dos->file_table.count; i++) {
+        const char *fp = dos_handle_path(dos, i);
+        if (!fp) continue;
+        uint16_t handle = (uint16_t)i, len = (uint16_t)strlen(fp);
+        uint8_t access = dos->file_table.files[i].access;
+        uint32_t pos = (uint32_t)dos_file_tell(dos, i);
+        fwrite(&handle, sizeof(handle), 1, f);
+        fwrite(&access, sizeof(access), 1, f);
+        fwrite(&pos, sizeof(pos), 1, f);
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(fp, 1, len, f);
+    }
+
+    uint8_t delta[SNAPSHOT_PAGE_SIZE], packed[SNAP_PACK_MAX];
+    for (uint32_t p = 0; p < SNAP_PAGES; p++) {
+        const uint8_t *cur = cpu->mem + p * SNAPSHOT_PAGE_SIZE;
+        const uint8_t *base = g_base + p * SNAPSHOT_PAGE_SIZE;
+        if (memcmp(cur, base, SNAPSHOT_PAGE_SIZE) == 0)
+            continue;
+        for (int i = 0; i < SNAPSHOT_PAGE_SIZE; i++)
+            delta[i] = cur[i] ^ base[i];
+        uint32_t n = pack(delta, SNAPSHOT_PAGE_SIZE, packed);
+        fwrite(&p, sizeof(p), 1, f);
+        put_block(f, packed, n);
+    }
+
+    long bytes = ftell(f);
+    int failed = ferror(f);
+    fclose(f);
+    if (failed) {
+        LOG_WARN(LOG_DOS, "[SNAP] Write to '%s' failed\n", path);
+        return -1;
+    }
+    LOG_INFO(LOG_DOS, "[SNAP] Saved '%s': %u pages, %u files, %ld bytes in %llu ms\n",
+             path, info.pages, info.files, bytes,
+             (unsigned long long)(timer_now_ms(&dos->timer) - start));
+    return 0;
+}
+
+int snapshot_restore(CPU *cpu, DosState *dos, const char *path)
+{
+    if (!g_base) {
+        LOG_WARN(LOG_DOS, "[SNAP] No baseline image, cannot restore\n");
+        return -1;
+    }
+    uint64_t start = timer_now_ms(&dos->timer);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        LOG_WARN(LOG_DOS, "[SNAP] Cannot read '%s'\n", path);
+        return -1;
+    }
+
+    /* Read everything before changing anything */
+    char magic[8];
+    SnapInfo info;
+    StackShape shape, here;
+    CPU regs;
+    VideoState video;
+    KeyboardState keyboard;
+    MouseState mouse;
+    uint32_t ivt[256];
+    uint32_t game_size = dos->game && dos->game_load ? dos->game_save_size : 0;
+    uint8_t *game = (uint8_t *)malloc(game_size ? game_size : 1);
+    const char *why = NULL;
+
+    if (!game)
+        why = "out of memory";
+    else if (fread(magic, 1, 8, f) != 8 || memcmp(magic, SNAP_MAGIC, 8) != 0 ||
+        get_block(f, &info, sizeof(info)) || get_block(f, &shape, sizeof(shape)) ||
+        get_block(f, &regs, sizeof(regs)) || get_block(f, &video, sizeof(video)) ||
+        get_block(f, &keyboard, sizeof(keyboard)) || get_block(f, &mouse, sizeof(mouse)) ||
+        get_block(f, ivt, sizeof(ivt)))
+        why = "not a snapshot from this build";
+    else if (get_block(f, game, game_size))
+        why = "the game state does not match this build";
+    else if (info.baseline != g_base_hash)
+        why = "taken with a different CIV.EXE";
+
+    stack_shape(cpu, &here);
+    if (!why && memcmp(&shape, &here, sizeof(shape)) != 0)
+        why = "the game is not waiting where it was taken";
+
+    typedef struct { uint16_t handle; uint8_t access; uint32_t pos; char path[512]; } SnapFile;
+    SnapFile *files = NULL;
+    uint8_t *mem = NULL;
+    if (!why) {
+        files = (SnapFile *)calloc(info.files ? info.files : 1, sizeof(SnapFile));
+        mem = (uint8_t *)malloc(MEM_SIZE);
+        if (!files || !mem)
+            why = "out of memory";
+    }
+    for (uint32_t i = 0; !why && i < info.files; i++) {
+        SnapFile *sf = &files[i];
+        uint16_t len;
+        if (fread(&sf->handle, sizeof(sf->handle), 1, f) != 1 ||
+            fread(&sf->access, sizeof(sf->access), 1, f) != 1 ||
+            fread(&sf->pos, sizeof(sf->pos), 1, f) != 1 ||
+            fread(&len, sizeof(len), 1, f) != 1 || len >= sizeof(sf->path) ||
+            fread(sf->path, 1, len, f) != len)
+            why = "truncated file table";
+    }
+    if (!why) {
+        memcpy(mem, g_base, MEM_SIZE);
+        uint8_t delta[SNAPSHOT_PAGE_SIZE], packed[SNAP_PACK_MAX];
+        for (uint32_t i = 0; !why && i < info.pages; i++) {
+            uint32_t p, n;
+            if (fread(&p, sizeof(p), 1, f) != 1 || p >= SNAP_PAGES ||
+                fread(&n, sizeof(n), 1, f) != 1 || n > sizeof(packed) ||
+                fread(packed, 1, n, f) != n ||
+                snapshot_unpack(packed, n, delta, SNAPSHOT_PAGE_SIZE) != 0) {
+                why = "corrupt page data";
+                break;
+            }
+            uint8_t *page = mem + p * SNAPSHOT_PAGE_SIZE;
+            for (int j = 0; j < SNAPSHOT_PAGE_SIZE; j++)
+                page[j] ^= delta[j];
+        }
+    }
+    fclose(f);
+
+    if (why) {
+        LOG_WARN(LOG_DOS, "[SNAP] Not restoring '%s': %s\n", path, why);
+        free(files);
+        free(mem);
+        free(game);
+        return -1;
+    }
+
+    /* Commit. The call count stays: it is the bench clock. So does
+     * in_irq, which belongs to the host stack this runs on. */
+    memcpy(cpu->mem, mem, MEM_SIZE);
+    free(mem);
+    uint8_t *mem_ptr = cpu->mem;
+    uint64_t calls = cpu->calls;
+    uint8_t in_irq = cpu->in_irq;
+    *cpu = regs;
+    cpu->mem = mem_ptr;
+    cpu->calls = calls;
+    cpu->in_irq = in_irq;
+    cpu->dos = dos;
+    cpu_sync_sregs(cpu);
+    vga_mark_rows(cpu, 0, VGA_ROWS);
+
+    dos->video = video;
+    dos->video.dirty = 1;
+    dos->keyboard = keyboard;
+    dos->mouse = mouse;
+    memcpy(dos->ivt, ivt, sizeof(ivt));
+    dos->mem_top = info.mem_top;
+    if (game_size)
+        dos->game_load(dos->game, game);
+    free(game);
+    timer_set_ticks(&dos->timer, info.ticks, timer_now_ms(&dos->timer));
+
+    dos_close_all(dos);
+    for (uint32_t i = 0; i < info.files; i++)
+        if (dos_file_reopen(dos, files[i].handle, files[i].path, files[i].access,
+                            (long)files[i].pos) != 0)
+            LOG_WARN(LOG_DOS, "[SNAP] Cannot reopen '%s' as handle %u\n",
+                     files[i].path, files[i].handle);
+    free(files);
+
+    LOG_INFO(LOG_DOS, "[SNAP] Restored '%s': %u pages, %u files in %llu ms\n",
+             path, info.pages, info.files, (unsigned long long)(timer_now_ms(&dos->timer) - start));
+    return 0;
+}
+
+void snapshot_service(CPU *cpu, DosState *dos)
+{
+    int req = dos->snapshot_request;
+    if (req == SNAPSHOT_NONE)
+        return;
+    dos->snapshot_request = SNAPSHOT_NONE;
+    if (!g_path[0])
+        return;
+    if (req == SNAPSHOT_SAVE)
+        snapshot_save(cpu, dos, g_path);
+    else
+        snapshot_restore(cpu, dos, g_path);
+}
@@ -11,7 +11,8 @@
  *   6. __astart clears BSS, sets SS=DS, calls C main
  *
  * In our recompilation, we replicate steps 3-6:
- *   - EXEPACK decompression + relocation
+ *   - EXEPACK decompression + relocation, or the image recomp.py
+ *     pre-baked into civ_image.c (see recomp/startup.h)
  *   - Set DS = LOAD_SEG + DGROUP (0x2A1C from real crt0)
  *   - Clear BSS, set up stack, call res_001A66 (C main)
  *
@@ -31,7 +32,8 @@
  * Part of the Civ Recomp project (sp00nznet/civ)
  */
 
-#include "recomp/cpu.h"
+#include "recomp/startup.h"
+#include "recomp/snapshot.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -200,12 +202,94 @@ static int exepack_decompress(CPU *cpu)
     return 0;
 }
 
+/* ---------- Pre-baked Image ---------- */
+
+int startup_verify_image;
+
+static const StartupImage *g_image;
+
+void startup_set_image(const StartupImage *img)
+{
+    g_image = img;
+}
+
+/*
+ * The pre-baked image, unpacked into a new buffer, if it was made from
+ * the image now in memory and unpacks to what it was hashed as.
+ */
+static uint8_t *baked_image(const CPU *cpu)
+{
+    const StartupImage *img = g_image;
+    uint32_t room = MEM_SIZE - seg_off(CIV_LOAD_SEG, 0);
+    if (!img || !img->size)
+        return NULL;
+    if (img->source_size > room || img->size > room ||
+        snapshot_hash(cpu->mem + seg_off(CIV_LOAD_SEG, 0), img->source_size) != img->source_hash) {
+        printf("[EXEPACK] Pre-baked image was made from a different CIV.EXE\n");
+        return NULL;
+    }
+
+    uint8_t *out = (uint8_t *)malloc(img->size);
+    if (!out)
+        return NULL;
+    if (snapshot_unpack(img->packed, img->packed_size, out, img->size) != 0 ||
+        snapshot_hash(out, img->size) != img->hash) {
+        fprintf(stderr, "[EXEPACK] Pre-baked image is damaged\n");
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+/*
+ * Replace the loaded image with its decompressed, relocated form.
+ * Returns 1 if the pre-baked image was used, 0 after decompressing
+ * live, -1 on error.
+ */
+static int startup_unpack(CPU *cpu)
+{
+    uint8_t *image = cpu->mem + seg_off(CIV_LOAD_SEG, 0);
+    uint8_t *baked = baked_image(cpu);
+
+    if (baked && !startup_verify_image) {
+        memcpy(image, baked, g_image->size);
+        free(baked);
+        printf("[EXEPACK] Pre-baked image: %u bytes\n", g_image->size);
+        return 1;
+    }
+
+    if (exepack_decompress(cpu) != 0) {
+        free(baked);
+        return -1;
+    }
+
+    if (startup_verify_image) {
+        if (!baked) {
+            printf("[EXEPACK] --verify-image: no usable pre-baked image to compare\n");
+            return 0;
+        }
+        uint32_t diffs = 0, first = 0;
+        for (uint32_t i = 0; i < g_image->size; i++) {
+            if (image[i] != baked[i] && diffs++ == 0)
+                first = i;
+        }
+        if (diffs)
+            fprintf(stderr, "[EXEPACK] --verify-image: %u byte(s) differ from the live "
+                    "decompression, first at image offset %05X\n", diffs, first);
+        else
+            printf("[EXEPACK] --verify-image: pre-baked image matches (%u bytes)\n",
+                   g_image->size);
+        free(baked);
+    }
+    return 0;
+}
+
 /* ---------- Entry Point ---------- */
 
 /*
  * res_02A310 - Entry point replacement
  *
- * Decompresses the EXEPACK'd resident image, initializes the data
+ * Unpacks the EXEPACK'd resident image, initializes the data
  * segment, clears BSS, sets up the stack, then calls the game's
  * C main() function (res_001A66).
  */
@@ -217,7 +301,8 @@ void res_02A310(CPU *cpu)
      * populating the DGROUP data segment with correct initialized data.
      */
     printf("[STARTUP] EXEPACK decompression...\n");
-    if (exepack_decompress(cpu) != 0) {
+    int unpacked = startup_unpack(cpu);
+    if (unpacked < 0) {
         fprintf(stderr, "[STARTUP] EXEPACK decompression failed!\n");
         cpu->halted = 1;
         return;
@@ -226,9 +311,10 @@ void res_02A310(CPU *cpu)
     /*
      * Dump decompressed resident image for offline analysis/lifting.
      * The dump starts at LOAD_SEG:0000 and covers the full decompressed
-     * image (DGROUP paragraphs * 16 bytes).
+     * image (DGROUP paragraphs * 16 bytes). Only written when the image
+     * was decompressed live (no pre-baked image, or --verify-image).
      */
-    {
+    if (!unpacked) {
         uint32_t base = seg_off(CIV_LOAD_SEG, 0);
         uint32_t size = (uint32_t)(CIV_LOAD_SEG + CIV_DGROUP) * 16 - base;
         FILE *dump = fopen("civ_decompressed.bin", "wb");
@@ -244,9 +330,10 @@ void res_02A310(CPU *cpu)
      * After EXEPACK decompression, DGROUP is at CIV_DGROUP paragraphs
      * from LOAD_SEG. DS = ES = SS (MSC DGROUP model).
      */
-    cpu->ds = CIV_LOAD_SEG + CIV_DGROUP;  /* 0x2B1C */
-    cpu->es = cpu->ds;
-    cpu->ss = cpu->ds;
+    set_sreg(cpu, SREG_DS, CIV_LOAD_SEG + CIV_DGROUP);  /* 0x2B1C */
+    cpu_set_dgroup(cpu, cpu->ds);
+    set_sreg(cpu, SREG_ES, cpu->ds);
+    set_sreg(cpu, SREG_SS, cpu->ds);
     cpu->sp = CIV_SP_INIT;
 
     printf("[STARTUP] DS=%04X ES=%04X SS=%04X SP=%04X\n",
@@ -0,0 +1,172 @@
+/*
+ * string_ops.c - Bulk REP string instruction helpers
+ *
+ * Part of the Civ Recomp project (sp00nznet/civ)
+ */
+
+#include "recomp/string_ops.h"
+#include <string.h>
+
+/* ─── Range helpers ─── */
+
+/*
+ * Lowest offset touched by n elements of size sz starting at off and
+ * moving in direction step (+sz / -sz). Returns 0 if the range wraps
+ * around the 64K segment, in which case callers use the slow loop.
+ */
+static int span_low(uint16_t off, uint32_t n, int32_t step, uint32_t *low)
+{
+    uint32_t sz = (uint32_t)(step < 0 ? -step : step);
+    uint32_t bytes = n * sz;
+    if (step > 0) {
+        if ((uint32_t)off + bytes > 0x10000) return 0;
+        *low = off;
+    } else {
+        if ((uint32_t)off + sz > 0x10000 || (uint32_t)off < bytes - sz) return 0;
+        *low = off - (bytes - sz);
+    }
+    return 1;
+}
+
+static void advance(uint16_t *reg, uint32_t n, int32_t step)
+{
+    *reg = (uint16_t)(*reg + (int32_t)n * step);
+}
+
+/* ─── MOVS ─── */
+
+static void rep_movs(CPU *cpu, uint16_t src_seg, int32_t sz)
+{
+    uint32_t n = cpu->cx;
+    int32_t step = df(cpu) ? -sz : sz;
+    uint32_t s_low, d_low;
+
+    if (n == 0) return;
+
+    if (span_low(cpu->si, n, step, &s_low) && span_low(cpu->di, n, step, &d_low)) {
+        uint32_t src = seg_off(src_seg, (uint16_t)s_low);
+        uint32_t dst = seg_off(cpu->es, (uint16_t)d_low);
+        uint32_t bytes = n * (uint32_t)sz;
+        /* An element-wise copy in the direction of travel only differs
+         * from memmove when the destination runs into source bytes that
+         * haven't been read yet (the "rep movsb with DI = SI + 1" fill). */
+        int replicates = step > 0 ? (dst > src && dst < src + bytes)
+                                  : (dst < src && dst + bytes > src);
+        if (!replicates) {
+            memmove(cpu->mem + dst, cpu->mem + src, bytes);
+            vga_mark_range(cpu, dst, bytes);
+            advance(&cpu->si, n, step);
+            advance(&cpu->di, n, step);
+            cpu->cx = 0;
+            return;
+        }
+    }
+
+    while (cpu->cx != 0) {
+        if (sz == 1)
+            mem_write8(cpu, cpu->es, cpu->di, mem_read8(cpu, src_seg, cpu->si));
+        else
+            mem_write16(cpu, cpu->es, cpu->di, mem_read16(cpu, src_seg, cpu->si));
+        cpu->si = (uint16_t)(cpu->si + step);
+        cpu->di = (uint16_t)(cpu->di + step);
+        cpu->cx--;
+    }
+}
+
+void rep_movsb(CPU *cpu, uint16_t src_seg) { rep_movs(cpu, src_seg, 1); }
+void rep_movsw(CPU *cpu, uint16_t src_seg) { rep_movs(cpu, src_seg, 2); }
+
+/* ─── STOS ─── */
+
+static void rep_stos(CPU *cpu, int32_t sz)
+{
+    uint32_t n = cpu->cx;
+    int32_t step = df(cpu) ? -sz : sz;
+    uint32_t d_low;
+
+    if (n == 0) return;
+
+    /* Filling is direction-independent once the range is known */
+    if (span_low(cpu->di, n, step, &d_low)) {
+        uint32_t dst = seg_off(cpu->es, (uint16_t)d_low);
+        uint8_t *p = cpu->mem + dst;
+        if (sz == 1 || cpu->al == cpu->ah) {
+            memset(p, cpu->al, n * (uint32_t)sz);
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                p[2 * i] = cpu->al;
+                p[2 * i + 1] = cpu->ah;
+            }
+        }
+        vga_mark_range(cpu, dst, n * (uint32_t)sz);
+        advance(&cpu->di, n, step);
+        cpu->cx = 0;
+        return;
+    }
+
+    while (cpu->cx != 0) {
+        if (sz == 1)
+            mem_write8(cpu, cpu->es, cpu->di, cpu->al);
+        else
+            mem_write16(cpu, cpu->es, cpu->di, cpu->ax);
+        cpu->di = (uint16_t)(cpu->di + step);
+        cpu->cx--;
+    }
+}
+
+void rep_stosb(CPU *cpu) { rep_stos(cpu, 1); }
+void rep_stosw(CPU *cpu) { rep_stos(cpu, 2); }
+
+/* ─── CMPS / SCAS ─── */
+
+/*
+ * Shared compare loop. Only the last comparison's flags are observable,
+ * so the loop itself compares plain values and the flags are computed
+ * once at the end (eagerly, so both lifter flag modes see them).
+ */
+static void rep_compare(CPU *cpu, int use_src, uint16_t src_seg, int32_t sz, int repz)
+{
+    int32_t step = df(cpu) ? -sz : sz;
+    uint16_t a = 0, b = 0;
+
+    if (cpu->cx == 0) return;
+
+    /* repnz scasb forward over an unwrapped range is memchr */
+    if (!use_src && sz == 1 && !repz && step > 0) {
+        uint32_t low;
+        if (span_low(cpu->di, cpu->cx, step, &low)) {
+            uint8_t *base = cpu->mem + seg_off(cpu->es, cpu->di);
+            uint8_t *hit = (uint8_t *)memchr(base, cpu->al, cpu->cx);
+            uint32_t n = hit ? (uint32_t)(hit - base) + 1 : cpu->cx;
+            b = base[n - 1];
+            advance(&cpu->di, n, step);
+            cpu->cx = (uint16_t)(cpu->cx - n);
+            flags_cmp8(cpu, cpu->al, (uint8_t)b);
+            return;
+        }
+    }
+
+    while (cpu->cx != 0) {
+        if (sz == 1) {
+            a = use_src ? mem_read8(cpu, src_seg, cpu->si) : cpu->al;
+            b = mem_read8(cpu, cpu->es, cpu->di);
+        } else {
+            a = use_src ? mem_read16(cpu, src_seg, cpu->si) : cpu->ax;
+            b = mem_read16(cpu, cpu->es, cpu->di);
+        }
+        if (use_src) cpu->si = (uint16_t)(cpu->si + step);
+        cpu->di = (uint16_t)(cpu->di + step);
+        cpu->cx--;
+        if ((a == b) != repz) break;
+    }
+
+    if (sz == 1)
+        flags_cmp8(cpu, (uint8_t)a, (uint8_t)b);
+    else
+        flags_cmp16(cpu, a, b);
+}
+
+void rep_cmpsb(CPU *cpu, uint16_t src_seg, int repz) { rep_compare(cpu, 1, src_seg, 1, repz); }
+void rep_cmpsw(CPU *cpu, uint16_t src_seg, int repz) { rep_compare(cpu, 1, src_seg, 2, repz); }
+void rep_scasb(CPU *cpu, int repz) { rep_compare(cpu, 0, 0, 1, repz); }
+void rep_scasw(CPU *cpu, int repz) { rep_compare(cpu, 0, 0, 2, repz); }
@@ -0,0 +1,188 @@
+"""
+abi.py - MSC cdecl calling-convention inference for native C variants
+
+Lifted calls normally go through the emulated stack: the caller pushes
+its arguments and a fake return address, the callee reads [bp+4..] (or
+[bp+6..] when far) back out of guest memory and returns with sp += 2/4.
+For functions whose frame is plain MSC 5.x cdecl, recomp.py --native-abi
+lifts instead
+
+    uint16_t name_native(CPU *cpu, uint16_t a0, uint16_t a1, ...)
+
+with every parameter slot replaced by a C parameter and the result
+returned in AX, plus a shim "void name(CPU *cpu)" that reads the
+parameters off the guest stack for callers that still use it (dispatch
+table, hand-written code, call sites that don't match below).
+
+A function is converted when (frame_params)
+
+  - it starts with PUSH BP / MOV BP, SP and never writes BP otherwise
+    (other than POP BP in the epilogue),
+  - it touches memory above BP only as parameter slots, with no index
+    register, through instructions the lifter reads and writes via
+    _read/_write (or LES/LDS for far pointer parameters),
+  - it returns with a plain RET/RETF of its own kind (no callee-pops
+    RET N) or through the shared MSC epilogue, and
+  - it is a leaf or near-leaf: every call it makes is a direct call to
+    another converted function (native_functions), so the deepest call
+    chains lose their guest-stack traffic entirely.
+
+A call site is converted (Lifter._plan_native_calls) when the pushes of
+at least the callee's parameters, the call and an ADD SP, n (or a
+single POP reg) form straight-line code with no branch targets inside
+and nothing else touching the stack; the pushes become C temporaries.
+
+Part of the Civ Recomp project (sp00nznet/civ)
+"""
+
+from decode16 import Decoder, OpType
+
+REG_SP = 4
+REG_BP = 5
+
+# Mnemonics whose memory operands the lifter emits through _read/_write
+ARG_MNEMONICS = {
+    'mov', 'xchg', 'push', 'add', 'sub', 'adc', 'sbb', 'cmp', 'test',
+    'and', 'or', 'xor', 'inc', 'dec', 'neg', 'not', 'mul', 'imul',
+    'div', 'idiv', 'shl', 'sal', 'shr', 'sar', 'les', 'lds',
+}
+
+# Instructions that move SP implicitly (not allowed around a call site)
+STACK_MNEMONICS = {
+    'push', 'pop', 'pushf', 'popf', 'pusha', 'popa', 'call', 'call far',
+    'jmp far', 'ret', 'retf', 'iret', 'int', 'into', 'enter', 'leave',
+}
+
+
+def _is_reg16(op, reg: int) -> bool:
+    return op is not None and op.type == OpType.REG16 and op.reg == reg
+
+
+def _signed(disp: int) -> int:
+    disp &= 0xFFFF
+    return disp - 0x10000 if disp & 0x8000 else disp
+
+
+def _mem_ops(inst):
+    return [op for op in (inst.op1, inst.op2)
+            if op is not None and op.type == OpType.MEM]
+
+
+def uses_sp(inst) -> bool:
+    """Instruction names SP as an operand."""
+    return _is_reg16(inst.op1, REG_SP) or _is_reg16(inst.op2, REG_SP)
+
+
+def frame_params(instructions: list, is_far: bool, mark: bool = False):
+    """Number of parameter words a cdecl function uses, or None if its
+    frame can't be converted. With mark set, each parameter operand gets
+    Operand.arg = its byte offset from the first parameter."""
+    if len(instructions) < 3:
+        return None
+    if not (instructions[0].mnemonic == 'push' and _is_reg16(instructions[0].op1, REG_BP) and
+            instructions[1].mnemonic == 'mov' and _is_reg16(instructions[1].op1, REG_BP) and
+            _is_reg16(instructions[1].op2, REG_SP)):
+        return None
+
+    first = 6 if is_far else 4      # [bp+first] is the first parameter
+    addrs = set(inst.address for inst in instructions)
+    nbytes = 0
+    slots = []
+    for i, inst in enumerate(instructions):
+        m = inst.mnemonic
+        if m in ('ret', 'retf'):
+            if inst.op1 is not None or (m == 'retf') != is_far:
+                return None
+        elif m in ('jmp far', 'iret', 'enter', 'pusha', 'popa', 'call far'):
+            return None
+        elif m == 'jmp' and inst.op1 is not None:
+            if inst.op1.type not in (OpType.REL8, OpType.REL16):
+                return None
+            if inst.op1.disp not in addrs and inst.op1.disp >= 0:
+                return None     # Tail jump out of the function
+        elif m == 'call' and (inst.op1 is None or
+                              inst.op1.type not in (OpType.REL16, OpType.FAR)):
+            return None
+        elif m == 'int' and inst.overlay_num >= 0:
+            return None
+
+        # BP holds the frame from the prologue to the epilogue
+        if i != 1 and m not in ('push', 'pop') and (_is_reg16(inst.op1, REG_BP) or
+                                                    (m == 'xchg' and _is_reg16(inst.op2, REG_BP))):
+            return None
+
+        for op in _mem_ops(inst):
+            if op.base != 'bp':
+                continue
+            disp = _signed(op.disp)
+            if disp < 0:
+                continue        # Locals
+            if op.index or disp < first or m not in ARG_MNEMONICS:
+                return None
+            off = disp - first
+            size = 4 if m in ('les', 'lds') else (op.size or 2)
+            if size > 1 and off & 1:
+                return None
+            nbytes = max(nbytes, off + size)
+            slots.append((op, off))
+
+    if mark:
+        for op, off in slots:
+            op.arg = off
+    return (nbytes + 1) // 2
+
+
+def native_candidates(functions, data: bytes, resolve, exclude=()) -> dict:
+    """{name: (params, is_far, callees)} for the functions frame_params
+    accepts; resolve(inst, func_start) names a direct call's target."""
+    candidates = {}
+    for func in functions:
+        if func.name in exclude:
+            continue
+        code = data[func.start:func.end]
+        instructions = Decoder(code, base_offset=func.start).decode_range(0, len(code))
+        params = frame_params(instructions, func.is_far)
+        if params is None:
+            continue
+        callees = {resolve(inst, func.start) for inst in instructions if inst.mnemonic == 'call'}
+        candidates[func.name] = (params, func.is_far, callees)
+    return candidates
+
+
+def native_functions(candidates: dict) -> dict:
+    """Leaf / near-leaf closure over candidates = {name: (params, is_far,
+    callees)}: the names whose every callee is converted as well, mapped
+    to (params, is_far)."""
+    natives = {}
+    changed = True
+    while changed:
+        changed = False
+        for name, (params, is_far, callees) in candidates.items():
+            if name not in natives and all(c in natives for c in callees):
+                natives[name] = (params, is_far)
+                changed = True
+    return natives
+
+
+# ─── Output ───
+
+def native_name(name: str) -> str:
+    return f'{name}_native'
+
+
+def native_prototype(name: str, params: int) -> str:
+    args = ''.join(f', uint16_t a{k}' for k in range(params))
+    return f'uint16_t {native_name(name)}(CPU *cpu{args})'
+
+
+def shim(name: str, params: int, is_far: bool) -> list:
+    """Emulated-stack entry for a native function: parameters come from
+    the guest stack above the return address the caller pushed."""
+    ret = 4 if is_far else 2
+    args = ''.join(f', sreg_read16(cpu, SREG_SS, (uint16_t)(cpu->sp + 0x{ret + 2 * k:X}))'
+                   for k in range(params))
+    return [f'void {name}(CPU *cpu)',
+            '{',
+            f'    cpu->ax = {native_name(name)}(cpu{args});',
+            f'    cpu->sp += {ret};',
+            '}']
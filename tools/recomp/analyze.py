@@ -11,15 +11,18 @@ Microsoft C 5.x function conventions:
   Callee:    Near CALL (E8) for same-segment, FAR CALL (9A) for cross-segment
   Args:      Pushed right-to-left, caller cleans stack (cdecl)
   Overlay:   INT 3Fh <ovl_num:u8> <offset:u16>
+  Data:      DS = DGROUP on entry, restored by any callee that changes it
 
 Part of the Civ Recomp project (sp00nznet/civ)
 """
 
+import os
 import struct
 import sys
 from dataclasses import dataclass, field
 from typing import Optional
 from decode16 import Decoder, Instruction, OpType
+from dgroup import DsTracker
 
 
 @dataclass
@@ -39,6 +42,10 @@ class Function:
     called_by: list = field(default_factory=list)    # Callers
     ovl_calls: list = field(default_factory=list)    # Overlay calls (ovl_num, offset)
 
+    # DS tracking (see dgroup.py)
+    ds_writes: bool = False                           # Loads DS itself
+    ds_calls: list = field(default_factory=list)     # Calls made with DS != DGROUP
+
     # Instruction count
     inst_count: int = 0
 
@@ -103,8 +110,16 @@ class Analyzer:
 
         functions = []
         current_func = None
+        first = 0           # Index of current_func's first instruction
+        sites = []          # (index, target) of its calls
         i = 0
 
+        def close(func, stop):
+            ds = DsTracker(instructions[first:stop])
+            func.ds_writes = ds.writes
+            func.ds_calls = [t for k, t in sites if not ds.clean[k - first]]
+            functions.append(func)
+
         while i < len(instructions):
             inst = instructions[i]
 
@@ -127,13 +142,15 @@ class Analyzer:
                 if current_func:
                     current_func.end = inst.offset
                     current_func.size = current_func.end - current_func.start
-                    functions.append(current_func)
+                    close(current_func, i)
 
                 # Start new function
                 current_func = Function()
                 current_func.start = inst.offset
                 current_func.overlay_num = overlay_num
                 current_func.is_overlay = overlay_num > 0
+                first = i
+                sites = []
 
                 # Check for SUB SP, N (local frame allocation)
                 if i + 2 < len(instructions):
@@ -148,19 +165,24 @@ class Analyzer:
             if current_func:
                 current_func.inst_count += 1
 
+                target = None
                 if inst.mnemonic == 'call':
                     if inst.op1 and inst.op1.type == OpType.REL16:
                         # Near call - target is relative to code range
                         target = start + inst.op1.disp
                         current_func.calls.append(target)
                     elif inst.op1 and inst.op1.type == OpType.FAR:
-                        current_func.calls.append(
-                            (inst.op1.far_seg, inst.op1.disp))
+                        target = (inst.op1.far_seg, inst.op1.disp)
+                        current_func.calls.append(target)
 
                 # Overlay calls
                 if inst.mnemonic == 'int' and inst.overlay_num >= 0:
                     current_func.ovl_calls.append(
                         (inst.overlay_num, inst.overlay_off))
+                    target = ('ovl', inst.overlay_num, inst.overlay_off)
+
+                if target is not None:
+                    sites.append((i, target))
 
                 # Detect far returns
                 if inst.mnemonic in ('retf',):
@@ -172,7 +194,7 @@ class Analyzer:
         if current_func:
             current_func.end = end
             current_func.size = current_func.end - current_func.start
-            functions.append(current_func)
+            close(current_func, len(instructions))
 
         return functions
 
@@ -333,9 +355,22 @@ class Analyzer:
 
     def export_symbols(self, path):
         """Export function map to a TOML-like symbols file."""
+        # Keep the hand-maintained [dispatch], [globals] and [overrides]
+        # sections (see dispatch.py, dgroup.py, overrides.py)
+        keep = []
+        if os.path.exists(path):
+            with open(path) as f:
+                section = None
+                for line in f:
+                    if line.startswith('['):
+                        section = line.strip()
+                    if section in ('[dispatch]', '[globals]', '[overrides]'):
+                        keep.append(line)
         with open(path, 'w') as out:
             out.write("# Civilization function symbols\n")
             out.write("# Auto-generated by analyze.py\n\n")
+            if keep:
+                out.write(''.join(keep).rstrip('\n') + '\n\n')
 
             out.write("[resident]\n")
             for f in sorted(self.functions, key=lambda f: f.start):
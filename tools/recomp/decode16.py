@@ -49,6 +49,7 @@ class Operand:
     disp: int = 0          # Displacement or immediate value
     size: int = 0          # Operand size in bytes (1 or 2)
     far_seg: int = 0       # Far pointer segment value
+    arg: int = -1          # Native parameter byte offset (abi.py), or -1
 
     def __repr__(self):
         if self.type == OpType.REG8:
@@ -777,6 +778,39 @@ class Decoder:
         return self.decode_range(0, len(self.data))
 
 
+# ─── Control flow ────────────────────────────────────────────────
+
+JUMP_MNEMONICS = {'jo', 'jno', 'jb', 'jae', 'je', 'jne', 'jbe', 'ja',
+                  'js', 'jns', 'jp', 'jnp', 'jl', 'jge', 'jle', 'jg',
+                  'jmp', 'loop', 'loopz', 'loopnz', 'jcxz'}
+
+
+def successors(instructions: list) -> list:
+    """Successor indices of each instruction of a function body. None
+    stands for leaving it: a return, a far or indirect jump, a jump out
+    of the body, or falling off its end."""
+    n = len(instructions)
+    index = {inst.address: i for i, inst in enumerate(instructions)}
+    succs = []
+    for i, inst in enumerate(instructions):
+        m = inst.mnemonic
+        nxt = [i + 1] if i + 1 < n else [None]
+        if m in ('ret', 'retf', 'iret', 'hlt', 'jmp far'):
+            succs.append([None])
+        elif m in JUMP_MNEMONICS:
+            op = inst.op1
+            tgt = None
+            if op and op.type in (OpType.REL8, OpType.REL16):
+                tgt = index.get(op.disp)
+            if m == 'jmp':
+                succs.append([tgt])
+            else:
+                succs.append([tgt] + nxt)
+        else:
+            succs.append(nxt)
+    return succs
+
+
 # ─── CLI for testing ─────────────────────────────────────────────
 
 def main():
@@ -0,0 +1,320 @@
+"""
+dgroup.py - DS == DGROUP analysis and named DGROUP globals
+
+MSC large-model code keeps DS = DGROUP everywhere except where a
+function explicitly loads another data segment, and every function that
+does restores it before returning. So a function can be lifted with its
+DS-relative accesses going straight into the DGROUP host pointer
+(dg_read16(dg, G_NAME) in include/recomp/cpu.h) when
+
+  - it never writes DS itself (mov ds / pop ds / lds), and
+  - no function reaches it through a call made while DS may hold
+    something else.
+
+DsTracker follows DS through a function for the second rule, as a
+forward dataflow fixpoint over the same successor sets the flag
+liveness pass uses (decode16.successors): DS is known to be DGROUP at
+entry, after "mov ds, ax" with AX loaded from the DGROUP segment
+immediate, and after a "pop ds" that matches a "push ds" made while it
+was, on every path that gets there. Code the fixpoint cannot reach
+(jump tables) counts as having any DS. Calls made where DS may be
+something else taint their targets and, transitively, everything those
+call.
+Calls through far pointers can't be followed; a CIV_CHECK_DGROUP build
+catches any such function entered with another DS.
+
+The [globals] section of civ.syms.toml names DGROUP variables:
+
+  name = { offset = 0x6874, type = "u16" }                  scalar
+  name = { offset = 0x5864, type = "u8", count = 80 }       array
+  name = { offset = 0x1234, type = "u8", count = 128,
+           stride = 28 }                                    records
+
+render_globals_h() turns them into G_* offsets and typed g_* accessors
+(civ_globals.h), and symbolize() lets the lifter refer to them by name.
+
+Part of the Civ Recomp project (sp00nznet/civ)
+"""
+
+import bisect
+import io
+import re
+
+from decode16 import OpType, successors
+
+# Link-time DGROUP paragraph (crt0's MOV AX, 2A1Ch; see startup.c)
+DGROUP_LINK = 0x2A1C
+
+SREG_DS = 3
+
+# Far call correction used by lift.py (file_off = seg*16 + off - corr)
+FAR_CORRECTION = 0x14
+FAR_CORRECTION_205A = 0x1A
+
+
+# ─── DS tracking ───
+
+def _is_sreg(op, reg=None) -> bool:
+    return op is not None and op.type == OpType.SREG and (reg is None or op.reg == reg)
+
+
+# Pushed segment registers remembered per path; deeper ones count as unknown
+DS_STACK_DEPTH = 16
+
+
+def _writes_ds(inst) -> bool:
+    m = inst.mnemonic
+    return ((m in ('pop', 'mov') and _is_sreg(inst.op1, SREG_DS)) or m == 'lds')
+
+
+def _loads_dgroup(inst, prev) -> bool:
+    """mov ds, r16 right after mov r16, DGROUP"""
+    op2 = inst.op2
+    return (op2 is not None and op2.type == OpType.REG16 and
+            prev is not None and prev.mnemonic == 'mov' and
+            prev.op1 is not None and prev.op1.type == OpType.REG16 and
+            prev.op1.reg == op2.reg and
+            prev.op2 is not None and prev.op2.type == OpType.IMM16 and
+            prev.op2.disp & 0xFFFF == DGROUP_LINK)
+
+
+def _join(a, b):
+    """Merge two (clean, saved) states: clean only if clean on both
+    paths, stacks compared from the top"""
+    if a is None:
+        return b
+    clean = a[0] and b[0]
+    sa, sb = a[1], b[1]
+    depth = max(len(sa), len(sb))
+    saved = tuple((len(sa) > k and sa[-1 - k]) and (len(sb) > k and sb[-1 - k])
+                  for k in range(depth - 1, -1, -1))
+    return clean, saved
+
+
+class DsTracker:
+    """Whether DS holds DGROUP before each instruction of a function."""
+
+    def __init__(self, instructions: list):
+        self.writes = any(_writes_ds(inst) for inst in instructions)
+        if not self.writes:
+            self.clean = [True] * len(instructions)
+            return
+        succs = successors(instructions)
+        states = [None] * len(instructions)
+        if instructions:
+            states[0] = (True, ())
+        self._solve(instructions, succs, states, [0] if instructions else [])
+        # Whatever is left is reached some way the CFG doesn't show
+        unreached = [i for i, st in enumerate(states) if st is None]
+        for i in unreached:
+            states[i] = (False, ())
+        self._solve(instructions, succs, states, unreached)
+        self.clean = [st[0] for st in states]
+
+    @staticmethod
+    def _step(inst, prev, state):
+        clean, saved = state
+        m, op1 = inst.mnemonic, inst.op1
+        if m == 'push' and _is_sreg(op1):
+            saved = (saved + (clean if op1.reg == SREG_DS else False,))[-DS_STACK_DEPTH:]
+        elif m == 'pop' and _is_sreg(op1):
+            top = saved[-1] if saved else False
+            saved = saved[:-1]
+            if op1.reg == SREG_DS:
+                clean = top
+        elif m == 'mov' and _is_sreg(op1, SREG_DS):
+            clean = _loads_dgroup(inst, prev)
+        elif m == 'lds':
+            clean = False
+        return clean, saved
+
+    def _solve(self, instructions, succs, states, work):
+        while work:
+            i = work.pop()
+            prev = instructions[i - 1] if i else None
+            out = self._step(instructions[i], prev, states[i])
+            for s in succs[i]:
+                if s is None:
+                    continue
+                joined = _join(states[s], out)
+                if joined != states[s]:
+                    states[s] = joined
+                    work.append(s)
+
+
+def call_targets(target, hdr_size: int, overlay_bases: dict) -> list:
+    """File offsets a recorded call target may resolve to (as lift.py does)."""
+    if isinstance(target, int):
+        return [target]
+    if target[0] == 'ovl':
+        _, num, off = target
+        return [overlay_bases[num] + off] if num in overlay_bases else []
+    seg, off = target
+    corr = FAR_CORRECTION_205A if seg == 0x205A else FAR_CORRECTION
+    return [seg * 16 + off - corr, hdr_size + seg * 16 + off]
+
+
+def dgroup_functions(functions, hdr_size: int, overlay_bases: dict) -> set:
+    """Names of the functions that run with DS == DGROUP on every path
+    to them through direct and overlay calls (far pointer calls are
+    CIV_CHECK_DGROUP's to catch)."""
+    funcs = sorted(functions, key=lambda f: f.start)
+    starts = [f.start for f in funcs]
+
+    def containing(off):
+        i = bisect.bisect_right(starts, off) - 1
+        if i >= 0 and funcs[i].start <= off < funcs[i].end:
+            return funcs[i]
+        return None
+
+    def all_calls(func):
+        return func.calls + [('ovl', n, o) for n, o in func.ovl_calls]
+
+    # Functions whose entry DS may not be DGROUP; each passes that on to
+    # everything it calls. The rest only taint what they call with DS changed.
+    tainted = set()
+    work = [(f, f.ds_calls) for f in funcs if f.ds_calls]
+    while work:
+        func, targets = work.pop()
+        for target in targets:
+            for off in call_targets(target, hdr_size, overlay_bases):
+                callee = containing(off)
+                if callee and callee.name not in tainted:
+                    tainted.add(callee.name)
+                    work.append((callee, all_calls(callee)))
+    return {f.name for f in funcs if not f.ds_writes} - tainted
+
+
+# ─── [globals] ───
+
+TYPES = {
+    'u8':  ('uint8_t', 1),
+    'i8':  ('int8_t', 1),
+    'u16': ('uint16_t', 2),
+    'i16': ('int16_t', 2),
+}
+
+_ENTRY_RE = re.compile(r'^(\w+)\s*=\s*\{([^}]*)\}\s*(?:#\s*(.*))?$')
+_FIELD_RE = re.compile(r'(\w+)\s*=\s*("[^"]*"|0[xX][0-9A-Fa-f]+|\d+)')
+
+
+class Global:
+    """One [globals] entry."""
+
+    def __init__(self, name, offset, type_, count=0, stride=0, comment=''):
+        self.name = name
+        self.offset = offset
+        self.type = type_
+        self.count = count
+        self.stride = stride
+        self.comment = comment
+
+    @property
+    def macro(self) -> str:
+        return f'G_{self.name.upper()}'
+
+    @property
+    def size(self) -> int:
+        elem = self.stride or TYPES[self.type][1]
+        return elem * max(1, self.count)
+
+
+def load_globals(syms_path: str) -> list:
+    """Parse the [globals] section of civ.syms.toml, sorted by offset."""
+    globals_ = []
+    section = None
+    try:
+        with open(syms_path) as f:
+            for line in f:
+                s = line.strip()
+                if s.startswith('['):
+                    section = s.strip('[]')
+                    continue
+                if section != 'globals':
+                    continue
+                m = _ENTRY_RE.match(s)
+                if not m:
+                    continue
+                fields = {k: v.strip('"') if v.startswith('"') else int(v, 0)
+                          for k, v in _FIELD_RE.findall(m.group(2))}
+                if 'offset' not in fields or fields.get('type') not in TYPES:
+                    print(f"  [globals] {m.group(1)}: needs offset and a type "
+                          f"({', '.join(TYPES)}), skipped")
+                    continue
+                globals_.append(Global(m.group(1), fields['offset'] & 0xFFFF,
+                                       fields['type'], fields.get('count', 0),
+                                       fields.get('stride', 0), m.group(3) or ''))
+    except OSError:
+        pass
+    return sorted(globals_, key=lambda g: g.offset)
+
+
+def symbolize(globals_: list, off: int):
+    """'G_NAME' or 'G_NAME + 0xN' for a DS offset inside a global, else None."""
+    best = None
+    for g in globals_:
+        if g.offset > off:
+            break
+        if off < g.offset + g.size and (best is None or g.size <= best.size):
+            best = g
+    if best is None:
+        return None
+    if off == best.offset:
+        return best.macro
+    return f'{best.macro} + 0x{off - best.offset:X}'
+
+
+def _accessors(g: Global) -> list:
+    ctype, width = TYPES[g.type]
+    bits = 8 * width
+    read = f'dg_read{bits}'
+    write = f'dg_write{bits}'
+    signed = g.type.startswith('i')
+    cast = f'({ctype})' if signed else ''
+    uns = f'(uint{bits}_t)' if signed else ''
+    lines = [f'#define {g.macro:<24s} 0x{g.offset:04X}']
+    if g.stride:
+        lines += [f'#define {g.macro + "_COUNT":<24s} {g.count}',
+                  f'#define {g.macro + "_STRIDE":<24s} {g.stride}',
+                  f'static inline uint8_t *g_{g.name}(uint8_t *dg, unsigned i)',
+                  f'{{ return dg + {g.macro} + i * {g.macro}_STRIDE; }}']
+    elif g.count:
+        addr = f'(uint16_t)({g.macro} + i * {width})' if width > 1 else f'(uint16_t)({g.macro} + i)'
+        lines += [f'#define {g.macro + "_COUNT":<24s} {g.count}',
+                  f'static inline {ctype} g_{g.name}(const uint8_t *dg, unsigned i)',
+                  f'{{ return {cast}{read}(dg, {addr}); }}',
+                  f'static inline void g_set_{g.name}(uint8_t *dg, unsigned i, {ctype} v)',
+                  f'{{ {write}(dg, {addr}, {uns}v); }}']
+    else:
+        lines += [f'static inline {ctype} g_{g.name}(const uint8_t *dg)',
+                  f'{{ return {cast}{read}(dg, {g.macro}); }}',
+                  f'static inline void g_set_{g.name}(uint8_t *dg, {ctype} v)',
+                  f'{{ {write}(dg, {g.macro}, {uns}v); }}']
+    return lines
+
+
+def render_globals_h(globals_: list, source: str = 'recomp.py') -> str:
+    """Source of civ_globals.h."""
+    with io.StringIO() as out:
+        out.write('/*\n')
+        out.write(' * civ_globals.h - Named DGROUP globals (civ.syms.toml [globals])\n')
+        out.write(' *\n')
+        out.write(f' * AUTO-GENERATED by {source} - DO NOT EDIT\n')
+        out.write(' *\n')
+        out.write(' * G_NAME is the DS offset. The accessors take the DGROUP pointer\n')
+        out.write(' * (cpu->dgroup, or dg in DGROUP-specialized lifted code):\n')
+        out.write(' *   scalar   g_name(dg), g_set_name(dg, v)\n')
+        out.write(' *   array    g_name(dg, i), g_set_name(dg, i, v)\n')
+        out.write(' *   records  g_name(dg, i) -> record i, G_NAME_STRIDE bytes each\n')
+        out.write(' */\n\n')
+        out.write('#ifndef CIV_GLOBALS_H\n#define CIV_GLOBALS_H\n\n')
+        out.write('#include "recomp/cpu.h"\n')
+        for g in globals_:
+            shape = g.type
+            if g.count:
+                shape += f'[{g.count}]' if not g.stride else f', {g.count} x {g.stride} bytes'
+            note = f' - {g.comment}' if g.comment else ''
+            out.write(f'\n/* {g.name}: {shape}{note} */\n')
+            out.write('\n'.join(_accessors(g)) + '\n')
+        out.write('\n#endif /* CIV_GLOBALS_H */\n')
+        return out.getvalue()
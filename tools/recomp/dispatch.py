@@ -0,0 +1,193 @@
+"""
+dispatch.py - Indirect call dispatch table generator
+
+Builds the seg:off -> function table behind recomp_dispatch() (see
+include/recomp/dispatch.h). Every function the recompiler can name gets
+an entry keyed by the linear address seg*16 + off that a far pointer to
+it would hold at runtime:
+
+  far_SSSS_OOOO   the address is in the name
+  res_XXXXXX      inverse of the lifter's far call correction
+                  (file_off = seg*16 + off - 0x14, or - 0x1A in 205A)
+  [dispatch]      explicit "SSSS:OOOO" = "name" pairs in civ.syms.toml,
+                  for pointers whose segment doesn't follow either rule
+
+The table is a two-level perfect hash (hash-and-displace): keys go into
+buckets by one hash, then each bucket - largest first - searches for a
+seed that moves all of its keys into free slots under a second hash.
+
+Part of the Civ Recomp project (sp00nznet/civ)
+"""
+
+import io
+import re
+
+# Mirrors dispatch_hash() in include/recomp/dispatch.h
+MASK32 = 0xFFFFFFFF
+
+# Far pointer correction used by lift.py for resident code
+FAR_CORRECTION = 0x14
+FAR_CORRECTION_205A = 0x1A
+SEG_205A_BASE = 0x205A * 16
+
+LOAD_SEG = 0x0100
+
+
+def dispatch_hash(key: int, seed: int) -> int:
+    key = (key ^ seed) & MASK32
+    key = (key * 0x9E3779B1) & MASK32
+    key ^= key >> 15
+    key = (key * 0x85EBCA77) & MASK32
+    key ^= key >> 13
+    return key
+
+
+def _pow2(n: int) -> int:
+    p = 1
+    while p < n:
+        p <<= 1
+    return p
+
+
+# ─── Entry collection ───
+
+_FAR_NAME_RE = re.compile(r'far_([0-9A-Fa-f]{4})_([0-9A-Fa-f]{4})$')
+_RES_NAME_RE = re.compile(r'res_([0-9A-Fa-f]{6})$')
+_EXPLICIT_RE = re.compile(
+    r'^\s*"([0-9A-Fa-f]{4}):([0-9A-Fa-f]{4})"\s*=\s*"(\w+)"')
+
+
+def resident_linear(file_off: int) -> list:
+    """Linear addresses a far call into resident code at file_off uses."""
+    addrs = [file_off + FAR_CORRECTION]
+    lin = file_off + FAR_CORRECTION_205A
+    if SEG_205A_BASE <= lin < SEG_205A_BASE + 0x10000:
+        addrs.append(lin)
+    return addrs
+
+
+def load_explicit(syms_path: str) -> dict:
+    """Parse the [dispatch] section of civ.syms.toml: linear -> name."""
+    entries = {}
+    section = None
+    try:
+        with open(syms_path) as f:
+            for line in f:
+                s = line.strip()
+                if s.startswith('['):
+                    section = s.strip('[]')
+                    continue
+                if section != 'dispatch':
+                    continue
+                m = _EXPLICIT_RE.match(s)
+                if m:
+                    seg, off = int(m.group(1), 16), int(m.group(2), 16)
+                    entries[seg * 16 + off] = m.group(3)
+    except OSError:
+        pass
+    return entries
+
+
+def collect_entries(names, explicit=None, defined=None) -> dict:
+    """Map linear address -> function name for every dispatchable name.
+
+    names holds far-callable functions only (a near res_ function would
+    return with the wrong frame size). Explicit entries win, then far_
+    names (exact), then res_ names. Explicit names must be in defined.
+    """
+    entries = {}
+    for name in sorted(names):
+        m = _RES_NAME_RE.match(name)
+        if m:
+            for lin in resident_linear(int(m.group(1), 16)):
+                entries.setdefault(lin, name)
+    for name in sorted(names):
+        m = _FAR_NAME_RE.match(name)
+        if m:
+            entries[int(m.group(1), 16) * 16 + int(m.group(2), 16)] = name
+    for lin, name in (explicit or {}).items():
+        if name in (defined if defined is not None else names):
+            entries[lin] = name
+        else:
+            print(f"  [dispatch] {name}: not a known function, skipped")
+    return entries
+
+
+# ─── Perfect hash ───
+
+def build_perfect_hash(keys: list) -> tuple:
+    """Return (disp, slots) with slots[i] = index into keys or None."""
+    n = len(keys)
+    nbuckets = _pow2(max(1, n // 2))
+    nslots = _pow2(max(2, n + n // 4))
+
+    buckets = [[] for _ in range(nbuckets)]
+    for i, k in enumerate(keys):
+        buckets[dispatch_hash(k, 0) & (nbuckets - 1)].append(i)
+
+    disp = [0] * nbuckets
+    slots = [None] * nslots
+    order = sorted(range(nbuckets), key=lambda b: -len(buckets[b]))
+    for b in order:
+        if not buckets[b]:
+            break
+        for seed in range(1, 0x10000):
+            placed = set()
+            for i in buckets[b]:
+                s = dispatch_hash(keys[i], seed) & (nslots - 1)
+                if slots[s] is not None or s in placed:
+                    break
+                placed.add(s)
+            else:
+                break
+        else:
+            raise RuntimeError(f'dispatch: no seed for bucket {b} ({len(buckets[b])} keys)')
+        disp[b] = seed
+        for i in buckets[b]:
+            slots[dispatch_hash(keys[i], seed) & (nslots - 1)] = i
+    return disp, slots
+
+
+# ─── Output ───
+
+def _rows(values: list, fmt: str, per_line: int = 12) -> str:
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ', '.join(fmt.format(v) for v in values[i:i + per_line]) + ',')
+    return '\n'.join(lines)
+
+
+def render_dispatch_c(entries: dict, source: str = 'recomp.py') -> str:
+    """Source of civ_dispatch.c, defining civ_dispatch_table."""
+    addrs = sorted(entries)
+    names = sorted(set(entries.values()))
+    disp, slots = build_perfect_hash(addrs)
+
+    with io.StringIO() as out:
+        out.write('/*\n')
+        out.write(' * civ_dispatch.c - seg:off -> function table for recomp_dispatch()\n')
+        out.write(' *\n')
+        out.write(f' * AUTO-GENERATED by {source} - DO NOT EDIT\n')
+        out.write(f' * {len(addrs)} entries, {len(disp)} buckets, {len(slots)} slots\n')
+        out.write(' */\n\n')
+        out.write('#include "recomp/dispatch.h"\n\n')
+        out.write('/* Forward declarations */\n')
+        for name in names:
+            out.write(f'void {name}(CPU *cpu);\n')
+        out.write('\nstatic const DispatchEntry entries[] = {\n')
+        for a in addrs:
+            out.write(f'    {{ 0x{a:05X}, {entries[a]}, "{entries[a]}" }},\n')
+        if not addrs:
+            out.write('    { 0xFFFFFFFF, 0, 0 },\n')
+        out.write('};\n\n')
+        out.write('static const uint16_t disp[] = {\n')
+        out.write(_rows(disp, '0x{:04X}') + '\n};\n\n')
+        out.write('static const uint16_t slots[] = {\n')
+        out.write(_rows([0xFFFF if s is None else s for s in slots], '0x{:04X}') + '\n};\n\n')
+        out.write('const DispatchTable civ_dispatch_table = {\n')
+        out.write(f'    entries, {len(addrs)},\n')
+        out.write(f'    disp, 0x{len(disp) - 1:X},\n')
+        out.write(f'    slots, 0x{len(slots) - 1:X},\n')
+        out.write(f'    0x{LOAD_SEG:04X},\n')
+        out.write('};\n')
+        return out.getvalue()
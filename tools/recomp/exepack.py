@@ -0,0 +1,181 @@
+"""
+exepack.py - Pre-baked startup image (civ_image.c)
+
+Does at build time what res_02A310 (src/recomp/startup.c) does on every
+start: unpacks the EXEPACK-compressed resident image as DOS would have
+loaded it at LOAD_SEG:0000 and adds LOAD_SEG to every segment fixup in
+the EXEPACK relocation table. The result is written into civ_image.c as
+a StartupImage (include/recomp/startup.h): PackBits-packed the same way
+snapshot.c packs memory pages, with FNV-1a hashes of the loaded bytes it
+was made from and of the unpacked image, so the runtime only trusts it
+for the same CIV.EXE and can check it against the live decompressor
+(civ --verify-image).
+
+An EXE without an EXEPACK header gets an empty image, and the runtime
+decompresses live as before.
+
+Part of the Civ Recomp project (sp00nznet/civ)
+"""
+
+import io
+import struct
+
+LOAD_SEG = 0x0100       # Segment the resident image is loaded at
+EXEPACK_CS = 0x2A10     # EXEPACK header paragraph, from the MZ entry CS
+RELOC_FROM_HDR = 0x125  # Relocation table offset in the EXEPACK block
+SIGNATURE = 0x4252      # "RB"
+
+
+class Image:
+    """Unpacked resident image and the loaded bytes it came from."""
+
+    def __init__(self, source: bytes, data: bytes, blocks: int, relocs: int):
+        self.source = source
+        self.data = data
+        self.blocks = blocks
+        self.relocs = relocs
+
+
+def fnv1a(data: bytes) -> int:
+    h = 0xCBF29CE484222325
+    for b in data:
+        h = ((h ^ b) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def resident_image(exe: bytes) -> bytes:
+    """The load module DOS reads from the MZ file (header and overlays excluded)."""
+    hdr_size = struct.unpack_from('<H', exe, 8)[0] * 16
+    last_page, pages = struct.unpack_from('<HH', exe, 2)
+    total = (pages - 1) * 512 + last_page if last_page else pages * 512
+    return exe[hdr_size:total]
+
+
+def unpack(exe: bytes):
+    """Decompress and relocate the resident image of exe, or None if it
+    isn't EXEPACKed. Mirrors exepack_decompress in startup.c byte for byte,
+    including the memory past the loaded bytes reading as zero."""
+    if exe[:2] != b'MZ':
+        return None
+    loaded = resident_image(exe)
+    hdr_off = EXEPACK_CS * 16
+    if hdr_off + 16 > len(loaded):
+        return None
+    exepack_size, = struct.unpack_from('<H', loaded, hdr_off + 6)
+    dest_len, signature = struct.unpack_from('<HH', loaded, hdr_off + 12)
+    if signature != SIGNATURE or dest_len == 0:
+        return None
+
+    source_size = hdr_off + exepack_size
+    size = dest_len * 16
+    image = bytearray(max(len(loaded), source_size, size))
+    image[:len(loaded)] = loaded
+    source = bytes(image[:source_size])
+    block = source[hdr_off:]
+
+    src, dst = hdr_off, size
+    while src > 0 and image[src - 1] == 0xFF:
+        src -= 1
+    blocks = 0
+    done = False
+    while not done and src >= 3:
+        cmd, count = image[src - 1], image[src - 2] << 8 | image[src - 3]
+        src -= 3
+        if cmd & 0xFE == 0xB0:
+            if src == 0:
+                raise ValueError('EXEPACK: fill past the start of the image')
+            src -= 1
+            n = min(count, dst)
+            image[dst - n:dst] = bytes([image[src]]) * n
+            dst -= n
+        elif cmd & 0xFE == 0xB2:
+            n = min(count, src, dst)
+            if dst >= src:
+                # The byte-at-a-time backward copy never reads what it wrote
+                image[dst - n:dst] = image[src - n:src]
+                src -= n
+                dst -= n
+            else:
+                for _ in range(n):
+                    src -= 1
+                    dst -= 1
+                    image[dst] = image[src]
+        else:
+            raise ValueError(f'EXEPACK: bad opcode 0x{cmd:02X} at src={src + 1}')
+        blocks += 1
+        done = bool(cmd & 0x01)
+
+    reloc = RELOC_FROM_HDR
+    relocs = 0
+    for seg in range(16):
+        if reloc + 2 > exepack_size:
+            break
+        count, = struct.unpack_from('<H', block, reloc)
+        reloc += 2
+        for _ in range(count):
+            if reloc + 2 > exepack_size:
+                break
+            offset, = struct.unpack_from('<H', block, reloc)
+            reloc += 2
+            addr = seg * 0x10000 + offset
+            if addr + 1 < size:
+                value, = struct.unpack_from('<H', image, addr)
+                struct.pack_into('<H', image, addr, (value + LOAD_SEG) & 0xFFFF)
+                relocs += 1
+
+    return Image(source, bytes(image[:size]), blocks, relocs)
+
+
+def pack(data: bytes) -> bytes:
+    """PackBits-style RLE, the encoder of pack() in snapshot.c."""
+    out = bytearray()
+    i, n = 0, len(data)
+    while i < n:
+        run = 1
+        while i + run < n and run < 130 and data[i + run] == data[i]:
+            run += 1
+        if run >= 3:
+            out += bytes((0x80 + run - 3, data[i]))
+            i += run
+            continue
+        start = i
+        while i < n and i - start < 128:
+            if i + 2 < n and data[i] == data[i + 1] == data[i + 2]:
+                break
+            i += 1
+        out.append(i - start - 1)
+        out += data[start:i]
+    return bytes(out)
+
+
+def render_image_c(image, source: str = 'recomp.py') -> str:
+    """Source of civ_image.c, defining civ_startup_image (empty for None)."""
+    with io.StringIO() as out:
+        out.write('/*\n')
+        out.write(' * civ_image.c - Pre-baked EXEPACK-decompressed, relocated startup image\n')
+        out.write(' *\n')
+        out.write(f' * AUTO-GENERATED by {source} - DO NOT EDIT\n')
+        out.write(' * Source: CIV.EXE (Sid Meier\'s Civilization, 1991)\n')
+        out.write(' */\n\n')
+        out.write('#include "recomp/startup.h"\n\n')
+        if image is None:
+            out.write('/* No EXEPACK header in CIV.EXE: startup decompresses live */\n')
+            out.write('const StartupImage civ_startup_image = { 0 };\n')
+            return out.getvalue()
+
+        packed = pack(image.data)
+        out.write(f'/* {len(image.data)} bytes from LOAD_SEG:0000, {image.blocks} blocks, '
+                  f'{image.relocs} relocations */\n')
+        out.write('static const uint8_t packed[] = {\n')
+        for i in range(0, len(packed), 16):
+            out.write('    ' + ','.join(f'0x{b:02X}' for b in packed[i:i + 16]) + ',\n')
+        out.write('};\n\n')
+        out.write('const StartupImage civ_startup_image = {\n')
+        out.write(f'    .source_size = {len(image.source)},\n')
+        out.write(f'    .source_hash = 0x{fnv1a(image.source):016X}ULL,\n')
+        out.write(f'    .size        = {len(image.data)},\n')
+        out.write(f'    .hash        = 0x{fnv1a(image.data):016X}ULL,\n')
+        out.write('    .packed      = packed,\n')
+        out.write('    .packed_size = sizeof(packed),\n')
+        out.write('};\n')
+        return out.getvalue()
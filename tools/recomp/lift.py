@@ -9,14 +9,70 @@ Generated code style:
     void res_001234(CPU *cpu) {
         push16(cpu, cpu->bp);           // push bp
         cpu->bp = cpu->sp;              // mov bp, sp
-        cpu->sp -= 0x10;               // sub sp, 0x10
+        cpu->sp = lazy_sub16(cpu, cpu->sp, 0x10);  // sub sp, 0x10
         ...
     }
 
+Lazy flags (default): ALU ops emit the lazy_* record helpers from cpu.h,
+which only store the op kind, operands and result. Flags are derived on
+demand by cc_*() and materialized with flags_sync() before anything that
+reads or writes cpu->flags directly. Lifter(lazy_flags=False) emits the
+eager flags_* helpers instead.
+
+Structured control flow (default): branches are rebuilt into if/else,
+do-while, for(;;) and counted for loops over contiguous instruction
+ranges; only branches that don't fit a pattern stay as goto. See
+Lifter._structure. Lifter(structure=False) emits one goto per branch.
+
+Segment registers: memory operands go through sreg_read*/sreg_write*,
+which add the offset to the segment's cached flat base (CPU.seg_base),
+and every write to a segment register (mov/pop sreg, lds, les) is a
+set_sreg call that keeps that base current. See _SEG_ACCESS_RE.
+
+DGROUP specialization (dgroup_funcs): in functions proven to run with
+DS = DGROUP (see dgroup.py) DS-relative operands become dg_read*/dg_write*
+on a DGROUP pointer fetched once at entry, and displacements that fall
+inside a [globals] entry of civ.syms.toml are written as its G_* name.
+See _DG_ACCESS_RE.
+
+Native calling convention (natives): functions abi.py proves to be
+plain cdecl leaves or near-leaves are lifted as name_native(cpu, a0..)
+returning AX, with their parameter slots as C parameters, plus an
+emulated-stack shim name(cpu). Call sites whose pushes and stack cleanup
+are straight-line call name_native directly. See _plan_native_calls.
+
+Overrides (overrides): calls to hand-written replacements registered in
+the [overrides] section of civ.syms.toml go through OVERRIDE_CALL, so
+civ --verify-overrides can check them against the lifted original. See
+overrides.py.
+
+Register promotion (promote_regs=True): AX..DX, SI, DI and BP are
+copied into C locals at function entry so the compiler can keep them in
+host registers despite cpu->mem aliasing the register file. They are
+spilled back to CPU before calls, INTs and port I/O, reloaded after calls
+and INTs, and spilled at every exit. Segment registers stay in CPU, next
+to their cached bases; SP stays there because push16/pop16 and the call
+sequences use it directly.
+
+Safe points: every loop back-edge (the bottom of a structured loop, or
+a branch to an earlier address) gets RECOMP_SAFE_POINT, and every
+function entry has one in RECOMP_ENTER. Those are where cpu_safe_point
+may run the game's timer interrupt handlers (see cpu.h).
+
+Profiling (profile=True): the body is emitted as a static name_body()
+and name() becomes a wrapper that brackets it with prof_enter/prof_exit
+on a static ProfSite (see include/recomp/profile.h), so every return
+path is covered without touching the body.
+
 Part of the Civ Recomp project (sp00nznet/civ)
 """
 
-from decode16 import Decoder, Instruction, OpType, Operand, REG8_NAMES, REG16_NAMES, SREG_NAMES
+import re
+
+import abi
+from dgroup import symbolize
+from decode16 import (Decoder, Instruction, OpType, Operand, REG8_NAMES, REG16_NAMES,
+                      SREG_NAMES, JUMP_MNEMONICS, successors)
 
 
 def _reg8(op: Operand) -> str:
@@ -31,6 +87,10 @@ def _sreg(op: Operand) -> str:
     """Generate C expression for segment register access."""
     return f'cpu->{SREG_NAMES[op.reg]}'
 
+def _set_sreg(name: str, val: str) -> str:
+    """Generate C statement writing segment register 'ds' etc."""
+    return f'set_sreg(cpu, SREG_{name.upper()}, (uint16_t)({val}));'
+
 def _mem_addr(op: Operand) -> tuple:
     """Generate (seg_expr, off_expr) for memory operand."""
     seg = f'cpu->{op.seg}' if op.seg else 'cpu->ds'
@@ -60,8 +120,33 @@ def _mem_addr(op: Operand) -> tuple:
 
     return seg, off
 
+def _arg_read(op: Operand) -> str:
+    """Native parameter slot as a C expression (see abi.py)."""
+    k, hi = op.arg >> 1, op.arg & 1
+    if op.size == 1:
+        return f'(uint8_t)(a{k} >> 8)' if hi else f'(uint8_t)a{k}'
+    return f'a{k}'
+
+def _arg_write(op: Operand, val: str) -> str:
+    k, hi = op.arg >> 1, op.arg & 1
+    if op.size != 1:
+        return f'a{k} = (uint16_t)({val});'
+    if hi:
+        return f'a{k} = (uint16_t)((a{k} & 0x00FF) | ((uint16_t)(uint8_t)({val}) << 8));'
+    return f'a{k} = (uint16_t)((a{k} & 0xFF00) | (uint8_t)({val}));'
+
+def _mem_pair(op: Operand) -> tuple:
+    """(offset, segment) word expressions of an m16:16 operand."""
+    if op.arg >= 0:
+        return f'a{op.arg >> 1}', f'a{(op.arg >> 1) + 1}'
+    seg, off = _mem_addr(op)
+    return (f'mem_read16(cpu, {seg}, {off})',
+            f'mem_read16(cpu, {seg}, (uint16_t)({off} + 2))')
+
 def _read(op: Operand) -> str:
     """Generate C expression to read an operand value."""
+    if op.arg >= 0:
+        return _arg_read(op)
     if op.type == OpType.REG8:
         return _reg8(op)
     elif op.type == OpType.REG16:
@@ -80,12 +165,14 @@ def _read(op: Operand) -> str:
 
 def _write(op: Operand, val: str) -> str:
     """Generate C statement to write a value to an operand."""
+    if op.arg >= 0:
+        return _arg_write(op, val)
     if op.type == OpType.REG8:
         return f'{_reg8(op)} = (uint8_t)({val});'
     elif op.type == OpType.REG16:
         return f'{_reg16(op)} = (uint16_t)({val});'
     elif op.type == OpType.SREG:
-        return f'{_sreg(op)} = (uint16_t)({val});'
+        return _set_sreg(SREG_NAMES[op.reg], val)
     elif op.type == OpType.MEM or op.type == OpType.MOFFS:
         seg, off = _mem_addr(op)
         if op.size == 1:
@@ -101,10 +188,190 @@ def _label(addr: int, prefix: str = '') -> str:
     return f'L_{addr:06X}'
 
 
+# ─── Flag liveness ───
+#
+# Backward dataflow over a function's instruction list. For every
+# instruction we compute which flags are live after it (read later on some
+# path before being overwritten). An ALU op whose flag writes are all dead
+# is emitted as plain C arithmetic with no flag helper at all.
+#
+# Conservative assumptions: flags are live at every exit (ret/retf, jumps
+# out of the function, indirect jumps), since callers do test CF/ZF set by
+# callees. Calls and INTs neither read nor write flags in this model, so
+# flags set by a callee stay live across the call site. Anything we don't
+# model (rotates, BCD, unhandled opcodes) reads all flags.
+
+F_CF, F_PF, F_AF, F_ZF, F_SF, F_OF = 0x001, 0x004, 0x010, 0x040, 0x080, 0x800
+F_ALL = F_CF | F_PF | F_AF | F_ZF | F_SF | F_OF
+F_SZP = F_SF | F_ZF | F_PF
+
+JCC_READS = {
+    'jo': F_OF, 'jno': F_OF, 'jb': F_CF, 'jae': F_CF,
+    'je': F_ZF, 'jne': F_ZF, 'jbe': F_CF | F_ZF, 'ja': F_CF | F_ZF,
+    'js': F_SF, 'jns': F_SF, 'jp': F_PF, 'jnp': F_PF,
+    'jl': F_SF | F_OF, 'jge': F_SF | F_OF,
+    'jle': F_ZF | F_SF | F_OF, 'jg': F_ZF | F_SF | F_OF,
+}
+
+BRANCH_MNEMONICS = JUMP_MNEMONICS
+
+# (reads, writes) per mnemonic; mnemonics not listed touch no flags
+FLAG_EFFECTS = {
+    'add': (0, F_ALL), 'sub': (0, F_ALL), 'cmp': (0, F_ALL), 'neg': (0, F_ALL),
+    'and': (0, F_ALL), 'or': (0, F_ALL), 'xor': (0, F_ALL), 'test': (0, F_ALL),
+    'adc': (F_CF, F_ALL), 'sbb': (F_CF, F_ALL),
+    'inc': (0, F_ALL & ~F_CF), 'dec': (0, F_ALL & ~F_CF),
+    'shl': (0, F_CF | F_SZP), 'sal': (0, F_CF | F_SZP),
+    'shr': (0, F_CF | F_SZP), 'sar': (0, F_CF | F_SZP),
+    'mul': (0, F_CF | F_OF), 'imul': (0, F_CF | F_OF),
+    'scasb': (0, F_ALL), 'scasw': (0, F_ALL),
+    'cmpsb': (0, F_ALL), 'cmpsw': (0, F_ALL),
+    'clc': (0, F_CF), 'stc': (0, F_CF), 'cmc': (F_CF, F_CF),
+    'sahf': (0, F_CF | F_PF | F_AF | F_ZF | F_SF),
+    'lahf': (F_CF | F_PF | F_AF | F_ZF | F_SF, 0),
+    'pushf': (F_ALL, 0), 'popf': (0, F_ALL),
+    'loopz': (F_ZF, 0), 'loopnz': (F_ZF, 0),
+    'rol': (F_ALL, 0), 'ror': (F_ALL, 0), 'rcl': (F_ALL, 0), 'rcr': (F_ALL, 0),
+    'daa': (F_ALL, 0), 'das': (F_ALL, 0), 'aaa': (F_ALL, 0), 'aas': (F_ALL, 0),
+    'aam': (F_ALL, 0), 'aad': (F_ALL, 0), 'db': (F_ALL, 0),
+}
+FLAG_EFFECTS.update({m: (r, 0) for m, r in JCC_READS.items()})
+
+# Ops the lifter can emit without their flag computation
+FLAG_ELIDABLE = {'add', 'sub', 'cmp', 'neg', 'and', 'or', 'xor', 'test',
+                 'adc', 'sbb', 'inc', 'dec', 'shl', 'sal', 'shr', 'sar',
+                 'mul', 'imul'}
+
+
+def _flag_effects(inst: Instruction) -> tuple:
+    """(reads, writes) flag masks for an instruction."""
+    m = inst.mnemonic
+    if inst.prefix in ('rep', 'repnz') and m in ('scasb', 'scasw', 'cmpsb', 'cmpsw'):
+        return 0, 0     # CX may be 0: flags possibly untouched, ZF test is internal
+    return FLAG_EFFECTS.get(m, (0, 0))
+
+
+def compute_flag_liveness(instructions: list) -> list:
+    """Return the live-out flag mask for each instruction (same order)."""
+    n = len(instructions)
+    succs = successors(instructions)
+    effects = [_flag_effects(inst) for inst in instructions]
+    live_in = [0] * n
+    live_out = [0] * n
+    changed = True
+    while changed:
+        changed = False
+        for i in range(n - 1, -1, -1):
+            out = 0
+            for s in succs[i]:
+                out |= F_ALL if s is None else live_in[s]
+            reads, writes = effects[i]
+            new_in = reads | (out & ~writes)
+            if out != live_out[i] or new_in != live_in[i]:
+                live_out[i] = out
+                live_in[i] = new_in
+                changed = True
+    return live_out
+
+
+# ─── Control-flow structuring ───
+#
+# Regions are contiguous instruction ranges [lo, hi). Falling off the
+# end of a region is always equivalent to executing the instruction at
+# index hi, which is what makes the rewrites below safe even when other
+# branches stay as gotos (C allows jumping into a block):
+#
+#   jcc T; A...; T:                  ->  if (!cc) { A }
+#   jcc T; A...; jmp E; T: B...; E:  ->  if (!cc) { A } else { B }
+#   H: A...; jcc/loop H              ->  do { A } while (cc / --cx != 0)
+#   H: A...; jmp H                   ->  for (;;) { A }
+#   jcxz X; H: A...; loop H; X:      ->  for (; cx != 0; cx--) { A }
+#   jmp C; B: A...; C: D...; jcc B   ->  for (;;) { D; if (!cc) break; A }
+#
+# The last one is how MSC compiles while/for loops (test at the bottom).
+
+CC_MAP = {
+    'jo': 'cc_o', 'jno': 'cc_no', 'jb': 'cc_b', 'jae': 'cc_ae',
+    'je': 'cc_e', 'jne': 'cc_ne', 'jbe': 'cc_be', 'ja': 'cc_a',
+    'js': 'cc_s', 'jns': 'cc_ns', 'jp': 'cc_p', 'jnp': 'cc_np',
+    'jl': 'cc_l', 'jge': 'cc_ge', 'jle': 'cc_le', 'jg': 'cc_g',
+}
+
+# Jcc with the opposite condition
+CC_INVERSE = {}
+for _a, _b in (('jo', 'jno'), ('jb', 'jae'), ('je', 'jne'), ('jbe', 'ja'),
+               ('js', 'jns'), ('jp', 'jnp'), ('jl', 'jge'), ('jle', 'jg')):
+    CC_INVERSE[_a], CC_INVERSE[_b] = _b, _a
+
+LOOP_COND = {
+    'loop': '--cpu->cx != 0',
+    'loopz': '--cpu->cx != 0 && zf(cpu)',
+    'loopnz': '--cpu->cx != 0 && !zf(cpu)',
+}
+
+
+# ─── Register promotion ───
+
+# Word registers with byte halves (Reg16 locals) and plain word registers
+PROMOTE_WORD8 = ('ax', 'bx', 'cx', 'dx')
+PROMOTE_WORD = ('si', 'di', 'bp')
+
+_REG_TOKEN_RE = re.compile(r'cpu->(?:([abcd])([xlh])|(si|di|bp))\b')
+
+# Memory access through a segment register: use its cached base instead
+_SEG_ACCESS_RE = re.compile(r'\bmem_(read|write)(8|16)\(cpu, cpu->(es|cs|ss|ds), ')
+
+
+def _seg_access(match) -> str:
+    return f'sreg_{match.group(1)}{match.group(2)}(cpu, SREG_{match.group(3).upper()}, '
+
+# DS-relative access in a DGROUP-specialized function
+_DG_ACCESS_RE = re.compile(r'\bsreg_(read|write)(8|16)\(cpu, SREG_DS, ')
+# Displacement of a dg_* access: [disp] or [reg (+ reg) + disp]
+_DG_DISP_RE = re.compile(
+    r'(\bdg_(?:read|write)(?:8|16)\(dg, (?:\(uint16_t\)\((?:cpu->\w+ \+ )+)?)0x([0-9A-F]+)\b')
+
+# Statements after which CPU registers may have changed (spill + reload)
+_SPILL_RELOAD_RE = re.compile(
+    r'\b(?:(?:res|far|ovl\d+)_\w+\(cpu[,)]|'
+    r'(?:dos_int21|bios_int10|bios_int16|mouse_int33|int_handler|rep_\w+|recomp_dispatch|'
+    r'OVERRIDE_CALL)\(cpu)')
+# Statements that only read CPU state (spill)
+_SPILL_ONLY_RE = re.compile(r'\bport_(?:in|out)8\(cpu')
+
+# Return statements, which spill promoted registers first
+_RETURN_RE = re.compile(r'\breturn(?=;| cpu->ax;| r_ax\.x;)')
+
+# Overlay number of an ovlNN_XXXXXX function (for ProfSite.overlay)
+_OVL_NAME_RE = re.compile(r'ovl(\d+)_')
+
+
+def _promote_token(match) -> str:
+    if match.group(1):
+        return f'r_{match.group(1)}x.{match.group(2)}'
+    return f'r_{match.group(3)}'
+
+
+def promoted_registers(body: list) -> list:
+    """Promotable registers referenced by an (unpromoted) function body."""
+    used = set()
+    for line in body:
+        for m in _REG_TOKEN_RE.finditer(line):
+            used.add(f'{m.group(1)}x' if m.group(1) else m.group(3))
+    return [r for r in PROMOTE_WORD8 + PROMOTE_WORD if r in used]
+
+
+def _promoted_field(reg: str) -> str:
+    return f'r_{reg}.x' if reg in PROMOTE_WORD8 else f'r_{reg}'
+
+
 class Lifter:
     """Lifts x86-16 instructions to C code."""
 
-    def __init__(self, overlay_bases=None, hdr_size=0x200, known_funcs=None):
+    def __init__(self, overlay_bases=None, hdr_size=0x200, known_funcs=None,
+                 lazy_flags=True, flag_liveness=True, promote_regs=False,
+                 structure=True, profile=False, dgroup_funcs=None, globals_=None,
+                 natives=None, overrides=None):
         self.output = []
         self.indent = 1
         self.labels_needed = set()
@@ -118,9 +385,69 @@ class Lifter:
         self.hdr_size = hdr_size
         # Set of known function file offsets (for resolving far calls)
         self.known_funcs = known_funcs or set()
+        # Emit lazy_* flag record helpers instead of eager flags_*
+        self.lazy_flags = lazy_flags
+        # Keep GPRs/segment registers in C locals (see promoted_registers)
+        self.promote_regs = promote_regs
+        self.promoted = []          # Registers held in locals in current function
+        self._spill = ''            # Statements storing them back to CPU
+        self._reload = ''           # Statements re-reading them from CPU
+        # Rebuild if/else and loops instead of one goto per branch
+        self.structure = structure
+        self.cf_stats = {}          # Structured constructs in current function
+        # Wrap each function in prof_enter/prof_exit
+        self.profile = profile
+        # Functions to lift with DS = DGROUP, and the named globals in it
+        self.dgroup_funcs = dgroup_funcs or set()
+        self.globals = globals_ or []
+        self.dgroup = False         # Current function is DGROUP-specialized
+        # name -> (parameter words, is_far) of functions lifted as
+        # name_native (see abi.py)
+        self.natives = natives or {}
+        self.overrides = overrides or set()   # Names registered in civ_overrides.c
+        self.native = None          # (params, is_far) if current function is one
+        self.sites = {}             # Instruction address -> native call site role
+        # Drop flag computations that the liveness pass proves dead
+        self.flag_liveness = flag_liveness
+        self.dead_flags = set()     # Addresses whose flag writes are dead
+        self.flag_ops = 0           # Flag-computing ops in current function
+        self.flags_removed = 0      # ... of which emitted as plain C
+
+    def _sync(self) -> str:
+        """Prefix for code that touches cpu->flags directly (lazy mode only)."""
+        return 'flags_sync(cpu); ' if self.lazy_flags else ''
+
+    def _alu(self, op: str, sz: str) -> str:
+        """Name of the flag helper for an ALU op ('add', 'sub', 'cmp', 'logic')."""
+        return f'{"lazy" if self.lazy_flags else "flags"}_{op}{sz}'
 
     def _emit(self, code: str, comment: str = ''):
         """Emit a line of C code with optional comment."""
+        code = _SEG_ACCESS_RE.sub(_seg_access, code)
+        if self.native:
+            code = code.replace('return;', 'return cpu->ax;')
+        if self.dgroup:
+            code = _DG_ACCESS_RE.sub(r'dg_\1\2(dg, ', code)
+            if self.globals:
+                code = _DG_DISP_RE.sub(self._dg_symbol, code)
+        if self.promoted:
+            code = _REG_TOKEN_RE.sub(_promote_token, code)
+            if _SPILL_RELOAD_RE.search(code):
+                self._emit_line(self._spill)
+                self._emit_line(code, comment)
+                self._emit_line(self._reload)
+                return
+            if _SPILL_ONLY_RE.search(code):
+                self._emit_line(self._spill)
+            code = _RETURN_RE.sub(f'{self._spill} return', code)
+        self._emit_line(code, comment)
+
+    def _dg_symbol(self, match) -> str:
+        sym = symbolize(self.globals, int(match.group(2), 16))
+        return match.group(1) + sym if sym else match.group(0)
+
+    def _emit_line(self, code: str, comment: str = ''):
+        """Emit one formatted line, aligning the comment."""
         pad = '    ' * self.indent
         if comment:
             # Align comments
@@ -132,6 +459,139 @@ class Lifter:
             line = f'{pad}{code}'
         self.output.append(line)
 
+    def _far_ptr(self, op: Operand) -> str:
+        """'seg, off' argument pair for an m16:16 far pointer operand."""
+        seg, off = _mem_addr(op)
+        return (f'mem_read16(cpu, {seg}, (uint16_t)({off} + 2)), '
+                f'mem_read16(cpu, {seg}, {off})')
+
+    def _emit_site(self, inst: Instruction, site: tuple, func_start: int, orig: str):
+        """Emit one instruction of a native call site (_plan_native_calls).
+        Returns False if the instruction still needs its normal lifting."""
+        kind, val = site
+        if kind == 'push':
+            self._emit(f'{val} = {_read(inst.op1)};', orig)
+        elif kind == 'call':
+            func_name = self.call_name(inst, func_start)
+            self.func_calls.add(func_name)
+            args = ''.join(f', {a}' for a in val)
+            code = f'{self._sync()}cpu->ax = {abi.native_name(func_name)}(cpu{args});'
+            if self.promoted:
+                # Not through _emit: the result must land in cpu->ax for the reload
+                self._emit_line(self._spill)
+                self._emit_line(code, orig)
+                self._emit_line(self._reload)
+            else:
+                self._emit(code, orig)
+        elif kind == 'pop':
+            self._emit(_write(inst.op1, val), orig)
+        elif inst.address in self.dead_flags:
+            self._emit('/* arguments passed natively */', orig)
+        else:
+            # Flags are live: rewind SP so the ADD computes them as before
+            self._emit(f'cpu->sp = (uint16_t)(cpu->sp - 0x{val:X});', 'native call args')
+            return False
+        return True
+
+    def _plan_native_calls(self, func_start: int):
+        """Find calls to native functions whose argument pushes and stack
+        cleanup are straight-line code, and plan them as C temporaries:
+        self.sites maps each instruction address involved to its role."""
+        self.sites = {}
+        insts = self.insts
+        for c, call in enumerate(insts):
+            if call.mnemonic != 'call' or call.op1 is None:
+                continue
+            info = self.natives.get(self.call_name(call, func_start))
+            if info is None or info[1] != (call.op1.type == OpType.FAR):
+                continue
+            params = info[0]
+
+            # Stack cleanup after the call gives the pushed argument count
+            clean = insts[c + 1] if c + 1 < len(insts) else None
+            if (clean is not None and clean.mnemonic == 'add' and
+                    clean.op1 is not None and clean.op1.type == OpType.REG16 and
+                    clean.op1.reg == abi.REG_SP and clean.op2 is not None and
+                    clean.op2.type in (OpType.IMM8, OpType.IMM16) and clean.op2.disp & 1 == 0):
+                count = (clean.op2.disp & 0xFFFF) // 2
+            elif (clean is not None and clean.mnemonic == 'pop' and
+                  clean.op1 is not None and clean.op1.type == OpType.REG16 and
+                  clean.op1.reg != abi.REG_SP):
+                count = 1
+            else:
+                clean, count = None, 0
+            if count < params or (clean and clean.address in self.branch_refs):
+                continue
+
+            # Walk back over the pushes through code that leaves SP alone
+            pushes = []
+            i = c - 1
+            while len(pushes) < count and i >= 0:
+                inst = insts[i]
+                if (inst.address in self.sites or abi.uses_sp(inst) or
+                        inst.mnemonic in BRANCH_MNEMONICS or inst.prefix):
+                    break
+                if inst.mnemonic == 'push':
+                    pushes.append(inst)
+                elif inst.mnemonic in abi.STACK_MNEMONICS:
+                    break
+                i -= 1
+            if len(pushes) < count:
+                continue
+            first = i + 1 if count else c
+            if any(insts[j].address in self.branch_refs for j in range(first + 1, c + 1)):
+                continue
+
+            # The last push is the first argument
+            names = [f'arg{k}_{call.address:X}' for k in range(count)]
+            for k, inst in enumerate(pushes):
+                self.sites[inst.address] = ('push', names[k])
+            self.sites[call.address] = ('call', names[:params])
+            if clean is not None:
+                self.sites[clean.address] = ('pop', names[0]) if clean.mnemonic == 'pop' else ('drop', 2 * count)
+
+    def _call(self, func_name: str) -> str:
+        """Call statement; registered overrides can be verified (override.h)."""
+        if func_name in self.overrides:
+            return f'OVERRIDE_CALL(cpu, {func_name});'
+        return f'{func_name}(cpu);'
+
+    def call_name(self, inst: Instruction, func_start: int):
+        """Function a direct near or far call goes to, or None."""
+        op1 = inst.op1
+        if op1 and op1.type == OpType.REL16:
+            target = func_start + op1.disp
+            # Look up known function name at this address
+            if target in self.known_funcs:
+                return self.known_funcs[target]
+            return f'res_{target:06X}'
+        if op1 and op1.type == OpType.FAR:
+            # Resolve far call segment:offset to a known function.
+            # CIV.EXE has NO MZ relocations - the MSC overlay manager
+            # patches segment values at runtime. The linker-assigned
+            # segments need a correction to map to file offsets:
+            #   file_off = seg*16 + off - 0x14  (most segments)
+            #   file_off = seg*16 + off - 0x1A  (segment 0x205A)
+            # We try both corrected and uncorrected formulas.
+            seg = op1.far_seg
+            off = op1.disp
+            # Try corrected formula (seg-specific adjustment)
+            corr = 0x1A if seg == 0x205A else 0x14
+            far_file_off = seg * 16 + off - corr
+            if far_file_off in self.known_funcs:
+                return self.known_funcs[far_file_off]
+            # Try original formula (hdr_size + seg*16 + off)
+            far_file_off2 = self.hdr_size + seg * 16 + off
+            if far_file_off2 in self.known_funcs:
+                return self.known_funcs[far_file_off2]
+            return f'far_{seg:04X}_{off:04X}'
+        return None
+
+    @staticmethod
+    def _safe_point(inst: Instruction, target: int) -> str:
+        """RECOMP_SAFE_POINT prefix for a branch that is a loop back-edge."""
+        return 'RECOMP_SAFE_POINT(cpu); ' if target <= inst.address else ''
+
     def _emit_label(self, addr: int):
         """Emit a label if it's referenced."""
         if addr in self.labels_needed:
@@ -146,10 +606,18 @@ class Lifter:
         # Emit label if this address is a jump target
         self._emit_label(inst.address)
 
+        # Flag results of this instruction are never read
+        dead = inst.address in self.dead_flags
+
         # Format original instruction as comment
         raw_hex = ' '.join(f'{b:02X}' for b in inst.raw[:6])
         orig = repr(inst)
 
+        # Part of a converted native call site
+        site = self.sites.get(inst.address)
+        if site and self._emit_site(inst, site, func_start, orig):
+            return
+
         # ─── Data movement ───
 
         if m == 'mov':
@@ -165,15 +633,10 @@ class Lifter:
             _, off = _mem_addr(op2)
             self._emit(_write(op1, off), orig)
 
-        elif m == 'lds':
-            seg, off = _mem_addr(op2)
-            self._emit(f'{_reg16(op1)} = mem_read16(cpu, {seg}, {off});', orig)
-            self._emit(f'cpu->ds = mem_read16(cpu, {seg}, (uint16_t)({off} + 2));')
-
-        elif m == 'les':
-            seg, off = _mem_addr(op2)
-            self._emit(f'{_reg16(op1)} = mem_read16(cpu, {seg}, {off});', orig)
-            self._emit(f'cpu->es = mem_read16(cpu, {seg}, (uint16_t)({off} + 2));')
+        elif m in ('lds', 'les'):
+            off, seg = _mem_pair(op2)
+            self._emit(f'{_reg16(op1)} = {off};', orig)
+            self._emit(_set_sreg(m[1:], seg))
 
         elif m == 'cbw':
             self._emit('cpu->ax = (uint16_t)(int16_t)(int8_t)cpu->al;', orig)
@@ -190,10 +653,16 @@ class Lifter:
             self._emit(_write(op1, 'pop16(cpu)'), orig)
 
         elif m == 'pushf':
-            self._emit('push16(cpu, cpu->flags);', orig)
+            if self.lazy_flags:
+                self._emit('push16(cpu, flags_get(cpu));', orig)
+            else:
+                self._emit('push16(cpu, cpu->flags);', orig)
 
         elif m == 'popf':
-            self._emit('cpu->flags = pop16(cpu);', orig)
+            if self.lazy_flags:
+                self._emit('cpu->flags = pop16(cpu); cpu->lf_op = LF_NONE;', orig)
+            else:
+                self._emit('cpu->flags = pop16(cpu);', orig)
 
         elif m == 'pusha':
             self._emit('{ uint16_t _sp = cpu->sp; '
@@ -210,96 +679,97 @@ class Lifter:
 
         # ─── Arithmetic ───
 
-        elif m == 'add':
-            if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(_write(op1,
-                    f'flags_add8(cpu, {_read(op1)}, {_read(op2)})'), orig)
-            else:
-                self._emit(_write(op1,
-                    f'flags_add16(cpu, {_read(op1)}, {_read(op2)})'), orig)
+        elif m in ('add', 'sub') and dead:
+            sign = '+' if m == 'add' else '-'
+            self._emit(_write(op1, f'{_read(op1)} {sign} {_read(op2)}'), orig)
 
-        elif m == 'adc':
-            if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(_write(op1,
-                    f'flags_add8(cpu, {_read(op1)}, {_read(op2)} + cf(cpu))'), orig)
-            else:
-                self._emit(_write(op1,
-                    f'flags_add16(cpu, {_read(op1)}, {_read(op2)} + cf(cpu))'), orig)
+        elif m in ('add', 'sub'):
+            sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
+            self._emit(_write(op1,
+                f'{self._alu(m, sz)}(cpu, {_read(op1)}, {_read(op2)})'), orig)
 
-        elif m == 'sub':
-            if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(_write(op1,
-                    f'flags_sub8(cpu, {_read(op1)}, {_read(op2)})'), orig)
-            else:
-                self._emit(_write(op1,
-                    f'flags_sub16(cpu, {_read(op1)}, {_read(op2)})'), orig)
+        elif m in ('adc', 'sbb') and dead:
+            sign = '+' if m == 'adc' else '-'
+            self._emit(_write(op1, f'{_read(op1)} {sign} {_read(op2)} {sign} cf(cpu)'), orig)
 
-        elif m == 'sbb':
-            if op1.size == 1 or op1.type == OpType.REG8:
+        elif m in ('adc', 'sbb'):
+            sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
+            if self.lazy_flags:
                 self._emit(_write(op1,
-                    f'flags_sub8(cpu, {_read(op1)}, {_read(op2)} + cf(cpu))'), orig)
+                    f'lazy_{m}{sz}(cpu, {_read(op1)}, {_read(op2)})'), orig)
             else:
+                base = 'add' if m == 'adc' else 'sub'
                 self._emit(_write(op1,
-                    f'flags_sub16(cpu, {_read(op1)}, {_read(op2)} + cf(cpu))'), orig)
+                    f'flags_{base}{sz}(cpu, {_read(op1)}, {_read(op2)} + cf(cpu))'), orig)
+
+        elif m in ('cmp', 'test') and dead:
+            self._emit('/* flags dead */', orig)
 
         elif m == 'cmp':
-            if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(f'flags_cmp8(cpu, {_read(op1)}, {_read(op2)});', orig)
-            else:
-                self._emit(f'flags_cmp16(cpu, {_read(op1)}, {_read(op2)});', orig)
+            sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
+            self._emit(f'{self._alu("cmp", sz)}(cpu, {_read(op1)}, {_read(op2)});', orig)
 
-        elif m == 'inc':
-            if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(f'{{ int _cf = cf(cpu); '
-                           f'{_write(op1, f"flags_add8(cpu, {_read(op1)}, 1)")} '
-                           f'if (_cf) cpu->flags |= FLAG_CF; '
-                           f'else cpu->flags &= ~FLAG_CF; }}', orig)
+        elif m in ('inc', 'dec') and dead:
+            sign = '+' if m == 'inc' else '-'
+            self._emit(_write(op1, f'{_read(op1)} {sign} 1'), orig)
+
+        elif m in ('inc', 'dec'):
+            sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
+            if self.lazy_flags:
+                self._emit(_write(op1, f'lazy_{m}{sz}(cpu, {_read(op1)})'), orig)
             else:
+                base = 'add' if m == 'inc' else 'sub'
                 self._emit(f'{{ int _cf = cf(cpu); '
-                           f'{_write(op1, f"flags_add16(cpu, {_read(op1)}, 1)")} '
+                           f'{_write(op1, f"flags_{base}{sz}(cpu, {_read(op1)}, 1)")} '
                            f'if (_cf) cpu->flags |= FLAG_CF; '
                            f'else cpu->flags &= ~FLAG_CF; }}', orig)
 
-        elif m == 'dec':
+        elif m == 'neg' and dead:
+            self._emit(_write(op1, f'0 - {_read(op1)}'), orig)
+
+        elif m == 'neg':
+            sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
+            self._emit(_write(op1, f'{self._alu("sub", sz)}(cpu, 0, {_read(op1)})'), orig)
+
+        elif m == 'mul' and dead:
             if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(f'{{ int _cf = cf(cpu); '
-                           f'{_write(op1, f"flags_sub8(cpu, {_read(op1)}, 1)")} '
-                           f'if (_cf) cpu->flags |= FLAG_CF; '
-                           f'else cpu->flags &= ~FLAG_CF; }}', orig)
+                self._emit(f'cpu->ax = (uint16_t)((uint16_t)cpu->al * {_read(op1)});', orig)
             else:
-                self._emit(f'{{ int _cf = cf(cpu); '
-                           f'{_write(op1, f"flags_sub16(cpu, {_read(op1)}, 1)")} '
-                           f'if (_cf) cpu->flags |= FLAG_CF; '
-                           f'else cpu->flags &= ~FLAG_CF; }}', orig)
+                self._emit(f'{{ uint32_t _r = (uint32_t)cpu->ax * {_read(op1)}; '
+                           f'cpu->ax = (uint16_t)_r; cpu->dx = (uint16_t)(_r >> 16); }}', orig)
 
-        elif m == 'neg':
+        elif m == 'imul' and dead:
             if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(_write(op1, f'flags_sub8(cpu, 0, {_read(op1)})'), orig)
+                self._emit(f'cpu->ax = (uint16_t)((int16_t)(int8_t)cpu->al * '
+                           f'(int8_t){_read(op1)});', orig)
             else:
-                self._emit(_write(op1, f'flags_sub16(cpu, 0, {_read(op1)})'), orig)
+                self._emit(f'{{ int32_t _r = (int32_t)(int16_t)cpu->ax * '
+                           f'(int16_t){_read(op1)}; '
+                           f'cpu->ax = (uint16_t)_r; '
+                           f'cpu->dx = (uint16_t)((uint32_t)_r >> 16); }}', orig)
 
         elif m == 'mul':
             if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(f'{{ uint16_t _r = (uint16_t)cpu->al * {_read(op1)}; '
+                self._emit(f'{{ {self._sync()}uint16_t _r = (uint16_t)cpu->al * {_read(op1)}; '
                            f'cpu->ax = _r; '
                            f'cpu->flags = (cpu->flags & ~(FLAG_CF|FLAG_OF)) | '
                            f'(_r > 0xFF ? FLAG_CF|FLAG_OF : 0); }}', orig)
             else:
-                self._emit(f'{{ uint32_t _r = (uint32_t)cpu->ax * {_read(op1)}; '
+                self._emit(f'{{ {self._sync()}uint32_t _r = (uint32_t)cpu->ax * {_read(op1)}; '
                            f'cpu->ax = (uint16_t)_r; cpu->dx = (uint16_t)(_r >> 16); '
                            f'cpu->flags = (cpu->flags & ~(FLAG_CF|FLAG_OF)) | '
                            f'(cpu->dx ? FLAG_CF|FLAG_OF : 0); }}', orig)
 
         elif m == 'imul':
             if op1.size == 1 or op1.type == OpType.REG8:
-                self._emit(f'{{ int16_t _r = (int16_t)(int8_t)cpu->al * '
+                self._emit(f'{{ {self._sync()}int16_t _r = (int16_t)(int8_t)cpu->al * '
                            f'(int8_t){_read(op1)}; '
                            f'cpu->ax = (uint16_t)_r; '
                            f'cpu->flags = (cpu->flags & ~(FLAG_CF|FLAG_OF)) | '
                            f'((uint16_t)_r != (uint16_t)(int16_t)(int8_t)_r ? '
                            f'FLAG_CF|FLAG_OF : 0); }}', orig)
             else:
-                self._emit(f'{{ int32_t _r = (int32_t)(int16_t)cpu->ax * '
+                self._emit(f'{{ {self._sync()}int32_t _r = (int32_t)(int16_t)cpu->ax * '
                            f'(int16_t){_read(op1)}; '
                            f'cpu->ax = (uint16_t)_r; '
                            f'cpu->dx = (uint16_t)((uint32_t)_r >> 16); '
@@ -332,43 +802,55 @@ class Lifter:
 
         # ─── Logic ───
 
+        elif m in ('and', 'or', 'xor') and dead:
+            c_op = {'and': '&', 'or': '|', 'xor': '^'}[m]
+            self._emit(_write(op1, f'{_read(op1)} {c_op} {_read(op2)}'), orig)
+
         elif m == 'and':
             val = f'{_read(op1)} & {_read(op2)}'
             sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
             self._emit(f'{{ uint{sz}_t _r = {val}; '
-                       f'flags_logic{sz}(cpu, _r); '
+                       f'{self._alu("logic", sz)}(cpu, _r); '
                        f'{_write(op1, "_r")} }}', orig)
 
         elif m == 'or':
             val = f'{_read(op1)} | {_read(op2)}'
             sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
             self._emit(f'{{ uint{sz}_t _r = {val}; '
-                       f'flags_logic{sz}(cpu, _r); '
+                       f'{self._alu("logic", sz)}(cpu, _r); '
                        f'{_write(op1, "_r")} }}', orig)
 
         elif m == 'xor':
             val = f'{_read(op1)} ^ {_read(op2)}'
             sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
             self._emit(f'{{ uint{sz}_t _r = {val}; '
-                       f'flags_logic{sz}(cpu, _r); '
+                       f'{self._alu("logic", sz)}(cpu, _r); '
                        f'{_write(op1, "_r")} }}', orig)
 
         elif m == 'test':
             val = f'{_read(op1)} & {_read(op2)}'
             sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
-            self._emit(f'flags_logic{sz}(cpu, {val});', orig)
+            self._emit(f'{self._alu("logic", sz)}(cpu, {val});', orig)
 
         elif m == 'not':
             self._emit(_write(op1, f'~{_read(op1)}'), orig)
 
         # ─── Shifts ───
 
+        elif m in ('shl', 'sal', 'shr') and dead:
+            c_op = '>>' if m == 'shr' else '<<'
+            self._emit(_write(op1, f'{_read(op1)} {c_op} {_read(op2)}'), orig)
+
+        elif m == 'sar' and dead:
+            stype = 'int8_t' if (op1.size == 1 or op1.type == OpType.REG8) else 'int16_t'
+            self._emit(_write(op1, f'({stype}){_read(op1)} >> {_read(op2)}'), orig)
+
         elif m in ('shl', 'sal'):
             r = _read(op1)
             cnt = _read(op2)
             sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
             bits = 8 if sz == '8' else 16
-            self._emit(f'{{ uint{sz}_t _v = {r}; uint8_t _c = {cnt}; '
+            self._emit(f'{{ {self._sync()}uint{sz}_t _v = {r}; uint8_t _c = {cnt}; '
                        f'uint{sz}_t _r = _v << _c; '
                        f'cpu->flags = (cpu->flags & ~FLAG_CF) | '
                        f'((_v >> ({bits} - _c)) & 1 ? FLAG_CF : 0); '
@@ -379,7 +861,7 @@ class Lifter:
             r = _read(op1)
             cnt = _read(op2)
             sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
-            self._emit(f'{{ uint{sz}_t _v = {r}; uint8_t _c = {cnt}; '
+            self._emit(f'{{ {self._sync()}uint{sz}_t _v = {r}; uint8_t _c = {cnt}; '
                        f'uint{sz}_t _r = _v >> _c; '
                        f'cpu->flags = (cpu->flags & ~FLAG_CF) | '
                        f'((_v >> (_c - 1)) & 1 ? FLAG_CF : 0); '
@@ -391,7 +873,7 @@ class Lifter:
             cnt = _read(op2)
             sz = '8' if (op1.size == 1 or op1.type == OpType.REG8) else '16'
             stype = 'int8_t' if sz == '8' else 'int16_t'
-            self._emit(f'{{ {stype} _v = ({stype}){r}; uint8_t _c = {cnt}; '
+            self._emit(f'{{ {self._sync()}{stype} _v = ({stype}){r}; uint8_t _c = {cnt}; '
                        f'{stype} _r = _v >> _c; '
                        f'cpu->flags = (cpu->flags & ~FLAG_CF) | '
                        f'((_v >> (_c - 1)) & 1 ? FLAG_CF : 0); '
@@ -412,13 +894,14 @@ class Lifter:
                 target = op1.disp
                 if target in self.valid_addrs:
                     self.labels_needed.add(target)
-                    self._emit(f'goto {_label(target, self.func_name)};', orig)
+                    self._emit(f'{self._safe_point(inst, target)}goto {_label(target, self.func_name)};', orig)
                 elif target < 0:
                     # Negative target = jump to shared epilogue before function start.
                     # MSC 5.x shared epilogues do: mov sp,bp; pop bp; ret/retf
                     # The mov sp,bp unwinds all local vars and pushed regs.
                     ret_sz = 4 if self.is_far else 2
-                    self._emit(f'cpu->sp = (uint16_t)(cpu->bp); cpu->bp = (uint16_t)(pop16(cpu)); cpu->sp += {ret_sz}; return;',
+                    ret = 'return cpu->ax;' if self.native else f'cpu->sp += {ret_sz}; return;'
+                    self._emit(f'cpu->sp = (uint16_t)(cpu->bp); cpu->bp = (uint16_t)(pop16(cpu)); {ret}',
                                f'shared epilogue ({orig})')
                 else:
                     self._emit(f'/* jmp out of function to 0x{target:06X} */', orig)
@@ -429,17 +912,12 @@ class Lifter:
 
         elif m in ('jo','jno','jb','jae','je','jne','jbe','ja',
                     'js','jns','jp','jnp','jl','jge','jle','jg'):
-            CC_MAP = {
-                'jo': 'cc_o', 'jno': 'cc_no', 'jb': 'cc_b', 'jae': 'cc_ae',
-                'je': 'cc_e', 'jne': 'cc_ne', 'jbe': 'cc_be', 'ja': 'cc_a',
-                'js': 'cc_s', 'jns': 'cc_ns', 'jp': 'cc_p', 'jnp': 'cc_np',
-                'jl': 'cc_l', 'jge': 'cc_ge', 'jle': 'cc_le', 'jg': 'cc_g',
-            }
             target = op1.disp
             cc = CC_MAP[m]
             if target in self.valid_addrs:
                 self.labels_needed.add(target)
-                self._emit(f'if ({cc}(cpu)) goto {_label(target, self.func_name)};', orig)
+                self._emit(f'{self._safe_point(inst, target)}if ({cc}(cpu)) '
+                           f'goto {_label(target, self.func_name)};', orig)
             else:
                 self._emit(f'/* {m} out of function to 0x{target:06X} */', orig)
 
@@ -447,7 +925,8 @@ class Lifter:
             target = op1.disp
             if target in self.valid_addrs:
                 self.labels_needed.add(target)
-                self._emit(f'cpu->cx--; if (cpu->cx != 0) goto {_label(target, self.func_name)};', orig)
+                self._emit(f'{self._safe_point(inst, target)}cpu->cx--; if (cpu->cx != 0) '
+                           f'goto {_label(target, self.func_name)};', orig)
             else:
                 self._emit(f'/* loop out of function to 0x{target:06X} */', orig)
 
@@ -455,7 +934,7 @@ class Lifter:
             target = op1.disp
             if target in self.valid_addrs:
                 self.labels_needed.add(target)
-                self._emit(f'cpu->cx--; if (cpu->cx != 0 && zf(cpu)) '
+                self._emit(f'{self._safe_point(inst, target)}cpu->cx--; if (cpu->cx != 0 && zf(cpu)) '
                            f'goto {_label(target, self.func_name)};', orig)
             else:
                 self._emit(f'/* loopz out of function to 0x{target:06X} */', orig)
@@ -464,7 +943,7 @@ class Lifter:
             target = op1.disp
             if target in self.valid_addrs:
                 self.labels_needed.add(target)
-                self._emit(f'cpu->cx--; if (cpu->cx != 0 && !zf(cpu)) '
+                self._emit(f'{self._safe_point(inst, target)}cpu->cx--; if (cpu->cx != 0 && !zf(cpu)) '
                            f'goto {_label(target, self.func_name)};', orig)
             else:
                 self._emit(f'/* loopnz out of function to 0x{target:06X} */', orig)
@@ -473,52 +952,42 @@ class Lifter:
             target = op1.disp
             if target in self.valid_addrs:
                 self.labels_needed.add(target)
-                self._emit(f'if (cpu->cx == 0) goto {_label(target, self.func_name)};', orig)
+                self._emit(f'{self._safe_point(inst, target)}if (cpu->cx == 0) '
+                           f'goto {_label(target, self.func_name)};', orig)
             else:
                 self._emit(f'/* jcxz out of function to 0x{target:06X} */', orig)
 
         elif m == 'call':
             if op1 and op1.type == OpType.REL16:
-                target = func_start + op1.disp
-                # Look up known function name at this address
-                if target in self.known_funcs:
-                    func_name = self.known_funcs[target]
-                else:
-                    func_name = f'res_{target:06X}'
+                func_name = self.call_name(inst, func_start)
                 self.func_calls.add(func_name)
                 # Simulate NEAR CALL: push 2-byte return IP on CPU stack
-                self._emit(f'push16(cpu, 0);', f'near call return addr')
-                self._emit(f'{func_name}(cpu);', orig)
+                self._emit(f'{self._sync()}push16(cpu, 0);', f'near call return addr')
+                self._emit(self._call(func_name), orig)
             elif op1 and op1.type == OpType.FAR:
-                # Resolve far call segment:offset to a known function.
-                # CIV.EXE has NO MZ relocations - the MSC overlay manager
-                # patches segment values at runtime. The linker-assigned
-                # segments need a correction to map to file offsets:
-                #   file_off = seg*16 + off - 0x14  (most segments)
-                #   file_off = seg*16 + off - 0x1A  (segment 0x205A)
-                # We try both corrected and uncorrected formulas.
-                func_name = None
-                seg = op1.far_seg
-                off = op1.disp
-                # Try corrected formula (seg-specific adjustment)
-                corr = 0x1A if seg == 0x205A else 0x14
-                far_file_off = seg * 16 + off - corr
-                if far_file_off in self.known_funcs:
-                    func_name = self.known_funcs[far_file_off]
-                else:
-                    # Try original formula (hdr_size + seg*16 + off)
-                    far_file_off2 = self.hdr_size + seg * 16 + off
-                    if far_file_off2 in self.known_funcs:
-                        func_name = self.known_funcs[far_file_off2]
-                if not func_name:
-                    func_name = f'far_{seg:04X}_{off:04X}'
+                func_name = self.call_name(inst, func_start)
                 self.func_calls.add(func_name)
                 # Simulate FAR CALL: push 4-byte return CS:IP on CPU stack
-                self._emit(f'push16(cpu, cpu->cs); push16(cpu, 0);', f'far call return addr')
-                self._emit(f'{func_name}(cpu);', orig)
+                self._emit(f'{self._sync()}push16(cpu, cpu->cs); push16(cpu, 0);', f'far call return addr')
+                self._emit(self._call(func_name), orig)
             else:
+                # Near pointer: the caller's runtime CS isn't known here
                 self._emit(f'/* indirect call {repr(op1)} - needs dispatch */', orig)
 
+        elif m == 'call far' and op1 and op1.type == OpType.MEM:
+            # Far pointer in memory (function tables, callbacks): look the
+            # target up at runtime, same return-frame simulation as call FAR
+            self._emit(f'{self._sync()}push16(cpu, cpu->cs); push16(cpu, 0);', f'far call return addr')
+            self._emit(f'recomp_dispatch(cpu, {self._far_ptr(op1)});', orig)
+
+        elif m == 'jmp far' and op1 and op1.type == OpType.MEM:
+            # Tail call: the target's retf pops our caller's frame
+            self._emit(f'{self._sync()}recomp_dispatch(cpu, {self._far_ptr(op1)}); return;', orig)
+
+        elif m in ('ret', 'retf') and self.native:
+            # Native variant: no return address on the guest stack
+            self._emit('return cpu->ax;', orig)
+
         elif m == 'ret':
             # Simulate NEAR RET: pop 2-byte return IP + optional extra bytes
             if op1:
@@ -549,20 +1018,20 @@ class Lifter:
                     func_name = f'ovl{ovl_num:02d}_{ovl_off:04X}'
                 self.ovl_calls.add(func_name)
                 # Simulate FAR CALL for overlay dispatch
-                self._emit(f'push16(cpu, cpu->cs); push16(cpu, 0);',
+                self._emit(f'{self._sync()}push16(cpu, cpu->cs); push16(cpu, 0);',
                            f'overlay far call return addr')
-                self._emit(f'{func_name}(cpu);',
+                self._emit(self._call(func_name),
                            f'INT 3Fh -> OVL {ovl_num:02X}:{ovl_off:04X}')
             elif int_num == 0x21:
-                self._emit(f'dos_int21(cpu);', orig)
+                self._emit(f'{self._sync()}dos_int21(cpu);', orig)
             elif int_num == 0x10:
-                self._emit(f'bios_int10(cpu);', orig)
+                self._emit(f'{self._sync()}bios_int10(cpu);', orig)
             elif int_num == 0x16:
-                self._emit(f'bios_int16(cpu);', orig)
+                self._emit(f'{self._sync()}bios_int16(cpu);', orig)
             elif int_num == 0x33:
-                self._emit(f'mouse_int33(cpu);', orig)
+                self._emit(f'{self._sync()}mouse_int33(cpu);', orig)
             else:
-                self._emit(f'int_handler(cpu, 0x{int_num:02X});', orig)
+                self._emit(f'{self._sync()}int_handler(cpu, 0x{int_num:02X});', orig)
 
         # ─── String ops ───
 
@@ -595,39 +1064,42 @@ class Lifter:
                        f'cpu->si += df(cpu) ? -2 : 2;', orig)
 
         elif m == 'scasb':
-            self._emit(f'flags_cmp8(cpu, cpu->al, mem_read8(cpu, cpu->es, cpu->di)); '
+            self._emit(f'{self._alu("cmp", "8")}(cpu, cpu->al, mem_read8(cpu, cpu->es, cpu->di)); '
                        f'cpu->di += df(cpu) ? -1 : 1;', orig)
 
         elif m == 'scasw':
-            self._emit(f'flags_cmp16(cpu, cpu->ax, mem_read16(cpu, cpu->es, cpu->di)); '
+            self._emit(f'{self._alu("cmp", "16")}(cpu, cpu->ax, mem_read16(cpu, cpu->es, cpu->di)); '
                        f'cpu->di += df(cpu) ? -2 : 2;', orig)
 
         elif m == 'cmpsb':
-            self._emit(f'flags_cmp8(cpu, mem_read8(cpu, cpu->ds, cpu->si), '
+            self._emit(f'{self._alu("cmp", "8")}(cpu, mem_read8(cpu, cpu->ds, cpu->si), '
                        f'mem_read8(cpu, cpu->es, cpu->di)); '
                        f'cpu->si += df(cpu) ? -1 : 1; '
                        f'cpu->di += df(cpu) ? -1 : 1;', orig)
 
         elif m == 'cmpsw':
-            self._emit(f'flags_cmp16(cpu, mem_read16(cpu, cpu->ds, cpu->si), '
+            self._emit(f'{self._alu("cmp", "16")}(cpu, mem_read16(cpu, cpu->ds, cpu->si), '
                        f'mem_read16(cpu, cpu->es, cpu->di)); '
                        f'cpu->si += df(cpu) ? -2 : 2; '
                        f'cpu->di += df(cpu) ? -2 : 2;', orig)
 
         # ─── Flags ───
 
-        elif m == 'clc': self._emit('cpu->flags &= ~FLAG_CF;', orig)
-        elif m == 'stc': self._emit('cpu->flags |= FLAG_CF;', orig)
-        elif m == 'cmc': self._emit('cpu->flags ^= FLAG_CF;', orig)
+        elif m == 'clc': self._emit(f'{self._sync()}cpu->flags &= ~FLAG_CF;', orig)
+        elif m == 'stc': self._emit(f'{self._sync()}cpu->flags |= FLAG_CF;', orig)
+        elif m == 'cmc': self._emit(f'{self._sync()}cpu->flags ^= FLAG_CF;', orig)
         elif m == 'cld': self._emit('cpu->flags &= ~FLAG_DF;', orig)
         elif m == 'std': self._emit('cpu->flags |= FLAG_DF;', orig)
         elif m == 'cli': self._emit('cpu->flags &= ~FLAG_IF;', orig)
         elif m == 'sti': self._emit('cpu->flags |= FLAG_IF;', orig)
 
         elif m == 'sahf':
-            self._emit('cpu->flags = (cpu->flags & 0xFF00) | cpu->ah;', orig)
+            self._emit(f'{self._sync()}cpu->flags = (cpu->flags & 0xFF00) | cpu->ah;', orig)
         elif m == 'lahf':
-            self._emit('cpu->ah = (uint8_t)(cpu->flags & 0xFF);', orig)
+            if self.lazy_flags:
+                self._emit('cpu->ah = (uint8_t)(flags_get(cpu) & 0xFF);', orig)
+            else:
+                self._emit('cpu->ah = (uint8_t)(cpu->flags & 0xFF);', orig)
 
         # ─── Misc ───
 
@@ -658,7 +1130,7 @@ class Lifter:
                 port_expr = f'0x{op2.disp & 0xFF:02X}'
             else:
                 port_expr = _read(op2) if op2 else 'cpu->dx'
-            self._emit(_write(op1, f'port_in8(cpu, {port_expr})'), orig)
+            self._emit(self._sync() + _write(op1, f'port_in8(cpu, {port_expr})'), orig)
 
         elif m == 'out':
             if op1 and op1.type == OpType.IMM8:
@@ -666,7 +1138,7 @@ class Lifter:
             else:
                 port_expr = _read(op1) if op1 else 'cpu->dx'
             val_expr = _read(op2) if op2 else 'cpu->al'
-            self._emit(f'port_out8(cpu, {port_expr}, {val_expr});', orig)
+            self._emit(f'{self._sync()}port_out8(cpu, {port_expr}, {val_expr});', orig)
 
         elif m == 'wait':
             self._emit('/* wait */', orig)
@@ -694,66 +1166,306 @@ class Lifter:
         self.ovl_calls = set()
         self.func_name = name
         self.is_far = is_far
+        self.dgroup = name in self.dgroup_funcs
+        self.native = self.natives.get(name)
+        if self.native:
+            abi.frame_params(instructions, is_far, mark=True)
         self.indent = 1
 
         # Build set of valid instruction addresses for this function
         self.valid_addrs = set(inst.address for inst in instructions)
 
-        # First pass: collect jump targets for labels (only within function)
+        # Flag liveness: find ALU ops whose flag results are never read
+        self.dead_flags = set()
+        self.flag_ops = 0
+        self.flags_removed = 0
+        if self.flag_liveness:
+            live_out = compute_flag_liveness(instructions)
+            for inst, live in zip(instructions, live_out):
+                if inst.mnemonic not in FLAG_ELIDABLE:
+                    continue
+                self.flag_ops += 1
+                if not (_flag_effects(inst)[1] & live):
+                    self.dead_flags.add(inst.address)
+                    self.flags_removed += 1
+
+        # First pass: recover structured control flow, then collect the
+        # targets of branches that remain gotos (only within function)
+        self.insts = instructions
+        self.index = {inst.address: i for i, inst in enumerate(instructions)}
+        self.branch_refs = {}
         for inst in instructions:
-            m = inst.mnemonic
-            if m in ('jmp', 'jo','jno','jb','jae','je','jne','jbe','ja',
-                     'js','jns','jp','jnp','jl','jge','jle','jg',
-                     'loop', 'loopz', 'loopnz', 'jcxz'):
-                if inst.op1 and inst.op1.type in (OpType.REL8, OpType.REL16):
-                    target = inst.op1.disp
-                    if target in self.valid_addrs:
-                        self.labels_needed.add(target)
+            target = self._branch_target(inst)
+            if target is not None:
+                self.branch_refs[target] = self.branch_refs.get(target, 0) + 1
+        self.cf_stats = {}
+        if self.structure:
+            self.nodes = self._structure(0, len(instructions))
+        else:
+            self.nodes = [('inst', i) for i in range(len(instructions))]
+        self._collect_labels(self.nodes)
+        self.sites = {}
+        if self.natives:
+            self._plan_native_calls(func_start)
 
         # Second pass: generate C code
-        self.output.append(f'void {name}(CPU *cpu)')
+        if self.flags_removed:
+            self.output.append(f'/* flags: {self.flags_removed}/{self.flag_ops} '
+                               f'computations removed */')
+        if self.native:
+            self.output.append(abi.native_prototype(name, self.native[0]))
+        elif self.profile:
+            self.output.append(f'static void {name}_body(CPU *cpu)')
+        else:
+            self.output.append(f'void {name}(CPU *cpu)')
         self.output.append('{')
 
-        for inst in instructions:
-            if inst.prefix == 'rep' and inst.mnemonic in ('movsb','movsw','stosb','stosw'):
-                self._emit_label(inst.address)
-                self._emit(f'while (cpu->cx != 0) {{ cpu->cx--;', f'rep {inst.mnemonic}')
+        self.promoted = []
+        if self.promote_regs:
+            # Lift once to see which registers the body touches, then again
+            # with those registers held in locals.
+            header = self.output
+            self.output = []
+            self._lift_body(instructions, func_start)
+            self.promoted = promoted_registers(self.output)
+            self._spill = ' '.join(f'cpu->{r} = {_promoted_field(r)};'
+                                   for r in self.promoted)
+            self._reload = ' '.join(f'{_promoted_field(r)} = cpu->{r};'
+                                    for r in self.promoted)
+            self.output = header
+            for r in self.promoted:
+                if r in PROMOTE_WORD8:
+                    self._emit_line(f'Reg16 r_{r} = {{ cpu->{r} }};')
+                else:
+                    self._emit_line(f'uint16_t r_{r} = cpu->{r};')
+
+        self._emit_line('RECOMP_ENTER(cpu);')
+        entry = len(self.output)
+        self._lift_body(instructions, func_start)
+        if self.dgroup and any('(dg, ' in line for line in self.output[entry:]):
+            self.output.insert(entry, '    uint8_t *const dg = DGROUP_ENTER(cpu);')
+        temps = [val for kind, val in self.sites.values() if kind == 'push']
+        if temps:
+            # Declared up front: a push may follow a label
+            self.output.insert(entry, f'    uint16_t {", ".join(temps)};')
+
+        if self.promoted:
+            self._emit_line(self._spill)
+        if self.native and instructions[-1].mnemonic not in ('ret', 'retf', 'jmp'):
+            self._emit_line('return cpu->ax;')
+        self.output.append('}')
+        if self.native:
+            self.output += [''] + abi.shim(name, self.native[0], is_far)
+
+        if self.profile:
+            m = _OVL_NAME_RE.match(name)
+            ovl = int(m.group(1)) if m else -1
+            self.output[:0] = [f'static ProfSite prof_{name} = '
+                               f'{{ .name = "{name}", .overlay = {ovl} }};']
+            self.output += ['',
+                            f'void {name}(CPU *cpu)',
+                            '{',
+                            f'    prof_enter(&prof_{name});',
+                            f'    {name}_body(cpu);',
+                            f'    prof_exit(&prof_{name});',
+                            '}']
+
+        return '\n'.join(self.output)
+
+    def _lift_body(self, instructions: list, func_start: int):
+        """Emit the statements for all instructions of the function."""
+        self._emit_nodes(self.nodes, func_start)
+
+    def _lift_one(self, inst: Instruction, func_start: int):
+        """Lift one instruction, routing rep-prefixed string ops to string_ops.c."""
+        m = inst.mnemonic
+        src_seg = f'cpu->{inst.seg_override}' if inst.seg_override else 'cpu->ds'
+        if inst.prefix == 'rep' and m in ('movsb', 'movsw'):
+            self._emit_label(inst.address)
+            self._emit(f'rep_{m}(cpu, {src_seg});', f'rep {m}')
+        elif inst.prefix == 'rep' and m in ('stosb', 'stosw'):
+            self._emit_label(inst.address)
+            self._emit(f'rep_{m}(cpu);', f'rep {m}')
+        elif inst.prefix in ('rep', 'repnz') and m in ('cmpsb', 'cmpsw', 'scasb', 'scasw'):
+            repz = 1 if inst.prefix == 'rep' else 0
+            args = f'{src_seg}, {repz}' if m.startswith('cmps') else f'{repz}'
+            self._emit_label(inst.address)
+            # Helpers read DF and leave eager flags behind
+            self._emit(f'{self._sync()}rep_{m}(cpu, {args});',
+                       f'{"repz" if repz else "repnz"} {m}')
+        else:
+            self.lift_instruction(inst, func_start)
+
+    # ─── Control-flow structuring ───
+
+    def _branch_target(self, inst: Instruction):
+        """In-function target address of a direct branch, or None."""
+        if inst.mnemonic not in BRANCH_MNEMONICS:
+            return None
+        op = inst.op1
+        if op and op.type in (OpType.REL8, OpType.REL16) and op.disp in self.valid_addrs:
+            return op.disp
+        return None
+
+    def _target_index(self, i: int):
+        """Instruction index targeted by the branch at index i, or None."""
+        target = self._branch_target(self.insts[i])
+        return None if target is None else self.index[target]
+
+    def _count(self, kind: str):
+        self.cf_stats[kind] = self.cf_stats.get(kind, 0) + 1
+
+    def _structure(self, lo: int, hi: int) -> list:
+        """Build structured nodes for instruction range [lo, hi)."""
+        nodes = []
+        i = lo
+        while i < hi:
+            node, end = self._match_at(i, hi)
+            nodes.append(node)
+            i = end
+        return nodes
+
+    def _back_edge(self, head: int, lo: int, hi: int, mnemonics) -> int:
+        """Last index in [lo, hi) branching back to head, or -1."""
+        for k in range(hi - 1, lo - 1, -1):
+            inst = self.insts[k]
+            if inst.mnemonic in mnemonics and self._target_index(k) == head:
+                return k
+        return -1
+
+    def _match_at(self, i: int, hi: int) -> tuple:
+        """Match the largest construct starting at index i within [i, hi)."""
+        inst = self.insts[i]
+        m = inst.mnemonic
+        t = self._target_index(i)
+        jccs = tuple(JCC_READS)
+
+        # jmp C; B: body; C: cond; jcc B   (MSC while/for loop)
+        if m == 'jmp' and t is not None and t > i + 1:
+            k = self._back_edge(i + 1, t, hi, jccs)
+            if k >= 0:
+                self._count('while')
+                return ('while', i, self._structure(t, k), k,
+                        self._structure(i + 1, t)), k + 1
+
+        # jcxz X; H: body; loop H; X:   (counted loop)
+        if m == 'jcxz' and t is not None and t > i + 1:
+            k = t - 1
+            if k < hi and self.insts[k].mnemonic == 'loop' and \
+               self._target_index(k) == i + 1:
+                self._count('for')
+                return ('for', i, self._structure(i + 1, k), k), k + 1
+
+        # H: body; jcc/jmp/loop H   (loop with the test at the bottom)
+        k = self._back_edge(i, i, hi, jccs + ('jmp', 'loop', 'loopz', 'loopnz'))
+        if k >= 0:
+            self._count('loop')
+            return ('loop', self._structure(i, k), k), k + 1
+
+        # jcc T; then; [jmp E; T: else; E:]
+        if (m in JCC_READS or m == 'jcxz') and t is not None and i + 1 < t <= hi:
+            j = t - 1
+            if j > i and self.insts[j].mnemonic == 'jmp' and \
+               not self.branch_refs.get(self.insts[j].address):
+                e = self._target_index(j)
+                if e is not None and t < e <= hi:
+                    self._count('if-else')
+                    return ('if', i, self._structure(i + 1, j), j,
+                            self._structure(t, e)), e
+            self._count('if')
+            return ('if', i, self._structure(i + 1, t), None, None), t
+
+        return ('inst', i), i + 1
+
+    def _collect_labels(self, nodes: list):
+        """Mark the targets of branches that are still emitted as goto."""
+        for node in nodes:
+            kind = node[0]
+            if kind == 'inst':
+                target = self._branch_target(self.insts[node[1]])
+                if target is not None:
+                    self.labels_needed.add(target)
+            elif kind == 'if':
+                self._collect_labels(node[2])
+                if node[4]:
+                    self._collect_labels(node[4])
+            elif kind == 'while':
+                self._collect_labels(node[2])
+                self._collect_labels(node[4])
+            else:
+                self._collect_labels(node[1] if kind == 'loop' else node[2])
+
+    def _cond(self, i: int, negate: bool = False) -> str:
+        """C condition under which the branch at index i is taken."""
+        m = self.insts[i].mnemonic
+        if m == 'jcxz':
+            return 'cpu->cx != 0' if negate else 'cpu->cx == 0'
+        if m in LOOP_COND:
+            return LOOP_COND[m]
+        return f'{CC_MAP[CC_INVERSE[m] if negate else m]}(cpu)'
+
+    def _emit_block(self, nodes: list, func_start: int):
+        self.indent += 1
+        self._emit_nodes(nodes, func_start)
+        self.indent -= 1
+
+    def _emit_nodes(self, nodes: list, func_start: int):
+        """Emit C for a list of structured nodes."""
+        for node in nodes:
+            kind = node[0]
+            if kind == 'inst':
+                self._lift_one(self.insts[node[1]], func_start)
+
+            elif kind == 'if':
+                _, i, then, j, other = node
+                self._emit_label(self.insts[i].address)
+                self._emit(f'if ({self._cond(i, negate=True)}) {{', repr(self.insts[i]))
+                self._emit_block(then, func_start)
+                if j is not None:
+                    self._emit('} else {', repr(self.insts[j]))
+                    self._emit_block(other, func_start)
+                self._emit('}')
+
+            elif kind == 'loop':
+                _, body, k = node
+                back = self.insts[k]
+                if back.mnemonic == 'jmp':
+                    self._emit('for (;;) {')
+                else:
+                    self._emit('do {')
+                self._emit_block(body, func_start)
                 self.indent += 1
-                # Emit the string op body (set address to -1 to avoid duplicate label)
-                stripped = Instruction()
-                stripped.__dict__.update(inst.__dict__)
-                stripped.prefix = ''
-                stripped.address = -1
-                self.lift_instruction(stripped, func_start)
+                self._emit_label(back.address)
+                self._emit('RECOMP_SAFE_POINT(cpu);')
                 self.indent -= 1
-                self._emit('}')
-            elif inst.prefix == 'rep' and inst.mnemonic in ('scasb','scasw','cmpsb','cmpsw'):
-                self._emit_label(inst.address)
-                self._emit(f'while (cpu->cx != 0) {{ cpu->cx--;', f'repz {inst.mnemonic}')
+                if back.mnemonic == 'jmp':
+                    self._emit('}', repr(back))
+                else:
+                    self._emit(f'}} while ({self._cond(k)});', repr(back))
+
+            elif kind == 'for':
+                _, i, body, k = node
+                self._emit_label(self.insts[i].address)
+                self._emit('for (; cpu->cx != 0; cpu->cx--) {',
+                           f'{self.insts[i]!r} / {self.insts[k]!r}')
+                self._emit_block(body, func_start)
                 self.indent += 1
-                stripped = Instruction()
-                stripped.__dict__.update(inst.__dict__)
-                stripped.prefix = ''
-                stripped.address = -1
-                self.lift_instruction(stripped, func_start)
-                self._emit('if (!zf(cpu)) break;')
+                self._emit_label(self.insts[k].address)
+                self._emit('RECOMP_SAFE_POINT(cpu);')
                 self.indent -= 1
                 self._emit('}')
-            elif inst.prefix == 'repnz' and inst.mnemonic in ('scasb','scasw','cmpsb','cmpsw'):
-                self._emit_label(inst.address)
-                self._emit(f'while (cpu->cx != 0) {{ cpu->cx--;', f'repnz {inst.mnemonic}')
+
+            elif kind == 'while':
+                _, i, cond, k, body = node
+                self._emit_label(self.insts[i].address)
+                self._emit('for (;;) {', repr(self.insts[i]))
+                self._emit_block(cond, func_start)
+                self.indent += 1
+                self._emit_label(self.insts[k].address)
+                self._emit(f'if ({self._cond(k, negate=True)}) break;', repr(self.insts[k]))
+                self.indent -= 1
+                self._emit_block(body, func_start)
                 self.indent += 1
-                stripped = Instruction()
-                stripped.__dict__.update(inst.__dict__)
-                stripped.prefix = ''
-                stripped.address = -1
-                self.lift_instruction(stripped, func_start)
-                self._emit('if (zf(cpu)) break;')
+                self._emit('RECOMP_SAFE_POINT(cpu);')
                 self.indent -= 1
                 self._emit('}')
-            else:
-                self.lift_instruction(inst, func_start)
-
-        self.output.append('}')
-
-        return '\n'.join(self.output)
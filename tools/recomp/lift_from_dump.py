@@ -433,7 +433,9 @@ def main():
         out.write(' * AUTO-GENERATED by lift_from_dump.py - DO NOT EDIT\n')
         out.write(' * Source: civ_decompressed.bin (runtime EXEPACK dump)\n')
         out.write(' */\n\n')
-        out.write('#include "recomp/cpu.h"\n\n')
+        out.write('#include "recomp/cpu.h"\n')
+        out.write('#include "recomp/string_ops.h"\n')
+        out.write('#include "recomp/dispatch.h"\n\n')
         out.write('/* DOS/BIOS interrupt handlers */\n')
         out.write('extern void dos_int21(CPU *cpu);\n')
         out.write('extern void bios_int10(CPU *cpu);\n')
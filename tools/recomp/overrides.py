@@ -0,0 +1,110 @@
+"""
+overrides.py - Registry of hand-written overrides (civ_overrides.c)
+
+A function defined in civ_impl.c replaces the lifted function of the
+same name. The [overrides] section of civ.syms.toml lists the ones meant
+as exact, faster equivalents of the original:
+
+  res_01A2B4 = { clobbers = "bx cx dx es flags" }   # map scan
+
+clobbers names the registers (ax .. ss, flags) the override may leave
+with different values than the original did - typically the cdecl
+scratch registers. For every listed function recomp.py keeps the lifted
+code as NAME_lifted next to the hand-written NAME, calls it from lifted
+code through OVERRIDE_CALL and registers the pair in civ_overrides.c,
+so civ --verify-overrides can run both and diff the results (see
+include/recomp/override.h).
+
+Part of the Civ Recomp project (sp00nznet/civ)
+"""
+
+import io
+import re
+
+REGISTERS = ('ax', 'bx', 'cx', 'dx', 'si', 'di', 'bp', 'sp',
+             'cs', 'ds', 'es', 'ss', 'flags')
+
+_ENTRY_RE = re.compile(r'^(\w+)\s*=\s*\{([^}]*)\}\s*(?:#\s*(.*))?$')
+_CLOBBERS_RE = re.compile(r'clobbers\s*=\s*"([^"]*)"')
+
+
+class Override:
+    """One [overrides] entry."""
+
+    def __init__(self, name, clobbers=(), comment=''):
+        self.name = name
+        self.clobbers = list(clobbers)
+        self.comment = comment
+
+    @property
+    def lifted(self) -> str:
+        return f'{self.name}_lifted'
+
+    @property
+    def mask(self) -> str:
+        return ' | '.join(f'OVR_{r.upper()}' for r in self.clobbers) or '0'
+
+
+def load_overrides(syms_path: str) -> dict:
+    """Parse the [overrides] section of civ.syms.toml: name -> Override."""
+    overrides = {}
+    section = None
+    try:
+        with open(syms_path) as f:
+            for line in f:
+                s = line.strip()
+                if s.startswith('['):
+                    section = s.strip('[]')
+                    continue
+                if section != 'overrides':
+                    continue
+                m = _ENTRY_RE.match(s)
+                if not m:
+                    continue
+                c = _CLOBBERS_RE.search(m.group(2))
+                regs = c.group(1).split() if c else []
+                bad = [r for r in regs if r not in REGISTERS]
+                if bad:
+                    print(f"  [overrides] {m.group(1)}: unknown register(s) "
+                          f"{', '.join(bad)}, skipped")
+                    continue
+                overrides[m.group(1)] = Override(m.group(1), regs, m.group(3) or '')
+    except OSError:
+        pass
+    return overrides
+
+
+def rename_lifted(code: str, ov: Override) -> str:
+    """Lifted C of an overridden function, defining NAME_lifted instead."""
+    return code.replace(f'void {ov.name}(CPU *cpu)', f'void {ov.lifted}(CPU *cpu)', 1)
+
+
+def render_overrides_c(overrides: list, lifted: set, source: str = 'recomp.py') -> str:
+    """Source of civ_overrides.c, defining civ_overrides[]. Overrides whose
+    original isn't in lifted (it failed to lift) are registered without it."""
+    with io.StringIO() as out:
+        out.write('/*\n')
+        out.write(' * civ_overrides.c - Hand-written overrides and their lifted originals\n')
+        out.write(' *\n')
+        out.write(f' * AUTO-GENERATED by {source} - DO NOT EDIT\n')
+        out.write(' * From the [overrides] section of civ.syms.toml\n')
+        out.write(' */\n\n')
+        out.write('#include "recomp/override.h"\n')
+        for ov in overrides:
+            note = f' - {ov.comment}' if ov.comment else ''
+            out.write(f'\n/* {ov.name}{note} */\n')
+            out.write(f'void {ov.name}(CPU *cpu);\n')
+            orig = '0'
+            if ov.name in lifted:
+                out.write(f'void {ov.lifted}(CPU *cpu);\n')
+                orig = ov.lifted
+            out.write(f'Override override_{ov.name} = {{ .name = "{ov.name}", '
+                      f'.native = {ov.name}, .lifted = {orig}, .clobbers = {ov.mask} }};\n')
+        out.write('\nOverride *const civ_overrides[] = {\n')
+        for ov in overrides:
+            out.write(f'    &override_{ov.name},\n')
+        if not overrides:
+            out.write('    0,\n')
+        out.write('};\n\n')
+        out.write(f'const unsigned civ_override_count = {len(overrides)};\n')
+        return out.getvalue()
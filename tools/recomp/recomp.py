@@ -7,15 +7,29 @@ Reads CIV.EXE, detects all functions in resident code and overlays,
 lifts each function to C, and writes compilable output files split
 across multiple .c files for parallel compilation.
 
+Lifting runs on a process pool and is cached per function, keyed on the
+function's bytes, the lifter options and a hash of the decoder/lifter
+sources. Output files are only rewritten when their contents change, so
+an unchanged rerun touches nothing and CMake rebuilds nothing.
+
 Part of the Civ Recomp project (sp00nznet/civ)
 """
 
+import hashlib
+import io
+import json
+import multiprocessing
 import os
 import sys
 import struct
 from decode16 import Decoder
 from analyze import Analyzer
 from lift import Lifter
+import abi
+import dgroup
+import dispatch
+import exepack
+import overrides
 
 
 HEADER = """\
@@ -29,6 +43,11 @@ HEADER = """\
  */
 
 #include "recomp/cpu.h"
+#include "recomp/string_ops.h"
+#include "recomp/dispatch.h"
+#include "recomp/profile.h"
+#include "recomp/override.h"
+#include "civ_globals.h"
 
 /* Forward declarations */
 {forward_decls}
@@ -47,7 +66,108 @@ extern uint8_t port_in8(CPU *cpu, uint16_t port);
 """
 
 
-def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
+# ─── Output helpers ───
+
+def write_if_changed(path: str, content: str) -> bool:
+    """Write content to path unless it already holds exactly that."""
+    try:
+        with open(path, 'r') as f:
+            if f.read() == content:
+                return False
+    except OSError:
+        pass
+    with open(path, 'w') as f:
+        f.write(content)
+    return True
+
+
+# ─── Lift cache ───
+
+_TOOL_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def lifter_version() -> str:
+    """Hash of the decoder and lifter sources; any edit invalidates the cache."""
+    h = hashlib.sha256()
+    for name in ('decode16.py', 'lift.py', 'dgroup.py', 'abi.py'):
+        with open(os.path.join(_TOOL_DIR, name), 'rb') as f:
+            h.update(f.read())
+    return h.hexdigest()
+
+
+class LiftCache:
+    """Lifted functions on disk, one JSON file per content key."""
+
+    def __init__(self, path: str, context: str):
+        self.path = path
+        self.context = context      # lifter version + options + symbol map
+        self.hits = 0
+        self.misses = 0
+
+    def key(self, func, code: bytes, dg: bool) -> str:
+        h = hashlib.sha256(self.context.encode())
+        h.update(f'{func.name}:{func.start:X}:{int(func.is_far)}:{int(dg)}'.encode())
+        h.update(code)
+        return h.hexdigest()
+
+    def _file(self, key: str) -> str:
+        return os.path.join(self.path, key[:2], key + '.json')
+
+    def get(self, key: str):
+        try:
+            with open(self._file(key), 'r') as f:
+                result = json.load(f)
+        except (OSError, ValueError):
+            self.misses += 1
+            return None
+        self.hits += 1
+        return result
+
+    def put(self, key: str, result: dict):
+        path = self._file(key)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        tmp = path + '.tmp'
+        with open(tmp, 'w') as f:
+            json.dump(result, f)
+        os.replace(tmp, path)
+
+
+# ─── Lifting (runs in pool workers) ───
+
+_worker = {}
+
+
+def _init_worker(data: bytes, lifter_args: dict):
+    _worker['data'] = data
+    _worker['lifter_args'] = lifter_args
+
+
+def _lift_job(job: tuple) -> dict:
+    """Decode and lift one function: job = (name, start, end, is_far, dgroup)."""
+    name, start, end, is_far, dg = job
+    code = _worker['data'][start:end]
+    instructions = Decoder(code, base_offset=start).decode_range(0, len(code))
+    lifter = Lifter(dgroup_funcs={name} if dg else None, **_worker['lifter_args'])
+    try:
+        c_code = lifter.lift_function(name, instructions, start, is_far)
+    except Exception as e:
+        return {'error': str(e)}
+    return {
+        'code': c_code,
+        'calls': sorted(lifter.func_calls),
+        'ovl_calls': sorted(lifter.ovl_calls),
+        'flags_removed': lifter.flags_removed,
+        'flag_ops': lifter.flag_ops,
+        'cf_stats': lifter.cf_stats,
+    }
+
+
+def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50,
+              lazy_flags: bool = True, flag_liveness: bool = True,
+              flag_stats: bool = False, promote_regs: bool = False,
+              structure: bool = True, profile: bool = False,
+              dgroup_spec: bool = True, native_abi: bool = False,
+              jobs: int = 0, use_cache: bool = True):
     """Run the full recompilation pipeline."""
 
     print("=" * 60)
@@ -81,48 +201,17 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
 
     hdr_size = analyzer.hdr_size
 
-    # Lift each function
-    print("\n--- Phase 2: Lifting ---")
-    os.makedirs(output_dir, exist_ok=True)
-
-    all_lifted = []
-    all_names = set()
-    errors = 0
-
-    for func in sorted(analyzer.functions, key=lambda f: f.start):
-        # Decode instructions for this function
-        code = data[func.start:func.end]
-        decoder = Decoder(code, base_offset=func.start)
-        instructions = decoder.decode_range(0, len(code))
-
-        # Lift
-        lifter = Lifter(overlay_bases=overlay_bases, hdr_size=hdr_size,
-                         known_funcs=known_funcs)
-        try:
-            c_code = lifter.lift_function(
-                func.name, instructions, func.start, func.is_far)
-            all_lifted.append((func, c_code, lifter.func_calls, lifter.ovl_calls))
-            all_names.add(func.name)
-        except Exception as e:
-            print(f"  Error lifting {func.name}: {e}")
-            errors += 1
-
-    print(f"Lifted {len(all_lifted)} functions ({errors} errors)")
-
-    # Collect all referenced function names for forward declarations
-    all_referenced = set()
-    for func, code, calls, ovl_calls in all_lifted:
-        all_referenced.update(calls)
-        all_referenced.update(ovl_calls)
-    all_referenced.update(all_names)
-
-    forward_decls = '\n'.join(
-        f'void {name}(CPU *cpu);'
-        for name in sorted(all_referenced)
-    )
-
-    # Collect hand-written implementations BEFORE writing output files,
-    # so we can exclude them from the auto-generated recomp files too.
+    # Functions that run with DS = DGROUP, and the named globals in it
+    syms_path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'civ.syms.toml')
+    globals_ = dgroup.load_globals(syms_path)
+    dg_funcs = set()
+    if dgroup_spec:
+        dg_funcs = dgroup.dgroup_functions(analyzer.functions, hdr_size, overlay_bases)
+        print(f"DGROUP: {len(dg_funcs)}/{len(analyzer.functions)} functions specialized, "
+              f"{len(globals_)} named globals")
+
+    # Collect hand-written implementations BEFORE lifting, so we can
+    # exclude them from the auto-generated recomp files (and from --native-abi).
     import re
     impl_funcs = set()  # Functions in civ_impl.c/civ_aliases.c (exclude from recomp output)
     dump_funcs = set()  # Functions in civ_dump_lifted.c (only exclude from stubs, NOT from recomp)
@@ -151,6 +240,131 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
     if dump_funcs:
         print(f"  Found {len(dump_funcs)} dump-lifted functions to exclude from stubs")
 
+    # Registered overrides keep their lifted original for --verify-overrides
+    lifted_names = {f.name for f in analyzer.functions}
+    registry = {}
+    for name, ov in overrides.load_overrides(syms_path).items():
+        if name not in impl_funcs:
+            print(f"  [overrides] {name}: not hand-written in civ_impl.c, skipped")
+        elif name not in lifted_names:
+            print(f"  [overrides] {name}: no lifted original, skipped")
+        else:
+            registry[name] = ov
+    if registry:
+        print(f"  {len(registry)} registered overrides")
+
+    # Leaf / near-leaf cdecl functions lifted with C parameters (abi.py)
+    natives = {}
+    if native_abi and profile:
+        print("Native ABI: off with --profile")
+    elif native_abi:
+        resolve = Lifter(overlay_bases=overlay_bases, hdr_size=hdr_size,
+                         known_funcs=known_funcs).call_name
+        natives = abi.native_functions(abi.native_candidates(
+            analyzer.functions, data, resolve, exclude=impl_funcs))
+        print(f"Native ABI: {len(natives)}/{len(analyzer.functions)} functions "
+              f"lifted with C parameters")
+
+    # Lift each function
+    print("\n--- Phase 2: Lifting ---")
+    os.makedirs(output_dir, exist_ok=True)
+
+    lifter_args = dict(overlay_bases=overlay_bases, hdr_size=hdr_size,
+                       known_funcs=known_funcs, lazy_flags=lazy_flags,
+                       flag_liveness=flag_liveness, promote_regs=promote_regs,
+                       structure=structure, profile=profile, globals_=globals_,
+                       natives=natives, overrides=set(registry))
+    # Everything besides the function's own bytes that shapes its output
+    context = json.dumps([lifter_version(), sorted(known_funcs.items()),
+                          sorted(overlay_bases.items()), hdr_size,
+                          lazy_flags, flag_liveness, promote_regs, structure,
+                          profile, [(g.name, g.offset, g.type, g.count, g.stride)
+                                    for g in globals_], sorted(natives.items()),
+                          sorted(registry)])
+    cache = LiftCache(os.path.join(output_dir, '.recomp_cache'), context) if use_cache else None
+
+    funcs = sorted(analyzer.functions, key=lambda f: f.start)
+    results = [None] * len(funcs)
+    keys = [None] * len(funcs)
+    pending = []
+    for i, func in enumerate(funcs):
+        if cache:
+            keys[i] = cache.key(func, data[func.start:func.end], func.name in dg_funcs)
+            results[i] = cache.get(keys[i])
+        if results[i] is None:
+            pending.append(i)
+
+    jobs = jobs or os.cpu_count() or 1
+    work = [(funcs[i].name, funcs[i].start, funcs[i].end, funcs[i].is_far,
+             funcs[i].name in dg_funcs) for i in pending]
+    if jobs > 1 and len(work) > 1:
+        with multiprocessing.Pool(min(jobs, len(work)), initializer=_init_worker,
+                                  initargs=(data, lifter_args)) as pool:
+            lifted = pool.map(_lift_job, work, chunksize=8)
+    else:
+        _init_worker(data, lifter_args)
+        lifted = [_lift_job(job) for job in work]
+    for i, result in zip(pending, lifted):
+        results[i] = result
+        if cache and 'error' not in result:
+            cache.put(keys[i], result)
+
+    all_lifted = []
+    all_names = set()
+    errors = 0
+    flag_counts = []    # (name, removed, total) from the flag-liveness pass
+    cf_totals = {}      # Structured constructs by kind
+
+    for func, result in zip(funcs, results):
+        if 'error' in result:
+            print(f"  Error lifting {func.name}: {result['error']}")
+            errors += 1
+            continue
+        all_lifted.append((func, result['code'], set(result['calls']), set(result['ovl_calls'])))
+        all_names.add(func.name)
+        flag_counts.append((func.name, result['flags_removed'], result['flag_ops']))
+        for kind, n in result['cf_stats'].items():
+            cf_totals[kind] = cf_totals.get(kind, 0) + n
+
+    print(f"Lifted {len(all_lifted)} functions ({errors} errors)")
+    if cache:
+        print(f"  Cache: {cache.hits} hits, {len(pending)} lifted on {jobs} job(s)")
+
+    if structure:
+        kinds = ', '.join(f'{n} {kind}' for kind, n in sorted(cf_totals.items()))
+        print(f"Control flow: {kinds or 'nothing'} structured")
+
+    if flag_liveness:
+        removed = sum(r for _, r, _ in flag_counts)
+        total = sum(t for _, _, t in flag_counts)
+        pct = 100.0 * removed / total if total else 0.0
+        print(f"Flag liveness: {removed}/{total} flag computations removed ({pct:.1f}%)")
+        if flag_stats:
+            print(f"  {'function':<20} {'removed':>8} {'total':>8}")
+            for name, r, t in sorted(flag_counts, key=lambda c: -c[1]):
+                if t:
+                    print(f"  {name:<20} {r:>8} {t:>8}")
+
+    # Collect all referenced function names for forward declarations
+    all_referenced = set()
+    for func, code, calls, ovl_calls in all_lifted:
+        all_referenced.update(calls)
+        all_referenced.update(ovl_calls)
+    all_referenced.update(all_names)
+
+    forward_decls = '\n'.join(
+        f'void {name}(CPU *cpu);'
+        for name in sorted(all_referenced)
+    )
+    native_decls = [abi.native_prototype(name, natives[name][0]) + ';'
+                    for name in sorted(all_referenced) if name in natives]
+    if native_decls:
+        forward_decls += '\n' + '\n'.join(native_decls)
+    override_decls = [f'extern Override override_{name};'
+                      for name in sorted(all_referenced) if name in registry]
+    if override_decls:
+        forward_decls += '\n' + '\n'.join(override_decls)
+
     # Write output files (split across multiple .c files)
     print(f"\n--- Phase 3: Output ---")
 
@@ -158,6 +372,7 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
     func_idx = 0
     total_files = 0
     impl_skipped = 0
+    unchanged = 0
 
     while func_idx < len(all_lifted):
         batch = all_lifted[func_idx:func_idx + funcs_per_file]
@@ -166,13 +381,19 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
         filename = f'civ_recomp_{file_idx:03d}.c'
         filepath = os.path.join(output_dir, filename)
 
-        with open(filepath, 'w') as out:
+        with io.StringIO() as out:
             out.write(HEADER.format(
                 filename=filename,
                 forward_decls=forward_decls,
             ))
             for func, code, calls, ovl_calls in batch:
                 # Skip functions that have hand-written implementations
+                if func.name in registry:
+                    out.write(f'\n/* {func.name}: overridden in civ_impl.c, lifted original '
+                              f'for --verify-overrides */\n')
+                    out.write(overrides.rename_lifted(code, registry[func.name]))
+                    out.write('\n\n')
+                    continue
                 if func.name in impl_funcs:
                     out.write(f'\n/* {func.name}: excluded (hand-written in civ_impl.c) */\n\n')
                     impl_skipped += 1
@@ -185,12 +406,18 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
                 out.write(f' */\n')
                 out.write(code)
                 out.write('\n\n')
+            changed = write_if_changed(filepath, out.getvalue())
 
         total_files += 1
         file_idx += 1
         funcs_in_file = len(batch)
-        print(f"  {filename}: {funcs_in_file} functions")
+        if changed:
+            print(f"  {filename}: {funcs_in_file} functions")
+        else:
+            unchanged += 1
 
+    if unchanged:
+        print(f"  {unchanged} of {total_files} files unchanged")
     if impl_skipped:
         print(f"  Skipped {impl_skipped} functions (hand-written in civ_impl.c)")
 
@@ -216,7 +443,7 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
 
     if unresolved:
         stub_file = os.path.join(output_dir, 'civ_stubs.c')
-        with open(stub_file, 'w') as out:
+        with io.StringIO() as out:
             out.write('/*\n * civ_stubs.c - Stub functions for unresolved symbols\n')
             out.write(' * AUTO-GENERATED by recomp.py\n')
             out.write(' *\n * These functions are referenced by the recompiled code but were\n')
@@ -227,7 +454,7 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
             out.write(' * Each stub logs a warning when called.\n')
             out.write(' */\n\n')
             out.write('#include "recomp/cpu.h"\n')
-            out.write('#include <stdio.h>\n\n')
+            out.write('#include "recomp/log.h"\n\n')
             for name in sorted(unresolved):
                 # Determine return type: far calls (far_*, ovl*) use retf (sp += 4),
                 # near calls (res_*) use ret (sp += 2)
@@ -236,23 +463,69 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
                 else:
                     ret_adj = 2  # near ret
                 out.write(f'void {name}(CPU *cpu) {{\n')
-                out.write(f'    (void)cpu;\n')
-                out.write(f'    static int _count = 0; _count++;\n')
-                out.write(f'    if (_count == 1 || (_count % 10000) == 0) fprintf(stderr, "[STUB] {name} called (n=%d)\\n", _count);\n')
+                out.write(f'    LOG_SAMPLED(LOG_LEVEL_WARN, LOG_DIAG, 1, 10000, "[STUB] {name} called (n=%llu)\\n",\n')
+                out.write(f'                (unsigned long long)log_hit);\n')
                 out.write(f'    cpu->sp += {ret_adj}; /* {"far" if ret_adj == 4 else "near"} ret */\n')
                 out.write(f'}}\n\n')
+                if name in natives:
+                    # Native callers reach it directly (lift error)
+                    out.write(f'{abi.native_prototype(name, natives[name][0])} {{\n')
+                    out.write(f'    LOG_SAMPLED(LOG_LEVEL_WARN, LOG_DIAG, 1, 10000, "[STUB] {abi.native_name(name)} called (n=%llu)\\n",\n')
+                    out.write(f'                (unsigned long long)log_hit);\n')
+                    out.write(f'    return cpu->ax;\n')
+                    out.write(f'}}\n\n')
+            write_if_changed(stub_file, out.getvalue())
         print(f"  civ_stubs.c: {len(unresolved)} stub functions")
 
+    # Write seg:off dispatch table for indirect far calls
+    far_names = {f.name for f, _, _, _ in all_lifted if f.is_far and not f.is_overlay}
+    far_names |= {n for n in all_referenced | all_impl if n.startswith('far_')}
+    entries = dispatch.collect_entries(
+        far_names, dispatch.load_explicit(syms_path),
+        defined=all_names | all_impl | unresolved)
+    write_if_changed(os.path.join(output_dir, 'civ_dispatch.c'), dispatch.render_dispatch_c(entries))
+    n = len(entries)
+    print(f"  civ_dispatch.c: {n} dispatch entries")
+
+    # Override registry
+    write_if_changed(os.path.join(output_dir, 'civ_overrides.c'),
+                     overrides.render_overrides_c([registry[n] for n in sorted(registry)],
+                                                  all_names))
+    print(f"  civ_overrides.c: {len(registry)} overrides")
+
+    # EXEPACK-decompressed, relocated resident image for startup
+    image = exepack.unpack(data)
+    write_if_changed(os.path.join(output_dir, 'civ_image.c'), exepack.render_image_c(image))
+    if image:
+        print(f"  civ_image.c: {len(image.data)} byte startup image, "
+              f"{image.relocs} relocations")
+    else:
+        print(f"  civ_image.c: no EXEPACK header, empty startup image")
+
+    # Named DGROUP globals for lifted and hand-written code
+    write_if_changed(os.path.join(output_dir, 'civ_globals.h'), dgroup.render_globals_h(globals_))
+    print(f"  civ_globals.h: {len(globals_)} globals")
+
     # Write master header
     header_path = os.path.join(output_dir, 'civ_recomp.h')
-    with open(header_path, 'w') as out:
+    with io.StringIO() as out:
         out.write('/* civ_recomp.h - Master header for recompiled Civilization code\n')
         out.write(' * AUTO-GENERATED by recomp.py\n */\n\n')
         out.write('#ifndef CIV_RECOMP_H\n#define CIV_RECOMP_H\n\n')
-        out.write('#include "recomp/cpu.h"\n\n')
+        out.write('#include "recomp/cpu.h"\n')
+        out.write('#include "recomp/dispatch.h"\n')
+        out.write('#include "recomp/override.h"\n')
+        out.write('#include "recomp/startup.h"\n\n')
+        if profile:
+            out.write('/* Lifted with --profile: the profiler is one process-wide call stack */\n')
+            out.write('#define CIV_PROFILED 1\n\n')
         out.write('/* All recompiled functions */\n')
         for name in sorted(all_names):
             out.write(f'void {name}(CPU *cpu);\n')
+        if natives:
+            out.write('\n/* C-parameter variants (--native-abi) */\n')
+            for name in sorted(all_names & natives.keys()):
+                out.write(f'{abi.native_prototype(name, natives[name][0])};\n')
         out.write(f'\n/* Entry point (resident code startup) */\n')
         # Find the entry point function
         entry_cs = struct.unpack_from('<H', data, 22)[0]
@@ -261,7 +534,15 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
         entry_off = hdr_size + entry_cs * 16 + entry_ip
         entry_name = f'res_{entry_off:06X}'
         out.write(f'#define CIV_ENTRY_POINT {entry_name}\n\n')
+        out.write('/* Indirect far call targets (civ_dispatch.c) */\n')
+        out.write('extern const DispatchTable civ_dispatch_table;\n\n')
+        out.write('/* Hand-written overrides with lifted originals (civ_overrides.c) */\n')
+        out.write('extern Override *const civ_overrides[];\n')
+        out.write('extern const unsigned civ_override_count;\n\n')
+        out.write('/* Pre-baked startup image (civ_image.c) */\n')
+        out.write('extern const StartupImage civ_startup_image;\n\n')
         out.write('#endif /* CIV_RECOMP_H */\n')
+        write_if_changed(header_path, out.getvalue())
 
     # Summary
     total_instructions = sum(f.inst_count for f, _, _, _ in all_lifted)
@@ -277,17 +558,45 @@ def recompile(exe_path: str, output_dir: str, funcs_per_file: int = 50):
 
 
 def main():
-    if len(sys.argv) < 2:
-        print("Usage: recomp.py <civ.exe> [output_dir] [funcs_per_file]")
+    opts = [a for a in sys.argv[1:] if a.startswith('--')]
+    args = [a for a in sys.argv[1:] if not a.startswith('--')]
+
+    if len(args) < 1:
+        print("Usage: recomp.py <civ.exe> [output_dir] [funcs_per_file] [options]")
         print("\nFull static recompilation pipeline.")
         print("Outputs compilable C code from CIV.EXE.")
+        print("\nOptions:")
+        print("  --eager-flags       Compute all flags after every ALU op (no lazy flags)")
+        print("  --no-flag-liveness  Keep flag computations even when provably dead")
+        print("  --flag-stats        Print per-function flag-liveness statistics")
+        print("  --promote-regs      Keep registers in C locals, spilled around calls")
+        print("  --no-structure      Emit every branch as goto (no if/loop recovery)")
+        print("  --profile           Instrument functions for civ_profile.folded/.txt")
+        print("  --no-dgroup         Don't lift DS-relative accesses as direct DGROUP loads")
+        print("  --native-abi        Lift leaf cdecl functions with C parameters and returns")
+        print("  --jobs=N            Lift on N processes (default: all cores)")
+        print("  --no-cache          Re-lift every function (ignore .recomp_cache)")
         sys.exit(1)
 
-    exe_path = sys.argv[1]
-    output_dir = sys.argv[2] if len(sys.argv) >= 3 else 'RecompiledFuncs'
-    funcs_per_file = int(sys.argv[3]) if len(sys.argv) >= 4 else 50
-
-    recompile(exe_path, output_dir, funcs_per_file)
+    exe_path = args[0]
+    output_dir = args[1] if len(args) >= 2 else 'RecompiledFuncs'
+    funcs_per_file = int(args[2]) if len(args) >= 3 else 50
+
+    jobs = 0
+    for opt in opts:
+        if opt.startswith('--jobs='):
+            jobs = int(opt.split('=', 1)[1])
+
+    recompile(exe_path, output_dir, funcs_per_file,
+              lazy_flags='--eager-flags' not in opts,
+              flag_liveness='--no-flag-liveness' not in opts,
+              flag_stats='--flag-stats' in opts,
+              promote_regs='--promote-regs' in opts,
+              structure='--no-structure' not in opts,
+              profile='--profile' in opts,
+              dgroup_spec='--no-dgroup' not in opts,
+              native_abi='--native-abi' in opts,
+              jobs=jobs, use_cache='--no-cache' not in opts)
 
 
 if __name__ == '__main__':